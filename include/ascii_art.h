@@ -1,6 +1,9 @@
 #ifndef ASCII_ART_H
 #define ASCII_ART_H
 
+#include "edge.h"
+#include "pyramid.h"
+
 // ASCII字符画风格枚举
 typedef enum
 {
@@ -8,9 +11,18 @@ typedef enum
     ASCII_STYLE_EXTENDED, // 扩展字符集 (13个字符)
     ASCII_STYLE_BLOCKS,   // 块状字符集 (ASCII兼容)
     ASCII_STYLE_DENSE,    // 密集字符集 (15个字符)
-    ASCII_STYLE_CLASSIC   // 经典字符集 (完全ASCII兼容)
+    ASCII_STYLE_CLASSIC,  // 经典字符集 (完全ASCII兼容)
+    ASCII_STYLE_EDGES     // 边缘方向字符 (| / - \ _)，其余字符块按亮度使用扩展字符集
 } ascii_style_t;
 
+// ANSI 彩色输出模式
+typedef enum
+{
+    ASCII_COLOR_NONE,     // 不输出颜色
+    ASCII_COLOR_256,      // xterm 256 色 (ESC[38;5;Nm)
+    ASCII_COLOR_TRUECOLOR // 24 位真彩色 (ESC[38;2;R;G;Bm)
+} ascii_color_t;
+
 /**
  * @brief 将图像转换为 ASCII 字符画并保存到文件中。
  * @param data 图像数据。
@@ -44,4 +56,93 @@ int image_to_ascii_styled(unsigned char *data,
                           ascii_style_t style,
                           float gamma);
 
+/**
+ * @brief 使用图像金字塔中合适的缩小层生成简单风格的 ASCII 字符画。
+ *
+ * 缩小倍数取能整除 scale_factor 的最大层，输出与在原图上采样基本一致，但读取的像素少得多。
+ * @param pyramid 图像金字塔。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_pyramid(const image_pyramid_t *pyramid, const char *output_file, int scale_factor);
+
+/**
+ * @brief 使用图像金字塔中合适的缩小层生成指定风格的 ASCII 字符画。
+ * @param pyramid 图像金字塔。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值，用于调整对比度 (0.5-2.0，默认0.8)。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_styled_pyramid(
+    const image_pyramid_t *pyramid, const char *output_file, int scale_factor, ascii_style_t style, float gamma);
+
+/**
+ * @brief 使用图像金字塔和原图的梯度场生成边缘方向风格 (ASCII_STYLE_EDGES) 的 ASCII 字符画。
+ *
+ * 亮度在金字塔的缩小层上采样，方向字符由原图梯度场按字符块汇总得到，梯度场可以与
+ * sobel_edge_detect_gradient 共用，边缘检测和字符画只计算一次梯度。
+ * @param pyramid 图像金字塔。
+ * @param gradient 原图的梯度场（尺寸必须与金字塔第0层相同），NULL 表示在采样层上计算。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param gamma 伽马校正值，用于调整对比度 (0.5-2.0，默认0.8)。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_edges_pyramid(const image_pyramid_t *pyramid,
+                                 const sobel_gradient_t *gradient,
+                                 const char *output_file,
+                                 int scale_factor,
+                                 float gamma);
+
+/**
+ * @brief 将图像转换为带 ANSI 颜色的 ASCII 字符画，颜色取每个字符块的平均 RGB。
+ *
+ * 颜色先量化到每通道5位（256色模式再经查找表映射到 xterm 调色板），只有量化后的颜色与前一个字符不同时
+ * 才输出新的转义序列；前景模式下空格不显示颜色，不会打断相同颜色的连续段。每行先在缓冲区中拼好再一次写出，
+ * 行尾重置颜色。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param output_file 输出文件路径，NULL 表示写标准输出。
+ * @param scale_factor 缩放因子，用于调整输出字符画的大小，值越大输出越小。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值，用于调整对比度 (0.5-2.0，默认0.8)。
+ * @param color 彩色输出模式，ASCII_COLOR_NONE 时只输出字符。
+ * @param background 为1时颜色作为背景色（字符保持终端默认前景色），为0时作为字符的前景色。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_color(const unsigned char *data,
+                         int width,
+                         int height,
+                         int channels,
+                         const char *output_file,
+                         int scale_factor,
+                         ascii_style_t style,
+                         float gamma,
+                         ascii_color_t color,
+                         int background);
+
+/**
+ * @brief 使用图像金字塔中合适的缩小层生成带 ANSI 颜色的 ASCII 字符画（见 image_to_ascii_color）。
+ * @param pyramid 图像金字塔。
+ * @param output_file 输出文件路径，NULL 表示写标准输出。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值，用于调整对比度 (0.5-2.0，默认0.8)。
+ * @param color 彩色输出模式，ASCII_COLOR_NONE 时只输出字符。
+ * @param background 为1时颜色作为背景色（字符保持终端默认前景色），为0时作为字符的前景色。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_color_pyramid(const image_pyramid_t *pyramid,
+                                 const char *output_file,
+                                 int scale_factor,
+                                 ascii_style_t style,
+                                 float gamma,
+                                 ascii_color_t color,
+                                 int background);
+
 #endif
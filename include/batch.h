@@ -1,9 +1,62 @@
 #ifndef BATCH_H
 #define BATCH_H
 
+// --workers 允许的最大工作进程数
+#define BATCH_MAX_WORKERS 256
+
+// batch_process 和 batch_run_workers 的 resume 参数
+#define BATCH_FRESH 0         // 删除全部进程的进度日志，从头处理（--fresh）
+#define BATCH_RESUME 1        // 重放进度日志，输出的字节数和修改时间与记录一致即视为已完成（默认）
+#define BATCH_RESUME_VERIFY 2 // 同 BATCH_RESUME，并重读每个输出核对 CRC-32（--verify）
+
+/**
+ * @brief 多个进程分担同一个 batch_input 目录时，本进程负责的部分。
+ *
+ * 两种划分方式：按文件名哈希静态分片（shard_count > 1，各进程处理 FNV-1a(文件名) % shard_count
+ * 等于 shard_index 的文件，不需要任何通信）；或按认领动态划分（claim_id 非 NULL，每幅图像开始处理前
+ * 以 O_CREAT|O_EXCL 在 batch_output/.claims/<claim_id>/ 下创建认领文件，创建成功的进程处理它，
+ * 处理得快的进程自然认领得多）。两者都只依赖文件系统，共享同一文件系统的多台主机同样可以分担。
+ */
+typedef struct
+{
+    int shard_index;      // 本进程的分片号（0 到 shard_count-1）
+    int shard_count;      // 分片数，<=1 表示不按哈希分片
+    const char *claim_id; // 认领目录名（同一次运行的各进程相同），NULL 表示不认领
+    int progress_fd;      // 每处理完一幅图像向它写一行 "ok <文件名>" 或 "failed <文件名>"，-1 表示不写
+} batch_shard_t;
+
 /**
  * @brief 执行批量图像处理。
+ * @param edge_ops 对边缘检测结果继续应用的效果链（格式见 effects_parse，例如 "close:3,open:3"），NULL 表示不处理。
+ * @param ops 对每幅原图应用的效果链（例如 "bilateral:16:30"），结果保存到 ops 子目录，NULL 表示不输出。
+ * @param dedupe_distance 按感知哈希去重：与已处理图像（包括以往批处理记录在输出目录 phash_index.txt 中的图像）
+ *                        的距离不超过它的图像不再处理，输出改为指向原图输出的符号链接；负数表示不去重。
+ *                        去重索引只属于一个进程，不能与 shard 同时使用。
+ * @param shard 多进程分担时本进程负责的部分，NULL 表示处理全部图像。
+ * @param resume BATCH_RESUME 时重放输出目录 .journal 中的进度日志，跳过以往（中断的）运行已完整写出的输出，
+ *               全部输出都已完成的图像不再解码；BATCH_FRESH 表示删除 .journal 中全部进程的日志，全部重新处理。
+ *               每个输出先写到同一目录的临时文件再原子改名，完成后在进度日志中记录它的字节数、修改时间和 CRC-32，
+ *               续跑时字节数和修改时间都与记录一致的输出才算已完成；BATCH_RESUME_VERIFY 时还要重读输出，
+ *               CRC-32 也一致才算已完成（读全部输出，代价与重新读一遍输出目录相同）。
+ * @return 成功返回1，效果链无效或无法创建输出目录、读取输入目录、打开进度日志时返回0。
+ */
+int batch_process(const char *edge_ops, const char *ops, int dedupe_distance, const batch_shard_t *shard, int resume);
+
+/**
+ * @brief 以多个本地工作进程执行批量处理，当前进程作为协调者汇总进度和结果。
+ *
+ * 在启动任何线程之前创建 workers 个子进程，每个子进程以自己的分片（claim_id 为 NULL 时按文件名哈希）
+ * 或认领方式（claim_id 非 NULL）调用 batch_process，各自拥有独立的分配器、调度器和 stb 全局状态，
+ * 可以由操作系统分布到不同的 NUMA 节点上。子进程通过管道逐幅报告结果，协调者定期输出汇总进度，
+ * 结束时输出每个进程处理的图像数。子进程的线程数默认为 CPU 数除以进程数（IMAGEPROC_THREADS 可覆盖），
+ * 设置 IMAGEPROC_STATS_FILE 时每个子进程写自己的统计文件（文件名后加 ".<进程号>"）。Windows 下不支持。
+ * @param edge_ops 边缘图的后处理效果链，同 batch_process。
+ * @param ops 对每幅原图应用的效果链，同 batch_process。
+ * @param workers 工作进程数（1 到 BATCH_MAX_WORKERS）。
+ * @param claim_id 认领目录名，NULL 表示按文件名哈希静态分片。
+ * @param resume 是否重放进度日志，同 batch_process。
+ * @return 全部子进程成功返回1，否则返回0。
  */
-void batch_process();
+int batch_run_workers(const char *edge_ops, const char *ops, int workers, const char *claim_id, int resume);
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef BILATERAL_H
+#define BILATERAL_H
+
+// 值域标准差的上限（亮度范围 0-255）
+#define BILATERAL_MAX_SIGMA_RANGE 255
+
+/**
+ * @brief 用双边网格 (bilateral grid) 做保边平滑，原地写回。
+ *
+ * 按空间标准差和值域标准差对 (x, y, 亮度) 降采样，把每个像素的颜色和权重1累加到最近的网格单元，
+ * 对网格沿三个维度做一维高斯模糊（标准差为一个单元，即空间上 sigma_spatial 像素、亮度上 sigma_range），
+ * 再按像素的位置和亮度对网格做三线性插值，颜色和除以权重和得到结果。亮度差远大于 sigma_range 的像素
+ * 落在相距很远的单元中，互不影响，因此边缘得以保留。网格的单元数约为像素数除以 sigma_spatial 的平方，
+ * 累加和插值每像素的开销固定，总开销几乎与空间标准差无关。三个阶段都拆分到多个线程执行，
+ * 累加按网格行划分，结果与线程数无关。
+ * @param data 图像数据（交错布局、紧密排列），灰度+Alpha 和 RGBA 图像的 Alpha 通道保持不变。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数（1-4）。
+ * @param sigma_spatial 空间标准差（像素，>=1）。
+ * @param sigma_range 值域标准差（亮度，1 到 BILATERAL_MAX_SIGMA_RANGE）。
+ * @return 成功返回1，失败返回0。
+ */
+int bilateral_filter(unsigned char *data, int width, int height, int channels, int sigma_spatial, int sigma_range);
+
+#endif
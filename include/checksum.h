@@ -0,0 +1,20 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 累加计算 CRC-32（与 zlib/PNG 相同的多项式）。
+ *
+ * 首次调用时生成按8字节切片的查找表，之后每次处理8个字节；多个线程可以同时调用。
+ * 分段计算时把上一段的返回值作为下一段的 crc 传入，第一段传0。
+ *
+ * @param crc 之前各段的 CRC-32，第一段为0。
+ * @param data 数据。
+ * @param len 字节数。
+ * @return 包含这段数据后的 CRC-32。
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif // CHECKSUM_H
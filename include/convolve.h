@@ -0,0 +1,153 @@
+#ifndef CONVOLVE_H
+#define CONVOLVE_H
+
+#include "planar.h"
+
+// 卷积时图像边界外像素的取值方式
+typedef enum
+{
+    BORDER_CLAMP,   // 钳制到最近的边缘像素：aaa|abcd|ddd
+    BORDER_REFLECT, // 以边缘像素为轴镜像（不重复边缘）：dcb|abcd|cba
+    BORDER_WRAP,    // 环绕到对侧：bcd|abcd|abc
+    BORDER_CONSTANT // 使用固定值：vvv|abcd|vvv
+} border_mode_t;
+
+// 任意（不可分离）卷积核的最大边长，可分离核不受此限制
+#define CONV_MAX_SIZE 31
+
+/**
+ * @brief 卷积核描述。
+ *
+ * 创建时自动分析：
+ * - 可分离性：权重矩阵秩为1时拆成行向量和列向量，按两遍一维卷积计算；
+ * - 整数性：所有权重乘以某个不超过1024的除数后都是整数时，使用整数运算。
+ */
+typedef struct
+{
+    int size;        // 边长（奇数）
+    int radius;      // 半径 = size / 2
+    float *weights;  // size * size 个权重（行优先），由行列向量直接创建的可分离核为NULL
+    int separable;   // 是否可分离
+    float *row;      // 可分离时的行向量（横向权重）
+    float *col;      // 可分离时的列向量（纵向权重）
+    int is_integer;  // 是否可以用整数运算
+    int divisor;     // 整数运算时的除数：weights = iweights / divisor
+    int *iweights;   // 整数权重 (size * size)，可分离核为NULL
+    int *irow;       // 可分离整数核的行向量
+    int *icol;       // 可分离整数核的列向量
+} conv_kernel_t;
+
+/**
+ * @brief 由任意权重矩阵创建卷积核，并分析可分离性和整数性。
+ * @param size 边长（1到CONV_MAX_SIZE之间的奇数）。
+ * @param weights size * size 个权重，行优先。
+ * @return 成功返回卷积核，失败返回NULL。
+ */
+conv_kernel_t *conv_kernel_create(int size, const float *weights);
+
+/**
+ * @brief 由行向量和列向量创建可分离卷积核（权重为二者外积）。
+ * @param size 边长（奇数）。
+ * @param row 横向权重。
+ * @param col 纵向权重。
+ * @return 成功返回卷积核，失败返回NULL。
+ */
+conv_kernel_t *conv_kernel_create_separable(int size, const float *row, const float *col);
+
+/**
+ * @brief 创建归一化的高斯卷积核 (sigma = radius / 2)。
+ * @param radius 半径。
+ * @return 成功返回卷积核，失败返回NULL。
+ */
+conv_kernel_t *conv_kernel_gaussian(int radius);
+
+/**
+ * @brief 按名称创建预置卷积核：sharpen、emboss、box3、box5、box7、sobel_x、sobel_y。
+ * @param name 预置名称。
+ * @return 成功返回卷积核，未知名称返回NULL。
+ */
+conv_kernel_t *conv_kernel_preset(const char *name);
+
+/**
+ * @brief 按名称解析边界模式（"clamp"、"reflect"、"wrap"、"constant"）。
+ * @param name 边界模式名称。
+ * @param mode 输出的边界模式。
+ * @return 成功返回1，未知名称返回0。
+ */
+int border_mode_from_name(const char *name, border_mode_t *mode);
+
+/**
+ * @brief 释放卷积核。
+ * @param kernel 卷积核。
+ */
+void conv_kernel_free(conv_kernel_t *kernel);
+
+/**
+ * @brief 对单个8位平面做卷积，结果四舍五入并钳制到0-255。
+ *
+ * 只计算 rect 内的输出像素，但会读取 rect 外 radius 范围内的邻域。
+ * 可分离核的横向一遍把每行分成三段：邻域完全在平面内的中间段直接读源行，
+ * 两端的少量像素先按边界模式填充到小缓冲区再计算，内层循环都没有边界判断。
+ * 所有源像素在写出第一行结果之前已读入内部缓冲区，因此 dst 可以指向 src 本身。
+ * @param src 源平面。
+ * @param src_stride 源平面行步长（字节）。
+ * @param width 源平面宽度。
+ * @param height 源平面高度。
+ * @param kernel 卷积核。
+ * @param border 边界模式。
+ * @param border_value BORDER_CONSTANT 模式下边界外像素的取值。
+ * @param rect 需要计算的输出区域（源平面坐标）。
+ * @param dst 输出区域左上角的地址。
+ * @param dst_stride 输出行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int convolve_plane(const unsigned char *src,
+                   int src_stride,
+                   int width,
+                   int height,
+                   const conv_kernel_t *kernel,
+                   border_mode_t border,
+                   unsigned char border_value,
+                   image_rect_t rect,
+                   unsigned char *dst,
+                   int dst_stride);
+
+/**
+ * @brief 对单个8位平面做整数卷积，输出未除以除数、未钳制的有符号累加和（用于求梯度等）。
+ * @param src 源平面。
+ * @param src_stride 源平面行步长（字节）。
+ * @param width 源平面宽度。
+ * @param height 源平面高度。
+ * @param kernel 卷积核（必须是整数核）。
+ * @param border 边界模式。
+ * @param border_value BORDER_CONSTANT 模式下边界外像素的取值。
+ * @param rect 需要计算的输出区域（源平面坐标）。
+ * @param dst 输出区域左上角的地址。
+ * @param dst_stride 输出行步长（元素个数）。
+ * @return 成功返回1，非整数核或失败返回0。
+ */
+int convolve_plane_int(const unsigned char *src,
+                       int src_stride,
+                       int width,
+                       int height,
+                       const conv_kernel_t *kernel,
+                       border_mode_t border,
+                       unsigned char border_value,
+                       image_rect_t rect,
+                       int *dst,
+                       int dst_stride);
+
+/**
+ * @brief 对交错布局的整幅图像逐通道卷积（原地），Alpha 通道保持不变。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param kernel 卷积核。
+ * @param border 边界模式。
+ * @return 成功返回1，失败返回0。
+ */
+int convolve_image(
+    unsigned char *data, int width, int height, int channels, const conv_kernel_t *kernel, border_mode_t border);
+
+#endif
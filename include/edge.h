@@ -1,15 +1,175 @@
 #ifndef EDGE_H
 #define EDGE_H
 
+#include "planar.h"
+#include "convolve.h"
+
+// 自动阈值模式（作为 threshold 参数传入）
+#define EDGE_THRESHOLD_OTSU -1       // 对梯度幅值直方图使用 Otsu 方法
+#define EDGE_THRESHOLD_PERCENTILE -2 // 取梯度幅值的 EDGE_AUTO_PERCENTILE 百分位
+
+// 百分位模式下被视为强边缘的梯度幅值百分位
+#define EDGE_AUTO_PERCENTILE 90.0
+
+// 整幅图像的 Sobel 梯度场：计算一次后可以同时用于边缘检测和按边缘方向选择字符的字符画
+typedef struct
+{
+    int width;
+    int height;
+    int *gx;                  // 水平梯度（有符号，未钳制），width * height
+    int *gy;                  // 垂直梯度（有符号，未钳制），width * height
+    unsigned char *magnitude; // 梯度幅值（钳制到 0-255），width * height
+} sobel_gradient_t;
+
 /**
  * @brief 使用 Sobel 算子进行边缘检测
  * @param data 输入图像数据
  * @param width 图像宽度
  * @param height 图像高度
  * @param channels 图像通道数
- * @param threshold 边缘检测阈值，范围0-255，值越小检测到的边缘越多
+ * @param threshold 边缘检测阈值，范围0-255，值越小检测到的边缘越多；
+ *                  传 EDGE_THRESHOLD_OTSU / EDGE_THRESHOLD_PERCENTILE 时根据梯度直方图自动选择
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径（去除 JPEG 噪声产生的斑点边缘），0 表示不滤波
+ * @note 图像边界外按镜像 (BORDER_REFLECT) 取值，边界像素同样参与检测
  * @return 返回边缘检测结果图像数据，调用者负责释放内存
  */
-unsigned char *sobel_edge_detect(const unsigned char *data, int width, int height, int channels, int threshold);
+unsigned char *sobel_edge_detect(
+    const unsigned char *data, int width, int height, int channels, int threshold, int median_radius);
+
+/**
+ * @brief 对图像中的矩形区域进行 Sobel 边缘检测，只读取区域外 2 + median_radius 像素的光晕
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 检测区域，超出图像的部分会被裁剪
+ * @param threshold 边缘检测阈值，范围0-255，或自动阈值模式
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param border 图像边界外像素的取值方式
+ * @return 返回 roi.w * roi.h * channels 大小的边缘图，调用者负责释放内存
+ */
+unsigned char *sobel_edge_detect_roi(const unsigned char *data,
+                                     int width,
+                                     int height,
+                                     int channels,
+                                     int stride,
+                                     image_rect_t roi,
+                                     int threshold,
+                                     int median_radius,
+                                     border_mode_t border);
+
+/**
+ * @brief 对图像中的矩形区域进行 Sobel 边缘检测，结果写入调用者提供的缓冲区
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 检测区域，超出图像的部分会被裁剪
+ * @param threshold 边缘检测阈值，范围0-255，或自动阈值模式
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param border 图像边界外像素的取值方式
+ * @param dst 输出区域左上角像素的地址；源像素在写出前已全部转换到内部灰度缓冲区，因此可以指向 data 本身
+ * @param dst_stride 输出的行步长（字节）
+ * @return 成功返回1，失败返回0
+ */
+int sobel_edge_detect_into(const unsigned char *data,
+                           int width,
+                           int height,
+                           int channels,
+                           int stride,
+                           image_rect_t roi,
+                           int threshold,
+                           int median_radius,
+                           border_mode_t border,
+                           unsigned char *dst,
+                           int dst_stride);
+
+/**
+ * @brief 计算矩形区域的 Sobel 梯度幅值（钳制到 0-255）
+ *
+ * 与 sobel_edge_detect_into 使用相同的灰度转换、中值滤波和梯度计算；区域只读取四周 1 + median_radius 像素的光晕，
+ * 因此把图像切成若干块分别计算，结果与整幅计算完全相同。
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 计算区域，超出图像的部分会被裁剪
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param border 图像边界外像素的取值方式
+ * @param dst 输出区域左上角的地址（每像素1字节）
+ * @param dst_stride 输出的行步长（字节）
+ * @return 成功返回1，失败返回0
+ */
+int sobel_magnitude_into(const unsigned char *data,
+                         int width,
+                         int height,
+                         int channels,
+                         int stride,
+                         image_rect_t roi,
+                         int median_radius,
+                         border_mode_t border,
+                         unsigned char *dst,
+                         int dst_stride);
+
+/**
+ * @brief 计算整幅图像的 Sobel 梯度场（图像边界外按镜像取值）
+ *
+ * 梯度与 sobel_edge_detect 内部使用的完全相同；幅值用 SSE2 每次计算16个像素。
+ * @param data 图像数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param gradient 输出的梯度场，用 sobel_gradient_free 释放
+ * @return 成功返回1，失败返回0
+ */
+int sobel_gradient_compute(
+    const unsigned char *data, int width, int height, int channels, int median_radius, sobel_gradient_t *gradient);
+
+/**
+ * @brief 释放梯度场的缓冲区
+ * @param gradient 梯度场（可以是计算失败后的梯度场）
+ */
+void sobel_gradient_free(sobel_gradient_t *gradient);
+
+/**
+ * @brief 由已计算的梯度场生成边缘图，结果与对同一图像调用 sobel_edge_detect 相同
+ * @param gradient sobel_gradient_compute 计算的梯度场
+ * @param threshold 边缘检测阈值，范围0-255，或自动阈值模式
+ * @param channels 输出的通道数
+ * @return 返回 width * height * channels 大小的边缘图，调用者负责释放内存
+ */
+unsigned char *sobel_edge_detect_gradient(const sobel_gradient_t *gradient, int threshold, int channels);
+
+/**
+ * @brief 由梯度幅值直方图确定自动阈值
+ * @param hist 梯度幅值的直方图（256个桶）
+ * @param mode EDGE_THRESHOLD_OTSU 或 EDGE_THRESHOLD_PERCENTILE
+ * @return 阈值（至少为1）
+ */
+int edge_auto_threshold(const unsigned int hist[256], int mode);
+
+/**
+ * @brief 对梯度幅值做双阈值滞后处理，生成边缘图（边缘为255，其余为0）
+ * @param magnitude 区域左上角的梯度幅值；区域四周一圈的幅值必须可读（图像外的位置为0）
+ * @param mag_stride 梯度幅值的行步长（字节）
+ * @param w 区域宽度
+ * @param h 区域高度
+ * @param threshold 强边缘阈值，弱边缘阈值为它的一半
+ * @param channels 输出的通道数
+ * @param dst 输出区域左上角像素的地址
+ * @param dst_stride 输出的行步长（字节）
+ */
+void edge_hysteresis(const unsigned char *magnitude,
+                     int mag_stride,
+                     int w,
+                     int h,
+                     int threshold,
+                     int channels,
+                     unsigned char *dst,
+                     int dst_stride);
 
 #endif
@@ -0,0 +1,135 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include "convolve.h"
+#include <stddef.h>
+
+// 一条效果链最多包含的操作数
+#define EFFECT_MAX_OPS 16
+
+// 可按名称调用的效果
+typedef enum
+{
+    EFFECT_GRAYSCALE,     // grayscale
+    EFFECT_INVERT,        // invert
+    EFFECT_BLUR,          // blur[:半径][:边界模式]，默认半径5、clamp
+    EFFECT_ROTATE,        // rotate
+    EFFECT_EDGE,          // edge[:阈值|otsu|percentile[:中值半径]][:边界模式]，默认 otsu、不做中值预滤波、reflect
+    EFFECT_RESIZE,        // resize[:百分比]，默认50，使用 Lanczos3
+    EFFECT_AUTO_CONTRAST, // autocontrast
+    EFFECT_SHARPEN,       // sharpen[:边界模式]，默认 clamp
+    EFFECT_EMBOSS,        // emboss[:边界模式]，默认 clamp
+    EFFECT_DILATE,        // dilate[:宽[x高]]，矩形结构元素，默认3x3，只给宽度时为正方形
+    EFFECT_ERODE,         // erode[:宽[x高]]
+    EFFECT_OPEN,          // open[:宽[x高]]
+    EFFECT_CLOSE,         // close[:宽[x高]]
+    EFFECT_MEDIAN,        // median[:半径]，默认1 (3x3)
+    EFFECT_BILATERAL      // bilateral[:空间标准差[:值域标准差]]，默认8和20，双边网格保边平滑
+} effect_type_t;
+
+// 效果链中的一个操作
+typedef struct
+{
+    effect_type_t type;
+    int param;            // 半径、标准差、阈值、百分比或结构元素宽度，不需要参数的效果忽略
+    int param2;           // 结构元素高度、边缘检测的中值预滤波半径或双边滤波的值域标准差，其余效果忽略
+    border_mode_t border; // 卷积类效果 (blur/sharpen/emboss/edge) 在图像边界外的取值方式，其余效果忽略
+} effect_op_t;
+
+// 效果处理的图像，data 由 malloc 分配或由 load_image 返回（后者用 free_image 释放）
+typedef struct
+{
+    unsigned char *data;
+    int width;
+    int height;
+    int channels;
+} effect_image_t;
+
+// 执行计划中每一步的内存需求
+typedef enum
+{
+    EFFECT_STEP_IN_PLACE, // 直接在当前缓冲区上逐像素/逐行修改，不需要额外内存
+    EFFECT_STEP_SCRATCH,  // 滤镜内部使用临时缓冲区（通道平面、灰度图等），结果写回当前缓冲区
+    EFFECT_STEP_RESHAPE   // 改变图像尺寸，结果写回当前缓冲区（容量按整条链的最大尺寸一次预留）
+} effect_step_kind_t;
+
+// 执行计划中的一步
+typedef struct
+{
+    effect_op_t op;
+    effect_step_kind_t kind;
+    int width;  // 该步输出的宽度
+    int height; // 该步输出的高度
+} effect_step_t;
+
+// 一条效果链的执行计划：整条链在同一个缓冲区上运行，最后只编码一次
+typedef struct
+{
+    effect_step_t steps[EFFECT_MAX_OPS];
+    int count;
+    int width;          // 输入宽度
+    int height;         // 输入高度
+    int channels;       // 通道数（所有效果都保持通道数不变）
+    size_t buffer_size; // 整条链所需的缓冲区容量（字节）
+} effect_plan_t;
+
+/**
+ * @brief 解析逗号分隔的效果列表，例如 "grayscale,blur:3,edge:40"。
+ * @param spec 效果列表字符串。
+ * @param ops 输出的操作数组。
+ * @param max_ops 数组容量。
+ * @return 成功返回操作个数，格式错误或为空返回0。
+ */
+int effects_parse(const char *spec, effect_op_t *ops, int max_ops);
+
+/**
+ * @brief 返回效果的名称。
+ * @param type 效果类型。
+ * @return 名称字符串。
+ */
+const char *effect_name(effect_type_t type);
+
+/**
+ * @brief 为效果链生成执行计划：确定每一步的输出尺寸和内存需求，以及缓冲区需要的最大容量。
+ * @param plan 输出的执行计划。
+ * @param ops 操作数组。
+ * @param count 操作个数。
+ * @param width 输入图像宽度。
+ * @param height 输入图像高度。
+ * @param channels 输入图像通道数。
+ * @return 成功返回1，失败返回0。
+ */
+int effect_plan_build(effect_plan_t *plan, const effect_op_t *ops, int count, int width, int height, int channels);
+
+/**
+ * @brief 打印执行计划。
+ * @param plan 执行计划。
+ */
+void effect_plan_print(const effect_plan_t *plan);
+
+/**
+ * @brief 按执行计划处理图像。缓冲区容量不足时只扩展一次，之后所有步骤都原地写回 img->data。
+ * @param plan 执行计划（输入尺寸必须与 img 一致）。
+ * @param img 图像，data 由 malloc 分配或由 load_image 返回（可能经 image_realloc 扩展）。
+ * @return 全部成功返回1，任一失败返回0（图像保持有效，尺寸为最后一个成功步骤的输出）。
+ */
+int effect_plan_execute(const effect_plan_t *plan, effect_image_t *img);
+
+/**
+ * @brief 对图像应用一个效果。改变尺寸的效果 (resize) 放大时会扩展 img->data。
+ * @param op 操作。
+ * @param img 图像。
+ * @return 成功返回1，失败返回0（图像保持有效）。
+ */
+int effect_apply(const effect_op_t *op, effect_image_t *img);
+
+/**
+ * @brief 按顺序应用一条效果链（生成执行计划后执行）。
+ * @param ops 操作数组。
+ * @param count 操作个数。
+ * @param img 图像。
+ * @return 全部成功返回1，任一失败返回0。
+ */
+int effects_apply_all(const effect_op_t *ops, int count, effect_image_t *img);
+
+#endif
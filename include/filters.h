@@ -1,6 +1,9 @@
 #ifndef FILTERS_H
 #define FILTERS_H
 
+#include "planar.h"
+#include "convolve.h"
+
 /**
  * @brief 将图像数据转换为灰度图。
  * @param data 图像的像素数据。
@@ -29,4 +32,81 @@ void invert(unsigned char *data, int width, int height, int channels);
  */
 void blur(unsigned char *data, int width, int height, int channels, int radius);
 
+/**
+ * @brief 自动对比度：根据亮度直方图把 0.5% 和 99.5% 百分位线性拉伸到 0 和 255。
+ * @param data 图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数。
+ * @return 成功返回1，失败返回0。
+ */
+int auto_contrast(unsigned char *data, int width, int height, int channels);
+
+/**
+ * @brief 对图像中的矩形区域进行灰度化。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param dst 输出区域左上角像素的地址，传NULL表示原地写回 data。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int grayscale_roi(unsigned char *data,
+                  int width,
+                  int height,
+                  int channels,
+                  int stride,
+                  image_rect_t roi,
+                  unsigned char *dst,
+                  int dst_stride);
+
+/**
+ * @brief 对图像中的矩形区域进行反色处理。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param dst 输出区域左上角像素的地址，传NULL表示原地写回 data。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int invert_roi(unsigned char *data,
+               int width,
+               int height,
+               int channels,
+               int stride,
+               image_rect_t roi,
+               unsigned char *dst,
+               int dst_stride);
+
+/**
+ * @brief 对图像中的矩形区域应用模糊滤镜，区域外 radius 像素内的邻域参与计算但不被修改。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数，超过 IMAGE_MAX_CHANNELS 时逐个通道处理（较慢）。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param radius 模糊半径。
+ * @param border 图像边界外像素的取值方式。
+ * @param dst 输出区域左上角像素的地址，传NULL表示原地写回 data。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int blur_roi(unsigned char *data,
+             int width,
+             int height,
+             int channels,
+             int stride,
+             image_rect_t roi,
+             int radius,
+             border_mode_t border,
+             unsigned char *dst,
+             int dst_stride);
+
 #endif
@@ -0,0 +1,128 @@
+#ifndef HDR_H
+#define HDR_H
+
+#include "effects.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief 高位深图像：像素以 float 交错存储。
+ *
+ * 8位和16位图像归一化到 [0, 1]；HDR (Radiance .hdr) 文件保留 stb_image 给出的线性值，可以大于1。
+ */
+typedef struct
+{
+    float *data;
+    int width;
+    int height;
+    int channels;
+    int bit_depth; // 源文件的位深：8、16，或 32 表示浮点 HDR
+} hdr_image_t;
+
+/**
+ * @brief 判断文件是否是高位深图像（16位PNG/PSD/PNM 或 HDR）。
+ * @param path 图像文件的路径。
+ * @return 是返回1，否则返回0。
+ */
+int hdr_is_high_bit_depth(const char *path);
+
+/**
+ * @brief 判断内存中的编码数据是否是高位深图像（16位PNG/PSD/PNM 或 HDR），用于链式处理模式的标准输入。
+ * @param buffer 编码数据。
+ * @param size 数据的字节数。
+ * @return 是返回1，否则返回0。
+ */
+int hdr_is_high_bit_depth_from_memory(const unsigned char *buffer, size_t size);
+
+/**
+ * @brief 按源文件的位深加载图像：HDR 用 stbi_loadf，16位用 stbi_load_16，其余用 stbi_load，统一转换为 float。
+ * @param path 图像文件的路径。
+ * @param img 输出的图像，用 hdr_image_free 释放。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_load(const char *path, hdr_image_t *img);
+
+/**
+ * @brief 按位深解码内存中的编码数据，同 hdr_image_load。
+ * @param buffer 编码数据（例如 read_stream 读到的标准输入）。
+ * @param size 数据的字节数。
+ * @param img 输出的图像，用 hdr_image_free 释放。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_load_from_memory(const unsigned char *buffer, size_t size, hdr_image_t *img);
+
+/**
+ * @brief 保存图像，格式由扩展名决定：.png 写16位PNG，.hdr 写 Radiance HDR，其余格式量化到8位后用 save_image 保存。
+ *
+ * HDR 源图像的线性值写入整数格式前先做 1/2.2 的伽马校正（与 stb_image 加载时的转换相反）。
+ * @param path 保存路径。
+ * @param img 图像。
+ * @param quality JPEG质量参数 (1-100)，仅对JPEG格式有效。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_save(const char *path, const hdr_image_t *img, int quality);
+
+/**
+ * @brief 把图像编码写到流（链式处理模式写标准输出）："png" 写16位PNG，其余格式（见 write_image_to_stream）
+ *        量化到8位后写出。
+ * @param fp 输出流，应以二进制模式打开。
+ * @param format 输出格式："png"、"jpg"、"bmp" 或 "tga"。
+ * @param img 图像。
+ * @param quality JPEG质量参数 (1-100)，仅对JPEG格式有效。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_write_to_stream(FILE *fp, const char *format, const hdr_image_t *img, int quality);
+
+/**
+ * @brief 释放 hdr_image_load 加载的图像。
+ * @param img 图像。
+ */
+void hdr_image_free(hdr_image_t *img);
+
+/**
+ * @brief 灰度化（与8位版本相同的亮度公式），Alpha 通道保持不变。
+ * @param img 图像。
+ */
+void hdr_grayscale(hdr_image_t *img);
+
+/**
+ * @brief 反色 (1 - 值)，与8位版本一样只处理前三个通道。
+ * @param img 图像。
+ */
+void hdr_invert(hdr_image_t *img);
+
+/**
+ * @brief 上下翻转图像。
+ * @param img 图像。
+ */
+void hdr_rotate(hdr_image_t *img);
+
+/**
+ * @brief 高斯模糊，权重与8位版本相同（conv_kernel_gaussian），边界按 BORDER_CLAMP 处理。
+ * @param img 图像。
+ * @param radius 模糊半径。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_blur(hdr_image_t *img, int radius);
+
+/**
+ * @brief 在 float 亮度上做 Sobel 边缘检测和滞后阈值，结果写回图像（边缘为1，其余为0）。
+ *
+ * 梯度幅值按8位亮度的尺度 (×255) 与阈值比较，因此阈值和自动阈值模式的含义与8位版本一致；
+ * 边界按 BORDER_REFLECT 处理。
+ * @param img 图像。
+ * @param threshold 阈值 (0-255)，或 EDGE_THRESHOLD_OTSU / EDGE_THRESHOLD_PERCENTILE。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_edge_detect(hdr_image_t *img, int threshold);
+
+/**
+ * @brief 按顺序应用效果链。支持 grayscale、invert、blur、rotate 和 edge（只支持默认的边界模式），其余效果报错。
+ * @param img 图像。
+ * @param ops 操作数组。
+ * @param count 操作个数。
+ * @return 全部成功返回1，任一失败返回0。
+ */
+int hdr_apply_effects(hdr_image_t *img, const effect_op_t *ops, int count);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+
+/**
+ * @brief 单幅图像的统计信息：亮度和各通道的直方图、最小/最大值、均值。
+ */
+typedef struct
+{
+    int channels;                     // 通道数
+    size_t pixel_count;               // 像素总数
+    unsigned int luma[256];           // 亮度直方图 (0.299R + 0.587G + 0.114B)
+    unsigned int channel[4][256];     // 各通道直方图
+    unsigned char luma_min, luma_max; // 亮度最小/最大值
+    double luma_mean;                 // 亮度均值
+    unsigned char min[4], max[4];     // 各通道最小/最大值
+    double mean[4];                   // 各通道均值
+} image_stats_t;
+
+/**
+ * @brief 把一段8位数据累加到直方图中。
+ *
+ * 内部使用4份交替写入的子直方图，相邻的相同取值不会连续写同一个计数器，
+ * 避免“写后立即读”造成的存储转发停顿，最后再合并到 hist。
+ * @param values 数据。
+ * @param count 数据个数。
+ * @param hist 累加目标（不清零）。
+ */
+void histogram_accumulate(const unsigned char *values, size_t count, unsigned int hist[256]);
+
+/**
+ * @brief 单遍计算图像的全部统计信息，按行分块并行，每个线程使用私有直方图，最后归并。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数 (1-4)。
+ * @param stats 输出的统计信息。
+ * @return 成功返回1，失败返回0。
+ */
+int compute_image_stats(const unsigned char *data, int width, int height, int channels, image_stats_t *stats);
+
+/**
+ * @brief 求直方图的百分位数。
+ * @param hist 直方图。
+ * @param percent 百分比 (0-100)。
+ * @return 累计计数首次达到 percent% 的取值。
+ */
+int histogram_percentile(const unsigned int hist[256], double percent);
+
+/**
+ * @brief 用 Otsu 方法求使类间方差最大的二值化阈值。
+ * @param hist 直方图。
+ * @return 阈值 (0-255)，大于该值的属于前景。
+ */
+int histogram_otsu_threshold(const unsigned int hist[256]);
+
+#endif
@@ -1,16 +1,49 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include "pyramid.h"
+#include <stddef.h>
+#include <stdio.h>
+
 /**
  * @brief 从指定路径加载图像。
+ *        设置了解码缓存（IMAGEPROC_PIXEL_CACHE，见 pixel_cache.h）时，返回的可能是映射的缓存文件。
  * @param path 图像文件的路径。
  * @param width 指向存储图像宽度的变量的指针。
  * @param height 指向存储图像高度的变量的指针。
  * @param channels 指向存储图像通道数的变量的指针。
- * @return 成功返回图像数据指针，失败返回NULL。
+ * @return 成功返回图像数据指针（用 free_image 释放，需要扩展时用 image_realloc），失败返回NULL。
  */
 unsigned char *load_image(const char *path, int *width, int *height, int *channels);
 
+/**
+ * @brief 加载图像并缩小，适用于只需要缩略图或 ASCII 字符画的任务：解码后立即逐级做2x2盒式平均，
+ *        每缩小一级就释放上一级，之后的处理只涉及缩小后的像素。缩小到 factor 倍为止，
+ *        长边再缩小一级就会小于 min_size 时提前停止。
+ * @param path 图像文件的路径。
+ * @param factor 最大缩小倍数（1/2/4/8，其他值按不超过它的最大2的幂处理）。
+ * @param min_size 缩小后长边的下限（像素），0 表示不限制。
+ * @param pyramid 输出的金字塔：只有缩小到的那一层有数据，其余各层只记录尺寸（第0层为原图尺寸），
+ *                可以直接交给 *_pyramid 字符画函数和 pyramid_thumbnail。没有缩小时第0层是解码结果，
+ *                需要用 free_image 释放；之后用 pyramid_free 释放其余各层。
+ * @return 成功返回1，失败返回0。
+ */
+int load_image_reduced(const char *path, int factor, int min_size, image_pyramid_t *pyramid);
+
+/**
+ * @brief 释放 load_image 返回的图像数据：映射的缓存文件解除映射，其余用 stbi_image_free 释放。
+ * @param data 图像数据，可以为NULL。
+ */
+void free_image(unsigned char *data);
+
+/**
+ * @brief 调整 load_image 返回的图像数据的大小，语义同 realloc：映射的缓存文件复制到新分配的内存后解除映射。
+ * @param data 图像数据，可以为NULL。
+ * @param size 新的字节数。
+ * @return 成功返回新的图像数据（之后用 free_image 或 free 释放），失败返回NULL（原数据保持不变）。
+ */
+unsigned char *image_realloc(unsigned char *data, size_t size);
+
 /**
  * @brief 将图像保存到指定路径。
  * @param path 保存图像文件的路径。
@@ -23,4 +56,47 @@ unsigned char *load_image(const char *path, int *width, int *height, int *channe
  */
 int save_image(const char *path, unsigned char *data, int width, int height, int channels, int quality);
 
+/**
+ * @brief 把整个输入流（如标准输入）读入内存。流的长度事先未知，按倍增方式读入。
+ * @param fp 输入流，应以二进制模式打开。
+ * @param size 指向存储读到的字节数的变量的指针。
+ * @return 成功返回数据（用 free 释放），读取失败、流为空或超过 2GB 时返回NULL。
+ */
+unsigned char *read_stream(FILE *fp, size_t *size);
+
+/**
+ * @brief 从内存中的编码数据解码8位图像。
+ * @param buffer 编码数据（例如 read_stream 读到的内容）。
+ * @param size 数据的字节数。
+ * @param width 指向存储图像宽度的变量的指针。
+ * @param height 指向存储图像高度的变量的指针。
+ * @param channels 指向存储图像通道数的变量的指针。
+ * @return 成功返回图像数据指针（用 stbi_image_free 或 free 释放），失败返回NULL。
+ */
+unsigned char *load_image_from_memory(const unsigned char *buffer, size_t size, int *width, int *height, int *channels);
+
+/**
+ * @brief 读取整个输入流（如标准输入）并从内存解码图像。
+ * @param fp 输入流，应以二进制模式打开。
+ * @param width 指向存储图像宽度的变量的指针。
+ * @param height 指向存储图像高度的变量的指针。
+ * @param channels 指向存储图像通道数的变量的指针。
+ * @return 成功返回图像数据指针（用 stbi_image_free 或 free 释放），失败返回NULL。
+ */
+unsigned char *load_image_from_stream(FILE *fp, int *width, int *height, int *channels);
+
+/**
+ * @brief 把图像编码后写入输出流（如标准输出），不经过临时文件。
+ * @param fp 输出流，应以二进制模式打开。
+ * @param format 编码格式："jpg"/"jpeg"、"png"、"bmp" 或 "tga"。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param quality JPEG质量参数 (1-100)，仅对JPEG格式有效。
+ * @return 成功返回1，失败返回0。
+ */
+int write_image_to_stream(
+    FILE *fp, const char *format, unsigned char *data, int width, int height, int channels, int quality);
+
 #endif
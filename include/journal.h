@@ -0,0 +1,107 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief 日志中一条完成记录：某个输入的某个输出已完整写出。
+ */
+typedef struct
+{
+    long long input_size;   // 输入文件的字节数
+    long long input_mtime;  // 输入文件的修改时间（秒），与字节数一起判断输入是否变化
+    long long output_size;  // 输出文件的字节数
+    long long output_mtime; // 输出文件的修改时间（秒），与字节数一起判断输出是否被改动
+    uint32_t params;        // 影响该输出的参数的哈希（例如效果链），参数改变后记录失效
+    uint32_t checksum;      // 输出文件内容的 CRC-32
+} journal_record_t;
+
+typedef struct
+{
+    uint64_t key;   // "<输出名>/<输入名>" 的64位 FNV-1a 哈希
+    long long time; // 记录的写入时间（微秒），同一个键保留最晚的一条
+    uint32_t seq;   // 重放顺序（日志文件按名称排序），写入时间相同时保留最后一条
+    journal_record_t record;
+} journal_entry_t;
+
+/**
+ * @brief 只追加的进度日志。
+ *
+ * 日志目录中每个写入者（进程）拥有自己的日志文件，打开时重放目录中的全部日志文件，
+ * 同一个 (输入, 输出) 只保留写入时间最晚的记录，结果不依赖各文件的读取顺序。重放的结果按键的哈希排序后二分查找，
+ * 每条记录只占几十字节，20万幅图像的全部输出也只需要几十 MB；之后只读，多个线程可以同时查找。
+ * 每行记录带有自身的 CRC-32，写到一半时崩溃留下的残行在重放时被丢弃。
+ */
+typedef struct
+{
+    journal_entry_t *entries; // 按键排序，每个键一条
+    int count;
+    int capacity;
+    FILE *fp;            // 本进程的日志文件（追加写）
+    int sync_every;      // 每追加多少条记录把日志和已完成的输出落盘一次
+    int pending;         // 上次落盘后追加的记录数
+    long long last_time; // 最近一条记录的写入时间，新记录的时间总是比它晚
+} journal_t;
+
+/**
+ * @brief 打开日志：创建日志目录，重放其中的全部日志文件，打开本进程的日志文件用于追加。
+ * @param journal 日志。
+ * @param dir 日志目录。
+ * @param name 本进程的日志文件名（位于 dir 中，以 .log 结尾才会被重放）。
+ * @param sync_every 每追加多少条记录落盘一次，<=0 时为1。
+ * @param replay 0 表示不重放并删除目录中的全部日志文件（从头开始），非0 表示重放。
+ * @return 成功返回1，失败返回0。
+ */
+int journal_open(journal_t *journal, const char *dir, const char *name, int sync_every, int replay);
+
+/**
+ * @brief 删除日志目录中的全部日志文件（包括其他进程的日志），之后重放不到任何以往的记录。
+ * @param dir 日志目录，不存在时什么也不做。
+ * @return 成功返回1，有文件无法删除时返回0。
+ */
+int journal_clear(const char *dir);
+
+/**
+ * @brief 查找重放得到的记录。
+ * @param journal 日志。
+ * @param input 输入名。
+ * @param output 输出名。
+ * @return 记录，不存在时返回NULL。
+ */
+const journal_record_t *journal_find(const journal_t *journal, const char *input, const char *output);
+
+/**
+ * @brief 追加一条记录（多个线程可以同时调用）：记录立即写入日志文件，每追加 sync_every 条落盘一次。
+ * @param journal 日志。
+ * @param input 输入名（不能包含换行符）。
+ * @param output 输出名（不能包含空白和 '/'）。
+ * @param record 记录。
+ * @return 成功返回1，失败返回0。
+ */
+int journal_append(journal_t *journal, const char *input, const char *output, const journal_record_t *record);
+
+/**
+ * @brief 把已追加的记录和此前完成的输出落盘：Linux 上用 syncfs 刷写整个文件系统，
+ *        保证日志中的每条记录指向的输出同样已经落盘；其他平台只刷写日志文件。
+ * @param journal 日志。
+ * @return 成功返回1，失败返回0。
+ */
+int journal_sync(journal_t *journal);
+
+/**
+ * @brief 落盘并关闭日志，释放重放的记录。
+ * @param journal 日志。
+ */
+void journal_close(journal_t *journal);
+
+/**
+ * @brief 计算文件的字节数和内容的 CRC-32。
+ * @param path 文件路径。
+ * @param size 输出的字节数。
+ * @param checksum 输出的 CRC-32。
+ * @return 成功返回1，文件无法读取时返回0。
+ */
+int journal_checksum_file(const char *path, long long *size, uint32_t *checksum);
+
+#endif
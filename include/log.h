@@ -0,0 +1,91 @@
+#ifndef LOG_H
+#define LOG_H
+
+// 日志级别，数值越大越详细
+typedef enum
+{
+    LOG_LEVEL_ERROR, // 错误（quiet 模式只输出这一级）
+    LOG_LEVEL_INFO,  // 进度和结果（默认）
+    LOG_LEVEL_DEBUG  // 每次加载、保存、效果调用的细节
+} log_level_t;
+
+// 日志格式
+typedef enum
+{
+    LOG_FORMAT_TEXT, // 原样输出消息：错误写标准错误，其余写标准输出
+    LOG_FORMAT_JSON  // 每行一个 JSON 对象，全部写标准错误
+} log_format_t;
+
+// 当前输出的最高级别，只由 log_set_level 修改
+extern int log_max_level;
+
+/**
+ * @brief 按级别输出一行日志。级别被关闭时只有一次整数比较，参数不会被求值，也不做格式化。
+ *
+ * 消息不需要以换行结尾。
+ */
+#define LOG_AT(level, ...)                                                                                             \
+    do {                                                                                                               \
+        if ((int)(level) <= log_max_level)                                                                             \
+            log_write(level, __VA_ARGS__);                                                                             \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/**
+ * @brief 判断某个级别是否会输出，用于跳过只为日志准备数据的代码。
+ * @param level 日志级别。
+ * @return 会输出返回1，否则返回0。
+ */
+int log_enabled(log_level_t level);
+
+/**
+ * @brief 设置输出的最高级别。
+ * @param level 日志级别。
+ */
+void log_set_level(log_level_t level);
+
+/**
+ * @brief 设置日志格式。
+ * @param format 日志格式。
+ */
+void log_set_format(log_format_t format);
+
+/**
+ * @brief 解析级别名称：quiet/error、info、debug。
+ * @param name 名称。
+ * @param level 输出的级别。
+ * @return 成功返回1，名称无效返回0。
+ */
+int log_parse_level(const char *name, log_level_t *level);
+
+/**
+ * @brief 按环境变量 IMAGEPROC_LOG_LEVEL（级别名称）和 IMAGEPROC_LOG_FORMAT（text 或 json）配置日志。
+ */
+void log_configure_from_env(void);
+
+/**
+ * @brief 格式化并写入一行日志，应通过 LOG_ERROR/LOG_INFO/LOG_DEBUG 调用。
+ *
+ * 日志先写入进程内的缓冲区，缓冲区满、距上次写出超过一秒、输出错误或调用 log_flush 时才写到输出流；
+ * 是否超过一秒只在写日志和调用 log_flush_pending 时检查，长时间运行的循环应定期调用 log_flush_pending。
+ * 多个线程可以同时调用，每行日志完整输出，不会交错。
+ * @param level 日志级别。
+ * @param format printf 风格的格式字符串。
+ */
+void log_write(log_level_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief 把缓冲的日志写到输出流。进程正常退出时会自动调用。
+ */
+void log_flush(void);
+
+/**
+ * @brief 距上次写出超过一秒时把缓冲的日志写到输出流。没有新日志时缓冲的日志不会自动写出，
+ *        由统计线程、服务主循环等定期调用，使日志最多缓冲约一秒。
+ */
+void log_flush_pending(void);
+
+#endif
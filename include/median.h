@@ -0,0 +1,48 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include "planar.h"
+
+// 中值滤波的最大半径：窗口内的像素数 (2r+1)^2 必须能用16位计数
+#define MEDIAN_MAX_RADIUS 127
+
+/**
+ * @brief 对图像中的矩形区域做中值滤波，窗口为 (2*radius+1) x (2*radius+1)，图像边界外按钳制取值。
+ *
+ * 半径1和2（3x3、5x5）使用剪枝后的中值选择网络，SSE2 下一次处理16个字节（任意通道数的交错数据都按字节处理）；
+ * 更大的半径使用 Perreault–Hébert 方法：每列维护一个列直方图，输出行下移时每列只加一个像素、减一个像素，
+ * 窗口右移时核直方图加上新进入的列直方图、减去移出的列直方图，再借助16桶的粗直方图查找中值，
+ * 每像素的开销与半径无关。按行分块并行。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param radius 窗口半径，0 到 MEDIAN_MAX_RADIUS。
+ * @param dst 输出区域左上角像素的地址，不能与 data 重叠。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int median_filter_roi(const unsigned char *data,
+                      int width,
+                      int height,
+                      int channels,
+                      int stride,
+                      image_rect_t roi,
+                      int radius,
+                      unsigned char *dst,
+                      int dst_stride);
+
+/**
+ * @brief 对整幅图像做中值滤波，原地写回。
+ * @param data 图像的像素数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param radius 窗口半径，0 到 MEDIAN_MAX_RADIUS。
+ * @return 成功返回1，失败返回0。
+ */
+int median_filter(unsigned char *data, int width, int height, int channels, int radius);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// 参与计数的最大线程数，更多的线程共享已有的计数槽
+#define METRICS_MAX_THREADS 64
+// 延迟直方图的桶数：第 i 个桶的上界为 0.25ms * 2^i，最后一个桶没有上界
+#define METRICS_LATENCY_BUCKETS 16
+
+// 批处理中单独计时的效果
+typedef enum
+{
+    METRICS_EFFECT_GRAYSCALE,
+    METRICS_EFFECT_BLUR,
+    METRICS_EFFECT_INVERT,
+    METRICS_EFFECT_ROTATE,
+    METRICS_EFFECT_EDGE,
+    METRICS_EFFECT_RESIZE,
+    METRICS_EFFECT_ASCII,
+    METRICS_EFFECT_THUMBNAIL,
+    METRICS_EFFECT_OPS,  // --ops 指定的效果链
+    METRICS_EFFECT_HASH, // --dedupe 的感知哈希
+    METRICS_EFFECT_COUNT
+} metrics_effect_t;
+
+// 记录延迟直方图的阶段
+typedef enum
+{
+    METRICS_STAGE_DECODE, // 读取并解码输入文件
+    METRICS_STAGE_ENCODE, // 编码并写出一个输出文件
+    METRICS_STAGE_COUNT
+} metrics_stage_t;
+
+/**
+ * @brief 开始一次计数：清零所有计数器，启动后台线程定期写出缓冲的日志，并按间隔输出状态行和统计文件。
+ * @param total_images 本次要处理的图像总数（用于计算等待中的图像数）。
+ * @param stats_path 统计文件路径（Prometheus 文本格式，原子替换），NULL 表示不写文件。
+ * @param interval_seconds 输出间隔（秒），<=0 时只在 metrics_stop 时输出一次。
+ */
+void metrics_start(int total_images, const char *stats_path, int interval_seconds);
+
+/**
+ * @brief 结束计数：停止后台线程，输出最终的状态行并写最后一次统计文件。
+ */
+void metrics_stop(void);
+
+/**
+ * @brief 单调时钟的当前时间（纳秒）。
+ * @return 纳秒数。
+ */
+uint64_t metrics_now_ns(void);
+
+/**
+ * @brief 记录一次效果的运行。
+ * @param effect 效果。
+ * @param pixels 处理的像素数。
+ * @param ns 耗时（纳秒）。
+ */
+void metrics_record_effect(metrics_effect_t effect, long long pixels, uint64_t ns);
+
+/**
+ * @brief 记录一次解码或编码：累加字节数并把耗时计入延迟直方图。
+ * @param stage 阶段。
+ * @param bytes 读取（解码）或写出（编码）的字节数。
+ * @param ns 耗时（纳秒）。
+ * @param ok 是否成功，失败时只计入失败次数。
+ */
+void metrics_record_stage(metrics_stage_t stage, long long bytes, uint64_t ns, int ok);
+
+/**
+ * @brief 标记一幅图像开始处理（等待中的图像数减一，处理中的图像数加一）。
+ */
+void metrics_image_begin(void);
+
+/**
+ * @brief 标记一幅图像由其他进程处理（从图像总数中去掉，不计入完成的图像）。
+ */
+void metrics_image_skip(void);
+
+/**
+ * @brief 标记一幅图像处理结束。
+ * @param ok 是否成功。
+ */
+void metrics_image_end(int ok);
+
+/**
+ * @brief 以 Prometheus 文本格式输出当前的全部计数。
+ * @param fp 输出流。
+ * @return 成功返回1，失败返回0。
+ */
+int metrics_write_prometheus(FILE *fp);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+// 形态学运算
+typedef enum
+{
+    MORPH_DILATE, // 膨胀：窗口内最大值
+    MORPH_ERODE,  // 腐蚀：窗口内最小值
+    MORPH_OPEN,   // 开运算：先腐蚀后膨胀，去掉比结构元素小的孤立亮点
+    MORPH_CLOSE   // 闭运算：先膨胀后腐蚀，填补比结构元素小的缺口，连接断开的边缘
+} morph_op_t;
+
+/**
+ * @brief 判断图像是否为二值图：每个样本都是0或255，且同一像素的各通道相同（例如边缘检测的输出）。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @return 是二值图返回1，否则返回0。
+ */
+int morphology_is_binary(const unsigned char *data, int width, int height, int channels);
+
+/**
+ * @brief 使用矩形结构元素对图像做形态学运算，原地写回。
+ *
+ * 矩形结构元素可分离为横向和纵向两遍一维最大/最小值滤波，每遍使用 van Herk/Gil-Werman 算法：
+ * 序列按结构元素长度分块，计算块内前缀和后缀的最大/最小值，每个输出只需合并一个后缀和一个前缀，
+ * 每像素的比较次数与结构元素大小无关。图像外的位置不参与运算。
+ * 二值图（见 morphology_is_binary）按位打包，每个64位字存64个像素，纵向一遍对整字做 OR/AND，
+ * 横向一遍用倍增的移位合并，结果与逐像素计算完全相同。两遍都拆分到多个线程执行。
+ * @param data 图像数据（交错布局、紧密排列）。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param op 形态学运算。
+ * @param kernel_width 结构元素宽度（锚点在 kernel_width / 2）。
+ * @param kernel_height 结构元素高度（锚点在 kernel_height / 2）。
+ * @return 成功返回1，失败返回0。
+ */
+int morphology(unsigned char *data,
+               int width,
+               int height,
+               int channels,
+               morph_op_t op,
+               int kernel_width,
+               int kernel_height);
+
+#endif
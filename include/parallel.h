@@ -0,0 +1,33 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/**
+ * @brief 并行任务回调，处理区间 [begin, end)。
+ * @param ctx 调用者传入的上下文。
+ * @param begin 区间起点（包含）。
+ * @param end 区间终点（不包含）。
+ */
+typedef void (*parallel_range_fn)(void *ctx, int begin, int end);
+
+/**
+ * @brief 获取并行任务使用的线程数。
+ *
+ * 默认等于CPU核数，可通过环境变量 IMAGEPROC_THREADS 覆盖（设为1即完全串行）。
+ * @return 线程数（至少为1）。
+ */
+int parallel_thread_count(void);
+
+/**
+ * @brief 把 [0, count) 切分成若干连续区间并在多个线程上执行。
+ *
+ * 区间数量不超过线程数，且每个区间至少包含 min_chunk 个元素；
+ * 工作量太小时直接在调用线程上执行，不创建线程。
+ * 在调度器的工作线程中调用时，区间作为任务交给同一个调度器执行（见 scheduler.h）。
+ * @param count 元素总数。
+ * @param min_chunk 每个区间的最小元素数。
+ * @param fn 区间回调。
+ * @param ctx 传给回调的上下文。
+ */
+void parallel_for(int count, int min_chunk, parallel_range_fn fn, void *ctx);
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef PHASH_H
+#define PHASH_H
+
+#include <stdint.h>
+
+// 计算感知哈希时最多读取的图像行数，更高的图像按固定间隔抽取行
+#define PHASH_SAMPLE_ROWS 256
+
+/**
+ * @brief 图像的感知哈希：两种64位哈希，重新保存、重新编码或轻微调整亮度后只有少数位改变。
+ */
+typedef struct
+{
+    uint64_t dhash; // 差异哈希：9x8 亮度缩略图中每行相邻两格的大小关系
+    uint64_t phash; // DCT 哈希：32x32 亮度缩略图的 8x8 低频 DCT 系数与其中位数的大小关系
+} image_hash_t;
+
+// 重复图像索引的分段：dHash 和 pHash 各分为4个16位的段，每段按取值分桶
+#define HASH_INDEX_BANDS 8
+#define HASH_INDEX_BAND_BITS 16
+#define HASH_INDEX_BUCKETS (1 << HASH_INDEX_BAND_BITS)
+
+/**
+ * @brief 按 image_hash_t 的感知哈希查找重复图像的索引。
+ *
+ * 名称查找使用开放寻址的哈希表；按距离查找时只比较与查询的某一段足够接近的桶中的条目，
+ * 不需要扫描整个索引（见 hash_index_find）。
+ */
+typedef struct
+{
+    image_hash_t hash;
+    char *name; // 图像的标识（批处理中为不含扩展名的文件名）
+    int id;     // 调用者的编号，从索引文件读入的条目为 -1
+} hash_index_entry_t;
+
+typedef struct
+{
+    hash_index_entry_t *entries;
+    int count;
+    int capacity;
+    int *name_slots; // 按名称哈希线性探测的表，存条目下标，-1 为空槽；负载不超过一半
+    int name_mask;   // 名称表的槽数减1（槽数为2的幂）
+    int *band_heads; // HASH_INDEX_BANDS 段各 HASH_INDEX_BUCKETS 个桶的链表头，-1 为空桶
+    int *band_links; // 每个条目在每段的桶链表中的前驱和后继，随 capacity 增长
+} hash_index_t;
+
+/**
+ * @brief 计算图像的感知哈希。
+ *
+ * 单遍扫描：每行用按通道数特化的亮度函数转换后，同时按面积累加到 32x32 和 9x8 两个缩略网格中；
+ * 图像高于 PHASH_SAMPLE_ROWS 行时按固定间隔抽取行，开销只占解码的一小部分。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param hash 输出的哈希。
+ * @return 成功返回1，失败返回0。
+ */
+int image_hash_compute(const unsigned char *data, int width, int height, int channels, image_hash_t *hash);
+
+/**
+ * @brief 两个哈希的距离：dHash 和 pHash 汉明距离中较大的一个，两种哈希都接近时才认为图像相同。
+ * @param a 第一个哈希。
+ * @param b 第二个哈希。
+ * @return 距离（0-64）。
+ */
+int image_hash_distance(image_hash_t a, image_hash_t b);
+
+/**
+ * @brief 初始化空索引。
+ * @param index 索引。
+ */
+void hash_index_init(hash_index_t *index);
+
+/**
+ * @brief 释放索引的全部条目。
+ * @param index 索引。
+ */
+void hash_index_free(hash_index_t *index);
+
+/**
+ * @brief 添加条目；已有同名条目时替换它的哈希和编号。
+ * @param index 索引。
+ * @param hash 哈希。
+ * @param name 图像标识（复制一份保存）。
+ * @param id 调用者的编号。
+ * @return 成功返回条目的下标，失败返回 -1。
+ */
+int hash_index_add(hash_index_t *index, image_hash_t hash, const char *name, int id);
+
+/**
+ * @brief 删除一个条目（最后一个条目移到它的位置）。
+ * @param index 索引。
+ * @param k 条目的下标。
+ */
+void hash_index_remove(hash_index_t *index, int k);
+
+/**
+ * @brief 按名称查找条目。
+ * @param index 索引。
+ * @param name 图像标识。
+ * @return 条目的下标，不存在时返回 -1。
+ */
+int hash_index_lookup_name(const hash_index_t *index, const char *name);
+
+/**
+ * @brief 查找与给定哈希距离最近且不超过 max_distance 的条目；距离相同时返回下标最小的条目。
+ *
+ * 两种哈希各分为4段，距离不超过 max_distance 的条目至少有一段与查询相差不超过 max_distance/4 位，
+ * 只比较这些桶中的条目；要查看的桶比条目还多时线性扫描。
+ * @param index 索引。
+ * @param hash 哈希。
+ * @param max_distance 允许的最大距离（见 image_hash_distance）。
+ * @param distance 输出找到的条目的距离，可以为 NULL。
+ * @return 条目的下标，没有足够接近的条目时返回 -1。
+ */
+int hash_index_find(const hash_index_t *index, image_hash_t hash, int max_distance, int *distance);
+
+/**
+ * @brief 从文本文件读入条目（每行 "dhash phash 名称"，哈希为16位十六进制），读入的条目编号为 -1。
+ * @param index 索引，读入的条目追加到其中。
+ * @param path 索引文件路径。
+ * @return 读入的条目数，文件不存在时返回0，读取失败返回 -1。
+ */
+int hash_index_load(hash_index_t *index, const char *path);
+
+/**
+ * @brief 把全部条目写入文本文件：先写临时文件再重命名，中途失败不会留下不完整的索引。
+ * @param index 索引。
+ * @param path 索引文件路径。
+ * @return 成功返回1，失败返回0。
+ */
+int hash_index_save(const hash_index_t *index, const char *path);
+
+#endif
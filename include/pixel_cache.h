@@ -0,0 +1,72 @@
+#ifndef PIXEL_CACHE_H
+#define PIXEL_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 缓存文件头的大小，像素数据从这里开始，按页对齐以便直接映射
+#define PIXEL_CACHE_HEADER_SIZE 4096
+// 每个分块的行数：分块是整行宽的行带，与批处理的最小分块行数相同
+#define PIXEL_CACHE_TILE_ROWS 32
+
+/**
+ * @brief 缓存文件头（位于文件开头，其余部分补0到 PIXEL_CACHE_HEADER_SIZE）。
+ *
+ * 像素数据按 tile_rows 行一个分块顺序存放，每个分块是整行宽的交错像素，因此整段数据就是紧密排列的
+ * 行主序图像：映射后不需要任何转换即可交给现有的效果使用，按行带处理的滤镜只会触发它访问的分块所在的页。
+ */
+typedef struct
+{
+    char magic[8];        // "IPXCACHE"
+    uint32_t version;     // 格式版本，当前为1
+    uint32_t header_size; // 像素数据的偏移（PIXEL_CACHE_HEADER_SIZE）
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t tile_rows;   // 每个分块的行数
+    uint64_t source_hash; // 源文件内容的哈希，与缓存文件名一致
+    uint64_t source_size; // 源文件的字节数
+    uint64_t data_size;   // 像素数据的字节数（width * height * channels）
+} pixel_cache_header_t;
+
+/**
+ * @brief 设置解码缓存目录（不存在时创建）；NULL 表示关闭缓存。
+ *        未调用时第一次加载图像按环境变量 IMAGEPROC_PIXEL_CACHE 设置。Windows 下不支持，始终关闭。
+ * @param dir 缓存目录。
+ * @return 成功返回1，目录路径过长或无法创建返回0（缓存保持关闭）。
+ */
+int pixel_cache_set_dir(const char *dir);
+
+/**
+ * @brief 缓存是否开启。
+ * @return 开启返回1，否则返回0。
+ */
+int pixel_cache_enabled(void);
+
+/**
+ * @brief 经缓存加载图像：读入源文件并计算内容哈希，缓存中有有效的条目时直接映射它（写时复制，修改不影响缓存文件）；
+ *        否则从已读入的内容解码，把像素写入缓存（先写临时文件再改名）后返回解码结果。
+ *        返回值必须用 free_image 释放，需要扩展时用 image_realloc。
+ * @param path 源文件路径。
+ * @param width 输出的图像宽度。
+ * @param height 输出的图像高度。
+ * @param channels 输出的图像通道数。
+ * @return 成功返回图像数据，失败返回NULL。
+ */
+unsigned char *pixel_cache_load(const char *path, int *width, int *height, int *channels);
+
+/**
+ * @brief 查询图像数据是否为映射的缓存文件。
+ * @param data 图像数据。
+ * @return 映射的像素数据字节数，不是映射时返回0。
+ */
+size_t pixel_cache_mapped_size(const unsigned char *data);
+
+/**
+ * @brief 解除映射的缓存文件。
+ * @param data 图像数据。
+ * @return data 是映射的缓存文件（已解除映射）返回1，否则返回0（调用者负责用 free 释放）。
+ */
+int pixel_cache_release(unsigned char *data);
+
+#endif
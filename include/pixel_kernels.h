@@ -0,0 +1,32 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+/**
+ * @brief 按通道数特化的逐行像素处理函数。
+ *
+ * 1、3、4 通道各有一份通道数为编译期常量的实现，内层循环没有运行时的通道循环，编译器可以展开和向量化；
+ * 其余通道数使用运行时通道数的通用实现。调用者每次调用只选择一次函数表，之后逐行调用。
+ * 所有函数的 channels 参数在特化版本中被忽略。
+ */
+typedef struct
+{
+    // 交错行 -> 单通道亮度 (0.299R + 0.587G + 0.114B)，不足三个通道时取第一个通道
+    void (*luma)(const unsigned char *src, unsigned char *dst, int width, int channels);
+    // 交错行 -> 交错灰度行，Alpha 等其余通道保持不变；src 与 dst 可以相同
+    void (*grayscale)(const unsigned char *src, unsigned char *dst, int width, int channels);
+    // 交错行 -> 交错反色行，只反转前三个通道；src 与 dst 可以相同
+    void (*invert)(const unsigned char *src, unsigned char *dst, int width, int channels);
+    // 交错行的 [x, width) 部分拆分到各通道平面（planes 已指向当前行）
+    void (*deinterleave)(const unsigned char *src, unsigned char *const *planes, int x, int width, int channels);
+    // 各通道平面的 [x, width) 部分合并到交错行（planes 已指向当前行）
+    void (*interleave)(const unsigned char *const *planes, unsigned char *dst, int x, int width, int channels);
+} pixel_kernels_t;
+
+/**
+ * @brief 按通道数选择逐行处理函数表。
+ * @param channels 通道数（>0）。
+ * @return 函数表，1/3/4 通道返回特化版本，其余返回通用版本。
+ */
+const pixel_kernels_t *pixel_kernels_for(int channels);
+
+#endif
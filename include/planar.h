@@ -0,0 +1,143 @@
+#ifndef PLANAR_H
+#define PLANAR_H
+
+// 像素内存布局
+typedef enum
+{
+    IMAGE_LAYOUT_INTERLEAVED, // 交错布局 (RGBRGB...)
+    IMAGE_LAYOUT_PLANAR       // 平面布局 (RRR...GGG...BBB...)
+} image_layout_t;
+
+// 平面布局下单个平面的最大通道数
+#define IMAGE_MAX_CHANNELS 4
+
+// 图像中的矩形区域 (Region of Interest)
+typedef struct
+{
+    int x; // 左上角横坐标
+    int y; // 左上角纵坐标
+    int w; // 宽度
+    int h; // 高度
+} image_rect_t;
+
+/**
+ * @brief 带步长和布局信息的图像描述结构。
+ *
+ * 交错布局时 data 指向第一行像素，stride 为相邻两行的字节距离；
+ * 平面布局时 planes[c] 指向第 c 个通道的第一行，stride 为平面内相邻两行的字节距离。
+ * stride 可以大于有效宽度，因此同一结构既能描述填充过的缓冲区，也能描述大图中的子矩形。
+ */
+typedef struct
+{
+    int width;                                // 图像宽度（像素）
+    int height;                               // 图像高度（像素）
+    int channels;                             // 通道数
+    int stride;                               // 行步长（字节）
+    image_layout_t layout;                    // 内存布局
+    unsigned char *data;                      // 交错布局的像素起点
+    unsigned char *planes[IMAGE_MAX_CHANNELS]; // 平面布局下各通道的起点
+    unsigned char *storage;                   // 自有内存（包装外部缓冲区时为NULL）
+} image_buffer_t;
+
+/**
+ * @brief 将矩形裁剪到图像范围内。
+ * @param rect 待裁剪的矩形，原地修改。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @return 裁剪后矩形非空返回1，否则返回0。
+ */
+int image_rect_clip(image_rect_t *rect, int width, int height);
+
+/**
+ * @brief 分配一幅指定布局的图像，行步长按32字节对齐。
+ * @param img 输出的图像结构。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param layout 内存布局。
+ * @return 成功返回1，失败返回0。
+ */
+int image_buffer_alloc(image_buffer_t *img, int width, int height, int channels, image_layout_t layout);
+
+/**
+ * @brief 将已有的交错像素缓冲区包装为图像结构（不复制数据）。
+ * @param img 输出的图像结构。
+ * @param data 交错像素数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param stride 行步长（字节），传0表示紧密排列 (width * channels)。
+ */
+void image_buffer_wrap(image_buffer_t *img, unsigned char *data, int width, int height, int channels, int stride);
+
+/**
+ * @brief 取图像中的一个子矩形视图（不复制数据，与原图共享内存）。
+ * @param src 源图像。
+ * @param x 子矩形左上角横坐标。
+ * @param y 子矩形左上角纵坐标。
+ * @param w 子矩形宽度。
+ * @param h 子矩形高度。
+ * @param view 输出的视图。
+ * @return 成功返回1，矩形越界返回0。
+ */
+int image_buffer_view(const image_buffer_t *src, int x, int y, int w, int h, image_buffer_t *view);
+
+/**
+ * @brief 释放 image_buffer_alloc 分配的内存，包装或视图结构不会释放外部数据。
+ * @param img 图像结构。
+ */
+void image_buffer_free(image_buffer_t *img);
+
+/**
+ * @brief 将交错像素行拆分为独立的通道平面。
+ * @param src 交错像素数据。
+ * @param src_stride 交错数据的行步长（字节）。
+ * @param planes 各通道平面的起点。
+ * @param plane_stride 平面的行步长（字节）。
+ * @param width 宽度。
+ * @param height 高度。
+ * @param channels 通道数 (1-4)。
+ */
+void deinterleave_rows(const unsigned char *src,
+                       int src_stride,
+                       unsigned char *const *planes,
+                       int plane_stride,
+                       int width,
+                       int height,
+                       int channels);
+
+/**
+ * @brief 将独立的通道平面合并为交错像素行。
+ * @param planes 各通道平面的起点。
+ * @param plane_stride 平面的行步长（字节）。
+ * @param dst 交错像素数据。
+ * @param dst_stride 交错数据的行步长（字节）。
+ * @param width 宽度。
+ * @param height 高度。
+ * @param channels 通道数 (1-4)。
+ */
+void interleave_rows(const unsigned char *const *planes,
+                     int plane_stride,
+                     unsigned char *dst,
+                     int dst_stride,
+                     int width,
+                     int height,
+                     int channels);
+
+/**
+ * @brief 将交错图像转换为新分配的平面图像。
+ * @param src 交错布局的源图像。
+ * @param dst 输出的平面图像，调用者负责用 image_buffer_free 释放。
+ * @return 成功返回1，失败返回0。
+ */
+int image_buffer_to_planar(const image_buffer_t *src, image_buffer_t *dst);
+
+/**
+ * @brief 将平面图像写回交错布局的目标图像（两者尺寸和通道数必须一致）。
+ * @param src 平面布局的源图像。
+ * @param dst 交错布局的目标图像。
+ * @return 成功返回1，失败返回0。
+ */
+int image_buffer_to_interleaved(const image_buffer_t *src, image_buffer_t *dst);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+// 金字塔最多保留的层数：1x, 2x, 4x, 8x
+#define PYRAMID_MAX_LEVELS 4
+// 缩略图长边的默认上限（像素）
+#define PYRAMID_THUMBNAIL_SIZE 128
+
+/**
+ * @brief 图像金字塔，第 i 层是原图按 2^i 倍缩小的结果（交错布局、紧密排列）。
+ *
+ * 第0层可以是调用者持有的原图（不释放）。只需要缩小图像时，较低的层可以为NULL
+ * （见 load_image_reduced），各层的尺寸仍照常记录，width[0] / height[0] 是原图尺寸。
+ */
+typedef struct
+{
+    int levels;                         // 有效层数
+    int channels;                       // 通道数
+    int width[PYRAMID_MAX_LEVELS];      // 各层宽度
+    int height[PYRAMID_MAX_LEVELS];     // 各层高度
+    unsigned char *data[PYRAMID_MAX_LEVELS]; // 各层像素数据
+} image_pyramid_t;
+
+/**
+ * @brief 用2x2盒式平均将图像缩小一半（奇数尺寸向上取整，末行/末列与自身平均）。
+ * @param src 源图像数据。
+ * @param width 源图像宽度。
+ * @param height 源图像高度。
+ * @param channels 通道数。
+ * @param out_width 输出宽度。
+ * @param out_height 输出高度。
+ * @return 成功返回新分配的缩小图像，调用者负责释放；失败返回NULL。
+ */
+unsigned char *downsample_2x(
+    const unsigned char *src, int width, int height, int channels, int *out_width, int *out_height);
+
+/**
+ * @brief 由原图构建金字塔。
+ * @param pyramid 输出的金字塔。
+ * @param data 原图数据，作为第0层（金字塔不负责释放）。
+ * @param width 原图宽度。
+ * @param height 原图高度。
+ * @param channels 通道数。
+ * @param max_factor 最大缩小倍数（1/2/4/8）。
+ * @return 成功返回1，失败返回0。
+ */
+int pyramid_build(image_pyramid_t *pyramid, unsigned char *data, int width, int height, int channels, int max_factor);
+
+/**
+ * @brief 为给定的块大小选择最合适的层：缩小倍数必须整除块大小，且尽可能大。
+ * @param pyramid 金字塔。
+ * @param block_size 每个输出单元在原图中对应的像素数。
+ * @return 选中的层号。
+ */
+int pyramid_level_for_block(const image_pyramid_t *pyramid, int block_size);
+
+/**
+ * @brief 选择长边不超过 max_size 的最大一层（都不满足时返回最小的一层）。
+ * @param pyramid 金字塔。
+ * @param max_size 长边上限（像素）。
+ * @return 选中的层号。
+ */
+int pyramid_level_for_size(const image_pyramid_t *pyramid, int max_size);
+
+/**
+ * @brief 生成长边不超过 max_size 的缩略图：取长边不超过 max_size 的最大一层，
+ *        最小的一层仍然过大时（原图大于 8*max_size）再用盒式滤波缩放到上限。
+ * @param pyramid 金字塔。
+ * @param max_size 长边上限（像素）。
+ * @param out_width 输出的缩略图宽度。
+ * @param out_height 输出的缩略图高度。
+ * @return 成功返回新分配的缩略图，调用者负责释放；失败返回NULL。
+ */
+unsigned char *pyramid_thumbnail(const image_pyramid_t *pyramid, int max_size, int *out_width, int *out_height);
+
+/**
+ * @brief 释放金字塔第1层及以上的数据（第0层由调用者管理）。
+ * @param pyramid 金字塔。
+ */
+void pyramid_free(image_pyramid_t *pyramid);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef RESIZE_H
+#define RESIZE_H
+
+// 重采样滤波器
+typedef enum
+{
+    RESIZE_FILTER_BOX,      // 盒式滤波（最近邻区域平均）
+    RESIZE_FILTER_BILINEAR, // 双线性（三角形核）
+    RESIZE_FILTER_BICUBIC,  // 双三次 (a = -0.5)
+    RESIZE_FILTER_LANCZOS3  // Lanczos3
+} resize_filter_t;
+
+/**
+ * @brief 缩放图像到指定尺寸。
+ *
+ * 先按列、再按行做两遍可分离卷积；每个输出行/列的权重预先计算成14位定点数表，
+ * 缩小时滤波核按比例放大以避免混叠。两遍都按行拆分到多个线程执行。
+ * @param data 源图像数据（交错布局、紧密排列）。
+ * @param width 源图像宽度。
+ * @param height 源图像高度。
+ * @param channels 图像通道数。
+ * @param new_width 目标宽度。
+ * @param new_height 目标高度。
+ * @param filter 重采样滤波器。
+ * @return 成功返回新分配的缩放结果，调用者负责释放；失败返回NULL。
+ */
+unsigned char *resize_image(const unsigned char *data,
+                            int width,
+                            int height,
+                            int channels,
+                            int new_width,
+                            int new_height,
+                            resize_filter_t filter);
+
+/**
+ * @brief 缩放图像，结果写入调用者提供的缓冲区。
+ * @param data 源图像数据（交错布局、紧密排列）。
+ * @param width 源图像宽度。
+ * @param height 源图像高度。
+ * @param channels 图像通道数。
+ * @param dst 目标缓冲区，至少 new_width * new_height * channels 字节。横向一遍先把所需源行全部读入
+ *            中间缓冲区，纵向一遍才写 dst，因此容量足够时 dst 可以就是 data。
+ * @param new_width 目标宽度。
+ * @param new_height 目标高度。
+ * @param filter 重采样滤波器。
+ * @return 成功返回1，失败返回0。
+ */
+int resize_image_into(const unsigned char *data,
+                      int width,
+                      int height,
+                      int channels,
+                      unsigned char *dst,
+                      int new_width,
+                      int new_height,
+                      resize_filter_t filter);
+
+/**
+ * @brief 按名称解析滤波器（"box"、"bilinear"、"bicubic"、"lanczos3"）。
+ * @param name 滤波器名称。
+ * @param filter 输出的滤波器。
+ * @return 成功返回1，未知名称返回0。
+ */
+int resize_filter_from_name(const char *name, resize_filter_t *filter);
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef ROTATE_H
 #define ROTATE_H
 
+#include "planar.h"
+
 /**
  * @brief 旋转图像（实现180度翻转）
  * @param data 图像的像素数据
@@ -10,4 +12,25 @@
  */
 void rotate_image(unsigned char *data, int width, int height, int channels);
 
-#endif
\ No newline at end of file
+/**
+ * @brief 对图像中的矩形区域做上下翻转
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 处理区域，超出图像的部分会被裁剪
+ * @param dst 输出区域左上角像素的地址，传NULL表示在区域内原地翻转
+ * @param dst_stride 输出的行步长（字节）
+ * @return 成功返回1，失败返回0
+ */
+int rotate_image_roi(unsigned char *data,
+                     int width,
+                     int height,
+                     int channels,
+                     int stride,
+                     image_rect_t roi,
+                     unsigned char *dst,
+                     int dst_stride);
+
+#endif
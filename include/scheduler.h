@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/**
+ * @brief 任务函数。
+ * @param arg 提交任务时传入的参数。
+ */
+typedef void (*task_fn)(void *arg);
+
+// 工作窃取调度器（不透明类型）
+typedef struct scheduler scheduler_t;
+
+// 一组任务，用于等待它们全部完成；提交前用 task_group_init 初始化
+typedef struct
+{
+    int pending; // 尚未完成的任务数
+} task_group_t;
+
+/**
+ * @brief 创建调度器并启动工作线程。
+ *
+ * 每个工作线程有自己的双端队列：自己提交的任务压入队尾并从队尾取（后进先出，缓存友好），
+ * 空闲时从其他线程的队首窃取（先进先出，偷到的是较大、较早的任务）。
+ * 在工作线程之外提交的任务进入一个全局队列，工作线程只在没有可窃取的任务时才从中领取。
+ * @param threads 工作线程数，<=0 时使用 parallel_thread_count()。
+ * @return 调度器，失败返回NULL。
+ */
+scheduler_t *scheduler_create(int threads);
+
+/**
+ * @brief 停止工作线程并释放调度器。调用前应等待所有任务完成。
+ * @param sched 调度器。
+ */
+void scheduler_destroy(scheduler_t *sched);
+
+/**
+ * @brief 调度器的工作线程数。
+ * @param sched 调度器。
+ * @return 线程数。
+ */
+int scheduler_thread_count(const scheduler_t *sched);
+
+/**
+ * @brief 当前线程所属的调度器。
+ * @return 在工作线程中返回其调度器，否则返回NULL。
+ */
+scheduler_t *scheduler_current(void);
+
+/**
+ * @brief 初始化任务组。
+ * @param group 任务组。
+ */
+void task_group_init(task_group_t *group);
+
+/**
+ * @brief 提交一个任务。在工作线程中提交时进入该线程的队列，否则进入全局队列。
+ * @param sched 调度器。
+ * @param group 任务所属的组，可以为NULL。
+ * @param fn 任务函数。
+ * @param arg 任务参数。
+ * @return 成功返回1；内存不足时在调用线程上直接执行任务并返回0。
+ */
+int scheduler_spawn(scheduler_t *sched, task_group_t *group, task_fn fn, void *arg);
+
+/**
+ * @brief 等待组内任务全部完成。
+ *
+ * 工作线程等待时继续执行自己队列中的任务或从其他线程窃取，但不领取全局队列中的任务，
+ * 避免在一个大任务的等待中又嵌套开始另一个大任务。其他线程等待时阻塞。
+ * @param sched 调度器。
+ * @param group 任务组。
+ */
+void scheduler_wait(scheduler_t *sched, task_group_t *group);
+
+#endif
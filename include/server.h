@@ -0,0 +1,21 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/**
+ * @brief 以服务模式运行：监听 Unix 域套接字，由常驻的工作线程池处理请求。
+ *
+ * 每个连接可以发送多行请求，每行得到一行应答（字段以空白分隔，路径中不能包含空白）：
+ * - "<输入图像> <输出图像> <效果列表>" → "OK <输出图像> <宽>x<高> <耗时>ms" 或 "ERR <原因>"，
+ *   效果列表的格式见 effects_parse，例如 "grayscale,blur:3,edge:40"；
+ * - "PING" → "PONG"；
+ * - "SHUTDOWN" → "BYE"，随后服务停止（SIGINT/SIGTERM 同样会停止服务）。
+ *
+ * 工作线程在整个服务期间常驻，各自保留输入文件缓冲区，处理请求时不再付出进程启动和冷缓存的开销。
+ * Windows 下不支持该模式。
+ * @param socket_path 套接字路径，已存在的同名文件会被删除。
+ * @param workers 工作线程数，<=0 时使用 parallel_thread_count()。
+ * @return 正常停止返回1，启动失败返回0。
+ */
+int serve_run(const char *socket_path, int workers);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+/**
+ * @brief 链式处理模式：读取一幅图像，按执行计划在同一个缓冲区上依次应用效果链，最后只编码一次。
+ *
+ * 输入/输出路径为NULL时使用标准输入/标准输出，不产生中间文件；写标准输出期间标准输出被重定向到
+ * 标准错误，各模块打印的日志不会混入图像数据。
+ * @param ops_spec 效果列表，格式见 effects_parse，例如 "grayscale,blur:3,edge:40"。
+ * @param input_path 输入图像路径，NULL 表示标准输入。
+ * @param output_path 输出图像路径，NULL 表示标准输出。
+ * @param format 写标准输出时的格式："png"、"jpg"、"bmp" 或 "tga"；写文件时由扩展名决定。
+ * @param quality JPEG质量参数 (1-100)。
+ * @return 成功返回1，失败返回0。
+ */
+int stream_process(const char *ops_spec,
+                   const char *input_path,
+                   const char *output_path,
+                   const char *format,
+                   int quality);
+
+#endif
@@ -1,26 +1,34 @@
 #include "ascii_art.h"
+#include "histogram.h"
+#include "log.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
 /**
- * @brief 将图像转换为 ASCII 字符画并保存到文件中。
- * @param data 图像数据。
- * @param width 图像宽度。
- * @param height 图像高度。
+ * @brief image_to_ascii 的实现，可直接在金字塔的缩小层上采样。
+ * @param data 采样所用图像（原图或缩小 level_factor 倍的图像）。
+ * @param width 采样图像宽度。
+ * @param height 采样图像高度。
  * @param channels 图像通道数。
- * @param output_file 输出ASCII字符画的文件路径。
- * @param scale_factor 缩放因子，用于调整输出字符画的大小，值越大输出越小。
+ * @param original_width 原图宽度（写入文件头）。
+ * @param original_height 原图高度（写入文件头）。
+ * @param output_file 输出文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param level_factor 采样图像相对原图的缩小倍数，必须整除 scale_factor。
  * @return 成功返回1，失败返回0。
  */
-int image_to_ascii(unsigned char *data, int width, int height, int channels, const char *output_file, int scale_factor)
+static int render_ascii_simple(const unsigned char *data,
+                               int width,
+                               int height,
+                               int channels,
+                               int original_width,
+                               int original_height,
+                               const char *output_file,
+                               int scale_factor,
+                               int level_factor)
 {
-    if (!data || width <= 0 || height <= 0 || channels <= 0 || !output_file || scale_factor <= 0) {
-        fprintf(stderr, "Invalid parameters for image_to_ascii\n");
-        return 0;
-    }
-
     // 块状字符集：使用ASCII兼容字符避免乱码问题
     const char *ascii_chars = " .:=#";
     int ascii_chars_len = strlen(ascii_chars);
@@ -34,6 +42,14 @@ int image_to_ascii(unsigned char *data, int width, int height, int channels, con
     // 垂直方向上，每个输出字符对应原始图像中的像素数（考虑高宽比补偿）
     int v_sample_step = (int)(scale_factor * aspect_ratio_correction);
 
+    // 在缩小后的图像上，每个字符覆盖的像素数按同样比例减少
+    int h_block = h_sample_step / level_factor;
+    int v_block = v_sample_step / level_factor;
+    if (h_block <= 0)
+        h_block = 1;
+    if (v_block <= 0)
+        v_block = 1;
+
     // 确保采样步长至少为1，防止除零或无效循环
     if (h_sample_step <= 0)
         h_sample_step = 1;
@@ -42,18 +58,18 @@ int image_to_ascii(unsigned char *data, int width, int height, int channels, con
 
     // 计算最终ASCII字符画的宽度（字符数）
     // 使用 (numerator + denominator - 1) / denominator 实现向上取整
-    int ascii_art_width = (width + h_sample_step - 1) / h_sample_step;
+    int ascii_art_width = (width + h_block - 1) / h_block;
     // 计算最终ASCII字符画的高度（字符数）
-    int ascii_art_height = (height + v_sample_step - 1) / v_sample_step;
+    int ascii_art_height = (height + v_block - 1) / v_block;
 
     FILE *fp = fopen(output_file, "w");
     if (!fp) {
-        fprintf(stderr, "Error opening output file '%s'\n", output_file);
+        LOG_ERROR("Error opening output file '%s'", output_file);
         return 0;
     }
 
     // 在输出文件中写入一些元信息
-    fprintf(fp, "ASCII Art - Original Image: %dx%d pixels\n", width, height);
+    fprintf(fp, "ASCII Art - Original Image: %dx%d pixels\n", original_width, original_height);
     fprintf(fp, "Output Dimensions: %d chars wide x %d chars high\n", ascii_art_width, ascii_art_height);
     fprintf(fp, "Sampling Step: Horizontal=%d pixels/char, Vertical=%d pixels/char\n", h_sample_step, v_sample_step);
     fprintf(fp, "Scale Factor: %d, Aspect Ratio Correction: %.1f\n\n", scale_factor, aspect_ratio_correction);
@@ -62,21 +78,21 @@ int image_to_ascii(unsigned char *data, int width, int height, int channels, con
     for (int char_y = 0; char_y < ascii_art_height; ++char_y) {
         for (int char_x = 0; char_x < ascii_art_width; ++char_x) {
             // 计算当前字符对应的原始图像区域的左上角坐标
-            int original_region_x_start = char_x * h_sample_step;
-            int original_region_y_start = char_y * v_sample_step;
+            int original_region_x_start = char_x * h_block;
+            int original_region_y_start = char_y * v_block;
 
             float sum_of_brightness_values = 0.0f;
             int num_pixels_in_current_block = 0;
 
             // 遍历当前字符对应的原始图像块内的所有像素
-            for (int dy_in_block = 0; dy_in_block < v_sample_step; ++dy_in_block) {
+            for (int dy_in_block = 0; dy_in_block < v_block; ++dy_in_block) {
                 int current_original_pixel_y = original_region_y_start + dy_in_block;
 
                 // 检查是否超出图像的垂直边界
                 if (current_original_pixel_y >= height)
                     break;
 
-                for (int dx_in_block = 0; dx_in_block < h_sample_step; ++dx_in_block) {
+                for (int dx_in_block = 0; dx_in_block < h_block; ++dx_in_block) {
                     int current_original_pixel_x = original_region_x_start + dx_in_block;
 
                     // 检查是否超出图像的水平边界
@@ -133,12 +149,65 @@ int image_to_ascii(unsigned char *data, int width, int height, int channels, con
         fprintf(fp, "\n"); // 每行结束后换行
     }
 
-    fclose(fp);
-    printf("Successfully saved ASCII art to '%s'\n", output_file);
-    printf("ASCII art dimensions: %d x %d characters\n", ascii_art_width, ascii_art_height);
+    // 写入失败（例如磁盘已满）时文件不完整，必须报告失败
+    int ok = !ferror(fp);
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok) {
+        LOG_ERROR("Error writing ASCII art to '%s'", output_file);
+        return 0;
+    }
+    LOG_DEBUG("Successfully saved ASCII art to '%s'", output_file);
+    LOG_DEBUG("ASCII art dimensions: %d x %d characters", ascii_art_width, ascii_art_height);
     return 1;
 }
 
+/**
+ * @brief 将图像转换为 ASCII 字符画并保存到文件中。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 缩放因子，用于调整输出字符画的大小，值越大输出越小。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii(unsigned char *data, int width, int height, int channels, const char *output_file, int scale_factor)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || !output_file || scale_factor <= 0) {
+        LOG_ERROR("Invalid parameters for image_to_ascii");
+        return 0;
+    }
+
+    return render_ascii_simple(data, width, height, channels, width, height, output_file, scale_factor, 1);
+}
+
+/**
+ * @brief 使用图像金字塔中合适的缩小层生成简单风格的 ASCII 字符画。
+ * @param pyramid 图像金字塔。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_pyramid(const image_pyramid_t *pyramid, const char *output_file, int scale_factor)
+{
+    if (!pyramid || pyramid->levels <= 0 || !output_file || scale_factor <= 0) {
+        LOG_ERROR("Invalid parameters for image_to_ascii_pyramid");
+        return 0;
+    }
+
+    // 每个字符覆盖 scale_factor x (2 * scale_factor) 个像素，选取能整除水平步长的最大缩小倍数
+    int level = pyramid_level_for_block(pyramid, scale_factor);
+    return render_ascii_simple(pyramid->data[level],
+                               pyramid->width[level],
+                               pyramid->height[level],
+                               pyramid->channels,
+                               pyramid->width[0],
+                               pyramid->height[0],
+                               output_file,
+                               scale_factor,
+                               1 << level);
+}
+
 /**
  * @brief 获取指定风格的ASCII字符集
  * @param style ASCII字符画风格
@@ -167,37 +236,161 @@ static const char *get_ascii_charset(ascii_style_t style)
         // 经典ASCII字符集：完全兼容所有终端和编码
         return " .-:=+*%#@";
 
+    case ASCII_STYLE_EDGES:
+        // 边缘方向风格：非边缘字符块使用扩展字符集按亮度选择
+        return " .,:;!+*oxO0#@";
+
     default:
         return " .:=#";
     }
 }
 
 /**
- * @brief 将图像转换为指定风格的 ASCII 字符画并保存到文件中。
- * @param data 图像数据。
- * @param width 图像宽度。
- * @param height 图像高度。
+ * @brief 按字符块汇总梯度场，为梯度强且方向一致的字符块选择边缘方向字符。
+ *
+ * 梯度幅值超过 Otsu 阈值的像素计入字符块的结构张量 (Σgx², Σgy², Σgx·gy)，张量的倍角方向给出主梯度方向，
+ * 边缘与梯度垂直：水平梯度为 '|'，垂直梯度为 '-'（强像素的重心落在字符块下三分之一时为 '_'），
+ * 对角方向为 '/' 或 '\'。细线两侧方向相反的梯度在张量中不会互相抵消。
+ * 强像素少于字符块的短边（一条水平边缘穿过字符块时的像素数）、或方向不一致（角点、纹理）的字符块
+ * 不选择方向字符。
+ * @param gradient 梯度场。
+ * @param block_w 每个字符块在梯度场中的宽度（像素）。
+ * @param block_h 每个字符块在梯度场中的高度（像素）。
+ * @param cols 字符画宽度（字符数）。
+ * @param rows 字符画高度（字符数）。
+ * @return cols * rows 的字符表，0 表示按亮度选择字符；失败返回 NULL。调用者负责释放内存。
+ */
+static char *edge_glyph_map(const sobel_gradient_t *gradient, int block_w, int block_h, int cols, int rows)
+{
+    char *glyphs = (char *)calloc((size_t)cols * rows, 1);
+    double *tensor = (double *)malloc((size_t)cols * 5 * sizeof(double));
+    if (!glyphs || !tensor) {
+        LOG_ERROR("Memory allocation failed for edge glyph map");
+        free(glyphs);
+        free(tensor);
+        return NULL;
+    }
+
+    int w = gradient->width;
+    int h = gradient->height;
+    unsigned int hist[256] = {0};
+    histogram_accumulate(gradient->magnitude, (size_t)w * h, hist);
+    int threshold = edge_auto_threshold(hist, EDGE_THRESHOLD_OTSU);
+    int min_strong = block_w < block_h ? block_w : block_h;
+
+    for (int char_y = 0; char_y < rows; char_y++) {
+        // tensor[5 * char_x] 依次为 Σgx²、Σgy²、Σgx·gy、强像素数和强像素的块内行号之和
+        memset(tensor, 0, (size_t)cols * 5 * sizeof(double));
+        int y_begin = char_y * block_h;
+        int y_end = y_begin + block_h < h ? y_begin + block_h : h;
+        for (int y = y_begin; y < y_end; y++) {
+            const int *gx = gradient->gx + (size_t)y * w;
+            const int *gy = gradient->gy + (size_t)y * w;
+            const unsigned char *mag = gradient->magnitude + (size_t)y * w;
+            int x_end = cols * block_w < w ? cols * block_w : w;
+            for (int x = 0; x < x_end; x++) {
+                if (mag[x] <= threshold)
+                    continue;
+                double *t = tensor + (size_t)(x / block_w) * 5;
+                t[0] += (double)gx[x] * gx[x];
+                t[1] += (double)gy[x] * gy[x];
+                t[2] += (double)gx[x] * gy[x];
+                t[3] += 1.0;
+                t[4] += y - y_begin;
+            }
+        }
+
+        for (int char_x = 0; char_x < cols; char_x++) {
+            const double *t = tensor + (size_t)char_x * 5;
+            if (t[3] < min_strong)
+                continue;
+            // 倍角表示：a = Σgx² - Σgy²，b = 2Σgx·gy；一致性 sqrt(a² + b²) / (Σgx² + Σgy²) 不低于 0.6
+            double a = t[0] - t[1];
+            double b = 2.0 * t[2];
+            double energy = t[0] + t[1];
+            if (a * a + b * b < 0.36 * energy * energy)
+                continue;
+
+            char glyph;
+            if (fabs(a) >= fabs(b))
+                glyph = a > 0 ? '|' : (3.0 * t[4] >= 2.0 * t[3] * (block_h - 1) ? '_' : '-');
+            else
+                glyph = b > 0 ? '/' : '\\';
+            glyphs[(size_t)char_y * cols + char_x] = glyph;
+        }
+    }
+
+    free(tensor);
+    return glyphs;
+}
+
+/**
+ * @brief 为边缘方向风格准备字符表：使用调用者提供的原图梯度场，或在采样图像上计算梯度场。
+ * @param data 采样所用图像。
+ * @param width 采样图像宽度。
+ * @param height 采样图像高度。
  * @param channels 图像通道数。
- * @param output_file 输出ASCII字符画的文件路径。
- * @param scale_factor 缩放因子，用于调整输出字符画的大小，值越大输出越小。
+ * @param gradient 原图的梯度场，NULL 表示在采样图像上计算。
+ * @param h_sample_step 每个字符在原图中的宽度（像素）。
+ * @param v_sample_step 每个字符在原图中的高度（像素）。
+ * @param h_block 每个字符在采样图像中的宽度（像素）。
+ * @param v_block 每个字符在采样图像中的高度（像素）。
+ * @param cols 字符画宽度（字符数）。
+ * @param rows 字符画高度（字符数）。
+ * @return cols * rows 的字符表，失败返回 NULL。调用者负责释放内存。
+ */
+static char *prepare_edge_glyphs(const unsigned char *data,
+                                 int width,
+                                 int height,
+                                 int channels,
+                                 const sobel_gradient_t *gradient,
+                                 int h_sample_step,
+                                 int v_sample_step,
+                                 int h_block,
+                                 int v_block,
+                                 int cols,
+                                 int rows)
+{
+    if (gradient)
+        return edge_glyph_map(gradient, h_sample_step, v_sample_step, cols, rows);
+
+    sobel_gradient_t local;
+    if (!sobel_gradient_compute(data, width, height, channels, 0, &local))
+        return NULL;
+    char *glyphs = edge_glyph_map(&local, h_block, v_block, cols, rows);
+    sobel_gradient_free(&local);
+    return glyphs;
+}
+
+/**
+ * @brief image_to_ascii_styled 的实现，可直接在金字塔的缩小层上采样。
+ * @param data 采样所用图像（原图或缩小 level_factor 倍的图像）。
+ * @param width 采样图像宽度。
+ * @param height 采样图像高度。
+ * @param channels 图像通道数。
+ * @param original_width 原图宽度（写入文件头）。
+ * @param original_height 原图高度（写入文件头）。
+ * @param output_file 输出文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param level_factor 采样图像相对原图的缩小倍数，必须整除 scale_factor。
  * @param style ASCII字符画风格。
- * @param gamma 伽马校正值，用于调整对比度 (0.5-2.0，默认0.8)。
+ * @param gamma 伽马校正值。
+ * @param gradient 边缘方向风格使用的原图梯度场，NULL 表示需要时在采样图像上计算。
  * @return 成功返回1，失败返回0。
  */
-int image_to_ascii_styled(unsigned char *data,
-                          int width,
-                          int height,
-                          int channels,
-                          const char *output_file,
-                          int scale_factor,
-                          ascii_style_t style,
-                          float gamma)
+static int render_ascii_styled(const unsigned char *data,
+                               int width,
+                               int height,
+                               int channels,
+                               int original_width,
+                               int original_height,
+                               const char *output_file,
+                               int scale_factor,
+                               int level_factor,
+                               ascii_style_t style,
+                               float gamma,
+                               const sobel_gradient_t *gradient)
 {
-    if (!data || width <= 0 || height <= 0 || channels <= 0 || !output_file || scale_factor <= 0) {
-        fprintf(stderr, "Invalid parameters for image_to_ascii_styled\n");
-        return 0;
-    }
-
     // 限制伽马值在合理范围内
     if (gamma < 0.1f)
         gamma = 0.1f;
@@ -218,18 +411,45 @@ int image_to_ascii_styled(unsigned char *data,
     if (v_sample_step <= 0)
         v_sample_step = 1;
 
-    int ascii_art_width = (width + h_sample_step - 1) / h_sample_step;
-    int ascii_art_height = (height + v_sample_step - 1) / v_sample_step;
+    // 在缩小后的图像上，每个字符覆盖的像素数按同样比例减少
+    int h_block = h_sample_step / level_factor;
+    int v_block = v_sample_step / level_factor;
+    if (h_block <= 0)
+        h_block = 1;
+    if (v_block <= 0)
+        v_block = 1;
+
+    int ascii_art_width = (width + h_block - 1) / h_block;
+    int ascii_art_height = (height + v_block - 1) / v_block;
+
+    // 边缘方向风格：梯度强的字符块使用方向字符
+    char *glyphs = NULL;
+    if (style == ASCII_STYLE_EDGES) {
+        glyphs = prepare_edge_glyphs(data,
+                                     width,
+                                     height,
+                                     channels,
+                                     gradient,
+                                     h_sample_step,
+                                     v_sample_step,
+                                     h_block,
+                                     v_block,
+                                     ascii_art_width,
+                                     ascii_art_height);
+        if (!glyphs)
+            return 0;
+    }
 
     FILE *fp = fopen(output_file, "w");
     if (!fp) {
-        fprintf(stderr, "Error opening output file '%s'\n", output_file);
+        LOG_ERROR("Error opening output file '%s'", output_file);
+        free(glyphs);
         return 0;
     }
 
     // 写入文件头信息
-    const char *style_names[] = {"Simple", "Extended", "Blocks", "Dense", "Classic"};
-    fprintf(fp, "ASCII Art - Original Image: %dx%d pixels\n", width, height);
+    const char *style_names[] = {"Simple", "Extended", "Blocks", "Dense", "Classic", "Edges"};
+    fprintf(fp, "ASCII Art - Original Image: %dx%d pixels\n", original_width, original_height);
     fprintf(fp, "Output Dimensions: %d chars wide x %d chars high\n", ascii_art_width, ascii_art_height);
     fprintf(fp, "Style: %s (%d characters), Gamma: %.2f\n", style_names[style], ascii_chars_len, gamma);
     fprintf(fp, "Sampling: H=%d, V=%d pixels/char\n\n", h_sample_step, v_sample_step);
@@ -237,19 +457,24 @@ int image_to_ascii_styled(unsigned char *data,
     // 生成ASCII字符画
     for (int char_y = 0; char_y < ascii_art_height; ++char_y) {
         for (int char_x = 0; char_x < ascii_art_width; ++char_x) {
-            int original_region_x_start = char_x * h_sample_step;
-            int original_region_y_start = char_y * v_sample_step;
+            if (glyphs && glyphs[(size_t)char_y * ascii_art_width + char_x]) {
+                fputc(glyphs[(size_t)char_y * ascii_art_width + char_x], fp);
+                continue;
+            }
+
+            int original_region_x_start = char_x * h_block;
+            int original_region_y_start = char_y * v_block;
 
             float sum_of_brightness_values = 0.0f;
             int num_pixels_in_current_block = 0;
 
             // 采样像素块
-            for (int dy_in_block = 0; dy_in_block < v_sample_step; ++dy_in_block) {
+            for (int dy_in_block = 0; dy_in_block < v_block; ++dy_in_block) {
                 int current_original_pixel_y = original_region_y_start + dy_in_block;
                 if (current_original_pixel_y >= height)
                     break;
 
-                for (int dx_in_block = 0; dx_in_block < h_sample_step; ++dx_in_block) {
+                for (int dx_in_block = 0; dx_in_block < h_block; ++dx_in_block) {
                     int current_original_pixel_x = original_region_x_start + dx_in_block;
                     if (current_original_pixel_x >= width)
                         break;
@@ -291,12 +516,463 @@ int image_to_ascii_styled(unsigned char *data,
         fprintf(fp, "\n");
     }
 
-    fclose(fp);
-    printf("Successfully saved styled ASCII art to '%s'\n", output_file);
-    printf("Style: %s, Dimensions: %d x %d characters, Gamma: %.2f\n",
-           style_names[style],
-           ascii_art_width,
-           ascii_art_height,
-           gamma);
+    int ok = !ferror(fp);
+    ok = (fclose(fp) == 0) && ok;
+    free(glyphs);
+    if (!ok) {
+        LOG_ERROR("Error writing ASCII art to '%s'", output_file);
+        return 0;
+    }
+    LOG_DEBUG("Successfully saved styled ASCII art to '%s'", output_file);
+    LOG_DEBUG("Style: %s, Dimensions: %d x %d characters, Gamma: %.2f",
+              style_names[style],
+              ascii_art_width,
+              ascii_art_height,
+              gamma);
     return 1;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 将图像转换为指定风格的 ASCII 字符画并保存到文件中。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 缩放因子，用于调整输出字符画的大小，值越大输出越小。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值，用于调整对比度 (0.5-2.0，默认0.8)。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_styled(unsigned char *data,
+                          int width,
+                          int height,
+                          int channels,
+                          const char *output_file,
+                          int scale_factor,
+                          ascii_style_t style,
+                          float gamma)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || !output_file || scale_factor <= 0) {
+        LOG_ERROR("Invalid parameters for image_to_ascii_styled");
+        return 0;
+    }
+
+    return render_ascii_styled(
+        data, width, height, channels, width, height, output_file, scale_factor, 1, style, gamma, NULL);
+}
+
+/**
+ * @brief 使用图像金字塔中合适的缩小层生成指定风格的 ASCII 字符画。
+ * @param pyramid 图像金字塔。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_styled_pyramid(
+    const image_pyramid_t *pyramid, const char *output_file, int scale_factor, ascii_style_t style, float gamma)
+{
+    if (!pyramid || pyramid->levels <= 0 || !output_file || scale_factor <= 0) {
+        LOG_ERROR("Invalid parameters for image_to_ascii_styled_pyramid");
+        return 0;
+    }
+
+    int level = pyramid_level_for_block(pyramid, scale_factor);
+    return render_ascii_styled(pyramid->data[level],
+                               pyramid->width[level],
+                               pyramid->height[level],
+                               pyramid->channels,
+                               pyramid->width[0],
+                               pyramid->height[0],
+                               output_file,
+                               scale_factor,
+                               1 << level,
+                               style,
+                               gamma,
+                               NULL);
+}
+
+/**
+ * @brief 使用图像金字塔和原图的梯度场生成边缘方向风格的 ASCII 字符画。
+ * @param pyramid 图像金字塔。
+ * @param gradient 原图的梯度场，NULL 表示在采样层上计算。
+ * @param output_file 输出ASCII字符画的文件路径。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param gamma 伽马校正值。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_edges_pyramid(const image_pyramid_t *pyramid,
+                                 const sobel_gradient_t *gradient,
+                                 const char *output_file,
+                                 int scale_factor,
+                                 float gamma)
+{
+    if (!pyramid || pyramid->levels <= 0 || !output_file || scale_factor <= 0 ||
+        (gradient && (gradient->width != pyramid->width[0] || gradient->height != pyramid->height[0]))) {
+        LOG_ERROR("Invalid parameters for image_to_ascii_edges_pyramid");
+        return 0;
+    }
+
+    int level = pyramid_level_for_block(pyramid, scale_factor);
+    return render_ascii_styled(pyramid->data[level],
+                               pyramid->width[level],
+                               pyramid->height[level],
+                               pyramid->channels,
+                               pyramid->width[0],
+                               pyramid->height[0],
+                               output_file,
+                               scale_factor,
+                               1 << level,
+                               ASCII_STYLE_EDGES,
+                               gamma,
+                               gradient);
+}
+
+// xterm 256 色调色板中 6x6x6 颜色立方体每一级的取值
+static const unsigned char xterm_cube_levels[6] = {0, 95, 135, 175, 215, 255};
+
+/**
+ * @brief 把5位分量扩展回8位（高位复制到低位，0 -> 0，31 -> 255）。
+ */
+static unsigned char expand5(int q)
+{
+    return (unsigned char)((q << 3) | (q >> 2));
+}
+
+/**
+ * @brief 生成 RGB555 颜色到 xterm 256 色索引的查找表：在颜色立方体 (16-231) 和灰阶 (232-255) 中
+ *        各取最近的一个，选距离较小者。
+ * @param lut 输出的查找表 (32768 项)。
+ */
+static void build_xterm_lut(unsigned char *lut)
+{
+    unsigned char nearest_level[256];
+    for (int v = 0; v < 256; v++) {
+        int best = 0;
+        for (int i = 1; i < 6; i++)
+            if (abs(xterm_cube_levels[i] - v) < abs(xterm_cube_levels[best] - v))
+                best = i;
+        nearest_level[v] = (unsigned char)best;
+    }
+
+    for (int code = 0; code < 32768; code++) {
+        int r = expand5(code >> 10), g = expand5((code >> 5) & 31), b = expand5(code & 31);
+        int cr = nearest_level[r], cg = nearest_level[g], cb = nearest_level[b];
+        int dr = xterm_cube_levels[cr] - r, dg = xterm_cube_levels[cg] - g, db = xterm_cube_levels[cb] - b;
+        int cube_dist = dr * dr + dg * dg + db * db;
+
+        // 灰阶的第 i 级取值为 8 + 10 * i
+        int gray = ((r + g + b) / 3 - 3) / 10;
+        gray = gray < 0 ? 0 : (gray > 23 ? 23 : gray);
+        int gv = 8 + 10 * gray;
+        int gray_dist = (gv - r) * (gv - r) + (gv - g) * (gv - g) + (gv - b) * (gv - b);
+
+        lut[code] = (unsigned char)(gray_dist < cube_dist ? 232 + gray : 16 + 36 * cr + 6 * cg + cb);
+    }
+}
+
+/**
+ * @brief 追加一个 0-255 的十进制数，返回写入后的位置。
+ */
+static char *append_u8(char *out, int v)
+{
+    if (v >= 100)
+        *out++ = (char)('0' + v / 100);
+    if (v >= 10)
+        *out++ = (char)('0' + v / 10 % 10);
+    *out++ = (char)('0' + v % 10);
+    return out;
+}
+
+/**
+ * @brief 追加设置颜色的转义序列，返回写入后的位置。
+ * @param out 输出位置（至少19字节）。
+ * @param color 彩色输出模式。
+ * @param background 是否设置背景色。
+ * @param key 256色模式下为调色板索引，真彩色模式下为 RGB555 颜色。
+ */
+static char *append_color_escape(char *out, ascii_color_t color, int background, int key)
+{
+    memcpy(out, background ? "\x1b[48;" : "\x1b[38;", 5);
+    out += 5;
+    if (color == ASCII_COLOR_256) {
+        memcpy(out, "5;", 2);
+        out = append_u8(out + 2, key);
+    }
+    else {
+        memcpy(out, "2;", 2);
+        out = append_u8(out + 2, expand5(key >> 10));
+        *out++ = ';';
+        out = append_u8(out, expand5((key >> 5) & 31));
+        *out++ = ';';
+        out = append_u8(out, expand5(key & 31));
+    }
+    *out++ = 'm';
+    return out;
+}
+
+/**
+ * @brief image_to_ascii_color 的实现，可直接在金字塔的缩小层上采样。
+ *
+ * 每个字符行先把所覆盖的像素行按列累加到各字符块的 RGB 和，再逐块取平均、查表得到字符和颜色，
+ * 整行拼好后一次写出。亮度到字符的映射（含伽马校正）也预先算成256项的表。
+ * 写到文件时带有与其他风格相同的文件头，写到标准输出时只输出字符画本身。
+ * @param data 采样所用图像（原图或缩小 level_factor 倍的图像）。
+ * @param width 采样图像宽度。
+ * @param height 采样图像高度。
+ * @param channels 图像通道数。
+ * @param original_width 原图宽度（写入文件头）。
+ * @param original_height 原图高度（写入文件头）。
+ * @param output_file 输出文件路径，NULL 表示写标准输出。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param level_factor 采样图像相对原图的缩小倍数，必须整除 scale_factor。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值。
+ * @param color 彩色输出模式。
+ * @param background 颜色是否作为背景色。
+ * @param gradient 边缘方向风格使用的原图梯度场，NULL 表示需要时在采样图像上计算。
+ * @return 成功返回1，失败返回0。
+ */
+static int render_ascii_color(const unsigned char *data,
+                              int width,
+                              int height,
+                              int channels,
+                              int original_width,
+                              int original_height,
+                              const char *output_file,
+                              int scale_factor,
+                              int level_factor,
+                              ascii_style_t style,
+                              float gamma,
+                              ascii_color_t color,
+                              int background,
+                              const sobel_gradient_t *gradient)
+{
+    if (gamma < 0.1f)
+        gamma = 0.1f;
+    if (gamma > 3.0f)
+        gamma = 3.0f;
+
+    const char *ascii_chars = get_ascii_charset(style);
+    int ascii_chars_len = strlen(ascii_chars);
+
+    // 与其他风格相同的采样步长和字符高宽比补偿
+    int h_sample_step = scale_factor;
+    int v_sample_step = scale_factor * 2;
+    int h_block = h_sample_step / level_factor;
+    int v_block = v_sample_step / level_factor;
+    if (h_block <= 0)
+        h_block = 1;
+    if (v_block <= 0)
+        v_block = 1;
+
+    int ascii_art_width = (width + h_block - 1) / h_block;
+    int ascii_art_height = (height + v_block - 1) / v_block;
+
+    // 亮度 -> 字符
+    char char_lut[256];
+    for (int v = 0; v < 256; v++) {
+        int index = (int)(powf(v / 255.0f, gamma) * (ascii_chars_len - 1) + 0.5f);
+        char_lut[v] = ascii_chars[index < 0 ? 0 : (index >= ascii_chars_len ? ascii_chars_len - 1 : index)];
+    }
+
+    // 每个字符最多一个转义序列 (ESC[38;2;255;255;255m，19字节) 加字符本身，行尾是重置序列和换行
+    size_t row_capacity = (size_t)ascii_art_width * 20 + 8;
+    char *row_buffer = (char *)malloc(row_capacity);
+    unsigned int *sums = (unsigned int *)malloc((size_t)ascii_art_width * 4 * sizeof(unsigned int));
+    unsigned char *xterm_lut = (color == ASCII_COLOR_256) ? (unsigned char *)malloc(32768) : NULL;
+    char *glyphs = (style == ASCII_STYLE_EDGES) ? prepare_edge_glyphs(data,
+                                                                      width,
+                                                                      height,
+                                                                      channels,
+                                                                      gradient,
+                                                                      h_sample_step,
+                                                                      v_sample_step,
+                                                                      h_block,
+                                                                      v_block,
+                                                                      ascii_art_width,
+                                                                      ascii_art_height)
+                                                : NULL;
+    if (!row_buffer || !sums || (color == ASCII_COLOR_256 && !xterm_lut) || (style == ASCII_STYLE_EDGES && !glyphs)) {
+        LOG_ERROR("Memory allocation failed in image_to_ascii_color");
+        free(row_buffer);
+        free(sums);
+        free(xterm_lut);
+        free(glyphs);
+        return 0;
+    }
+    if (xterm_lut)
+        build_xterm_lut(xterm_lut);
+
+    FILE *fp = output_file ? fopen(output_file, "w") : stdout;
+    if (!fp) {
+        LOG_ERROR("Error opening output file '%s'", output_file);
+        free(row_buffer);
+        free(sums);
+        free(xterm_lut);
+        free(glyphs);
+        return 0;
+    }
+
+    if (output_file) {
+        static const char *style_names[] = {"Simple", "Extended", "Blocks", "Dense", "Classic", "Edges"};
+        static const char *color_names[] = {"none", "256", "truecolor"};
+        fprintf(fp, "ASCII Art - Original Image: %dx%d pixels\n", original_width, original_height);
+        fprintf(fp, "Output Dimensions: %d chars wide x %d chars high\n", ascii_art_width, ascii_art_height);
+        fprintf(fp, "Style: %s (%d characters), Gamma: %.2f\n", style_names[style], ascii_chars_len, gamma);
+        fprintf(fp, "Color: %s (%s)\n", color_names[color], background ? "background" : "foreground");
+        fprintf(fp, "Sampling: H=%d, V=%d pixels/char\n\n", h_sample_step, v_sample_step);
+    }
+
+    int gray_offset = channels >= 3 ? 1 : 0; // 灰度图像的三个分量都取第一个通道
+    for (int char_y = 0; char_y < ascii_art_height; ++char_y) {
+        // 按列累加这一字符行覆盖的全部像素：sums[4 * char_x] 依次为 R、G、B 和像素数
+        memset(sums, 0, (size_t)ascii_art_width * 4 * sizeof(unsigned int));
+        int y_end = (char_y + 1) * v_block < height ? (char_y + 1) * v_block : height;
+        for (int y = char_y * v_block; y < y_end; y++) {
+            const unsigned char *p = data + (size_t)y * width * channels;
+            for (int char_x = 0, x = 0; char_x < ascii_art_width; ++char_x) {
+                unsigned int *s = sums + (size_t)char_x * 4;
+                int x_end = x + h_block < width ? x + h_block : width;
+                for (; x < x_end; x++, p += channels) {
+                    s[0] += p[0];
+                    s[1] += p[gray_offset];
+                    s[2] += p[2 * gray_offset];
+                }
+                s[3] += x_end - char_x * h_block;
+            }
+        }
+
+        char *out = row_buffer;
+        int last_key = -1;
+        for (int char_x = 0; char_x < ascii_art_width; ++char_x) {
+            const unsigned int *s = sums + (size_t)char_x * 4;
+            int r = (int)((s[0] + s[3] / 2) / s[3]);
+            int g = (int)((s[1] + s[3] / 2) / s[3]);
+            int b = (int)((s[2] + s[3] / 2) / s[3]);
+            char ch = char_lut[(299 * r + 587 * g + 114 * b + 500) / 1000];
+            if (glyphs && glyphs[(size_t)char_y * ascii_art_width + char_x])
+                ch = glyphs[(size_t)char_y * ascii_art_width + char_x];
+
+            // 前景模式下空格看不出颜色，沿用前一个颜色，相同颜色的连续段不被打断
+            if (color != ASCII_COLOR_NONE && (background || ch != ' ')) {
+                int key = ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+                if (color == ASCII_COLOR_256)
+                    key = xterm_lut[key];
+                if (key != last_key) {
+                    out = append_color_escape(out, color, background, key);
+                    last_key = key;
+                }
+            }
+            *out++ = ch;
+        }
+        if (color != ASCII_COLOR_NONE && last_key >= 0) {
+            memcpy(out, "\x1b[0m", 4);
+            out += 4;
+        }
+        *out++ = '\n';
+        fwrite(row_buffer, 1, (size_t)(out - row_buffer), fp);
+    }
+
+    int ok = !ferror(fp);
+    if (output_file)
+        ok = (fclose(fp) == 0) && ok;
+    else
+        fflush(fp);
+    free(row_buffer);
+    free(sums);
+    free(xterm_lut);
+    free(glyphs);
+    if (!ok)
+        LOG_ERROR("Error writing ASCII art to '%s'", output_file ? output_file : "stdout");
+    return ok;
+}
+
+/**
+ * @brief 将图像转换为带 ANSI 颜色的 ASCII 字符画，颜色取每个字符块的平均 RGB。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param output_file 输出文件路径，NULL 表示写标准输出。
+ * @param scale_factor 缩放因子，用于调整输出字符画的大小，值越大输出越小。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值。
+ * @param color 彩色输出模式，ASCII_COLOR_NONE 时只输出字符。
+ * @param background 为1时颜色作为背景色，为0时作为字符的前景色。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_color(const unsigned char *data,
+                         int width,
+                         int height,
+                         int channels,
+                         const char *output_file,
+                         int scale_factor,
+                         ascii_style_t style,
+                         float gamma,
+                         ascii_color_t color,
+                         int background)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || scale_factor <= 0) {
+        LOG_ERROR("Invalid parameters for image_to_ascii_color");
+        return 0;
+    }
+
+    return render_ascii_color(data,
+                              width,
+                              height,
+                              channels,
+                              width,
+                              height,
+                              output_file,
+                              scale_factor,
+                              1,
+                              style,
+                              gamma,
+                              color,
+                              background,
+                              NULL);
+}
+
+/**
+ * @brief 使用图像金字塔中合适的缩小层生成带 ANSI 颜色的 ASCII 字符画。
+ * @param pyramid 图像金字塔。
+ * @param output_file 输出文件路径，NULL 表示写标准输出。
+ * @param scale_factor 相对原图的缩放因子。
+ * @param style ASCII字符画风格。
+ * @param gamma 伽马校正值。
+ * @param color 彩色输出模式，ASCII_COLOR_NONE 时只输出字符。
+ * @param background 为1时颜色作为背景色，为0时作为字符的前景色。
+ * @return 成功返回1，失败返回0。
+ */
+int image_to_ascii_color_pyramid(const image_pyramid_t *pyramid,
+                                 const char *output_file,
+                                 int scale_factor,
+                                 ascii_style_t style,
+                                 float gamma,
+                                 ascii_color_t color,
+                                 int background)
+{
+    if (!pyramid || pyramid->levels <= 0 || scale_factor <= 0) {
+        LOG_ERROR("Invalid parameters for image_to_ascii_color_pyramid");
+        return 0;
+    }
+
+    int level = pyramid_level_for_block(pyramid, scale_factor);
+    return render_ascii_color(pyramid->data[level],
+                              pyramid->width[level],
+                              pyramid->height[level],
+                              pyramid->channels,
+                              pyramid->width[0],
+                              pyramid->height[0],
+                              output_file,
+                              scale_factor,
+                              1 << level,
+                              style,
+                              gamma,
+                              color,
+                              background,
+                              NULL);
+}
@@ -4,6 +4,16 @@
 #include "rotate.h"
 #include "ascii_art.h"
 #include "edge.h"
+#include "effects.h"
+#include "histogram.h"
+#include "pyramid.h"
+#include "resize.h"
+#include "metrics.h"
+#include "log.h"
+#include "parallel.h"
+#include "journal.h"
+#include "phash.h"
+#include "scheduler.h"
 #include "stb_image.h"
 
 #include <stdio.h>
@@ -12,14 +22,113 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <errno.h>
 #ifdef _WIN32
 #include <windows.h>
 #include <direct.h>
 #define mkdir(path, mode) _mkdir(path)
 #else
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
+#include <sys/wait.h>
 #endif
 
+// 默认每隔多少秒输出一行批处理状态（环境变量 IMAGEPROC_STATS_INTERVAL 可覆盖，0 表示只在结束时输出）
+#define BATCH_STATS_INTERVAL 5
+// 像素数不少于此值的图像按行分块并行处理，更小的图像整幅在一个任务中处理
+#define BATCH_TILE_MIN_PIXELS (1 << 20)
+// 分块的最小行数，避免模糊的光晕和任务开销在很薄的分块上占比过大
+#define BATCH_TILE_MIN_ROWS 32
+// 每幅图像最多的输出文件数
+#define BATCH_MAX_OUTPUTS 9
+// 输出路径的缓冲区大小："<输出子目录（<256字节）>/<不含扩展名的文件名（<256字节）>_<输出名>.jpg"
+#define BATCH_PATH_MAX (256 + 256 + 32)
+// 去重索引文件（位于输出目录中），记录实际处理过的图像的感知哈希，供以后的批处理查找
+#define BATCH_HASH_INDEX "phash_index.txt"
+// 认领文件的目录（位于输出目录中），每次运行使用其中以认领标识命名的子目录
+#define BATCH_CLAIM_DIR ".claims"
+// 进度日志的目录（位于输出目录中），每个进程写其中自己的日志文件
+#define BATCH_JOURNAL_DIR ".journal"
+// 默认每完成多少个输出把进度日志落盘一次（环境变量 IMAGEPROC_JOURNAL_SYNC 可覆盖）
+#define BATCH_JOURNAL_SYNC 64
+
+// 每幅图像的输出，顺序与 batch_output_paths 相同
+enum
+{
+    BATCH_OUTPUT_GRAYSCALE,
+    BATCH_OUTPUT_BLUR,
+    BATCH_OUTPUT_INVERT,
+    BATCH_OUTPUT_ROTATE,
+    BATCH_OUTPUT_EDGE,
+    BATCH_OUTPUT_RESIZE,
+    BATCH_OUTPUT_ASCII,
+    BATCH_OUTPUT_THUMBNAIL,
+    BATCH_OUTPUT_OPS
+};
+
+// 进度日志中记录的输出名
+static const char *const batch_output_names[BATCH_MAX_OUTPUTS] = {
+    "grayscale", "blur", "invert", "rotate", "edge", "resize", "ascii", "thumbnail", "ops"};
+
+// --dedupe 的共享状态：本次和以往批处理中实际处理过的图像的哈希索引
+typedef struct
+{
+    hash_index_t index; // 条目编号为本次批处理中图像的序号，从索引文件读入的条目为 -1
+    int max_distance;   // 感知哈希距离不超过它的图像视为重复
+    int skipped;        // 本次跳过的重复图像数
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+} batch_dedupe_t;
+
+// 批处理中一幅图像的状态，由图像任务和它派生的效果任务、分块任务共享
+typedef struct
+{
+    const char *file_name;
+    char basename[256]; // 不含扩展名的文件名，输出文件名和去重索引都使用它
+    int id;             // 在本次批处理中的序号
+    char input_path[512];
+    char grayscale_output[BATCH_PATH_MAX], blur_output[BATCH_PATH_MAX], invert_output[BATCH_PATH_MAX],
+        rotate_output[BATCH_PATH_MAX], ascii_output[BATCH_PATH_MAX], edge_output[BATCH_PATH_MAX],
+        thumbnail_output[BATCH_PATH_MAX], resize_output[BATCH_PATH_MAX], ops_output[BATCH_PATH_MAX];
+
+    unsigned char *data;
+    int width, height, channels;
+    long long pixels;
+    int tile_rows;               // 每个分块的最小行数，等于图像高度时整幅在一个任务中处理
+    const effect_op_t *edge_ops; // 边缘图的后处理效果链
+    int edge_op_count;
+    const effect_op_t *ops; // 对原图应用的效果链（--ops），op_count 为0时不输出
+    int op_count;
+    batch_dedupe_t *dedupe; // 去重的共享状态，NULL 表示不去重
+    const char *claim_dir;  // 认领文件的目录，NULL 表示不认领（处理分给本进程的全部图像）
+    int progress_fd;        // 处理完后向它报告结果，-1 表示不报告
+    int duplicate;          // 1 表示是重复图像，输出已链接到原图的输出
+    int duplicate_of;       // 重复图像的原图在本次批处理中的序号，原图来自以往的批处理时为 -1
+    int loaded;
+    journal_t *journal;            // 进度日志，NULL 表示不记录
+    int verify;                    // 续跑时重读输出核对 CRC-32
+    const uint32_t *output_params; // 影响各输出的参数的哈希（按 BATCH_OUTPUT_* 下标）
+    long long input_size;          // 输入文件的字节数和修改时间，与日志记录比较判断输入是否变化
+    long long input_mtime;
+    unsigned done; // 日志表明已完整写出、不需要重做的输出（按 BATCH_OUTPUT_* 的位）
+    int resumed;   // 1 表示全部输出都已完成，整幅图像被跳过
+    int failed;    // 任一效果或保存失败时置1
+} batch_image_t;
+
+// 一个效果的分块回调的上下文
+typedef struct
+{
+    batch_image_t *img;
+    unsigned char *dst;
+    unsigned char *magnitude; // 边缘检测：整幅梯度幅值图（四周各多1像素，值为0）
+    int mag_stride;
+    unsigned int (*hist)[256]; // 边缘检测：每个分块的梯度幅值直方图
+    int threshold;
+} batch_tile_ctx_t;
+
 /**
  * @brief 创建目录（如果不存在）
  * @param dir_path 目录路径
@@ -35,10 +144,13 @@ static int create_directory_if_not_exists(const char *dir_path)
 #else
         if (mkdir(dir_path, 0755) != 0) {
 #endif
-            fprintf(stderr, "Error creating directory: %s\n", dir_path);
+            // 多个工作进程可能同时创建同一个目录
+            if (errno == EEXIST)
+                return 1;
+            LOG_ERROR("Error creating directory: %s", dir_path);
             return 0;
         }
-        printf("Created directory: %s\n", dir_path);
+        LOG_INFO("Created directory: %s", dir_path);
     }
     return 1;
 }
@@ -94,37 +206,946 @@ static void extract_basename(const char *filename, char *basename, size_t size)
     basename[name_len] = '\0';
 }
 
+/**
+ * @brief 获取文件大小
+ * @param path 文件路径
+ * @return 文件字节数，失败返回0
+ */
+static long long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+/**
+ * @brief 保存图像，并记录编码耗时和写出的字节数
+ * @return 成功返回1，失败返回0
+ */
+static int save_image_timed(const char *path, unsigned char *data, int width, int height, int channels, int quality)
+{
+    uint64_t start = metrics_now_ns();
+    int ok = save_image(path, data, width, height, channels, quality);
+    metrics_record_stage(METRICS_STAGE_ENCODE, ok ? file_size(path) : 0, metrics_now_ns() - start, ok);
+    return ok;
+}
+
+/**
+ * @brief 列出输入目录中的图像文件
+ * @param input_dir 输入目录
+ * @param count 输出的文件个数
+ * @return 文件名数组（用 free_file_list 释放），目录无法打开时返回NULL
+ */
+static char **list_image_files(const char *input_dir, int *count)
+{
+    DIR *dir = opendir(input_dir);
+    if (!dir)
+        return NULL;
+
+    char **names = NULL;
+    int capacity = 0;
+    *count = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        // 跳过"."和".."，以及不是图像的文件
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 || !is_image_file(entry->d_name)) {
+            continue;
+        }
+
+        if (*count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 16;
+            char **grown = (char **)realloc(names, new_capacity * sizeof(char *));
+            if (!grown)
+                break;
+            names = grown;
+            capacity = new_capacity;
+        }
+        names[*count] = strdup(entry->d_name);
+        if (names[*count])
+            (*count)++;
+    }
+
+    closedir(dir);
+    if (!names)
+        names = (char **)calloc(1, sizeof(char *));
+    return names;
+}
+
+static void free_file_list(char **names, int count)
+{
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+}
+
+/**
+ * @brief 字符串的 FNV-1a 哈希：决定按哈希分片时文件属于哪个分片（只依赖文件名，各进程和各主机的结果相同），
+ *        也用于记录效果链参数。
+ */
+static uint32_t fnv1a(const char *text)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief 只保留属于给定分片的文件，其余文件释放。
+ * @param files 文件名数组，原地压缩。
+ * @param count 文件个数，更新为保留的个数。
+ * @param shard_index 分片号。
+ * @param shard_count 分片数。
+ */
+static void filter_shard(char **files, int *count, int shard_index, int shard_count)
+{
+    int kept = 0;
+    for (int i = 0; i < *count; i++) {
+        if (fnv1a(files[i]) % (uint32_t)shard_count == (uint32_t)shard_index)
+            files[kept++] = files[i];
+        else
+            free(files[i]);
+    }
+    *count = kept;
+}
+
+/**
+ * @brief 标记图像处理失败（多个效果任务可能同时调用）。
+ */
+static void batch_fail(batch_image_t *img)
+{
+    __atomic_store_n(&img->failed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 以分块的行区间 [begin, end) 构造处理区域。
+ */
+static image_rect_t tile_rect(const batch_image_t *img, int begin, int end)
+{
+    image_rect_t rect = {0, begin, img->width, end - begin};
+    return rect;
+}
+
+static void grayscale_tile(void *arg, int begin, int end)
+{
+    batch_tile_ctx_t *ctx = (batch_tile_ctx_t *)arg;
+    batch_image_t *img = ctx->img;
+    int stride = img->width * img->channels;
+    grayscale_roi(img->data,
+                  img->width,
+                  img->height,
+                  img->channels,
+                  stride,
+                  tile_rect(img, begin, end),
+                  ctx->dst + (size_t)begin * stride,
+                  stride);
+}
+
+static void invert_tile(void *arg, int begin, int end)
+{
+    batch_tile_ctx_t *ctx = (batch_tile_ctx_t *)arg;
+    batch_image_t *img = ctx->img;
+    int stride = img->width * img->channels;
+    invert_roi(img->data,
+               img->width,
+               img->height,
+               img->channels,
+               stride,
+               tile_rect(img, begin, end),
+               ctx->dst + (size_t)begin * stride,
+               stride);
+}
+
+static void blur_tile(void *arg, int begin, int end)
+{
+    batch_tile_ctx_t *ctx = (batch_tile_ctx_t *)arg;
+    batch_image_t *img = ctx->img;
+    int stride = img->width * img->channels;
+    // 与 blur 相同：半径5，边界按 BORDER_CLAMP 处理
+    if (!blur_roi(img->data,
+                  img->width,
+                  img->height,
+                  img->channels,
+                  stride,
+                  tile_rect(img, begin, end),
+                  5,
+                  BORDER_CLAMP,
+                  ctx->dst + (size_t)begin * stride,
+                  stride))
+        batch_fail(img);
+}
+
+static void rotate_tile(void *arg, int begin, int end)
+{
+    batch_tile_ctx_t *ctx = (batch_tile_ctx_t *)arg;
+    batch_image_t *img = ctx->img;
+    int stride = img->width * img->channels;
+    // 上下翻转后的第 [begin, end) 行来自源图像的第 [height - end, height - begin) 行
+    rotate_image_roi(img->data,
+                     img->width,
+                     img->height,
+                     img->channels,
+                     stride,
+                     tile_rect(img, img->height - end, img->height - begin),
+                     ctx->dst + (size_t)begin * stride,
+                     stride);
+}
+
+static void edge_magnitude_tile(void *arg, int begin, int end)
+{
+    batch_tile_ctx_t *ctx = (batch_tile_ctx_t *)arg;
+    batch_image_t *img = ctx->img;
+    unsigned char *magnitude = ctx->magnitude + (size_t)begin * ctx->mag_stride;
+    if (!sobel_magnitude_into(img->data,
+                              img->width,
+                              img->height,
+                              img->channels,
+                              img->width * img->channels,
+                              tile_rect(img, begin, end),
+                              0,
+                              BORDER_REFLECT,
+                              magnitude,
+                              ctx->mag_stride)) {
+        batch_fail(img);
+        return;
+    }
+
+    // 每个分块统计自己的直方图，全部完成后再合并，分块之间不需要同步
+    unsigned int *hist = ctx->hist[begin / img->tile_rows];
+    for (int y = 0; y < end - begin; y++)
+        histogram_accumulate(magnitude + (size_t)y * ctx->mag_stride, img->width, hist);
+}
+
+static void edge_hysteresis_tile(void *arg, int begin, int end)
+{
+    batch_tile_ctx_t *ctx = (batch_tile_ctx_t *)arg;
+    batch_image_t *img = ctx->img;
+    int stride = img->width * img->channels;
+    edge_hysteresis(ctx->magnitude + (size_t)begin * ctx->mag_stride,
+                    ctx->mag_stride,
+                    img->width,
+                    end - begin,
+                    ctx->threshold,
+                    img->channels,
+                    ctx->dst + (size_t)begin * stride,
+                    stride);
+}
+
+/**
+ * @brief 对整幅图像按行分块执行一个 ROI 效果，结果写入新缓冲区。
+ *
+ * 分块经 parallel_for 交给调度器，与其他图像的任务共享工作线程的队列；小图像的 tile_rows
+ * 等于图像高度，只有一个分块，直接在当前任务中执行。
+ * @return 输出缓冲区，失败返回NULL。
+ */
+static unsigned char *run_tiled(batch_image_t *img, parallel_range_fn fn)
+{
+    batch_tile_ctx_t ctx = {0};
+    ctx.img = img;
+    ctx.dst = (unsigned char *)malloc((size_t)img->pixels * img->channels);
+    if (!ctx.dst)
+        return NULL;
+    parallel_for(img->height, img->tile_rows, fn, &ctx);
+    return ctx.dst;
+}
+
+/**
+ * @brief 分块的 Sobel 边缘检测，结果与 sobel_edge_detect（Otsu 自动阈值）完全相同。
+ *
+ * 第一遍各分块计算梯度幅值和直方图，合并直方图确定阈值；第二遍各分块做滞后阈值，
+ * 分块边界处需要的相邻梯度已在第一遍写入整幅梯度幅值图。
+ * @return 边缘图，失败返回NULL。
+ */
+static unsigned char *run_tiled_edge(batch_image_t *img)
+{
+    batch_tile_ctx_t ctx = {0};
+    ctx.img = img;
+    ctx.mag_stride = img->width + 2;
+    int tiles = (img->height + img->tile_rows - 1) / img->tile_rows;
+    unsigned char *magnitude_data = (unsigned char *)calloc((size_t)ctx.mag_stride * (img->height + 2), 1);
+    ctx.hist = (unsigned int(*)[256])calloc((size_t)tiles, sizeof(*ctx.hist));
+    ctx.dst = (unsigned char *)malloc((size_t)img->pixels * img->channels);
+    if (!magnitude_data || !ctx.hist || !ctx.dst) {
+        free(magnitude_data);
+        free(ctx.hist);
+        free(ctx.dst);
+        return NULL;
+    }
+    ctx.magnitude = magnitude_data + ctx.mag_stride + 1;
+
+    // parallel_for 的区间边界不一定是 tile_rows 的整数倍，直方图按区间起点所在的分块归属，
+    // 因此每个分块至少 tile_rows 行时不会有两个区间写同一个直方图
+    parallel_for(img->height, img->tile_rows, edge_magnitude_tile, &ctx);
+
+    unsigned int hist[256] = {0};
+    for (int t = 0; t < tiles; t++)
+        for (int i = 0; i < 256; i++)
+            hist[i] += ctx.hist[t][i];
+    ctx.threshold = edge_auto_threshold(hist, EDGE_THRESHOLD_OTSU);
+
+    parallel_for(img->height, img->tile_rows, edge_hysteresis_tile, &ctx);
+
+    free(magnitude_data);
+    free(ctx.hist);
+    return ctx.dst;
+}
+
+/**
+ * @brief 图像的一个输出的路径。
+ * @param img 图像。
+ * @param output 输出（BATCH_OUTPUT_*）。
+ */
+static const char *output_path(const batch_image_t *img, int output)
+{
+    const char *paths[BATCH_MAX_OUTPUTS] = {img->grayscale_output,
+                                            img->blur_output,
+                                            img->invert_output,
+                                            img->rotate_output,
+                                            img->edge_output,
+                                            img->resize_output,
+                                            img->ascii_output,
+                                            img->thumbnail_output,
+                                            img->ops_output};
+    return paths[output];
+}
+
+/**
+ * @brief 输出的临时文件路径：同一目录中的隐藏文件 ".<基本名>.part<扩展名>"，扩展名不变，保存时仍按它选择格式。
+ */
+static void temp_output_path(const char *path, char *tmp, size_t size)
+{
+    const char *file = strrchr(path, '/');
+    file = file ? file + 1 : path;
+    const char *ext = strrchr(file, '.');
+    int stem = ext ? (int)(ext - file) : (int)strlen(file);
+    snprintf(tmp, size, "%.*s.%.*s.part%s", (int)(file - path), path, stem, file, ext ? ext : "");
+}
+
+/**
+ * @brief 把写完的临时文件原子地改名为输出，并在进度日志中记录输出的字节数、修改时间和 CRC-32。
+ *        崩溃时只可能留下临时文件，不会留下看起来完整、实际被截断的输出。
+ * @return 成功返回1，失败返回0。
+ */
+static int commit_output(batch_image_t *img, int output, const char *tmp)
+{
+    const char *path = output_path(img, output);
+#ifdef _WIN32
+    int ok = MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    int ok = rename(tmp, path) == 0;
+#endif
+    if (!ok) {
+        LOG_ERROR("Failed to rename %s to %s", tmp, path);
+        remove(tmp);
+        return 0;
+    }
+    if (img->journal) {
+        struct stat st;
+        journal_record_t record = {img->input_size, img->input_mtime, 0, 0, img->output_params[output], 0};
+        if (stat(path, &st) == 0 && journal_checksum_file(path, &record.output_size, &record.checksum)) {
+            record.output_mtime = (long long)st.st_mtime;
+            journal_append(img->journal, img->file_name, batch_output_names[output], &record);
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 把图像编码到输出的临时文件，成功后改名为输出。
+ * @return 成功返回1，失败返回0。
+ */
+static int save_output(batch_image_t *img,
+                       int output,
+                       unsigned char *data,
+                       int width,
+                       int height,
+                       int channels,
+                       int quality)
+{
+    char tmp[600];
+    temp_output_path(output_path(img, output), tmp, sizeof(tmp));
+    if (!save_image_timed(tmp, data, width, height, channels, quality)) {
+        remove(tmp);
+        return 0;
+    }
+    return commit_output(img, output, tmp);
+}
+
+/**
+ * @brief 进度日志表明输出已完整写出、不需要重做。
+ */
+static int output_done(const batch_image_t *img, int output)
+{
+    return (img->done >> output) & 1;
+}
+
+/**
+ * @brief 保存效果的输出并释放缓冲区；缓冲区为NULL（效果失败）时标记图像失败。
+ */
+static void finish_effect(batch_image_t *img,
+                          metrics_effect_t effect,
+                          uint64_t start,
+                          unsigned char *result,
+                          int output)
+{
+    metrics_record_effect(effect, img->pixels, metrics_now_ns() - start);
+    if (!result || !save_output(img, output, result, img->width, img->height, img->channels, 100))
+        batch_fail(img);
+    free(result);
+}
+
+// 1. 灰度处理
+static void grayscale_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (output_done(img, BATCH_OUTPUT_GRAYSCALE))
+        return;
+    uint64_t start = metrics_now_ns();
+    finish_effect(img, METRICS_EFFECT_GRAYSCALE, start, run_tiled(img, grayscale_tile), BATCH_OUTPUT_GRAYSCALE);
+}
+
+// 2. 模糊处理
+static void blur_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (output_done(img, BATCH_OUTPUT_BLUR))
+        return;
+    uint64_t start = metrics_now_ns();
+    finish_effect(img, METRICS_EFFECT_BLUR, start, run_tiled(img, blur_tile), BATCH_OUTPUT_BLUR);
+}
+
+// 3. 反色处理
+static void invert_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (output_done(img, BATCH_OUTPUT_INVERT))
+        return;
+    uint64_t start = metrics_now_ns();
+    finish_effect(img, METRICS_EFFECT_INVERT, start, run_tiled(img, invert_tile), BATCH_OUTPUT_INVERT);
+}
+
+// 4. 旋转处理
+static void rotate_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (output_done(img, BATCH_OUTPUT_ROTATE))
+        return;
+    uint64_t start = metrics_now_ns();
+    finish_effect(img, METRICS_EFFECT_ROTATE, start, run_tiled(img, rotate_tile), BATCH_OUTPUT_ROTATE);
+}
+
+// 5. 边缘检测（根据梯度直方图自动选择阈值），可选地继续应用后处理效果链（例如形态学闭运算连接断开的边缘）
+static void edge_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (output_done(img, BATCH_OUTPUT_EDGE))
+        return;
+    uint64_t start = metrics_now_ns();
+    effect_image_t edges = {run_tiled_edge(img), img->width, img->height, img->channels};
+    // 后处理在同一个缓冲区上完成，不需要额外的编码和解码
+    if (edges.data && img->edge_op_count > 0 && !effects_apply_all(img->edge_ops, img->edge_op_count, &edges)) {
+        free(edges.data);
+        edges.data = NULL;
+    }
+    metrics_record_effect(METRICS_EFFECT_EDGE, img->pixels, metrics_now_ns() - start);
+    if (!edges.data ||
+        !save_output(img, BATCH_OUTPUT_EDGE, edges.data, edges.width, edges.height, edges.channels, 100))
+        batch_fail(img);
+    free(edges.data);
+    LOG_DEBUG("Applied edge detection (automatic Otsu threshold) to %s", img->file_name);
+}
+
+// 6. 缩放（Lanczos3 缩小到一半），缩放内部的 parallel_for 同样交给调度器
+static void resize_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (output_done(img, BATCH_OUTPUT_RESIZE))
+        return;
+    int resize_width = (img->width + 1) / 2;
+    int resize_height = (img->height + 1) / 2;
+    uint64_t start = metrics_now_ns();
+    unsigned char *resize_data = resize_image(
+        img->data, img->width, img->height, img->channels, resize_width, resize_height, RESIZE_FILTER_LANCZOS3);
+    metrics_record_effect(METRICS_EFFECT_RESIZE, img->pixels, metrics_now_ns() - start);
+    if (!resize_data ||
+        !save_output(img, BATCH_OUTPUT_RESIZE, resize_data, resize_width, resize_height, img->channels, 100))
+        batch_fail(img);
+    free(resize_data);
+}
+
+// 7. ASCII字符画（使用块状ASCII兼容字符集）和缩略图，都在缩小金字塔上完成
+static void pyramid_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (output_done(img, BATCH_OUTPUT_ASCII) && output_done(img, BATCH_OUTPUT_THUMBNAIL))
+        return;
+
+    // 金字塔的构建计入缩略图的耗时
+    image_pyramid_t pyramid;
+    uint64_t start = metrics_now_ns();
+    int pyramid_ok = pyramid_build(&pyramid, img->data, img->width, img->height, img->channels, 8);
+    metrics_record_effect(METRICS_EFFECT_THUMBNAIL, img->pixels, metrics_now_ns() - start);
+    if (!pyramid_ok) {
+        batch_fail(img);
+        return;
+    }
+
+    if (!output_done(img, BATCH_OUTPUT_ASCII)) {
+        char tmp[600];
+        temp_output_path(img->ascii_output, tmp, sizeof(tmp));
+        start = metrics_now_ns();
+        int ascii_ok = image_to_ascii_styled_pyramid(&pyramid, tmp, 5, ASCII_STYLE_BLOCKS, 0.8f);
+        metrics_record_effect(METRICS_EFFECT_ASCII, img->pixels, metrics_now_ns() - start);
+        if (!ascii_ok)
+            remove(tmp);
+        if (!ascii_ok || !commit_output(img, BATCH_OUTPUT_ASCII, tmp))
+            batch_fail(img);
+    }
+
+    if (!output_done(img, BATCH_OUTPUT_THUMBNAIL)) {
+        int thumbnail_width, thumbnail_height;
+        unsigned char *thumbnail_data =
+            pyramid_thumbnail(&pyramid, PYRAMID_THUMBNAIL_SIZE, &thumbnail_width, &thumbnail_height);
+        if (!thumbnail_data ||
+            !save_output(
+                img, BATCH_OUTPUT_THUMBNAIL, thumbnail_data, thumbnail_width, thumbnail_height, img->channels, 90))
+            batch_fail(img);
+        free(thumbnail_data);
+    }
+    pyramid_free(&pyramid);
+}
+
+// 8. 命令行指定的效果链（例如 bilateral:16:30），在原图的副本上执行
+static void ops_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+    if (img->op_count == 0 || output_done(img, BATCH_OUTPUT_OPS))
+        return;
+
+    uint64_t start = metrics_now_ns();
+    size_t size = (size_t)img->width * img->height * img->channels;
+    effect_image_t result = {(unsigned char *)malloc(size), img->width, img->height, img->channels};
+    if (result.data) {
+        memcpy(result.data, img->data, size);
+        if (!effects_apply_all(img->ops, img->op_count, &result)) {
+            free(result.data);
+            result.data = NULL;
+        }
+    }
+    metrics_record_effect(METRICS_EFFECT_OPS, img->pixels, metrics_now_ns() - start);
+    if (!result.data ||
+        !save_output(img, BATCH_OUTPUT_OPS, result.data, result.width, result.height, result.channels, 100))
+        batch_fail(img);
+    free(result.data);
+}
+
+/**
+ * @brief 列出图像的全部输出路径（未指定 --ops 时不含效果链的输出）。
+ * @param img 图像。
+ * @param paths 输出的路径数组，至少 BATCH_MAX_OUTPUTS 项。
+ * @return 路径数。
+ */
+static int batch_output_paths(batch_image_t *img, const char **paths)
+{
+    int n = img->op_count > 0 ? BATCH_MAX_OUTPUTS : BATCH_OUTPUT_OPS;
+    for (int i = 0; i < n; i++)
+        paths[i] = output_path(img, i);
+    return n;
+}
+
+#ifndef _WIN32
+/**
+ * @brief 由图像的输出路径得到另一幅图像的同类输出的文件名：输出文件名都是 "<基本名><后缀>"，只替换基本名。
+ * @param img 图像。
+ * @param path img 的一个输出路径。
+ * @param original 另一幅图像的基本名。
+ * @param name 输出的文件名（不含目录）。
+ * @param size 缓冲区大小。
+ */
+static void sibling_output_name(batch_image_t *img, const char *path, const char *original, char *name, size_t size)
+{
+    const char *file = strrchr(path, '/');
+    file = file ? file + 1 : path;
+    snprintf(name, size, "%s%s", original, file + strlen(img->basename));
+}
+
+/**
+ * @brief 检查以往批处理中的原图的输出是否都还在（对应本图像需要的全部输出）。
+ */
+static int original_outputs_exist(batch_image_t *img, const char *original)
+{
+    const char *paths[BATCH_MAX_OUTPUTS];
+    int n = batch_output_paths(img, paths);
+    for (int i = 0; i < n; i++) {
+        char name[512], target[1024];
+        sibling_output_name(img, paths[i], original, name, sizeof(name));
+        const char *file = strrchr(paths[i], '/');
+        snprintf(target, sizeof(target), "%.*s%s", file ? (int)(file + 1 - paths[i]) : 0, paths[i], name);
+        if (file_size(target) <= 0)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief 把重复图像的每个输出替换为指向原图同类输出的符号链接（同一目录中的相对链接）。
+ *        原图在本次批处理中可能还没有写完输出，链接在批处理结束时才全部有效。
+ * @return 成功返回1，失败返回0。
+ */
+static int link_duplicate_outputs(batch_image_t *img, const char *original)
+{
+    const char *paths[BATCH_MAX_OUTPUTS];
+    int n = batch_output_paths(img, paths);
+    for (int i = 0; i < n; i++) {
+        char name[512];
+        sibling_output_name(img, paths[i], original, name, sizeof(name));
+        unlink(paths[i]); // 以往批处理留下的输出
+        if (symlink(name, paths[i]) != 0) {
+            LOG_ERROR("Failed to link %s to %s", paths[i], name);
+            return 0;
+        }
+    }
+    return 1;
+}
+#endif
+
+/**
+ * @brief 计算图像的感知哈希并在索引中查找重复：找到时把输出链接到原图的输出，否则把图像加入索引。
+ *
+ * 同名的旧条目描述的是这个文件以前的内容，先删除，避免与自己比较；以往批处理的原图若输出已被删除，
+ * 它的条目同样删除后继续查找。哈希失败时照常处理图像。
+ * @param img 已解码的图像。
+ * @return 是重复图像（不需要再处理）返回1，否则返回0。
+ */
+static int batch_dedupe(batch_image_t *img)
+{
+#ifdef _WIN32
+    (void)img;
+    return 0;
+#else
+    batch_dedupe_t *dedupe = img->dedupe;
+    image_hash_t hash;
+    uint64_t start = metrics_now_ns();
+    int ok = image_hash_compute(img->data, img->width, img->height, img->channels, &hash);
+    metrics_record_effect(METRICS_EFFECT_HASH, img->pixels, metrics_now_ns() - start);
+    if (!ok)
+        return 0;
+
+    char original[256];
+    int distance = 0;
+    pthread_mutex_lock(&dedupe->lock);
+    hash_index_remove(&dedupe->index, hash_index_lookup_name(&dedupe->index, img->basename));
+    int k;
+    while ((k = hash_index_find(&dedupe->index, hash, dedupe->max_distance, &distance)) >= 0 &&
+           dedupe->index.entries[k].id < 0 && !original_outputs_exist(img, dedupe->index.entries[k].name)) {
+        hash_index_remove(&dedupe->index, k);
+    }
+    if (k >= 0) {
+        snprintf(original, sizeof(original), "%s", dedupe->index.entries[k].name);
+        img->duplicate = 1;
+        img->duplicate_of = dedupe->index.entries[k].id;
+        dedupe->skipped++;
+    }
+    else {
+        hash_index_add(&dedupe->index, hash, img->basename, img->id);
+    }
+    pthread_mutex_unlock(&dedupe->lock);
+    if (k < 0)
+        return 0;
+
+    if (!link_duplicate_outputs(img, original))
+        batch_fail(img);
+    LOG_INFO("Skipped %s: duplicate of %s (distance %d)", img->file_name, original, distance);
+    return 1;
+#endif
+}
+
+/**
+ * @brief 认领文件的路径："<认领目录>/<输入文件名>.claim"。
+ */
+static void claim_path(const batch_image_t *img, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s.claim", img->claim_dir, img->file_name);
+}
+
+/**
+ * @brief 认领一幅图像：以 O_CREAT|O_EXCL 创建认领文件，同一时刻只有一个进程（包括其他主机上的进程）能创建成功，
+ *        不需要锁或协调服务。认领文件中记录主机名和进程号，便于排查。
+ * @return 认领成功返回1，已被其他进程认领返回0，无法创建认领文件返回 -1。
+ */
+static int batch_claim(const batch_image_t *img)
+{
+#ifdef _WIN32
+    (void)img;
+    return 1;
+#else
+    char path[768];
+    claim_path(img, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        if (errno == EEXIST)
+            return 0;
+        LOG_ERROR("Failed to create claim file: %s", path);
+        return -1;
+    }
+    char host[256] = "";
+    char owner[320];
+    gethostname(host, sizeof(host) - 1);
+    int n = snprintf(owner, sizeof(owner), "%s %ld\n", host, (long)getpid());
+    if (write(fd, owner, (size_t)n) != n)
+        LOG_ERROR("Failed to write claim file: %s", path);
+    close(fd);
+    return 1;
+#endif
+}
+
+/**
+ * @brief 向协调者报告一幅图像的结果。
+ */
+static void batch_report(const batch_image_t *img, int ok)
+{
+#ifndef _WIN32
+    if (img->progress_fd >= 0) {
+        // 不超过 PIPE_BUF 的一次写入是原子的，多个工作线程的报告行不会交错
+        char line[320];
+        int n = snprintf(line, sizeof(line), "%s %s\n", ok ? "ok" : "failed", img->file_name);
+        if (write(img->progress_fd, line, (size_t)n) != n)
+            LOG_ERROR("Failed to report progress for %s", img->file_name);
+    }
+#else
+    (void)img;
+    (void)ok;
+#endif
+}
+
+/**
+ * @brief 一幅图像处理结束：更新统计，向协调者报告结果；处理失败时删除认领文件，以同一认领标识重新运行时会再次处理它。
+ * @param img 图像。
+ * @param ok 是否成功。
+ */
+static void batch_image_finish(batch_image_t *img, int ok)
+{
+    metrics_image_end(ok);
+#ifndef _WIN32
+    if (!ok && img->claim_dir) {
+        char path[768];
+        claim_path(img, path, sizeof(path));
+        unlink(path);
+    }
+#endif
+    batch_report(img, ok);
+}
+
+/**
+ * @brief 检查输出文件与进度日志中的记录是否一致：只比较字节数和修改时间，续跑不需要读任何输出；
+ *        verify 非0 时再重读文件比较 CRC-32，能发现字节数和修改时间都没变的改动。
+ * @return 一致返回1，否则返回0。
+ */
+static int output_matches(const char *path, const journal_record_t *record, int verify)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || (long long)st.st_size != record->output_size ||
+        (long long)st.st_mtime != record->output_mtime)
+        return 0;
+    long long size;
+    uint32_t checksum;
+    return !verify || (journal_checksum_file(path, &size, &checksum) && size == record->output_size &&
+                       checksum == record->checksum);
+}
+
+/**
+ * @brief 读取输入文件的字节数和修改时间，按进度日志标记已完成的输出：记录中的输入和参数与本次相同，
+ *        且输出文件的字节数和修改时间（img->verify 时还有 CRC-32）与记录一致。
+ * @return 本次需要的全部输出都已完成（整幅图像不需要处理）返回1，否则返回0。
+ */
+static int batch_resume(batch_image_t *img)
+{
+    struct stat st;
+    if (stat(img->input_path, &st) != 0)
+        return 0;
+    img->input_size = (long long)st.st_size;
+    img->input_mtime = (long long)st.st_mtime;
+
+    int n = img->op_count > 0 ? BATCH_MAX_OUTPUTS : BATCH_OUTPUT_OPS;
+    for (int i = 0; i < n; i++) {
+        const journal_record_t *r = journal_find(img->journal, img->file_name, batch_output_names[i]);
+        if (r && r->input_size == img->input_size && r->input_mtime == img->input_mtime &&
+            r->params == img->output_params[i] && output_matches(output_path(img, i), r, img->verify))
+            img->done |= 1u << i;
+    }
+    return img->done == (1u << n) - 1;
+}
+
+static const task_fn batch_effects[] = {
+    grayscale_task, blur_task, invert_task, rotate_task, edge_task, resize_task, pyramid_task, ops_task};
+#define BATCH_EFFECT_COUNT ((int)(sizeof(batch_effects) / sizeof(batch_effects[0])))
+
+/**
+ * @brief 处理一幅图像：解码后按尺寸选择任务粒度，再运行全部效果。
+ *
+ * 小图像的全部效果在当前任务中依次执行，多幅小图像由不同的工作线程同时处理；
+ * 大图像的每个效果作为一个任务提交，各效果再按行分块，空闲的工作线程从队列中窃取这些任务，
+ * 一幅大图像不会让其他线程在批处理末尾空等。
+ */
+static void batch_image_task(void *arg)
+{
+    batch_image_t *img = (batch_image_t *)arg;
+
+    // 认领在图像真正开始处理时才进行，先处理完的进程接着认领剩下的图像
+    int claimed = img->claim_dir ? batch_claim(img) : 1;
+    if (claimed == 0) {
+        LOG_DEBUG("Skipping %s: claimed by another worker", img->file_name);
+        metrics_image_skip();
+        return;
+    }
+
+    // 以往（中断的）运行已完成的图像不再解码；认领模式下只有认领到它的进程核对输出并报告，协调者不会重复计数
+    if (img->journal && batch_resume(img)) {
+        LOG_DEBUG("Skipping %s: complete in the journal", img->file_name);
+        img->resumed = 1;
+        metrics_image_skip();
+        batch_report(img, 1);
+        return;
+    }
+    LOG_DEBUG("Processing file: %s", img->input_path);
+    metrics_image_begin();
+    if (claimed < 0) {
+        batch_image_finish(img, 0);
+        return;
+    }
+
+    // 加载图像
+    uint64_t start = metrics_now_ns();
+    img->data = load_image(img->input_path, &img->width, &img->height, &img->channels);
+    metrics_record_stage(
+        METRICS_STAGE_DECODE, file_size(img->input_path), metrics_now_ns() - start, img->data != NULL);
+    if (!img->data) {
+        LOG_ERROR("Failed to load image: %s", img->input_path);
+        batch_image_finish(img, 0);
+        return;
+    }
+    img->loaded = 1;
+    img->pixels = (long long)img->width * img->height;
+
+    // 重复图像只需链接输出，不再运行效果
+    if (img->dedupe && batch_dedupe(img)) {
+        free_image(img->data);
+        img->data = NULL;
+        batch_image_finish(img, !img->failed);
+        return;
+    }
+
+    scheduler_t *sched = scheduler_current();
+    if (sched && img->pixels >= BATCH_TILE_MIN_PIXELS) {
+        img->tile_rows = BATCH_TILE_MIN_ROWS;
+        task_group_t group;
+        task_group_init(&group);
+        for (int i = 1; i < BATCH_EFFECT_COUNT; i++)
+            scheduler_spawn(sched, &group, batch_effects[i], img);
+        batch_effects[0](img);
+        scheduler_wait(sched, &group);
+    }
+    else {
+        img->tile_rows = img->height;
+        for (int i = 0; i < BATCH_EFFECT_COUNT; i++)
+            batch_effects[i](img);
+    }
+
+    // 释放图像数据
+    free_image(img->data);
+    img->data = NULL;
+
+    batch_image_finish(img, !img->failed);
+    LOG_INFO("Completed processing: %s", img->file_name);
+}
+
 /**
  * @brief 执行批量图像处理。
+ * @param edge_ops 对边缘检测结果继续应用的效果链（格式见 effects_parse，例如 "close:3,open:3"），NULL 表示不处理。
+ * @param ops 对每幅原图应用的效果链（例如 "bilateral:16:30"），结果保存到 ops 子目录，NULL 表示不输出。
+ * @param dedupe_distance 感知哈希距离不超过它的图像视为重复，输出链接到原图的输出而不再处理；负数表示不去重。
+ * @param shard 多进程分担时本进程负责的部分（按文件名哈希分片或按认领），NULL 表示处理全部图像。
+ * @param resume BATCH_RESUME 时重放进度日志，跳过以往（中断的）运行已完整写出的输出，
+ *               BATCH_RESUME_VERIFY 时还重读输出核对 CRC-32；BATCH_FRESH 表示删除全部进程的进度日志后从头开始。
+ * @return 成功返回1，效果链无效或无法创建输出目录、读取输入目录、打开进度日志时返回0。
  */
-void batch_process()
+int batch_process(const char *edge_ops, const char *ops, int dedupe_distance, const batch_shard_t *shard, int resume)
 {
+    effect_op_t edge_op_list[EFFECT_MAX_OPS];
+    int edge_op_count = 0;
+    if (edge_ops) {
+        edge_op_count = effects_parse(edge_ops, edge_op_list, EFFECT_MAX_OPS);
+        if (edge_op_count == 0)
+            return 0;
+    }
+    effect_op_t op_list[EFFECT_MAX_OPS];
+    int op_count = 0;
+    if (ops) {
+        op_count = effects_parse(ops, op_list, EFFECT_MAX_OPS);
+        if (op_count == 0)
+            return 0;
+    }
+#ifdef _WIN32
+    if (dedupe_distance >= 0) {
+        LOG_ERROR("Duplicate detection (--dedupe) needs symbolic links and is not supported on Windows");
+        return 0;
+    }
+    if (shard && shard->claim_id) {
+        LOG_ERROR("Claiming images (--claim) is not supported on Windows");
+        return 0;
+    }
+#endif
+    int shard_count = shard && shard->shard_count > 1 ? shard->shard_count : 1;
+    const char *claim_id = shard ? shard->claim_id : NULL;
+    if (shard_count > 1 && (shard->shard_index < 0 || shard->shard_index >= shard_count)) {
+        LOG_ERROR("Invalid shard %d/%d", shard->shard_index, shard_count);
+        return 0;
+    }
+    if (claim_id && (!claim_id[0] || strchr(claim_id, '/') || strchr(claim_id, '\\') || strcmp(claim_id, ".") == 0 ||
+                     strcmp(claim_id, "..") == 0)) {
+        LOG_ERROR("Invalid claim id: %s", claim_id);
+        return 0;
+    }
+    if (dedupe_distance >= 0 && (shard_count > 1 || claim_id)) {
+        LOG_ERROR("Duplicate detection (--dedupe) keeps a per-process index and cannot be combined with sharding");
+        return 0;
+    }
+
     // 输入和输出目录
     const char *input_dir = "./batch_input";
     const char *output_dir = "./batch_output";
 
     // 确保输出目录存在
     if (!create_directory_if_not_exists(output_dir)) {
-        fprintf(stderr, "Failed to create output directory: %s\n", output_dir);
-        return;
+        LOG_ERROR("Failed to create output directory: %s", output_dir);
+        return 0;
     }
 
     // 创建输出子目录
-    char grayscale_dir[256], blur_dir[256], invert_dir[256], rotate_dir[256], ascii_dir[256], edge_dir[256];
+    char grayscale_dir[256], blur_dir[256], invert_dir[256], rotate_dir[256], ascii_dir[256], edge_dir[256],
+        thumbnail_dir[256], resize_dir[256], ops_dir[256];
 #ifdef _WIN32
-    sprintf(grayscale_dir, "%s\\grayscale", output_dir);
-    sprintf(blur_dir, "%s\\blur", output_dir);
-    sprintf(invert_dir, "%s\\invert", output_dir);
-    sprintf(rotate_dir, "%s\\rotate", output_dir);
-    sprintf(ascii_dir, "%s\\ascii", output_dir);
-    sprintf(edge_dir, "%s\\edge", output_dir);
+    snprintf(grayscale_dir, sizeof(grayscale_dir), "%s\\grayscale", output_dir);
+    snprintf(blur_dir, sizeof(blur_dir), "%s\\blur", output_dir);
+    snprintf(invert_dir, sizeof(invert_dir), "%s\\invert", output_dir);
+    snprintf(rotate_dir, sizeof(rotate_dir), "%s\\rotate", output_dir);
+    snprintf(ascii_dir, sizeof(ascii_dir), "%s\\ascii", output_dir);
+    snprintf(edge_dir, sizeof(edge_dir), "%s\\edge", output_dir);
+    snprintf(thumbnail_dir, sizeof(thumbnail_dir), "%s\\thumbnail", output_dir);
+    snprintf(resize_dir, sizeof(resize_dir), "%s\\resize", output_dir);
+    snprintf(ops_dir, sizeof(ops_dir), "%s\\ops", output_dir);
 #else
-    sprintf(grayscale_dir, "%s/grayscale", output_dir);
-    sprintf(blur_dir, "%s/blur", output_dir);
-    sprintf(invert_dir, "%s/invert", output_dir);
-    sprintf(rotate_dir, "%s/rotate", output_dir);
-    sprintf(ascii_dir, "%s/ascii", output_dir);
-    sprintf(edge_dir, "%s/edge", output_dir);
+    snprintf(grayscale_dir, sizeof(grayscale_dir), "%s/grayscale", output_dir);
+    snprintf(blur_dir, sizeof(blur_dir), "%s/blur", output_dir);
+    snprintf(invert_dir, sizeof(invert_dir), "%s/invert", output_dir);
+    snprintf(rotate_dir, sizeof(rotate_dir), "%s/rotate", output_dir);
+    snprintf(ascii_dir, sizeof(ascii_dir), "%s/ascii", output_dir);
+    snprintf(edge_dir, sizeof(edge_dir), "%s/edge", output_dir);
+    snprintf(thumbnail_dir, sizeof(thumbnail_dir), "%s/thumbnail", output_dir);
+    snprintf(resize_dir, sizeof(resize_dir), "%s/resize", output_dir);
+    snprintf(ops_dir, sizeof(ops_dir), "%s/ops", output_dir);
 #endif
 
     create_directory_if_not_exists(grayscale_dir);
@@ -133,129 +1154,441 @@ void batch_process()
     create_directory_if_not_exists(rotate_dir);
     create_directory_if_not_exists(ascii_dir);
     create_directory_if_not_exists(edge_dir);
+    create_directory_if_not_exists(thumbnail_dir);
+    create_directory_if_not_exists(resize_dir);
+    if (op_count > 0)
+        create_directory_if_not_exists(ops_dir);
 
-    // 打开输入目录
-    DIR *dir = opendir(input_dir);
-    if (!dir) {
-        fprintf(stderr, "Error opening input directory: %s\n", input_dir);
-        return;
+    // 认领目录：同一认领标识的各进程共用，其中已有的认领文件表示图像已被处理或正在处理
+    char claim_dir[512];
+    if (claim_id) {
+        snprintf(claim_dir, sizeof(claim_dir), "%s/%s", output_dir, BATCH_CLAIM_DIR);
+        create_directory_if_not_exists(claim_dir);
+        snprintf(claim_dir, sizeof(claim_dir), "%s/%s/%s", output_dir, BATCH_CLAIM_DIR, claim_id);
+        if (!create_directory_if_not_exists(claim_dir))
+            return 0;
+    }
+
+    // 进度日志：每个进程写自己的文件（按哈希分片的进程重新运行时沿用同一个文件），重放时读入目录中的全部文件
+    char journal_dir[512], journal_name[320];
+    snprintf(journal_dir, sizeof(journal_dir), "%s/%s", output_dir, BATCH_JOURNAL_DIR);
+    if (claim_id) {
+        char host[256] = "";
+        long pid = 0;
+#ifndef _WIN32
+        gethostname(host, sizeof(host) - 1);
+        pid = (long)getpid();
+#endif
+        snprintf(journal_name, sizeof(journal_name), "claim-%s-%ld.log", host, pid);
+    }
+    else if (shard_count > 1) {
+        snprintf(journal_name, sizeof(journal_name), "shard-%d-of-%d.log", shard->shard_index, shard_count);
     }
+    else {
+        snprintf(journal_name, sizeof(journal_name), "main.log");
+    }
+    const char *sync_env = getenv("IMAGEPROC_JOURNAL_SYNC");
+    journal_t journal;
+    if (!journal_open(&journal, journal_dir, journal_name, sync_env ? atoi(sync_env) : BATCH_JOURNAL_SYNC, resume))
+        return 0;
+    if (journal.count > 0)
+        LOG_INFO("Replayed %d completed outputs from %s", journal.count, journal_dir);
+    uint32_t output_params[BATCH_MAX_OUTPUTS] = {0};
+    output_params[BATCH_OUTPUT_EDGE] = fnv1a(edge_ops ? edge_ops : "");
+    output_params[BATCH_OUTPUT_OPS] = fnv1a(ops ? ops : "");
 
-    printf("Starting batch processing of images in %s\n", input_dir);
+    // 先列出全部输入文件，等待处理的图像数从一开始就是确定的
+    int file_count = 0;
+    char **files = list_image_files(input_dir, &file_count);
+    if (!files) {
+        LOG_ERROR("Error opening input directory: %s", input_dir);
+        journal_close(&journal);
+        return 0;
+    }
+    if (shard_count > 1) {
+        filter_shard(files, &file_count, shard->shard_index, shard_count);
+        LOG_INFO("Shard %d/%d: %d images", shard->shard_index, shard_count, file_count);
+    }
 
-    // 读取目录中的每个文件
-    struct dirent *entry;
-    int processed_count = 0;
+    LOG_INFO("Starting batch processing of images in %s", input_dir);
 
-    while ((entry = readdir(dir)) != NULL) {
-        // 跳过"."和".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
+    // 运行期间定期输出状态行；设置 IMAGEPROC_STATS_FILE 时同时写 Prometheus 文本格式的统计文件
+    const char *interval_env = getenv("IMAGEPROC_STATS_INTERVAL");
+    metrics_start(file_count,
+                  getenv("IMAGEPROC_STATS_FILE"),
+                  interval_env ? atoi(interval_env) : BATCH_STATS_INTERVAL);
 
-        // 检查是否为图像文件
-        if (!is_image_file(entry->d_name)) {
-            continue;
-        }
+    batch_image_t *images = (batch_image_t *)calloc(file_count > 0 ? file_count : 1, sizeof(batch_image_t));
+    if (!images) {
+        LOG_ERROR("Memory allocation failed for batch state");
+        metrics_stop();
+        free_file_list(files, file_count);
+        journal_close(&journal);
+        return 0;
+    }
+
+    // 去重索引：读入以往批处理记录的哈希
+    batch_dedupe_t dedupe;
+    char index_path[512];
+    snprintf(index_path, sizeof(index_path), "%s/%s", output_dir, BATCH_HASH_INDEX);
+    if (dedupe_distance >= 0) {
+        hash_index_init(&dedupe.index);
+        dedupe.max_distance = dedupe_distance;
+        dedupe.skipped = 0;
+#ifndef _WIN32
+        pthread_mutex_init(&dedupe.lock, NULL);
+#endif
+        int loaded = hash_index_load(&dedupe.index, index_path);
+        if (loaded > 0)
+            LOG_INFO("Loaded %d image hashes from %s", loaded, index_path);
+    }
+
+    // 每幅图像提交为一个任务；调度器创建失败时在当前线程上依次处理
+    scheduler_t *sched = scheduler_create(0);
+    task_group_t group;
+    task_group_init(&group);
+
+    for (int file_index = 0; file_index < file_count; file_index++) {
+        const char *file_name = files[file_index];
+        batch_image_t *img = &images[file_index];
+        img->file_name = file_name;
+        img->edge_ops = edge_op_list;
+        img->edge_op_count = edge_op_count;
+        img->ops = op_list;
+        img->op_count = op_count;
+        img->id = file_index;
+        img->dedupe = dedupe_distance >= 0 ? &dedupe : NULL;
+        img->duplicate_of = -1;
+        img->claim_dir = claim_id ? claim_dir : NULL;
+        img->progress_fd = shard ? shard->progress_fd : -1;
+        img->journal = &journal;
+        img->verify = resume == BATCH_RESUME_VERIFY;
+        img->output_params = output_params;
 
         // 构建完整的输入文件路径
-        char input_path[512];
 #ifdef _WIN32
-        sprintf(input_path, "%s\\%s", input_dir, entry->d_name);
+        snprintf(img->input_path, sizeof(img->input_path), "%s\\%s", input_dir, file_name);
 #else
-        sprintf(input_path, "%s/%s", input_dir, entry->d_name);
+        snprintf(img->input_path, sizeof(img->input_path), "%s/%s", input_dir, file_name);
 #endif
 
         // 提取基本文件名（不含扩展名）
-        char basename[256];
-        extract_basename(entry->d_name, basename, sizeof(basename));
+        char *basename = img->basename;
+        extract_basename(file_name, basename, sizeof(img->basename));
 
         // 构建输出文件路径
-        char grayscale_output[512], blur_output[512], invert_output[512], rotate_output[512], ascii_output[512],
-            edge_output[512];
 #ifdef _WIN32
-        sprintf(grayscale_output, "%s\\%s_grayscale.jpg", grayscale_dir, basename);
-        sprintf(blur_output, "%s\\%s_blur.jpg", blur_dir, basename);
-        sprintf(invert_output, "%s\\%s_invert.jpg", invert_dir, basename);
-        sprintf(rotate_output, "%s\\%s_rotate.jpg", rotate_dir, basename);
-        sprintf(ascii_output, "%s\\%s_ascii.txt", ascii_dir, basename);
-        sprintf(edge_output, "%s\\%s_edge.jpg", edge_dir, basename);
+        snprintf(img->grayscale_output, sizeof(img->grayscale_output), "%s\\%s_grayscale.jpg", grayscale_dir, basename);
+        snprintf(img->blur_output, sizeof(img->blur_output), "%s\\%s_blur.jpg", blur_dir, basename);
+        snprintf(img->invert_output, sizeof(img->invert_output), "%s\\%s_invert.jpg", invert_dir, basename);
+        snprintf(img->rotate_output, sizeof(img->rotate_output), "%s\\%s_rotate.jpg", rotate_dir, basename);
+        snprintf(img->ascii_output, sizeof(img->ascii_output), "%s\\%s_ascii.txt", ascii_dir, basename);
+        snprintf(img->edge_output, sizeof(img->edge_output), "%s\\%s_edge.jpg", edge_dir, basename);
+        snprintf(img->thumbnail_output, sizeof(img->thumbnail_output), "%s\\%s_thumbnail.jpg", thumbnail_dir, basename);
+        snprintf(img->resize_output, sizeof(img->resize_output), "%s\\%s_resize.jpg", resize_dir, basename);
+        snprintf(img->ops_output, sizeof(img->ops_output), "%s\\%s_ops.jpg", ops_dir, basename);
 #else
-        sprintf(grayscale_output, "%s/%s_grayscale.jpg", grayscale_dir, basename);
-        sprintf(blur_output, "%s/%s_blur.jpg", blur_dir, basename);
-        sprintf(invert_output, "%s/%s_invert.jpg", invert_dir, basename);
-        sprintf(rotate_output, "%s/%s_rotate.jpg", rotate_dir, basename);
-        sprintf(ascii_output, "%s/%s_ascii.txt", ascii_dir, basename);
-        sprintf(edge_output, "%s/%s_edge.jpg", edge_dir, basename);
+        snprintf(img->grayscale_output, sizeof(img->grayscale_output), "%s/%s_grayscale.jpg", grayscale_dir, basename);
+        snprintf(img->blur_output, sizeof(img->blur_output), "%s/%s_blur.jpg", blur_dir, basename);
+        snprintf(img->invert_output, sizeof(img->invert_output), "%s/%s_invert.jpg", invert_dir, basename);
+        snprintf(img->rotate_output, sizeof(img->rotate_output), "%s/%s_rotate.jpg", rotate_dir, basename);
+        snprintf(img->ascii_output, sizeof(img->ascii_output), "%s/%s_ascii.txt", ascii_dir, basename);
+        snprintf(img->edge_output, sizeof(img->edge_output), "%s/%s_edge.jpg", edge_dir, basename);
+        snprintf(img->thumbnail_output, sizeof(img->thumbnail_output), "%s/%s_thumbnail.jpg", thumbnail_dir, basename);
+        snprintf(img->resize_output, sizeof(img->resize_output), "%s/%s_resize.jpg", resize_dir, basename);
+        snprintf(img->ops_output, sizeof(img->ops_output), "%s/%s_ops.jpg", ops_dir, basename);
 #endif
 
-        printf("Processing file: %s\n", input_path);
+        if (sched)
+            scheduler_spawn(sched, &group, batch_image_task, img);
+        else
+            batch_image_task(img);
+    }
 
-        // 加载图像
-        int width, height, channels;
-        unsigned char *image_data = load_image(input_path, &width, &height, &channels);
-        if (!image_data) {
-            fprintf(stderr, "Failed to load image: %s\n", input_path);
-            continue;
-        }
+    if (sched) {
+        scheduler_wait(sched, &group);
+        scheduler_destroy(sched);
+    }
 
-        // 1. 灰度处理
-        unsigned char *grayscale_data = (unsigned char *)malloc(width * height * channels);
-        if (grayscale_data) {
-            memcpy(grayscale_data, image_data, width * height * channels);
-            grayscale(grayscale_data, width, height, channels);
-            save_image(grayscale_output, grayscale_data, width, height, channels, 100);
-            free(grayscale_data);
-        }
+    int processed_count = 0, resumed_count = 0;
+    for (int i = 0; i < file_count; i++) {
+        processed_count += images[i].loaded;
+        resumed_count += images[i].resumed;
+    }
+    journal_close(&journal);
+    if (resumed_count > 0)
+        LOG_INFO("Skipped %d images completed by an earlier run", resumed_count);
 
-        // 2. 模糊处理
-        unsigned char *blur_data = (unsigned char *)malloc(width * height * channels);
-        if (blur_data) {
-            memcpy(blur_data, image_data, width * height * channels);
-            blur(blur_data, width, height, channels, 5); // 使用半径5的模糊
-            save_image(blur_output, blur_data, width, height, channels, 100);
-            free(blur_data);
+    if (dedupe_distance >= 0) {
+        // 原图处理失败时，链接到它的重复图像同样没有有效输出
+        for (int i = 0; i < file_count; i++) {
+            if (images[i].duplicate && images[i].duplicate_of >= 0 && images[images[i].duplicate_of].failed) {
+                LOG_ERROR("%s was linked to %s, which failed", images[i].file_name, files[images[i].duplicate_of]);
+                images[i].failed = 1;
+            }
         }
-
-        // 3. 反色处理
-        unsigned char *invert_data = (unsigned char *)malloc(width * height * channels);
-        if (invert_data) {
-            memcpy(invert_data, image_data, width * height * channels);
-            invert(invert_data, width, height, channels);
-            save_image(invert_output, invert_data, width, height, channels, 100);
-            free(invert_data);
+        // 只记录成功处理的原图
+        for (int k = dedupe.index.count - 1; k >= 0; k--) {
+            int id = dedupe.index.entries[k].id;
+            if (id >= 0 && images[id].failed)
+                hash_index_remove(&dedupe.index, k);
         }
+        hash_index_save(&dedupe.index, index_path);
+        LOG_INFO("Skipped %d duplicate images (hash distance <= %d)", dedupe.skipped, dedupe_distance);
+        hash_index_free(&dedupe.index);
+#ifndef _WIN32
+        pthread_mutex_destroy(&dedupe.lock);
+#endif
+    }
 
-        // 4. 旋转处理
-        unsigned char *rotate_data = (unsigned char *)malloc(width * height * channels);
-        if (rotate_data) {
-            memcpy(rotate_data, image_data, width * height * channels);
-            rotate_image(rotate_data, width, height, channels);
-            save_image(rotate_output, rotate_data, width, height, channels, 100);
-            free(rotate_data);
-        }
+    free(images);
+    free_file_list(files, file_count);
+    metrics_stop();
+
+    LOG_INFO("Batch processing complete. Processed %d images.", processed_count);
+    LOG_INFO("Results saved to %s", output_dir);
+    return 1;
+}
+
+#ifdef _WIN32
 
-        // 5. 边缘检测
-        int edge_threshold = 50; // 稍微降低阈值，检测更多边缘
-        unsigned char *edge_data = sobel_edge_detect(image_data, width, height, channels, edge_threshold);
-        if (edge_data) {
-            save_image(edge_output, edge_data, width, height, channels, 100);
-            free(edge_data);
-            printf("Applied edge detection (threshold: %d) to %s\n", edge_threshold, entry->d_name);
+/**
+ * @brief Windows 下没有 fork，不支持多进程批处理。
+ */
+int batch_run_workers(const char *edge_ops, const char *ops, int workers, const char *claim_id, int resume)
+{
+    (void)edge_ops;
+    (void)ops;
+    (void)workers;
+    (void)claim_id;
+    (void)resume;
+    LOG_ERROR("Batch worker processes (--workers) are not supported on Windows");
+    return 0;
+}
+
+#else
+
+// 协调者一侧的工作进程状态
+typedef struct
+{
+    pid_t pid;
+    int fd;          // 进度管道的读端，子进程结束、管道关闭后为 -1
+    char line[320];  // 尚未读到换行符的报告行
+    int line_len;
+    int ok;          // 成功处理的图像数
+    int failed;      // 处理失败的图像数
+} batch_worker_t;
+
+/**
+ * @brief 子进程：按进程数调整环境变量后处理自己的部分，然后退出，不返回。
+ */
+static void run_worker(
+    int index, int workers, const char *edge_ops, const char *ops, const char *claim_id, int resume, int fd)
+{
+    // 状态行由协调者汇总输出，每个子进程只在结束时输出自己的统计
+    setenv("IMAGEPROC_STATS_INTERVAL", "0", 1);
+    char value[512];
+    if (!getenv("IMAGEPROC_THREADS")) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        snprintf(value, sizeof(value), "%ld", cpus / workers > 1 ? cpus / workers : 1);
+        setenv("IMAGEPROC_THREADS", value, 1);
+    }
+    const char *stats_file = getenv("IMAGEPROC_STATS_FILE");
+    if (stats_file) {
+        snprintf(value, sizeof(value), "%s.%d", stats_file, index);
+        setenv("IMAGEPROC_STATS_FILE", value, 1);
+    }
+
+    batch_shard_t shard = {index, claim_id ? 1 : workers, claim_id, fd};
+    int ok = batch_process(edge_ops, ops, -1, &shard, resume);
+    close(fd);
+    exit(ok ? 0 : 1);
+}
+
+/**
+ * @brief 处理从工作进程读到的数据：每个完整的报告行更新它的计数，不完整的部分留到下次读取。
+ */
+static void worker_consume(batch_worker_t *worker, const char *data, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (data[i] != '\n') {
+            if (worker->line_len < (int)sizeof(worker->line) - 1)
+                worker->line[worker->line_len++] = data[i];
+            continue;
         }
+        worker->line[worker->line_len] = '\0';
+        worker->line_len = 0;
+        if (strncmp(worker->line, "ok ", 3) == 0)
+            worker->ok++;
+        else if (strncmp(worker->line, "failed ", 7) == 0)
+            worker->failed++;
+    }
+}
 
-        // 6. ASCII字符画（使用块状ASCII兼容字符集）
-        image_to_ascii_styled(image_data, width, height, channels, ascii_output, 5, ASCII_STYLE_BLOCKS, 0.8f);
+/**
+ * @brief 输出全部工作进程汇总的进度。
+ */
+static void report_workers(const batch_worker_t *workers, int count, int total, uint64_t elapsed_ns)
+{
+    int ok = 0, failed = 0, running = 0;
+    for (int i = 0; i < count; i++) {
+        ok += workers[i].ok;
+        failed += workers[i].failed;
+        running += workers[i].fd >= 0;
+    }
+    double seconds = elapsed_ns > 0 ? elapsed_ns / 1e9 : 1e-9;
+    LOG_INFO("[workers] %.1fs images %d/%d (%d failed, %d of %d workers running) %.2f img/s",
+             elapsed_ns / 1e9,
+             ok + failed,
+             total,
+             failed,
+             running,
+             count,
+             (ok + failed) / seconds);
+}
 
-        // 释放图像数据
-        stbi_image_free(image_data);
+/**
+ * @brief 以多个本地工作进程执行批量处理，当前进程作为协调者汇总进度和结果。
+ * @param edge_ops 边缘图的后处理效果链，同 batch_process。
+ * @param ops 对每幅原图应用的效果链，同 batch_process。
+ * @param workers 工作进程数（1 到 BATCH_MAX_WORKERS）。
+ * @param claim_id 认领目录名，NULL 表示按文件名哈希静态分片。
+ * @param resume 是否重放进度日志，同 batch_process。
+ * @return 全部子进程成功返回1，否则返回0。
+ */
+int batch_run_workers(const char *edge_ops, const char *ops, int workers, const char *claim_id, int resume)
+{
+    if (workers < 1 || workers > BATCH_MAX_WORKERS) {
+        LOG_ERROR("Invalid worker count: %d", workers);
+        return 0;
+    }
 
-        processed_count++;
-        printf("Completed processing: %s\n", entry->d_name);
+    // 图像总数只用于汇总进度，各子进程自己列出输入目录
+    int total = 0;
+    char **files = list_image_files("./batch_input", &total);
+    if (!files) {
+        LOG_ERROR("Error opening input directory: ./batch_input");
+        return 0;
     }
+    free_file_list(files, total);
 
-    closedir(dir);
+    // 从头开始时由协调者一次删除以往的日志，子进程再各自重放：后启动的子进程不会删掉先启动的子进程已写的记录
+    if (resume == BATCH_FRESH) {
+        if (!journal_clear("./batch_output/" BATCH_JOURNAL_DIR))
+            return 0;
+        resume = BATCH_RESUME;
+    }
+
+    batch_worker_t *worker = (batch_worker_t *)calloc((size_t)workers, sizeof(batch_worker_t));
+    struct pollfd *fds = (struct pollfd *)calloc((size_t)workers, sizeof(struct pollfd));
+    if (!worker || !fds) {
+        free(worker);
+        free(fds);
+        LOG_ERROR("Memory allocation failed for worker state");
+        return 0;
+    }
+
+    LOG_INFO("Starting %d batch workers (%s)", workers, claim_id ? "claiming images" : "hash sharding");
+    // 缓冲中的日志和输出不能被子进程再写一遍
+    log_flush();
+    fflush(NULL);
+
+    int started = 0;
+    for (; started < workers; started++) {
+        int pipe_fds[2];
+        if (pipe(pipe_fds) != 0)
+            break;
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            break;
+        }
+        if (pid == 0) {
+            close(pipe_fds[0]);
+            for (int i = 0; i < started; i++)
+                close(worker[i].fd);
+            run_worker(started, workers, edge_ops, ops, claim_id, resume, pipe_fds[1]);
+        }
+        close(pipe_fds[1]);
+        worker[started].pid = pid;
+        worker[started].fd = pipe_fds[0];
+    }
+    int ok = started == workers;
+    if (!ok)
+        LOG_ERROR("Failed to start batch worker %d of %d", started + 1, workers);
 
-    printf("Batch processing complete. Processed %d images.\n", processed_count);
-    printf("Results saved to %s\n", output_dir);
+    // 读取各工作进程的报告直到全部管道关闭，其间按 IMAGEPROC_STATS_INTERVAL 输出汇总进度
+    const char *interval_env = getenv("IMAGEPROC_STATS_INTERVAL");
+    int interval = interval_env ? atoi(interval_env) : BATCH_STATS_INTERVAL;
+    uint64_t start = metrics_now_ns();
+    uint64_t last_report = start;
+    int open_count = started;
+    while (open_count > 0) {
+        for (int i = 0; i < started; i++) {
+            fds[i].fd = worker[i].fd; // 负数的描述符被 poll 忽略
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        if (poll(fds, (nfds_t)started, 1000) < 0 && errno != EINTR)
+            break;
+        log_flush_pending();
+        for (int i = 0; i < started; i++) {
+            if (!fds[i].revents)
+                continue;
+            char data[4096];
+            ssize_t n = read(worker[i].fd, data, sizeof(data));
+            if (n > 0) {
+                worker_consume(&worker[i], data, (int)n);
+            }
+            else if (n == 0 || errno != EINTR) {
+                close(worker[i].fd);
+                worker[i].fd = -1;
+                open_count--;
+            }
+        }
+        uint64_t now = metrics_now_ns();
+        if (interval > 0 && now - last_report >= (uint64_t)interval * 1000000000ull) {
+            report_workers(worker, started, total, now - start);
+            last_report = now;
+        }
+    }
+
+    int processed = 0, failed = 0;
+    for (int i = 0; i < started; i++) {
+        if (worker[i].fd >= 0)
+            close(worker[i].fd);
+        int status = 0;
+        while (waitpid(worker[i].pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            LOG_INFO("Worker %d (pid %ld): %d images, %d failed",
+                     i,
+                     (long)worker[i].pid,
+                     worker[i].ok + worker[i].failed,
+                     worker[i].failed);
+        }
+        else {
+            // 认领模式下它正在处理的图像留下了认领文件，需要以新的认领标识重新运行才会再处理
+            if (WIFSIGNALED(status))
+                LOG_ERROR("Worker %d (pid %ld) was killed by signal %d", i, (long)worker[i].pid, WTERMSIG(status));
+            else
+                LOG_ERROR("Worker %d (pid %ld) exited with status %d", i, (long)worker[i].pid, WEXITSTATUS(status));
+            ok = 0;
+        }
+        processed += worker[i].ok + worker[i].failed;
+        failed += worker[i].failed;
+    }
+
+    report_workers(worker, started, total, metrics_now_ns() - start);
+    LOG_INFO("Batch processing complete. %d workers processed %d of %d images (%d failed).",
+             started,
+             processed,
+             total,
+             failed);
+    free(worker);
+    free(fds);
+    return ok;
 }
+
+#endif
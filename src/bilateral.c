@@ -0,0 +1,305 @@
+#include "bilateral.h"
+#include "convolve.h"
+#include "log.h"
+#include "parallel.h"
+#include "pixel_kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 网格模糊的高斯核半径：conv_kernel_gaussian(2) 的标准差正好是一个网格单元
+#define BILATERAL_BLUR_RADIUS 2
+// 网格占用内存的上限，超过时应增大空间或值域标准差
+#define BILATERAL_MAX_GRID_BYTES ((size_t)1 << 30)
+// 每个任务的最少图像行数
+#define BILATERAL_MIN_ROWS 32
+// 纵向模糊时每个任务处理的单元数
+#define BILATERAL_SPAN 256
+
+// 一次双边滤波的共享状态
+typedef struct
+{
+    unsigned char *data;
+    int width, height, channels;
+    int colors; // 参与平滑的通道数（不含 Alpha）
+    int sigma_spatial, sigma_range;
+    float *grid; // gh * gw * gd 个单元，每个单元4个 float：颜色和（最多3个通道）、权重和
+    int gw, gh, gd;
+    const pixel_kernels_t *kernels;
+    int *splat_x;                      // 每一列累加到的网格列
+    int *slice_x;                      // 每一列插值时左侧的网格列
+    float *slice_tx;                   // 每一列插值时右侧网格列的权重
+    int splat_z[256], slice_z[256];    // 每个亮度累加到的网格层、插值时下方的网格层
+    float slice_tz[256];               // 每个亮度插值时上方网格层的权重
+    const float *weights;              // 网格模糊的一维高斯核
+    int outer, n, inner, span, chunks; // 当前模糊一遍的形状：outer 组，每组沿模糊方向 n 个、步长 inner 个单元
+    int failed;                        // 任一任务分配临时缓冲区失败时置1
+} bilateral_job_t;
+
+/**
+ * @brief 把网格行 [begin, end) 对应的图像行累加到网格。每个像素只累加到最近的单元，
+ *        不同任务写不同的网格行，不需要同步。
+ */
+static void splat_rows(void *ctx, int begin, int end)
+{
+    bilateral_job_t *job = (bilateral_job_t *)ctx;
+    int w = job->width, c = job->channels, s = job->sigma_spatial;
+    unsigned char *luma = (unsigned char *)malloc((size_t)w);
+    if (!luma) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // 图像第 y 行累加到网格第 (y + s/2) / s 行
+    int y0 = begin * s - s / 2, y1 = end * s - s / 2;
+    if (y0 < 0)
+        y0 = 0;
+    if (y1 > job->height)
+        y1 = job->height;
+
+    for (int y = y0; y < y1; y++) {
+        const unsigned char *row = job->data + (size_t)y * w * c;
+        job->kernels->luma(row, luma, w, c);
+        float *grid_row = job->grid + (size_t)((y + s / 2) / s) * job->gw * job->gd * 4;
+        for (int x = 0; x < w; x++) {
+            float *cell = grid_row + ((size_t)job->splat_x[x] * job->gd + job->splat_z[luma[x]]) * 4;
+            const unsigned char *p = row + (size_t)x * c;
+            for (int k = 0; k < job->colors; k++)
+                cell[k] += p[k];
+            cell[3] += 1.0f;
+        }
+    }
+    free(luma);
+}
+
+/**
+ * @brief 网格模糊的一遍：处理 [begin, end) 个工作单元，每个单元是一组中连续 span 列沿模糊方向的一维高斯卷积，
+ *        网格外按0处理（权重和同样为0，插值后归一化即可抵消）。
+ */
+static void blur_grid(void *ctx, int begin, int end)
+{
+    bilateral_job_t *job = (bilateral_job_t *)ctx;
+    int n = job->n, inner = job->inner, span = job->span;
+    const float *w = job->weights;
+    float *tmp = (float *)malloc((size_t)n * span * 4 * sizeof(float));
+    if (!tmp) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    for (int item = begin; item < end; item++) {
+        int o = item / job->chunks;
+        int j0 = (item % job->chunks) * span;
+        int count = (j0 + span <= inner) ? span : inner - j0;
+        float *base = job->grid + ((size_t)o * n * inner + j0) * 4;
+
+        // 先复制这一组的源数据，结果直接写回网格
+        for (int i = 0; i < n; i++)
+            memcpy(tmp + (size_t)i * count * 4, base + (size_t)i * inner * 4, (size_t)count * 4 * sizeof(float));
+
+        for (int i = 0; i < n; i++) {
+            int k0 = (i < BILATERAL_BLUR_RADIUS) ? -i : -BILATERAL_BLUR_RADIUS;
+            int k1 = (i + BILATERAL_BLUR_RADIUS >= n) ? n - 1 - i : BILATERAL_BLUR_RADIUS;
+            float *out = base + (size_t)i * inner * 4;
+            for (int j = 0; j < count; j++) {
+#if defined(__SSE2__)
+                __m128 acc = _mm_setzero_ps();
+                for (int k = k0; k <= k1; k++) {
+                    __m128 v = _mm_loadu_ps(tmp + ((size_t)(i + k) * count + j) * 4);
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k + BILATERAL_BLUR_RADIUS]), v));
+                }
+                _mm_storeu_ps(out + (size_t)j * 4, acc);
+#else
+                float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                for (int k = k0; k <= k1; k++) {
+                    const float *v = tmp + ((size_t)(i + k) * count + j) * 4;
+                    for (int e = 0; e < 4; e++)
+                        acc[e] += w[k + BILATERAL_BLUR_RADIUS] * v[e];
+                }
+                memcpy(out + (size_t)j * 4, acc, sizeof(acc));
+#endif
+            }
+        }
+    }
+    free(tmp);
+}
+
+/**
+ * @brief 沿网格的一个维度做一遍模糊：网格看作 outer 组，每组沿模糊方向 n 个位置，相邻位置相隔 inner 个单元。
+ */
+static void blur_axis(bilateral_job_t *job, int outer, int n, int inner, int span, int min_chunk)
+{
+    job->outer = outer;
+    job->n = n;
+    job->inner = inner;
+    job->span = span;
+    job->chunks = (inner + span - 1) / span;
+    parallel_for(outer * job->chunks, min_chunk, blur_grid, job);
+}
+
+/**
+ * @brief 对图像行 [begin, end) 按位置和亮度在网格中三线性插值，写回归一化的颜色。
+ */
+static void slice_rows(void *ctx, int begin, int end)
+{
+    bilateral_job_t *job = (bilateral_job_t *)ctx;
+    int w = job->width, c = job->channels, s = job->sigma_spatial;
+    size_t dz = 4, dx = (size_t)job->gd * 4, dy = (size_t)job->gw * job->gd * 4;
+    unsigned char *luma = (unsigned char *)malloc((size_t)w);
+    if (!luma) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    for (int y = begin; y < end; y++) {
+        unsigned char *row = job->data + (size_t)y * w * c;
+        job->kernels->luma(row, luma, w, c);
+        int gy = y / s;
+        float ty = (float)(y - gy * s) / s;
+        const float *grid_row = job->grid + (size_t)gy * dy;
+
+        for (int x = 0; x < w; x++) {
+            int z = luma[x];
+            const float *p = grid_row + job->slice_x[x] * dx + job->slice_z[z] * dz;
+            float tx = job->slice_tx[x], tz = job->slice_tz[z];
+            float r[4];
+#if defined(__SSE2__)
+            __m128 vtz = _mm_set1_ps(tz), vtx = _mm_set1_ps(tx), vty = _mm_set1_ps(ty);
+            __m128 a0 = _mm_loadu_ps(p), a1 = _mm_loadu_ps(p + dz);
+            __m128 b0 = _mm_loadu_ps(p + dx), b1 = _mm_loadu_ps(p + dx + dz);
+            __m128 c0 = _mm_loadu_ps(p + dy), c1 = _mm_loadu_ps(p + dy + dz);
+            __m128 d0 = _mm_loadu_ps(p + dy + dx), d1 = _mm_loadu_ps(p + dy + dx + dz);
+            __m128 a = _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(a1, a0), vtz));
+            __m128 b = _mm_add_ps(b0, _mm_mul_ps(_mm_sub_ps(b1, b0), vtz));
+            __m128 cc = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), vtz));
+            __m128 d = _mm_add_ps(d0, _mm_mul_ps(_mm_sub_ps(d1, d0), vtz));
+            __m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), vtx));
+            __m128 bottom = _mm_add_ps(cc, _mm_mul_ps(_mm_sub_ps(d, cc), vtx));
+            _mm_storeu_ps(r, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), vty)));
+#else
+            for (int e = 0; e < 4; e++) {
+                float a = p[e] + (p[dz + e] - p[e]) * tz;
+                float b = p[dx + e] + (p[dx + dz + e] - p[dx + e]) * tz;
+                float cc = p[dy + e] + (p[dy + dz + e] - p[dy + e]) * tz;
+                float d = p[dy + dx + e] + (p[dy + dx + dz + e] - p[dy + dx + e]) * tz;
+                float top = a + (b - a) * tx;
+                float bottom = cc + (d - cc) * tx;
+                r[e] = top + (bottom - top) * ty;
+            }
+#endif
+            // 像素自身所在的单元总有正的权重，权重和为0只可能来自浮点下溢，此时保留原值
+            if (r[3] <= 0.0f)
+                continue;
+            unsigned char *out = row + (size_t)x * c;
+            for (int k = 0; k < job->colors; k++) {
+                float v = r[k] / r[3] + 0.5f;
+                out[k] = (unsigned char)(v < 0.0f ? 0 : (v > 255.0f ? 255 : (int)v));
+            }
+        }
+    }
+    free(luma);
+}
+
+/**
+ * @brief 用双边网格 (bilateral grid) 做保边平滑，原地写回。
+ *
+ * 按空间标准差和值域标准差对 (x, y, 亮度) 降采样，把每个像素的颜色和权重1累加到最近的网格单元，
+ * 对网格沿三个维度做一维高斯模糊（标准差为一个单元，即空间上 sigma_spatial 像素、亮度上 sigma_range），
+ * 再按像素的位置和亮度对网格做三线性插值，颜色和除以权重和得到结果。亮度差远大于 sigma_range 的像素
+ * 落在相距很远的单元中，互不影响，因此边缘得以保留。网格的单元数约为像素数除以 sigma_spatial 的平方，
+ * 累加和插值每像素的开销固定，总开销几乎与空间标准差无关。三个阶段都拆分到多个线程执行，
+ * 累加按网格行划分，结果与线程数无关。
+ * @param data 图像数据（交错布局、紧密排列），灰度+Alpha 和 RGBA 图像的 Alpha 通道保持不变。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数（1-4）。
+ * @param sigma_spatial 空间标准差（像素，>=1）。
+ * @param sigma_range 值域标准差（亮度，1 到 BILATERAL_MAX_SIGMA_RANGE）。
+ * @return 成功返回1，失败返回0。
+ */
+int bilateral_filter(unsigned char *data, int width, int height, int channels, int sigma_spatial, int sigma_range)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || channels > 4 || sigma_spatial <= 0 ||
+        sigma_range <= 0 || sigma_range > BILATERAL_MAX_SIGMA_RANGE) {
+        LOG_ERROR("Invalid parameters for bilateral_filter");
+        return 0;
+    }
+
+    // 每个维度多留一个单元，插值时右侧/下方/上方的单元总在网格内
+    bilateral_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.data = data;
+    job.width = width;
+    job.height = height;
+    job.channels = channels;
+    job.colors = (channels == 2 || channels == 4) ? channels - 1 : channels;
+    job.sigma_spatial = sigma_spatial;
+    job.sigma_range = sigma_range;
+    job.gw = (width - 1) / sigma_spatial + 2;
+    job.gh = (height - 1) / sigma_spatial + 2;
+    job.gd = 255 / sigma_range + 2;
+    job.kernels = pixel_kernels_for(channels);
+
+    size_t cells = (size_t)job.gw * job.gh * job.gd;
+    if (cells > BILATERAL_MAX_GRID_BYTES / (4 * sizeof(float))) {
+        LOG_ERROR("Bilateral grid for %dx%d with sigma %d/%d is too large, use a larger sigma",
+                  width,
+                  height,
+                  sigma_spatial,
+                  sigma_range);
+        return 0;
+    }
+
+    conv_kernel_t *kernel = conv_kernel_gaussian(BILATERAL_BLUR_RADIUS);
+    job.grid = (float *)calloc(cells * 4, sizeof(float));
+    job.splat_x = (int *)malloc((size_t)width * sizeof(int));
+    job.slice_x = (int *)malloc((size_t)width * sizeof(int));
+    job.slice_tx = (float *)malloc((size_t)width * sizeof(float));
+    if (!kernel || !job.grid || !job.splat_x || !job.slice_x || !job.slice_tx) {
+        LOG_ERROR("Memory allocation failed in bilateral_filter");
+        conv_kernel_free(kernel);
+        free(job.grid);
+        free(job.splat_x);
+        free(job.slice_x);
+        free(job.slice_tx);
+        return 0;
+    }
+    job.weights = kernel->row;
+
+    for (int x = 0; x < width; x++) {
+        job.splat_x[x] = (x + sigma_spatial / 2) / sigma_spatial;
+        job.slice_x[x] = x / sigma_spatial;
+        job.slice_tx[x] = (float)(x % sigma_spatial) / sigma_spatial;
+    }
+    for (int z = 0; z < 256; z++) {
+        job.splat_z[z] = (z + sigma_range / 2) / sigma_range;
+        job.slice_z[z] = z / sigma_range;
+        job.slice_tz[z] = (float)(z % sigma_range) / sigma_range;
+    }
+
+    // 累加：按网格行划分，每个任务至少覆盖 BILATERAL_MIN_ROWS 个图像行
+    parallel_for(job.gh, (BILATERAL_MIN_ROWS + sigma_spatial - 1) / sigma_spatial, splat_rows, &job);
+
+    // 模糊：亮度方向（单元连续）、横向（每组是一个网格行）、纵向（按 BILATERAL_SPAN 个单元分组）
+    if (!job.failed)
+        blur_axis(&job, job.gh * job.gw, job.gd, 1, 1, 64);
+    if (!job.failed)
+        blur_axis(&job, job.gh, job.gw, job.gd, job.gd, 1);
+    if (!job.failed)
+        blur_axis(&job, 1, job.gh, job.gw * job.gd, BILATERAL_SPAN, 1);
+
+    // 插值：每个像素只读网格，原地写回
+    if (!job.failed)
+        parallel_for(height, BILATERAL_MIN_ROWS, slice_rows, &job);
+
+    if (job.failed)
+        LOG_ERROR("Memory allocation failed in bilateral_filter");
+    conv_kernel_free(kernel);
+    free(job.grid);
+    free(job.splat_x);
+    free(job.slice_x);
+    free(job.slice_tx);
+    return !job.failed;
+}
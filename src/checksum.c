@@ -0,0 +1,66 @@
+#include "checksum.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// 切片查找表：crc_tables[0] 是逐字节的表，crc_tables[k] 是把一个字节向后推 k 个字节后的贡献
+static uint32_t crc_tables[8][256];
+
+/**
+ * @brief 生成切片查找表，只执行一次。
+ */
+static void crc_tables_init(void)
+{
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t v = n;
+        for (int k = 0; k < 8; k++)
+            v = (v & 1) ? 0xedb88320u ^ (v >> 1) : v >> 1;
+        crc_tables[0][n] = v;
+    }
+    for (uint32_t n = 0; n < 256; n++)
+        for (int k = 1; k < 8; k++)
+            crc_tables[k][n] = (crc_tables[k - 1][n] >> 8) ^ crc_tables[0][crc_tables[k - 1][n] & 0xff];
+}
+
+#ifdef _WIN32
+static INIT_ONCE crc_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK crc_tables_init_once(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    (void)once;
+    (void)param;
+    (void)context;
+    crc_tables_init();
+    return TRUE;
+}
+#define CRC_TABLES_INIT() InitOnceExecuteOnce(&crc_once, crc_tables_init_once, NULL, NULL)
+#else
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+#define CRC_TABLES_INIT() pthread_once(&crc_once, crc_tables_init)
+#endif
+
+/**
+ * @brief 累加计算 CRC-32（与 zlib/PNG 相同的多项式），按8字节切片查表。
+ * @param crc 之前各段的 CRC-32，第一段为0。
+ * @param data 数据。
+ * @param len 字节数。
+ * @return 包含这段数据后的 CRC-32。
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    CRC_TABLES_INIT();
+    const unsigned char *p = (const unsigned char *)data;
+    crc = ~crc;
+    for (; len >= 8; len -= 8, p += 8) {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = crc_tables[7][lo & 0xff] ^ crc_tables[6][(lo >> 8) & 0xff] ^ crc_tables[5][(lo >> 16) & 0xff] ^
+              crc_tables[4][lo >> 24] ^ crc_tables[3][hi & 0xff] ^ crc_tables[2][(hi >> 8) & 0xff] ^
+              crc_tables[1][(hi >> 16) & 0xff] ^ crc_tables[0][hi >> 24];
+    }
+    for (; len > 0; len--, p++)
+        crc = crc_tables[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,811 @@
+#include "convolve.h"
+#include <stdlib.h> // For malloc and free
+#include <string.h> // For memcpy and memset
+#include <math.h>   // For exp, floor and fabs
+
+// 整数核的最大除数
+#define CONV_MAX_DIVISOR 1024
+// 整数核权重绝对值之和的上限，保证 255 * 和 不会溢出 int
+#define CONV_MAX_INT_SUM (1 << 23)
+
+// 让编译器把固定长度的抽头循环完全展开
+#if defined(__clang__)
+#define CONV_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define CONV_UNROLL _Pragma("GCC unroll 8")
+#else
+#define CONV_UNROLL
+#endif
+
+/*
+ * 横向一维卷积：in 是预先填充好的行（长度 count + taps - 1），out[x] = Σ w[k] * in[x + k]。
+ * taps 为常量时编译器会完全展开内层循环，3/5/7 抽头各生成一份专用版本，其余使用运行时抽头数的通用版本。
+ */
+#define CONV_DEFINE_HPASS(name, wtype, atype, taps)                                                                    \
+    static void name(const unsigned char *in, int count, int n, const wtype *w, atype *out)                            \
+    {                                                                                                                  \
+        (void)n;                                                                                                       \
+        for (int x = 0; x < count; x++) {                                                                              \
+            const unsigned char *p = in + x;                                                                           \
+            atype acc = 0;                                                                                             \
+            CONV_UNROLL                                                                                                \
+            for (int k = 0; k < (taps); k++)                                                                           \
+                acc += w[k] * p[k];                                                                                    \
+            out[x] = acc;                                                                                              \
+        }                                                                                                              \
+    }
+
+/*
+ * 二维卷积：rows 是 taps 个预先填充好的行指针，out[x] = ΣΣ w[ky][kx] * rows[ky][x + kx]。
+ */
+#define CONV_DEFINE_2D(name, wtype, atype, taps)                                                                       \
+    static void name(const unsigned char *const *rows, int count, int n, const wtype *w, atype *out)                   \
+    {                                                                                                                  \
+        (void)n;                                                                                                       \
+        for (int x = 0; x < count; x++) {                                                                              \
+            atype acc = 0;                                                                                             \
+            CONV_UNROLL                                                                                                \
+            for (int ky = 0; ky < (taps); ky++) {                                                                      \
+                const unsigned char *p = rows[ky] + x;                                                                 \
+                const wtype *wr = w + ky * (taps);                                                                     \
+                CONV_UNROLL                                                                                            \
+                for (int kx = 0; kx < (taps); kx++)                                                                    \
+                    acc += wr[kx] * p[kx];                                                                             \
+            }                                                                                                          \
+            out[x] = acc;                                                                                              \
+        }                                                                                                              \
+    }
+
+CONV_DEFINE_HPASS(hpass_f3, float, float, 3)
+CONV_DEFINE_HPASS(hpass_f5, float, float, 5)
+CONV_DEFINE_HPASS(hpass_f7, float, float, 7)
+CONV_DEFINE_HPASS(hpass_fn, float, float, n)
+CONV_DEFINE_HPASS(hpass_i3, int, int, 3)
+CONV_DEFINE_HPASS(hpass_i5, int, int, 5)
+CONV_DEFINE_HPASS(hpass_i7, int, int, 7)
+CONV_DEFINE_HPASS(hpass_in, int, int, n)
+
+CONV_DEFINE_2D(pass2d_f3, float, float, 3)
+CONV_DEFINE_2D(pass2d_f5, float, float, 5)
+CONV_DEFINE_2D(pass2d_f7, float, float, 7)
+CONV_DEFINE_2D(pass2d_fn, float, float, n)
+CONV_DEFINE_2D(pass2d_i3, int, int, 3)
+CONV_DEFINE_2D(pass2d_i5, int, int, 5)
+CONV_DEFINE_2D(pass2d_i7, int, int, 7)
+CONV_DEFINE_2D(pass2d_in, int, int, n)
+
+typedef void (*hpass_f_fn)(const unsigned char *, int, int, const float *, float *);
+typedef void (*hpass_i_fn)(const unsigned char *, int, int, const int *, int *);
+typedef void (*pass2d_f_fn)(const unsigned char *const *, int, int, const float *, float *);
+typedef void (*pass2d_i_fn)(const unsigned char *const *, int, int, const int *, int *);
+
+static hpass_f_fn select_hpass_f(int taps)
+{
+    return taps == 3 ? hpass_f3 : taps == 5 ? hpass_f5 : taps == 7 ? hpass_f7 : hpass_fn;
+}
+
+static hpass_i_fn select_hpass_i(int taps)
+{
+    return taps == 3 ? hpass_i3 : taps == 5 ? hpass_i5 : taps == 7 ? hpass_i7 : hpass_in;
+}
+
+static pass2d_f_fn select_pass2d_f(int taps)
+{
+    return taps == 3 ? pass2d_f3 : taps == 5 ? pass2d_f5 : taps == 7 ? pass2d_f7 : pass2d_fn;
+}
+
+static pass2d_i_fn select_pass2d_i(int taps)
+{
+    return taps == 3 ? pass2d_i3 : taps == 5 ? pass2d_i5 : taps == 7 ? pass2d_i7 : pass2d_in;
+}
+
+/**
+ * @brief 纵向一维卷积：acc[x] = Σ w[k] * in[k * stride + x]，按行累加以便向量化。
+ */
+static void vpass_f(const float *in, int stride, int count, int taps, const float *w, float *acc)
+{
+    for (int x = 0; x < count; x++)
+        acc[x] = w[0] * in[x];
+    for (int k = 1; k < taps; k++) {
+        const float *row = in + (size_t)k * stride;
+        float wk = w[k];
+        for (int x = 0; x < count; x++)
+            acc[x] += wk * row[x];
+    }
+}
+
+static void vpass_i(const int *in, int stride, int count, int taps, const int *w, int *acc)
+{
+    for (int x = 0; x < count; x++)
+        acc[x] = w[0] * in[x];
+    for (int k = 1; k < taps; k++) {
+        const int *row = in + (size_t)k * stride;
+        int wk = w[k];
+        for (int x = 0; x < count; x++)
+            acc[x] += wk * row[x];
+    }
+}
+
+/**
+ * @brief 浮点累加结果四舍五入并钳制到 0-255。
+ */
+static void store_f(const float *acc, int count, unsigned char *dst)
+{
+    for (int x = 0; x < count; x++) {
+        float v = acc[x] + 0.5f;
+        dst[x] = v <= 0.0f ? 0 : (v >= 255.0f ? 255 : (unsigned char)v);
+    }
+}
+
+/**
+ * @brief 整数累加结果除以除数（四舍五入）并钳制到 0-255。
+ */
+static void store_i(const int *acc, int count, int divisor, unsigned char *dst)
+{
+    int half = divisor / 2;
+    for (int x = 0; x < count; x++) {
+        int v = acc[x] <= 0 ? 0 : (acc[x] + half) / divisor;
+        dst[x] = (unsigned char)(v > 255 ? 255 : v);
+    }
+}
+
+/**
+ * @brief 把越界坐标按边界模式映射回 [0, n)。
+ * @return 映射后的坐标；BORDER_CONSTANT 模式下越界返回-1。
+ */
+static int border_map(int i, int n, border_mode_t mode)
+{
+    if (i >= 0 && i < n)
+        return i;
+
+    switch (mode) {
+    case BORDER_REFLECT: {
+        if (n == 1)
+            return 0;
+        int period = 2 * n - 2;
+        i %= period;
+        if (i < 0)
+            i += period;
+        return i < n ? i : period - i;
+    }
+    case BORDER_WRAP:
+        i %= n;
+        return i < 0 ? i + n : i;
+    case BORDER_CONSTANT:
+        return -1;
+    case BORDER_CLAMP:
+    default:
+        return i < 0 ? 0 : n - 1;
+    }
+}
+
+/**
+ * @brief 取一行中从 x0 开始的 count 个像素，越界部分按边界模式填充。
+ *
+ * 只有两端越界的像素逐个映射，中间部分整段复制。
+ */
+static void pad_span(
+    const unsigned char *row, int width, int x0, int count, border_mode_t mode, unsigned char value, unsigned char *out)
+{
+    int left = x0 < 0 ? -x0 : 0;
+    if (left > count)
+        left = count;
+    int middle = width - (x0 + left);
+    if (middle > count - left)
+        middle = count - left;
+    if (middle < 0)
+        middle = 0;
+
+    for (int i = 0; i < left; i++) {
+        int idx = border_map(x0 + i, width, mode);
+        out[i] = idx < 0 ? value : row[idx];
+    }
+    if (middle > 0)
+        memcpy(out + left, row + x0 + left, middle);
+    for (int i = left + middle; i < count; i++) {
+        int idx = border_map(x0 + i, width, mode);
+        out[i] = idx < 0 ? value : row[idx];
+    }
+}
+
+/**
+ * @brief 卷积的公共实现，按核的类型选择可分离/二维、浮点/整数路径。
+ *
+ * dst8 非NULL时输出钳制后的8位结果，否则向 dst32 输出整数累加和。
+ */
+static int convolve_rect(const unsigned char *src,
+                         int src_stride,
+                         int width,
+                         int height,
+                         const conv_kernel_t *kernel,
+                         border_mode_t border,
+                         unsigned char border_value,
+                         image_rect_t rect,
+                         unsigned char *dst8,
+                         int *dst32,
+                         int dst_stride)
+{
+    if (!src || !kernel || width <= 0 || height <= 0 || rect.w <= 0 || rect.h <= 0 || rect.x < 0 || rect.y < 0 ||
+        rect.x + rect.w > width || rect.y + rect.h > height) {
+        return 0;
+    }
+    if (dst32 && !kernel->is_integer) {
+        return 0;
+    }
+
+    int taps = kernel->size;
+    int radius = kernel->radius;
+    int span = rect.w + 2 * radius;     // 填充后的行长度
+    int src_rows = rect.h + 2 * radius; // 需要读取的源行数（含边界外的行）
+    int use_int = kernel->is_integer;
+
+    // 每行的累加结果，float 和 int 同为4字节
+    void *acc = malloc((size_t)rect.w * sizeof(float));
+    // 填充缓冲区的前 span 字节是 BORDER_CONSTANT 模式下边界外的整行
+    unsigned char *const_row = (unsigned char *)malloc(span);
+    if (!acc || !const_row) {
+        free(acc);
+        free(const_row);
+        return 0;
+    }
+    memset(const_row, border_value, span);
+
+    if (kernel->separable) {
+        // 每行输出分为三段：左右两端邻域越界，中间段邻域全部在行内
+        int left = radius - rect.x;
+        if (left < 0)
+            left = 0;
+        if (left > rect.w)
+            left = rect.w;
+        int right = rect.x + rect.w - (width - radius);
+        if (right < 0)
+            right = 0;
+        if (right > rect.w - left)
+            right = rect.w - left;
+        int middle = rect.w - left - right;
+
+        // 端部填充缓冲区，长度足够容纳任意一端的输出及其邻域
+        unsigned char *edge = (unsigned char *)malloc((left > right ? left : right) + 2 * radius + 1);
+        void *inter = malloc((size_t)src_rows * rect.w * sizeof(float));
+        if (!edge || !inter) {
+            free(edge);
+            free(inter);
+            free(acc);
+            free(const_row);
+            return 0;
+        }
+
+        // 第一遍：每个源行做横向卷积，结果暂存在 src_rows x rect.w 的中间缓冲区
+        hpass_f_fn hpass_f = select_hpass_f(taps);
+        hpass_i_fn hpass_i = select_hpass_i(taps);
+        for (int i = 0; i < src_rows; i++) {
+            int sy = border_map(rect.y - radius + i, height, border);
+            float *fout = (float *)inter + (size_t)i * rect.w;
+            int *iout = (int *)inter + (size_t)i * rect.w;
+
+            if (sy < 0) {
+                // 整行都在边界外，取固定值
+                if (use_int)
+                    hpass_i(const_row, rect.w, taps, kernel->irow, iout);
+                else
+                    hpass_f(const_row, rect.w, taps, kernel->row, fout);
+                continue;
+            }
+
+            const unsigned char *row = src + (size_t)sy * src_stride;
+            if (left > 0) {
+                pad_span(row, width, rect.x - radius, left + 2 * radius, border, border_value, edge);
+                if (use_int)
+                    hpass_i(edge, left, taps, kernel->irow, iout);
+                else
+                    hpass_f(edge, left, taps, kernel->row, fout);
+            }
+            if (middle > 0) {
+                // 快速路径：直接读源行，无需复制和边界判断
+                const unsigned char *in = row + rect.x + left - radius;
+                if (use_int)
+                    hpass_i(in, middle, taps, kernel->irow, iout + left);
+                else
+                    hpass_f(in, middle, taps, kernel->row, fout + left);
+            }
+            if (right > 0) {
+                int x0 = rect.x + left + middle;
+                pad_span(row, width, x0 - radius, right + 2 * radius, border, border_value, edge);
+                if (use_int)
+                    hpass_i(edge, right, taps, kernel->irow, iout + left + middle);
+                else
+                    hpass_f(edge, right, taps, kernel->row, fout + left + middle);
+            }
+        }
+
+        // 第二遍：纵向卷积，此时源数据已全部读入，可以安全地原地写回
+        for (int y = 0; y < rect.h; y++) {
+            if (use_int) {
+                vpass_i((int *)inter + (size_t)y * rect.w, rect.w, rect.w, taps, kernel->icol, (int *)acc);
+                if (dst8)
+                    store_i((int *)acc, rect.w, kernel->divisor, dst8 + (size_t)y * dst_stride);
+                else
+                    memcpy(dst32 + (size_t)y * dst_stride, acc, (size_t)rect.w * sizeof(int));
+            }
+            else {
+                vpass_f((float *)inter + (size_t)y * rect.w, rect.w, rect.w, taps, kernel->col, (float *)acc);
+                store_f((float *)acc, rect.w, dst8 + (size_t)y * dst_stride);
+            }
+        }
+
+        free(edge);
+        free(inter);
+    }
+    else {
+        // 不可分离：一次填充全部需要的源行，之后按行指针做二维卷积
+        unsigned char *padded = (unsigned char *)malloc((size_t)src_rows * span);
+        if (!padded) {
+            free(acc);
+            free(const_row);
+            return 0;
+        }
+        for (int i = 0; i < src_rows; i++) {
+            int sy = border_map(rect.y - radius + i, height, border);
+            if (sy < 0)
+                memcpy(padded + (size_t)i * span, const_row, span);
+            else
+                pad_span(src + (size_t)sy * src_stride,
+                         width,
+                         rect.x - radius,
+                         span,
+                         border,
+                         border_value,
+                         padded + (size_t)i * span);
+        }
+
+        pass2d_f_fn pass_f = select_pass2d_f(taps);
+        pass2d_i_fn pass_i = select_pass2d_i(taps);
+        const unsigned char *rows[CONV_MAX_SIZE];
+        for (int y = 0; y < rect.h; y++) {
+            for (int k = 0; k < taps; k++) {
+                rows[k] = padded + (size_t)(y + k) * span;
+            }
+            if (use_int) {
+                pass_i(rows, rect.w, taps, kernel->iweights, (int *)acc);
+                if (dst8)
+                    store_i((int *)acc, rect.w, kernel->divisor, dst8 + (size_t)y * dst_stride);
+                else
+                    memcpy(dst32 + (size_t)y * dst_stride, acc, (size_t)rect.w * sizeof(int));
+            }
+            else {
+                pass_f(rows, rect.w, taps, kernel->weights, (float *)acc);
+                store_f((float *)acc, rect.w, dst8 + (size_t)y * dst_stride);
+            }
+        }
+
+        free(padded);
+    }
+
+    free(acc);
+    free(const_row);
+    return 1;
+}
+
+/**
+ * @brief 寻找最小的除数 d (1-1024)，使所有权重乘以 d 后都是整数。
+ * @return 找到时返回 d 并把整数权重写入 iw，否则返回0。
+ */
+static int find_divisor(const float *w, int n, int *iw)
+{
+    for (int d = 1; d <= CONV_MAX_DIVISOR; d++) {
+        long long total = 0;
+        int ok = 1;
+        for (int i = 0; i < n; i++) {
+            double v = (double)w[i] * d;
+            double r = floor(v + 0.5);
+            if (fabs(v - r) > 1e-4 || fabs(r) > CONV_MAX_INT_SUM) {
+                ok = 0;
+                break;
+            }
+            iw[i] = (int)r;
+            total += (long long)(r < 0 ? -r : r);
+        }
+        if (ok && total > 0 && total <= CONV_MAX_INT_SUM) {
+            return d;
+        }
+    }
+    return 0;
+}
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief 把秩为1的整数矩阵分解为整数列向量与行向量的外积。
+ * @return 可分解返回1，否则返回0。
+ */
+static int factor_integer(const int *iw, int size, int *irow, int *icol)
+{
+    int py = 0, px = 0, best = 0;
+    for (int i = 0; i < size * size; i++) {
+        int v = iw[i] < 0 ? -iw[i] : iw[i];
+        if (v > best) {
+            best = v;
+            py = i / size;
+            px = i % size;
+        }
+    }
+    if (best == 0)
+        return 0;
+
+    // 行向量取主元所在行除以其最大公约数，列向量必须是它的整数倍
+    int g = 0;
+    for (int x = 0; x < size; x++) {
+        g = gcd(g, iw[py * size + x] < 0 ? -iw[py * size + x] : iw[py * size + x]);
+    }
+    for (int x = 0; x < size; x++) {
+        irow[x] = iw[py * size + x] / g;
+    }
+    for (int y = 0; y < size; y++) {
+        if (iw[y * size + px] % irow[px] != 0)
+            return 0;
+        icol[y] = iw[y * size + px] / irow[px];
+    }
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if (icol[y] * irow[x] != iw[y * size + x])
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 秩1检测：以绝对值最大的元素为主元，检查 w[y][x] == col[y] * row[x]。
+ * @return 可分离返回1，否则返回0。
+ */
+static int factor_float(const float *w, int size, float *row, float *col)
+{
+    int py = 0, px = 0;
+    float best = 0.0f;
+    for (int i = 0; i < size * size; i++) {
+        if (fabsf(w[i]) > best) {
+            best = fabsf(w[i]);
+            py = i / size;
+            px = i % size;
+        }
+    }
+    if (best == 0.0f)
+        return 0;
+
+    float pivot = w[py * size + px];
+    for (int x = 0; x < size; x++) {
+        row[x] = w[py * size + x];
+    }
+    for (int y = 0; y < size; y++) {
+        col[y] = w[y * size + px] / pivot;
+    }
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if (fabsf(col[y] * row[x] - w[y * size + x]) > 1e-5f * best)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 按名称解析边界模式（"clamp"、"reflect"、"wrap"、"constant"）。
+ * @param name 边界模式名称。
+ * @param mode 输出的边界模式。
+ * @return 成功返回1，未知名称返回0。
+ */
+int border_mode_from_name(const char *name, border_mode_t *mode)
+{
+    static const struct
+    {
+        const char *name;
+        border_mode_t mode;
+    } modes[] = {
+        {"clamp", BORDER_CLAMP}, {"reflect", BORDER_REFLECT}, {"wrap", BORDER_WRAP}, {"constant", BORDER_CONSTANT}};
+
+    if (!name || !mode)
+        return 0;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (strcmp(name, modes[i].name) == 0) {
+            *mode = modes[i].mode;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 释放卷积核。
+ * @param kernel 卷积核。
+ */
+void conv_kernel_free(conv_kernel_t *kernel)
+{
+    if (!kernel)
+        return;
+    free(kernel->weights);
+    free(kernel->row);
+    free(kernel->col);
+    free(kernel->iweights);
+    free(kernel->irow);
+    free(kernel->icol);
+    free(kernel);
+}
+
+/**
+ * @brief 分配卷积核结构及其行列向量。
+ */
+static conv_kernel_t *kernel_alloc(int size)
+{
+    conv_kernel_t *kernel = (conv_kernel_t *)calloc(1, sizeof(conv_kernel_t));
+    if (!kernel)
+        return NULL;
+
+    kernel->size = size;
+    kernel->radius = size / 2;
+    kernel->row = (float *)malloc(size * sizeof(float));
+    kernel->col = (float *)malloc(size * sizeof(float));
+    kernel->irow = (int *)malloc(size * sizeof(int));
+    kernel->icol = (int *)malloc(size * sizeof(int));
+    if (!kernel->row || !kernel->col || !kernel->irow || !kernel->icol) {
+        conv_kernel_free(kernel);
+        return NULL;
+    }
+    return kernel;
+}
+
+/**
+ * @brief 由任意权重矩阵创建卷积核，并分析可分离性和整数性。
+ * @param size 边长（1到CONV_MAX_SIZE之间的奇数）。
+ * @param weights size * size 个权重，行优先。
+ * @return 成功返回卷积核，失败返回NULL。
+ */
+conv_kernel_t *conv_kernel_create(int size, const float *weights)
+{
+    if (!weights || size < 1 || size > CONV_MAX_SIZE || size % 2 == 0) {
+        return NULL;
+    }
+
+    conv_kernel_t *kernel = kernel_alloc(size);
+    if (!kernel)
+        return NULL;
+
+    int n = size * size;
+    kernel->weights = (float *)malloc(n * sizeof(float));
+    kernel->iweights = (int *)malloc(n * sizeof(int));
+    if (!kernel->weights || !kernel->iweights) {
+        conv_kernel_free(kernel);
+        return NULL;
+    }
+    memcpy(kernel->weights, weights, n * sizeof(float));
+
+    kernel->divisor = find_divisor(weights, n, kernel->iweights);
+    kernel->is_integer = kernel->divisor > 0;
+
+    if (kernel->is_integer) {
+        kernel->separable = factor_integer(kernel->iweights, size, kernel->irow, kernel->icol);
+        for (int i = 0; kernel->separable && i < size; i++) {
+            kernel->row[i] = (float)kernel->irow[i];
+            kernel->col[i] = (float)kernel->icol[i] / kernel->divisor;
+        }
+    }
+    else {
+        kernel->separable = factor_float(weights, size, kernel->row, kernel->col);
+    }
+    return kernel;
+}
+
+/**
+ * @brief 由行向量和列向量创建可分离卷积核（权重为二者外积）。
+ * @param size 边长（奇数）。
+ * @param row 横向权重。
+ * @param col 纵向权重。
+ * @return 成功返回卷积核，失败返回NULL。
+ */
+conv_kernel_t *conv_kernel_create_separable(int size, const float *row, const float *col)
+{
+    if (!row || !col || size < 1 || size % 2 == 0) {
+        return NULL;
+    }
+
+    conv_kernel_t *kernel = kernel_alloc(size);
+    if (!kernel)
+        return NULL;
+
+    kernel->separable = 1;
+    memcpy(kernel->row, row, size * sizeof(float));
+    memcpy(kernel->col, col, size * sizeof(float));
+
+    // 两个向量各自能化为整数时，整体除数是二者之积
+    int row_divisor = find_divisor(row, size, kernel->irow);
+    int col_divisor = row_divisor ? find_divisor(col, size, kernel->icol) : 0;
+    if (row_divisor && col_divisor) {
+        long long row_sum = 0, col_sum = 0;
+        for (int i = 0; i < size; i++) {
+            row_sum += abs(kernel->irow[i]);
+            col_sum += abs(kernel->icol[i]);
+        }
+        if (row_sum * col_sum <= CONV_MAX_INT_SUM) {
+            kernel->is_integer = 1;
+            kernel->divisor = row_divisor * col_divisor;
+        }
+    }
+    return kernel;
+}
+
+/**
+ * @brief 创建归一化的高斯卷积核 (sigma = radius / 2)。
+ * @param radius 半径。
+ * @return 成功返回卷积核，失败返回NULL。
+ */
+conv_kernel_t *conv_kernel_gaussian(int radius)
+{
+    if (radius < 0) {
+        return NULL;
+    }
+
+    int size = 2 * radius + 1;
+    float *g = (float *)malloc(size * sizeof(float));
+    if (!g)
+        return NULL;
+
+    if (radius == 0) {
+        g[0] = 1.0f;
+    }
+    else {
+        // 二维高斯 G(x,y) = g(x) * g(y)，归一化的一维核的外积正好是归一化的二维核
+        float sigma = radius / 2.0f;
+        float sigma2 = 2.0f * sigma * sigma;
+        float sum = 0.0f;
+        for (int i = -radius; i <= radius; i++) {
+            g[i + radius] = (float)exp(-(i * i) / sigma2);
+            sum += g[i + radius];
+        }
+        for (int i = 0; i < size; i++) {
+            g[i] /= sum;
+        }
+    }
+
+    conv_kernel_t *kernel = conv_kernel_create_separable(size, g, g);
+    free(g);
+    return kernel;
+}
+
+/**
+ * @brief 按名称创建预置卷积核：sharpen、emboss、box3、box5、box7、sobel_x、sobel_y。
+ * @param name 预置名称。
+ * @return 成功返回卷积核，未知名称返回NULL。
+ */
+conv_kernel_t *conv_kernel_preset(const char *name)
+{
+    static const float sharpen[9] = {0, -1, 0, -1, 5, -1, 0, -1, 0};
+    static const float emboss[9] = {-2, -1, 0, -1, 1, 1, 0, 1, 2};
+    static const float sobel_x[9] = {-1, 0, 1, -2, 0, 2, -1, 0, 1};
+    static const float sobel_y[9] = {-1, -2, -1, 0, 0, 0, 1, 2, 1};
+
+    if (!name)
+        return NULL;
+    if (strcmp(name, "sharpen") == 0)
+        return conv_kernel_create(3, sharpen);
+    if (strcmp(name, "emboss") == 0)
+        return conv_kernel_create(3, emboss);
+    if (strcmp(name, "sobel_x") == 0)
+        return conv_kernel_create(3, sobel_x);
+    if (strcmp(name, "sobel_y") == 0)
+        return conv_kernel_create(3, sobel_y);
+
+    if (strcmp(name, "box3") == 0 || strcmp(name, "box5") == 0 || strcmp(name, "box7") == 0) {
+        int size = name[3] - '0';
+        float box[7];
+        for (int i = 0; i < size; i++) {
+            box[i] = 1.0f / size;
+        }
+        return conv_kernel_create_separable(size, box, box);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 对单个8位平面做卷积，结果四舍五入并钳制到0-255。
+ * @param src 源平面。
+ * @param src_stride 源平面行步长（字节）。
+ * @param width 源平面宽度。
+ * @param height 源平面高度。
+ * @param kernel 卷积核。
+ * @param border 边界模式。
+ * @param border_value BORDER_CONSTANT 模式下边界外像素的取值。
+ * @param rect 需要计算的输出区域（源平面坐标）。
+ * @param dst 输出区域左上角的地址。
+ * @param dst_stride 输出行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int convolve_plane(const unsigned char *src,
+                   int src_stride,
+                   int width,
+                   int height,
+                   const conv_kernel_t *kernel,
+                   border_mode_t border,
+                   unsigned char border_value,
+                   image_rect_t rect,
+                   unsigned char *dst,
+                   int dst_stride)
+{
+    if (!dst)
+        return 0;
+    return convolve_rect(src, src_stride, width, height, kernel, border, border_value, rect, dst, NULL, dst_stride);
+}
+
+/**
+ * @brief 对单个8位平面做整数卷积，输出未除以除数、未钳制的有符号累加和。
+ * @param src 源平面。
+ * @param src_stride 源平面行步长（字节）。
+ * @param width 源平面宽度。
+ * @param height 源平面高度。
+ * @param kernel 卷积核（必须是整数核）。
+ * @param border 边界模式。
+ * @param border_value BORDER_CONSTANT 模式下边界外像素的取值。
+ * @param rect 需要计算的输出区域（源平面坐标）。
+ * @param dst 输出区域左上角的地址。
+ * @param dst_stride 输出行步长（元素个数）。
+ * @return 成功返回1，非整数核或失败返回0。
+ */
+int convolve_plane_int(const unsigned char *src,
+                       int src_stride,
+                       int width,
+                       int height,
+                       const conv_kernel_t *kernel,
+                       border_mode_t border,
+                       unsigned char border_value,
+                       image_rect_t rect,
+                       int *dst,
+                       int dst_stride)
+{
+    if (!dst)
+        return 0;
+    return convolve_rect(src, src_stride, width, height, kernel, border, border_value, rect, NULL, dst, dst_stride);
+}
+
+/**
+ * @brief 对交错布局的整幅图像逐通道卷积（原地），Alpha 通道保持不变。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param kernel 卷积核。
+ * @param border 边界模式。
+ * @return 成功返回1，失败返回0。
+ */
+int convolve_image(
+    unsigned char *data, int width, int height, int channels, const conv_kernel_t *kernel, border_mode_t border)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || channels > IMAGE_MAX_CHANNELS || !kernel) {
+        return 0;
+    }
+
+    image_buffer_t interleaved, planes;
+    image_buffer_wrap(&interleaved, data, width, height, channels, 0);
+    if (!image_buffer_to_planar(&interleaved, &planes)) {
+        return 0;
+    }
+
+    // 灰度+Alpha 和 RGBA 图像的最后一个通道是 Alpha
+    int color_channels = (channels == 2 || channels == 4) ? channels - 1 : channels;
+    image_rect_t full = {0, 0, width, height};
+    int ok = 1;
+    for (int c = 0; c < color_channels && ok; c++) {
+        ok = convolve_plane(
+            planes.planes[c], planes.stride, width, height, kernel, border, 0, full, planes.planes[c], planes.stride);
+    }
+
+    if (ok)
+        image_buffer_to_interleaved(&planes, &interleaved);
+    image_buffer_free(&planes);
+    return ok;
+}
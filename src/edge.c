@@ -1,9 +1,16 @@
 #include "edge.h"
+#include "log.h"
+#include "histogram.h"
+#include "median.h"
+#include "pixel_kernels.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
 #include <stdbool.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /**
  * @brief 使用 Sobel 算子进行边缘检测
@@ -11,57 +18,182 @@
  * @param width 图像宽度
  * @param height 图像高度
  * @param channels 图像通道数
- * @param threshold 边缘检测阈值，范围0-255，值越小检测到的边缘越多
+ * @param threshold 边缘检测阈值，范围0-255，值越小检测到的边缘越多；
+ *                  传 EDGE_THRESHOLD_OTSU / EDGE_THRESHOLD_PERCENTILE 时根据梯度直方图自动选择
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径（去除 JPEG 噪声产生的斑点边缘），0 表示不滤波
+ * @note 图像边界外按镜像 (BORDER_REFLECT) 取值，边界像素同样参与检测
  * @return 返回边缘检测结果图像数据，调用者负责释放内存
  */
-unsigned char *sobel_edge_detect(const unsigned char *data, int width, int height, int channels, int threshold)
+unsigned char *sobel_edge_detect(
+    const unsigned char *data, int width, int height, int channels, int threshold, int median_radius)
 {
     if (!data || width <= 0 || height <= 0 || channels <= 0) {
-        fprintf(stderr, "Invalid parameters for sobel_edge_detect\n");
+        LOG_ERROR("Invalid parameters for sobel_edge_detect");
         return NULL;
     }
 
-    // 确保阈值在有效范围内
-    if (threshold < 0)
-        threshold = 0;
-    if (threshold > 255)
-        threshold = 255;
+    image_rect_t full = {0, 0, width, height};
+    return sobel_edge_detect_roi(
+        data, width, height, channels, width * channels, full, threshold, median_radius, BORDER_REFLECT);
+}
+
+/**
+ * @brief 对图像中的矩形区域进行 Sobel 边缘检测
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 检测区域，超出图像的部分会被裁剪
+ * @param threshold 边缘检测阈值，范围0-255，或自动阈值模式
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param border 图像边界外像素的取值方式
+ * @return 返回 roi.w * roi.h * channels 大小的边缘图，调用者负责释放内存
+ */
+unsigned char *sobel_edge_detect_roi(const unsigned char *data,
+                                     int width,
+                                     int height,
+                                     int channels,
+                                     int stride,
+                                     image_rect_t roi,
+                                     int threshold,
+                                     int median_radius,
+                                     border_mode_t border)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || !image_rect_clip(&roi, width, height)) {
+        LOG_ERROR("Invalid parameters for sobel_edge_detect_roi");
+        return NULL;
+    }
 
-    // 为边缘检测结果分配内存（与输入图像相同大小）
-    unsigned char *edge_data = (unsigned char *)malloc(width * height * channels);
+    // 为边缘检测结果分配内存（与检测区域相同大小）
+    unsigned char *edge_data = (unsigned char *)malloc((size_t)roi.w * roi.h * channels);
     if (!edge_data) {
-        fprintf(stderr, "Memory allocation failed in sobel_edge_detect\n");
+        LOG_ERROR("Memory allocation failed in sobel_edge_detect");
         return NULL;
     }
 
-    // 初始化边缘图像为黑色
-    memset(edge_data, 0, width * height * channels);
+    if (!sobel_edge_detect_into(data,
+                                width,
+                                height,
+                                channels,
+                                stride,
+                                roi,
+                                threshold,
+                                median_radius,
+                                border,
+                                edge_data,
+                                roi.w * channels)) {
+        free(edge_data);
+        return NULL;
+    }
+    return edge_data;
+}
+
+/**
+ * @brief 由一行有符号梯度计算梯度幅值（钳制到 0-255）
+ * @param gx 水平梯度
+ * @param gy 垂直梯度
+ * @param n 像素数
+ * @param dst 输出的梯度幅值
+ * @note |gx|、|gy| 不超过 1020，平方和小于 2^24，单精度浮点可以精确表示；
+ *       幅值不超过255时整数平方和的平方根与下一个整数相差远大于单精度的舍入误差，
+ *       因此截断后的结果与双精度计算完全一致
+ */
+static void sobel_magnitude_row(const int *gx, const int *gy, int n, unsigned char *dst)
+{
+    int x = 0;
+#if defined(__SSE2__)
+    // 每次16个像素：平方和转为单精度开方，截断为整数后用饱和打包钳制到255
+    for (; x + 16 <= n; x += 16) {
+        __m128i mag[4];
+        for (int k = 0; k < 4; k++) {
+            __m128 fx = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(gx + x + 4 * k)));
+            __m128 fy = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(gy + x + 4 * k)));
+            __m128 sum = _mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy));
+            mag[k] = _mm_cvttps_epi32(_mm_sqrt_ps(sum));
+        }
+        __m128i lo = _mm_packs_epi32(mag[0], mag[1]);
+        __m128i hi = _mm_packs_epi32(mag[2], mag[3]);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; x < n; x++) {
+        // 计算梯度幅值
+        int mag = (int)sqrt(gx[x] * gx[x] + gy[x] * gy[x]);
+        dst[x] = (mag > 255) ? 255 : mag;
+    }
+}
+
+/**
+ * @brief 计算矩形区域的 Sobel 有符号梯度
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 计算区域，必须已裁剪到图像内
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param border 图像边界外像素的取值方式
+ * @param grad_x 输出的水平梯度（roi.w * roi.h，紧密排列）
+ * @param grad_y 输出的垂直梯度（roi.w * roi.h，紧密排列）
+ * @return 成功返回1，失败返回0
+ */
+static int sobel_gradient_rect(const unsigned char *data,
+                               int width,
+                               int height,
+                               int channels,
+                               int stride,
+                               image_rect_t roi,
+                               int median_radius,
+                               border_mode_t border,
+                               int *grad_x,
+                               int *grad_y)
+{
+    // 梯度需要灰度的8邻域，所以只读取区域外1像素的光晕；中值滤波的窗口再向外扩 median_radius 像素
+    // 环绕模式在图像边缘需要对侧的像素，因此读取整幅图像
+    image_rect_t smooth_rect = {roi.x - 1, roi.y - 1, roi.w + 2, roi.h + 2};
+    image_rect_t gray_rect = {roi.x - 1 - median_radius,
+                              roi.y - 1 - median_radius,
+                              roi.w + 2 + 2 * median_radius,
+                              roi.h + 2 + 2 * median_radius};
+    if (border == BORDER_WRAP) {
+        smooth_rect = (image_rect_t){0, 0, width, height};
+        gray_rect = smooth_rect;
+    }
+    image_rect_clip(&smooth_rect, width, height);
+    image_rect_clip(&gray_rect, width, height);
+    int gw = gray_rect.w;
+    int gh = gray_rect.h;
 
     // 创建灰度图，用于计算边缘
-    unsigned char *gray_data = (unsigned char *)malloc(width * height);
+    unsigned char *gray_data = (unsigned char *)malloc((size_t)gw * gh);
     if (!gray_data) {
-        fprintf(stderr, "Memory allocation failed for gray image\n");
-        free(edge_data);
-        return NULL;
+        LOG_ERROR("Memory allocation failed for gray image");
+        return 0;
     }
 
-    // 转换为灰度图
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int pixel_idx = (y * width + x) * channels;
-
-            if (channels >= 3) {
-                // 使用加权平均计算灰度值（相同的灰度转换公式）
-                float gray_value = 0.299f * data[pixel_idx] +     // R
-                                   0.587f * data[pixel_idx + 1] + // G
-                                   0.114f * data[pixel_idx + 2];  // B
-                gray_data[y * width + x] = (unsigned char)gray_value;
-            }
-            else {
-                // 已经是灰度图
-                gray_data[y * width + x] = data[pixel_idx];
-            }
+    // 转换为灰度图（与灰度化使用相同的转换公式），按通道数选择特化的行函数
+    const pixel_kernels_t *kernels = pixel_kernels_for(channels);
+    for (int y = 0; y < gh; y++) {
+        const unsigned char *row = data + (size_t)(gray_rect.y + y) * stride + (size_t)gray_rect.x * channels;
+        kernels->luma(row, gray_data + (size_t)y * gw, gw, channels);
+    }
+
+    // 中值滤波只需覆盖梯度用到的范围；灰度区域只在图像边界处被裁剪，钳制取值即图像边界外的取值
+    if (median_radius > 0) {
+        image_rect_t inner = {smooth_rect.x - gray_rect.x, smooth_rect.y - gray_rect.y, smooth_rect.w, smooth_rect.h};
+        unsigned char *smooth_data = (unsigned char *)malloc((size_t)smooth_rect.w * smooth_rect.h);
+        if (!smooth_data || !median_filter_roi(gray_data, gw, gh, 1, gw, inner, median_radius, smooth_data, inner.w)) {
+            LOG_ERROR("Median pre-filter failed in sobel_magnitude_into");
+            free(smooth_data);
+            free(gray_data);
+            return 0;
         }
+        free(gray_data);
+        gray_data = smooth_data;
+        gray_rect = smooth_rect;
+        gw = gray_rect.w;
+        gh = gray_rect.h;
     }
 
     // Sobel算子
@@ -75,96 +207,328 @@ unsigned char *sobel_edge_detect(const unsigned char *data, int width, int heigh
     // [ 0  0  0]
     // [ 1  2  1]
 
-    // 创建临时的梯度幅值图像，用于进一步处理
-    unsigned char *magnitude_data = (unsigned char *)malloc(width * height);
-    if (!magnitude_data) {
-        fprintf(stderr, "Memory allocation failed for magnitude data\n");
-        free(gray_data);
-        return edge_data;
-    }
-
-    // 初始化为0
-    memset(magnitude_data, 0, width * height);
-
-    // 找出最大梯度幅值，用于归一化
-    int max_magnitude = 0;
-
-    // 应用Sobel算子并计算所有像素的梯度幅值
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            // 计算水平梯度 Gx
-            int gx = (-1) * gray_data[(y - 1) * width + (x - 1)] + (0) * gray_data[(y - 1) * width + (x)] +
-                     (1) * gray_data[(y - 1) * width + (x + 1)] + (-2) * gray_data[(y)*width + (x - 1)] +
-                     (0) * gray_data[(y)*width + (x)] + (2) * gray_data[(y)*width + (x + 1)] +
-                     (-1) * gray_data[(y + 1) * width + (x - 1)] + (0) * gray_data[(y + 1) * width + (x)] +
-                     (1) * gray_data[(y + 1) * width + (x + 1)];
-
-            // 计算垂直梯度 Gy
-            int gy = (-1) * gray_data[(y - 1) * width + (x - 1)] + (-2) * gray_data[(y - 1) * width + (x)] +
-                     (-1) * gray_data[(y - 1) * width + (x + 1)] + (0) * gray_data[(y)*width + (x - 1)] +
-                     (0) * gray_data[(y)*width + (x)] + (0) * gray_data[(y)*width + (x + 1)] +
-                     (1) * gray_data[(y + 1) * width + (x - 1)] + (2) * gray_data[(y + 1) * width + (x)] +
-                     (1) * gray_data[(y + 1) * width + (x + 1)];
-
-            // 计算梯度幅值
-            int magnitude = (int)sqrt(gx * gx + gy * gy);
-
-            // 记录最大梯度幅值
-            if (magnitude > max_magnitude) {
-                max_magnitude = magnitude;
-            }
+    // 梯度由卷积引擎计算：两个 Sobel 核都是可分离的整数核，输出未钳制的有符号梯度；
+    // 灰度区域只在图像边界处被裁剪，引擎在区域边缘按边界模式取值即得到图像边界上的梯度
+    image_rect_t grad_rect = {roi.x - gray_rect.x, roi.y - gray_rect.y, roi.w, roi.h};
+    conv_kernel_t *kx = conv_kernel_preset("sobel_x");
+    conv_kernel_t *ky = conv_kernel_preset("sobel_y");
+    int ok = kx && ky && convolve_plane_int(gray_data, gw, gw, gh, kx, border, 0, grad_rect, grad_x, roi.w) &&
+             convolve_plane_int(gray_data, gw, gw, gh, ky, border, 0, grad_rect, grad_y, roi.w);
+    if (!ok) {
+        LOG_ERROR("Gradient computation failed in sobel_edge_detect");
+    }
+
+    conv_kernel_free(kx);
+    conv_kernel_free(ky);
+    free(gray_data);
+    return ok;
+}
+
+/**
+ * @brief 计算矩形区域的 Sobel 梯度幅值（钳制到 0-255）
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 计算区域，超出图像的部分会被裁剪
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param border 图像边界外像素的取值方式
+ * @param dst 输出区域左上角的地址（每像素1字节）
+ * @param dst_stride 输出的行步长（字节）
+ * @return 成功返回1，失败返回0
+ */
+int sobel_magnitude_into(const unsigned char *data,
+                         int width,
+                         int height,
+                         int channels,
+                         int stride,
+                         image_rect_t roi,
+                         int median_radius,
+                         border_mode_t border,
+                         unsigned char *dst,
+                         int dst_stride)
+{
+    if (!data || !dst || width <= 0 || height <= 0 || channels <= 0 || median_radius < 0 ||
+        !image_rect_clip(&roi, width, height)) {
+        LOG_ERROR("Invalid parameters for sobel_magnitude_into");
+        return 0;
+    }
 
-            // 存储梯度幅值
-            magnitude_data[y * width + x] = (magnitude > 255) ? 255 : magnitude;
+    int *grad_x = (int *)malloc((size_t)roi.w * roi.h * sizeof(int));
+    int *grad_y = (int *)malloc((size_t)roi.w * roi.h * sizeof(int));
+    int ok = grad_x && grad_y &&
+             sobel_gradient_rect(data, width, height, channels, stride, roi, median_radius, border, grad_x, grad_y);
+    if (ok) {
+        for (int y = 0; y < roi.h; y++) {
+            size_t offset = (size_t)y * roi.w;
+            sobel_magnitude_row(grad_x + offset, grad_y + offset, roi.w, dst + (size_t)y * dst_stride);
         }
     }
 
+    free(grad_x);
+    free(grad_y);
+    return ok;
+}
+
+/**
+ * @brief 计算整幅图像的 Sobel 梯度场（图像边界外按镜像取值）
+ * @param data 图像数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param gradient 输出的梯度场，用 sobel_gradient_free 释放
+ * @return 成功返回1，失败返回0
+ */
+int sobel_gradient_compute(
+    const unsigned char *data, int width, int height, int channels, int median_radius, sobel_gradient_t *gradient)
+{
+    if (!gradient) {
+        LOG_ERROR("Invalid parameters for sobel_gradient_compute");
+        return 0;
+    }
+    memset(gradient, 0, sizeof(*gradient));
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || median_radius < 0) {
+        LOG_ERROR("Invalid parameters for sobel_gradient_compute");
+        return 0;
+    }
+
+    size_t pixels = (size_t)width * height;
+    gradient->width = width;
+    gradient->height = height;
+    gradient->gx = (int *)malloc(pixels * sizeof(int));
+    gradient->gy = (int *)malloc(pixels * sizeof(int));
+    gradient->magnitude = (unsigned char *)malloc(pixels);
+    image_rect_t full = {0, 0, width, height};
+    if (!gradient->gx || !gradient->gy || !gradient->magnitude ||
+        !sobel_gradient_rect(data,
+                             width,
+                             height,
+                             channels,
+                             width * channels,
+                             full,
+                             median_radius,
+                             BORDER_REFLECT,
+                             gradient->gx,
+                             gradient->gy)) {
+        LOG_ERROR("Failed to compute gradient field");
+        sobel_gradient_free(gradient);
+        return 0;
+    }
+
+    for (int y = 0; y < height; y++) {
+        size_t offset = (size_t)y * width;
+        sobel_magnitude_row(gradient->gx + offset, gradient->gy + offset, width, gradient->magnitude + offset);
+    }
+    return 1;
+}
+
+/**
+ * @brief 释放梯度场的缓冲区
+ * @param gradient 梯度场（可以是计算失败后的梯度场）
+ */
+void sobel_gradient_free(sobel_gradient_t *gradient)
+{
+    if (!gradient)
+        return;
+    free(gradient->gx);
+    free(gradient->gy);
+    free(gradient->magnitude);
+    memset(gradient, 0, sizeof(*gradient));
+}
+
+/**
+ * @brief 由已计算的梯度场生成边缘图，结果与对同一图像调用 sobel_edge_detect 相同
+ * @param gradient sobel_gradient_compute 计算的梯度场
+ * @param threshold 边缘检测阈值，范围0-255，或自动阈值模式
+ * @param channels 输出的通道数
+ * @return 返回 width * height * channels 大小的边缘图，调用者负责释放内存
+ */
+unsigned char *sobel_edge_detect_gradient(const sobel_gradient_t *gradient, int threshold, int channels)
+{
+    if (!gradient || !gradient->magnitude || channels <= 0) {
+        LOG_ERROR("Invalid parameters for sobel_edge_detect_gradient");
+        return NULL;
+    }
+    int w = gradient->width;
+    int h = gradient->height;
+
+    if (threshold < EDGE_THRESHOLD_PERCENTILE)
+        threshold = 0;
+    if (threshold > 255)
+        threshold = 255;
+
+    // 与 sobel_edge_detect_into 相同：梯度幅值四周补一圈0，供滞后阈值检查邻域
+    int mw = w + 2;
+    unsigned char *magnitude_data = (unsigned char *)calloc((size_t)mw * (h + 2), 1);
+    unsigned char *edge_data = (unsigned char *)malloc((size_t)w * h * channels);
+    if (!magnitude_data || !edge_data) {
+        LOG_ERROR("Memory allocation failed in sobel_edge_detect_gradient");
+        free(magnitude_data);
+        free(edge_data);
+        return NULL;
+    }
+    unsigned char *magnitude = magnitude_data + mw + 1;
+    for (int y = 0; y < h; y++) {
+        memcpy(magnitude + (size_t)y * mw, gradient->magnitude + (size_t)y * w, w);
+    }
+
+    if (threshold < 0) {
+        unsigned int hist[256] = {0};
+        histogram_accumulate(gradient->magnitude, (size_t)w * h, hist);
+        threshold = edge_auto_threshold(hist, threshold);
+    }
+
+    edge_hysteresis(magnitude, mw, w, h, threshold, channels, edge_data, w * channels);
+    free(magnitude_data);
+
+    LOG_DEBUG("Sobel edge detection from gradient field completed (threshold: %d)", threshold);
+    return edge_data;
+}
+
+/**
+ * @brief 由梯度幅值直方图确定自动阈值
+ * @param hist 梯度幅值的直方图（256个桶）
+ * @param mode EDGE_THRESHOLD_OTSU 或 EDGE_THRESHOLD_PERCENTILE
+ * @return 阈值（至少为1）
+ */
+int edge_auto_threshold(const unsigned int hist[256], int mode)
+{
+    int threshold = (mode == EDGE_THRESHOLD_OTSU) ? histogram_otsu_threshold(hist)
+                                                  : histogram_percentile(hist, EDGE_AUTO_PERCENTILE);
+    // 避免平坦图像上阈值过低而把噪声当作边缘
+    return threshold < 1 ? 1 : threshold;
+}
+
+/**
+ * @brief 对梯度幅值做双阈值滞后处理，生成边缘图（边缘为255，其余为0）
+ * @param magnitude 区域左上角的梯度幅值；区域四周一圈的幅值必须可读（图像外的位置为0）
+ * @param mag_stride 梯度幅值的行步长（字节）
+ * @param w 区域宽度
+ * @param h 区域高度
+ * @param threshold 强边缘阈值，弱边缘阈值为它的一半
+ * @param channels 输出的通道数
+ * @param dst 输出区域左上角像素的地址
+ * @param dst_stride 输出的行步长（字节）
+ */
+void edge_hysteresis(const unsigned char *magnitude,
+                     int mag_stride,
+                     int w,
+                     int h,
+                     int threshold,
+                     int channels,
+                     unsigned char *dst,
+                     int dst_stride)
+{
     // 应用非极大值抑制和双阈值（简化版）
     int high_threshold = threshold;
     int low_threshold = threshold / 2;
 
-    // 应用阈值，生成边缘图像
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            int mag = magnitude_data[y * width + x];
+    // 应用阈值，生成边缘图像（边缘为白色，其余为黑色）
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const unsigned char *m = magnitude + (size_t)y * mag_stride + x;
+            bool is_edge = false;
 
             // 强边缘 - 直接标记为白色
-            if (mag > high_threshold) {
-                for (int c = 0; c < channels; c++) {
-                    edge_data[(y * width + x) * channels + c] = 255;
-                }
+            if (*m > high_threshold) {
+                is_edge = true;
             }
             // 弱边缘 - 如果连接到强边缘，也标记为白色
-            else if (mag > low_threshold) {
+            else if (*m > low_threshold) {
                 // 检查8邻域是否存在强边缘
-                bool connected_to_strong = false;
-                for (int ny = -1; ny <= 1 && !connected_to_strong; ny++) {
-                    for (int nx = -1; nx <= 1 && !connected_to_strong; nx++) {
+                for (int ny = -1; ny <= 1 && !is_edge; ny++) {
+                    for (int nx = -1; nx <= 1; nx++) {
                         if (nx == 0 && ny == 0)
                             continue;
 
-                        int neighbor_mag = magnitude_data[(y + ny) * width + (x + nx)];
-                        if (neighbor_mag > high_threshold) {
-                            connected_to_strong = true;
+                        if (m[ny * mag_stride + nx] > high_threshold) {
+                            is_edge = true;
                             break;
                         }
                     }
                 }
-
-                if (connected_to_strong) {
-                    for (int c = 0; c < channels; c++) {
-                        edge_data[(y * width + x) * channels + c] = 255;
-                    }
-                }
             }
-            // 非边缘保持为黑色
+
+            memset(dst + (size_t)y * dst_stride + (size_t)x * channels, is_edge ? 255 : 0, channels);
+        }
+    }
+}
+
+/**
+ * @brief 对图像中的矩形区域进行 Sobel 边缘检测，结果写入调用者提供的缓冲区
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 检测区域，超出图像的部分会被裁剪
+ * @param threshold 边缘检测阈值，范围0-255，或自动阈值模式
+ * @param median_radius 计算梯度前对灰度图做中值滤波的半径，0 表示不滤波
+ * @param border 图像边界外像素的取值方式
+ * @param dst 输出区域左上角像素的地址；源像素在写出前已全部转换到内部梯度缓冲区，因此可以指向 data 本身
+ * @param dst_stride 输出的行步长（字节）
+ * @return 成功返回1，失败返回0
+ */
+int sobel_edge_detect_into(const unsigned char *data,
+                           int width,
+                           int height,
+                           int channels,
+                           int stride,
+                           image_rect_t roi,
+                           int threshold,
+                           int median_radius,
+                           border_mode_t border,
+                           unsigned char *dst,
+                           int dst_stride)
+{
+    if (!data || !dst || width <= 0 || height <= 0 || channels <= 0 || !image_rect_clip(&roi, width, height)) {
+        LOG_ERROR("Invalid parameters for sobel_edge_detect_into");
+        return 0;
+    }
+
+    // 确保阈值在有效范围内（负值是自动阈值模式，在梯度计算完成后确定）
+    if (threshold < EDGE_THRESHOLD_PERCENTILE)
+        threshold = 0;
+    if (threshold > 255)
+        threshold = 255;
+
+    // 滞后阈值需要梯度的8邻域，所以梯度在区域外扩1像素（且不超出图像）的范围内计算
+    image_rect_t grad_rect = {roi.x - 1, roi.y - 1, roi.w + 2, roi.h + 2};
+    image_rect_clip(&grad_rect, width, height);
+
+    // 梯度幅值图比梯度区域四周各多1像素，这圈像素保持为0，
+    // 使图像边界上的像素做滞后阈值检查时无需判断邻域是否越界
+    int mw = grad_rect.w + 2;
+    unsigned char *magnitude_data = (unsigned char *)calloc((size_t)mw * (grad_rect.h + 2), 1);
+    if (!magnitude_data) {
+        LOG_ERROR("Memory allocation failed for magnitude data");
+        return 0;
+    }
+    if (!sobel_magnitude_into(
+            data, width, height, channels, stride, grad_rect, median_radius, border, magnitude_data + mw + 1, mw)) {
+        free(magnitude_data);
+        return 0;
+    }
+    // 检测区域左上角的梯度幅值
+    const unsigned char *magnitude =
+        magnitude_data + (size_t)(roi.y - grad_rect.y + 1) * mw + (roi.x - grad_rect.x + 1);
+
+    // 自动阈值：由检测区域内梯度幅值的直方图决定
+    if (threshold < 0) {
+        unsigned int hist[256] = {0};
+        for (int y = 0; y < roi.h; y++) {
+            histogram_accumulate(magnitude + (size_t)y * mw, roi.w, hist);
         }
+        threshold = edge_auto_threshold(hist, threshold);
     }
 
+    edge_hysteresis(magnitude, mw, roi.w, roi.h, threshold, channels, dst, dst_stride);
+
     // 释放临时图像数据
-    free(gray_data);
     free(magnitude_data);
 
-    printf("Sobel edge detection with hysteresis completed (threshold: %d)\n", threshold);
-    return edge_data;
+    LOG_DEBUG("Sobel edge detection with hysteresis completed (threshold: %d)", threshold);
+    return 1;
 }
@@ -0,0 +1,427 @@
+#include "effects.h"
+#include "log.h"
+#include "image.h"
+#include "filters.h"
+#include "rotate.h"
+#include "edge.h"
+#include "resize.h"
+#include "convolve.h"
+#include "median.h"
+#include "bilateral.h"
+#include "morphology.h"
+#include "planar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 效果名称表，与 effect_type_t 的顺序一致
+static const struct
+{
+    const char *name;
+    effect_type_t type;
+    int default_param;
+    int default_param2;
+    border_mode_t default_border;
+} effect_table[] = {
+    {"grayscale", EFFECT_GRAYSCALE, 0, 0, BORDER_CLAMP},
+    {"invert", EFFECT_INVERT, 0, 0, BORDER_CLAMP},
+    {"blur", EFFECT_BLUR, 5, 0, BORDER_CLAMP},
+    {"rotate", EFFECT_ROTATE, 0, 0, BORDER_CLAMP},
+    {"edge", EFFECT_EDGE, EDGE_THRESHOLD_OTSU, 0, BORDER_REFLECT},
+    {"resize", EFFECT_RESIZE, 50, 0, BORDER_CLAMP},
+    {"autocontrast", EFFECT_AUTO_CONTRAST, 0, 0, BORDER_CLAMP},
+    {"sharpen", EFFECT_SHARPEN, 0, 0, BORDER_CLAMP},
+    {"emboss", EFFECT_EMBOSS, 0, 0, BORDER_CLAMP},
+    {"dilate", EFFECT_DILATE, 3, 3, BORDER_CLAMP},
+    {"erode", EFFECT_ERODE, 3, 3, BORDER_CLAMP},
+    {"open", EFFECT_OPEN, 3, 3, BORDER_CLAMP},
+    {"close", EFFECT_CLOSE, 3, 3, BORDER_CLAMP},
+    {"median", EFFECT_MEDIAN, 1, 0, BORDER_CLAMP},
+    {"bilateral", EFFECT_BILATERAL, 8, 20, BORDER_CLAMP},
+};
+
+#define EFFECT_COUNT ((int)(sizeof(effect_table) / sizeof(effect_table[0])))
+
+/**
+ * @brief 返回效果的名称。
+ * @param type 效果类型。
+ * @return 名称字符串。
+ */
+const char *effect_name(effect_type_t type)
+{
+    return ((int)type >= 0 && (int)type < EFFECT_COUNT) ? effect_table[type].name : "unknown";
+}
+
+/**
+ * @brief 是否为形态学效果（参数为结构元素的宽和高）。
+ */
+static int is_morphology(effect_type_t type)
+{
+    return type == EFFECT_DILATE || type == EFFECT_ERODE || type == EFFECT_OPEN || type == EFFECT_CLOSE;
+}
+
+/**
+ * @brief 是否为按卷积核取邻域的效果（可以选择边界模式）。
+ */
+static int is_stencil(effect_type_t type)
+{
+    return type == EFFECT_BLUR || type == EFFECT_SHARPEN || type == EFFECT_EMBOSS || type == EFFECT_EDGE;
+}
+
+/**
+ * @brief 解析单个 "名称[:参数]" 项。
+ * @return 成功返回1，失败返回0。
+ */
+static int parse_op(const char *item, size_t len, effect_op_t *op)
+{
+    char buf[64];
+    if (len == 0 || len >= sizeof(buf)) {
+        return 0;
+    }
+    memcpy(buf, item, len);
+    buf[len] = '\0';
+
+    char *arg = strchr(buf, ':');
+    if (arg) {
+        *arg++ = '\0';
+    }
+
+    for (int i = 0; i < EFFECT_COUNT; i++) {
+        if (strcmp(buf, effect_table[i].name) != 0) {
+            continue;
+        }
+
+        op->type = effect_table[i].type;
+        op->param = effect_table[i].default_param;
+        op->param2 = effect_table[i].default_param2;
+        op->border = effect_table[i].default_border;
+
+        // 卷积类效果可以在最后给出边界模式，例如 blur:3:wrap、edge:otsu:1:constant、sharpen:reflect
+        if (arg && is_stencil(op->type)) {
+            char *last = strrchr(arg, ':');
+            if (border_mode_from_name(last ? last + 1 : arg, &op->border)) {
+                if (last)
+                    *last = '\0';
+                else
+                    arg = NULL;
+            }
+        }
+        if (!arg) {
+            return 1;
+        }
+
+        // 边缘检测可以在阈值之后再给出中值预滤波的半径，例如 edge:otsu:1；
+        // 双边滤波可以在空间标准差之后再给出值域标准差，例如 bilateral:16:30
+        char *second_arg = (op->type == EFFECT_EDGE || op->type == EFFECT_BILATERAL) ? strchr(arg, ':') : NULL;
+        if (second_arg) {
+            *second_arg++ = '\0';
+            char *end;
+            long value = strtol(second_arg, &end, 10);
+            long low = (op->type == EFFECT_EDGE) ? 0 : 1;
+            long high = (op->type == EFFECT_EDGE) ? MEDIAN_MAX_RADIUS : BILATERAL_MAX_SIGMA_RANGE;
+            if (*second_arg == '\0' || *end != '\0' || value < low || value > high) {
+                return 0;
+            }
+            op->param2 = (int)value;
+        }
+
+        // 边缘检测的阈值也可以写成自动阈值模式的名称
+        if (op->type == EFFECT_EDGE && strcmp(arg, "otsu") == 0) {
+            op->param = EDGE_THRESHOLD_OTSU;
+            return 1;
+        }
+        if (op->type == EFFECT_EDGE && strcmp(arg, "percentile") == 0) {
+            op->param = EDGE_THRESHOLD_PERCENTILE;
+            return 1;
+        }
+
+        // 形态学效果的参数可以写成 宽x高
+        char *height_arg = is_morphology(op->type) ? strchr(arg, 'x') : NULL;
+        if (height_arg) {
+            *height_arg++ = '\0';
+        }
+
+        char *end;
+        long value = strtol(arg, &end, 10);
+        if (*arg == '\0' || *end != '\0' || value < 0 || value > 10000) {
+            return 0;
+        }
+        if ((op->type == EFFECT_BLUR || op->type == EFFECT_RESIZE || op->type == EFFECT_MEDIAN ||
+             op->type == EFFECT_BILATERAL || is_morphology(op->type)) &&
+            value == 0) {
+            return 0;
+        }
+        if (op->type == EFFECT_MEDIAN && value > MEDIAN_MAX_RADIUS) {
+            return 0;
+        }
+        op->param = (int)value;
+        if (is_morphology(op->type)) {
+            op->param2 = op->param;
+        }
+        if (height_arg) {
+            value = strtol(height_arg, &end, 10);
+            if (*height_arg == '\0' || *end != '\0' || value <= 0 || value > 10000) {
+                return 0;
+            }
+            op->param2 = (int)value;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 解析逗号分隔的效果列表，例如 "grayscale,blur:3,edge:40"。
+ * @param spec 效果列表字符串。
+ * @param ops 输出的操作数组。
+ * @param max_ops 数组容量。
+ * @return 成功返回操作个数，格式错误或为空返回0。
+ */
+int effects_parse(const char *spec, effect_op_t *ops, int max_ops)
+{
+    if (!spec || !ops || max_ops <= 0) {
+        return 0;
+    }
+
+    int count = 0;
+    const char *p = spec;
+    while (*p) {
+        const char *comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+
+        if (count >= max_ops) {
+            LOG_ERROR("Too many effects (at most %d): %s", max_ops, spec);
+            return 0;
+        }
+        if (!parse_op(p, len, &ops[count])) {
+            LOG_ERROR("Invalid effect '%.*s' in: %s", (int)len, p, spec);
+            return 0;
+        }
+        count++;
+
+        if (!comma)
+            break;
+        p = comma + 1;
+    }
+    return count;
+}
+
+/**
+ * @brief 计算 resize:百分比 的输出尺寸。
+ */
+static void resize_dimensions(int percent, int width, int height, int *new_width, int *new_height)
+{
+    *new_width = (int)((long long)width * percent / 100);
+    *new_height = (int)((long long)height * percent / 100);
+    if (*new_width < 1)
+        *new_width = 1;
+    if (*new_height < 1)
+        *new_height = 1;
+}
+
+/**
+ * @brief 为效果链生成执行计划：确定每一步的输出尺寸和内存需求，以及缓冲区需要的最大容量。
+ * @param plan 输出的执行计划。
+ * @param ops 操作数组。
+ * @param count 操作个数。
+ * @param width 输入图像宽度。
+ * @param height 输入图像高度。
+ * @param channels 输入图像通道数。
+ * @return 成功返回1，失败返回0。
+ */
+int effect_plan_build(effect_plan_t *plan, const effect_op_t *ops, int count, int width, int height, int channels)
+{
+    if (!plan || !ops || count < 0 || count > EFFECT_MAX_OPS || width <= 0 || height <= 0 || channels <= 0) {
+        return 0;
+    }
+
+    plan->count = count;
+    plan->width = width;
+    plan->height = height;
+    plan->channels = channels;
+    plan->buffer_size = (size_t)width * height * channels;
+
+    int w = width, h = height;
+    for (int i = 0; i < count; i++) {
+        effect_step_t *step = &plan->steps[i];
+        step->op = ops[i];
+
+        switch (ops[i].type) {
+        case EFFECT_GRAYSCALE:
+        case EFFECT_INVERT:
+        case EFFECT_ROTATE:
+        case EFFECT_AUTO_CONTRAST:
+            step->kind = EFFECT_STEP_IN_PLACE;
+            break;
+        case EFFECT_RESIZE:
+            step->kind = EFFECT_STEP_RESHAPE;
+            resize_dimensions(ops[i].param, w, h, &w, &h);
+            break;
+        default:
+            step->kind = EFFECT_STEP_SCRATCH;
+            break;
+        }
+
+        step->width = w;
+        step->height = h;
+        size_t size = (size_t)w * h * channels;
+        if (size > plan->buffer_size)
+            plan->buffer_size = size;
+    }
+    return 1;
+}
+
+/**
+ * @brief 打印执行计划。
+ * @param plan 执行计划。
+ */
+void effect_plan_print(const effect_plan_t *plan)
+{
+    static const char *kind_names[] = {"in place", "in place, filter scratch", "in place, reshape"};
+
+    LOG_INFO("Execution plan: %d step(s), %dx%d, %d channels, buffer %zu bytes",
+             plan->count,
+             plan->width,
+             plan->height,
+             plan->channels,
+             plan->buffer_size);
+    for (int i = 0; i < plan->count; i++) {
+        const effect_step_t *step = &plan->steps[i];
+        LOG_INFO("  %d. %-12s -> %dx%d (%s)",
+                 i + 1,
+                 effect_name(step->op.type),
+                 step->width,
+                 step->height,
+                 kind_names[step->kind]);
+    }
+}
+
+/**
+ * @brief 在容量足够的缓冲区上原地执行一个效果。
+ */
+static int apply_in_place(const effect_op_t *op, effect_image_t *img)
+{
+    int w = img->width, h = img->height, c = img->channels;
+
+    switch (op->type) {
+    case EFFECT_GRAYSCALE:
+        grayscale(img->data, w, h, c);
+        return 1;
+
+    case EFFECT_INVERT:
+        invert(img->data, w, h, c);
+        return 1;
+
+    case EFFECT_BLUR: {
+        image_rect_t full = {0, 0, w, h};
+        return blur_roi(img->data, w, h, c, w * c, full, op->param, op->border, NULL, 0);
+    }
+
+    case EFFECT_ROTATE:
+        rotate_image(img->data, w, h, c);
+        return 1;
+
+    case EFFECT_AUTO_CONTRAST:
+        return auto_contrast(img->data, w, h, c);
+
+    case EFFECT_SHARPEN:
+    case EFFECT_EMBOSS: {
+        conv_kernel_t *kernel = conv_kernel_preset(op->type == EFFECT_SHARPEN ? "sharpen" : "emboss");
+        int ok = kernel && convolve_image(img->data, w, h, c, kernel, op->border);
+        conv_kernel_free(kernel);
+        return ok;
+    }
+
+    case EFFECT_DILATE:
+    case EFFECT_ERODE:
+    case EFFECT_OPEN:
+    case EFFECT_CLOSE: {
+        static const morph_op_t morph_ops[] = {MORPH_DILATE, MORPH_ERODE, MORPH_OPEN, MORPH_CLOSE};
+        return morphology(img->data, w, h, c, morph_ops[op->type - EFFECT_DILATE], op->param, op->param2);
+    }
+
+    case EFFECT_MEDIAN:
+        return median_filter(img->data, w, h, c, op->param);
+
+    case EFFECT_BILATERAL:
+        return bilateral_filter(img->data, w, h, c, op->param, op->param2);
+
+    case EFFECT_EDGE: {
+        // 边缘检测先把源图转换到内部灰度缓冲区，结果可以直接覆盖源图
+        image_rect_t full = {0, 0, w, h};
+        return sobel_edge_detect_into(
+            img->data, w, h, c, w * c, full, op->param, op->param2, op->border, img->data, w * c);
+    }
+
+    case EFFECT_RESIZE: {
+        // 横向一遍读完所需源行后才写目标，缓冲区容量足够时可以原地缩放
+        int nw, nh;
+        resize_dimensions(op->param, w, h, &nw, &nh);
+        if (!resize_image_into(img->data, w, h, c, img->data, nw, nh, RESIZE_FILTER_LANCZOS3))
+            return 0;
+        img->width = nw;
+        img->height = nh;
+        return 1;
+    }
+    }
+    return 0;
+}
+
+/**
+ * @brief 按执行计划处理图像。缓冲区容量不足时只扩展一次，之后所有步骤都原地写回 img->data。
+ * @param plan 执行计划（输入尺寸必须与 img 一致）。
+ * @param img 图像，data 由 malloc 分配或由 load_image 返回（可能经 image_realloc 扩展）。
+ * @return 全部成功返回1，任一失败返回0（图像保持有效，尺寸为最后一个成功步骤的输出）。
+ */
+int effect_plan_execute(const effect_plan_t *plan, effect_image_t *img)
+{
+    if (!plan || !img || !img->data || img->width != plan->width || img->height != plan->height ||
+        img->channels != plan->channels) {
+        return 0;
+    }
+
+    // 整条链只需要一个缓冲区，放大时在开始前一次扩展到最大尺寸
+    if (plan->buffer_size > (size_t)img->width * img->height * img->channels) {
+        unsigned char *grown = image_realloc(img->data, plan->buffer_size);
+        if (!grown) {
+            LOG_ERROR("Memory allocation failed for effect buffer");
+            return 0;
+        }
+        img->data = grown;
+    }
+
+    for (int i = 0; i < plan->count; i++) {
+        if (!apply_in_place(&plan->steps[i].op, img)) {
+            LOG_ERROR("Effect '%s' failed", effect_name(plan->steps[i].op.type));
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 对图像应用一个效果。改变尺寸的效果 (resize) 放大时会扩展 img->data。
+ * @param op 操作。
+ * @param img 图像。
+ * @return 成功返回1，失败返回0（图像保持有效）。
+ */
+int effect_apply(const effect_op_t *op, effect_image_t *img)
+{
+    return effects_apply_all(op, 1, img);
+}
+
+/**
+ * @brief 按顺序应用一条效果链（生成执行计划后执行）。
+ * @param ops 操作数组。
+ * @param count 操作个数。
+ * @param img 图像。
+ * @return 全部成功返回1，任一失败返回0。
+ */
+int effects_apply_all(const effect_op_t *ops, int count, effect_image_t *img)
+{
+    effect_plan_t plan;
+    if (!img || !effect_plan_build(&plan, ops, count, img->width, img->height, img->channels)) {
+        return 0;
+    }
+    return effect_plan_execute(&plan, img);
+}
@@ -1,8 +1,11 @@
 #include "filters.h"
+#include "planar.h"
+#include "histogram.h"
+#include "log.h"
+#include "pixel_kernels.h"
 #include <stddef.h> // For size_t
 #include <stdlib.h> // For malloc and free
 #include <string.h> // For memcpy
-#include <math.h>   // For exp() 和 M_PI
 
 /**
  * @brief 将图像数据转换为灰度图。
@@ -17,17 +20,46 @@ void grayscale(unsigned char *data, int width, int height, int channels)
         // 可以选择在这里添加错误处理或日志记录
         return;
     }
-    size_t pixel_count = (size_t)width * height;
-    for (size_t i = 0; i < pixel_count; i++) {
-        unsigned char *p = data + i * channels;
-        // 计算灰度值 (Luminance method)
-        unsigned char gray = (unsigned char)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]);
-        p[0] = gray; // R
-        p[1] = gray; // G
-        p[2] = gray; // B
-        // 如果有alpha通道，通常保持不变
-        // if (channels == 4) { p[3] = p[3]; }
+    image_rect_t full = {0, 0, width, height};
+    grayscale_roi(data, width, height, channels, width * channels, full, NULL, 0);
+}
+
+/**
+ * @brief 对图像中的矩形区域进行灰度化。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param dst 输出区域左上角像素的地址，传NULL表示原地写回 data。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int grayscale_roi(unsigned char *data,
+                  int width,
+                  int height,
+                  int channels,
+                  int stride,
+                  image_rect_t roi,
+                  unsigned char *dst,
+                  int dst_stride)
+{
+    if (data == NULL || channels <= 0 || !image_rect_clip(&roi, width, height)) {
+        return 0;
+    }
+    if (dst == NULL) {
+        dst = data + (size_t)roi.y * stride + (size_t)roi.x * channels;
+        dst_stride = stride;
     }
+
+    // 每次调用只按通道数选择一次行函数，1/3/4 通道使用特化版本
+    const pixel_kernels_t *kernels = pixel_kernels_for(channels);
+    for (int y = 0; y < roi.h; y++) {
+        const unsigned char *src_row = data + (size_t)(roi.y + y) * stride + (size_t)roi.x * channels;
+        kernels->grayscale(src_row, dst + (size_t)y * dst_stride, roi.w, channels);
+    }
+    return 1;
 }
 
 /**
@@ -42,22 +74,90 @@ void invert(unsigned char *data, int width, int height, int channels)
     if (data == NULL || width <= 0 || height <= 0 || channels <= 0) {
         return; // 参数无效，直接返回
     }
+    image_rect_t full = {0, 0, width, height};
+    invert_roi(data, width, height, channels, width * channels, full, NULL, 0);
+}
 
-    // 计算总像素数
-    size_t pixel_count = (size_t)width * height;
+/**
+ * @brief 对图像中的矩形区域进行反色处理。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param dst 输出区域左上角像素的地址，传NULL表示原地写回 data。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int invert_roi(unsigned char *data,
+               int width,
+               int height,
+               int channels,
+               int stride,
+               image_rect_t roi,
+               unsigned char *dst,
+               int dst_stride)
+{
+    if (data == NULL || channels <= 0 || !image_rect_clip(&roi, width, height)) {
+        return 0;
+    }
+    if (dst == NULL) {
+        dst = data + (size_t)roi.y * stride + (size_t)roi.x * channels;
+        dst_stride = stride;
+    }
+
+    // 逐行遍历区域内的像素，Alpha 通道保持不变
+    const pixel_kernels_t *kernels = pixel_kernels_for(channels);
+    for (int y = 0; y < roi.h; y++) {
+        const unsigned char *src_row = data + (size_t)(roi.y + y) * stride + (size_t)roi.x * channels;
+        kernels->invert(src_row, dst + (size_t)y * dst_stride, roi.w, channels);
+    }
+    return 1;
+}
 
-    // 遍历所有像素
+/**
+ * @brief 自动对比度：把亮度的 0.5% 和 99.5% 百分位线性拉伸到 0 和 255。
+ * @param data 图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数。
+ * @return 成功返回1，失败返回0。
+ */
+int auto_contrast(unsigned char *data, int width, int height, int channels)
+{
+    if (data == NULL || width <= 0 || height <= 0 || channels <= 0 || channels > 4) {
+        return 0;
+    }
+
+    image_stats_t stats;
+    if (!compute_image_stats(data, width, height, channels, &stats)) {
+        return 0;
+    }
+
+    // 两端各裁掉0.5%的像素，避免个别极亮/极暗像素让拉伸失效
+    int lo = histogram_percentile(stats.luma, 0.5);
+    int hi = histogram_percentile(stats.luma, 99.5);
+    if (hi <= lo) {
+        return 1; // 亮度几乎恒定，无需拉伸
+    }
+
+    // 预计算查找表，每个像素只做一次查表
+    unsigned char lut[256];
+    for (int v = 0; v < 256; v++) {
+        int stretched = (int)((v - lo) * 255.0f / (hi - lo) + 0.5f);
+        lut[v] = (unsigned char)(stretched < 0 ? 0 : (stretched > 255 ? 255 : stretched));
+    }
+
+    size_t pixel_count = (size_t)width * height;
+    int color_channels = channels < 3 ? channels : 3; // Alpha 通道保持不变
     for (size_t i = 0; i < pixel_count; i++) {
         unsigned char *p = data + i * channels;
-
-        // 反转 RGB 分量 (255 - 原值)
-        for (int j = 0; j < channels && j < 3; j++) {
-            p[j] = 255 - p[j];
+        for (int c = 0; c < color_channels; c++) {
+            p[c] = lut[p[c]];
         }
-
-        // 如果有 Alpha 通道（第4个通道），保持不变
-        // 通常我们不会反转 Alpha 通道，因为它表示透明度
     }
+    return 1;
 }
 
 /**
@@ -73,87 +173,139 @@ void blur(unsigned char *data, int width, int height, int channels, int radius)
     if (data == NULL || width <= 0 || height <= 0 || channels <= 0 || radius <= 0) {
         return; // 参数无效，直接返回
     }
+    image_rect_t full = {0, 0, width, height};
+    if (!blur_roi(data, width, height, channels, width * channels, full, radius, BORDER_CLAMP, NULL, 0))
+        LOG_ERROR("Blur failed (%dx%d, %d channels, radius %d)", width, height, channels, radius);
+}
 
-    // 为处理后的图像分配临时内存
-    unsigned char *temp = (unsigned char *)malloc(width * height * channels);
-    if (temp == NULL) {
-        // 内存分配失败
-        return;
+/**
+ * @brief 通道数超过 IMAGE_MAX_CHANNELS 时的模糊：逐个通道从交错数据中取出光晕区域的平面，卷积后写回输出。
+ *        每个通道只写回自己的字节，原地写回时尚未处理的通道不受影响。
+ * @return 成功返回1，失败返回0。
+ */
+static int blur_channels_one_by_one(const unsigned char *data,
+                                    int channels,
+                                    int stride,
+                                    image_rect_t halo,
+                                    image_rect_t out_rect,
+                                    const conv_kernel_t *kernel,
+                                    border_mode_t border,
+                                    unsigned char *dst,
+                                    int dst_stride)
+{
+    unsigned char *plane = (unsigned char *)malloc((size_t)halo.w * halo.h);
+    if (plane == NULL) {
+        return 0;
     }
 
-    // 复制原始数据到临时缓冲区
-    memcpy(temp, data, width * height * channels);
+    int ok = 1;
+    for (int c = 0; c < channels && ok; c++) {
+        for (int y = 0; y < halo.h; y++) {
+            const unsigned char *src = data + (size_t)(halo.y + y) * stride + (size_t)halo.x * channels + c;
+            unsigned char *p = plane + (size_t)y * halo.w;
+            for (int x = 0; x < halo.w; x++) {
+                p[x] = src[(size_t)x * channels];
+            }
+        }
+        unsigned char *out_plane = plane + (size_t)out_rect.y * halo.w + out_rect.x;
+        ok = convolve_plane(plane, halo.w, halo.w, halo.h, kernel, border, 0, out_rect, out_plane, halo.w);
+        for (int y = 0; ok && y < out_rect.h; y++) {
+            const unsigned char *p = out_plane + (size_t)y * halo.w;
+            unsigned char *out = dst + (size_t)y * dst_stride + c;
+            for (int x = 0; x < out_rect.w; x++) {
+                out[(size_t)x * channels] = p[x];
+            }
+        }
+    }
+
+    free(plane);
+    return ok;
+}
+
+/**
+ * @brief 对图像中的矩形区域应用模糊滤镜。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像的宽度。
+ * @param height 图像的高度。
+ * @param channels 图像的通道数。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param radius 模糊半径。
+ * @param border 图像边界外像素的取值方式。
+ * @param dst 输出区域左上角像素的地址，传NULL表示原地写回 data。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int blur_roi(unsigned char *data,
+             int width,
+             int height,
+             int channels,
+             int stride,
+             image_rect_t roi,
+             int radius,
+             border_mode_t border,
+             unsigned char *dst,
+             int dst_stride)
+{
+    if (data == NULL || channels <= 0 || radius <= 0 || !image_rect_clip(&roi, width, height)) {
+        return 0;
+    }
+    if (dst == NULL) {
+        dst = data + (size_t)roi.y * stride + (size_t)roi.x * channels;
+        dst_stride = stride;
+    }
 
-    // 高斯模糊的核心大小 = 2 * radius + 1
-    int kernel_size = 2 * radius + 1;
+    // 只读取处理区域加上四周 radius 像素的光晕，工作量随区域大小而不是整幅图像增长
+    // 环绕模式在图像边缘需要对侧的像素，因此读取整幅图像
+    image_rect_t halo = {roi.x - radius, roi.y - radius, roi.w + 2 * radius, roi.h + 2 * radius};
+    if (border == BORDER_WRAP) {
+        halo = (image_rect_t){0, 0, width, height};
+    }
+    image_rect_clip(&halo, width, height);
 
-    // 计算高斯权重
-    // 分配权重数组
-    float *kernel = (float *)malloc(kernel_size * kernel_size * sizeof(float));
+    // 高斯核可分离，卷积引擎按横、纵两遍一维卷积计算
+    conv_kernel_t *kernel = conv_kernel_gaussian(radius);
     if (kernel == NULL) {
-        free(temp);
-        return;
+        return 0;
     }
 
-    // 设置标准差 sigma
-    float sigma = radius / 2.0f;
-    float sigma2 = 2.0f * sigma * sigma;
-    float sigma2_pi = sigma2 * M_PI;
-    float sum = 0.0f; // 用于归一化
-
-    // 计算高斯核权重
-    for (int y = -radius; y <= radius; y++) {
-        for (int x = -radius; x <= radius; x++) {
-            // 高斯函数: G(x,y) = (1/(2*π*σ^2)) * e^(-(x^2+y^2)/(2*σ^2))
-            float weight = exp(-(x * x + y * y) / sigma2) / sigma2_pi;
-            int idx = (y + radius) * kernel_size + (x + radius);
-            kernel[idx] = weight;
-            sum += weight;
-        }
+    // 光晕平面只在图像边界处被裁剪，引擎在平面边缘按边界模式取值即等价于在图像边界处取值
+    image_rect_t out_rect = {roi.x - halo.x, roi.y - halo.y, roi.w, roi.h};
+    if (channels > IMAGE_MAX_CHANNELS) {
+        int ok = blur_channels_one_by_one(data, channels, stride, halo, out_rect, kernel, border, dst, dst_stride);
+        conv_kernel_free(kernel);
+        return ok;
     }
 
-    // 归一化核，使权重和为1
-    for (int i = 0; i < kernel_size * kernel_size; i++) {
-        kernel[i] /= sum;
-    }
-
-    // 遍历所有像素
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            // 对每个通道分别计算高斯模糊值
-            for (int c = 0; c < channels; c++) {
-                float sum = 0.0f;
-
-                // 应用高斯核
-                for (int ky = -radius; ky <= radius; ky++) {
-                    for (int kx = -radius; kx <= radius; kx++) {
-                        // 计算相邻像素坐标
-                        int nx = x + kx;
-                        int ny = y + ky;
-
-                        // 边界检查 - 使用边界钳制方法
-                        if (nx < 0)
-                            nx = 0;
-                        if (nx >= width)
-                            nx = width - 1;
-                        if (ny < 0)
-                            ny = 0;
-                        if (ny >= height)
-                            ny = height - 1;
-
-                        // 获取相邻像素值并根据权重累加
-                        int kernel_idx = (ky + radius) * kernel_size + (kx + radius);
-                        sum += temp[(ny * width + nx) * channels + c] * kernel[kernel_idx];
-                    }
-                }
-
-                // 设置到目标像素
-                data[(y * width + x) * channels + c] = (unsigned char)(sum + 0.5f); // 四舍五入
-            }
-        }
+    // 拆分为独立的通道平面，使内层循环在连续内存上按步长1访问
+    // 平面是源数据的副本，因此原地写回也不会影响尚未处理的像素
+    image_buffer_t interleaved, planes;
+    image_buffer_wrap(&interleaved, data, width, height, channels, stride);
+    image_buffer_t halo_view;
+    image_buffer_view(&interleaved, halo.x, halo.y, halo.w, halo.h, &halo_view);
+    if (!image_buffer_to_planar(&halo_view, &planes)) {
+        // 内存分配失败
+        conv_kernel_free(kernel);
+        return 0;
+    }
+
+    int ok = 1;
+    for (int c = 0; c < channels && ok; c++) {
+        unsigned char *out_plane = planes.planes[c] + (size_t)out_rect.y * planes.stride + out_rect.x;
+        ok = convolve_plane(
+            planes.planes[c], planes.stride, halo.w, halo.h, kernel, border, 0, out_rect, out_plane, planes.stride);
+    }
+
+    // 合并回交错布局的输出区域
+    if (ok) {
+        image_buffer_t result, out;
+        image_buffer_view(&planes, out_rect.x, out_rect.y, roi.w, roi.h, &result);
+        image_buffer_wrap(&out, dst, roi.w, roi.h, channels, dst_stride);
+        image_buffer_to_interleaved(&result, &out);
     }
 
     // 释放内存
-    free(kernel);
-    free(temp);
+    conv_kernel_free(kernel);
+    image_buffer_free(&planes);
+    return ok;
 }
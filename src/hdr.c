@@ -0,0 +1,713 @@
+#include "hdr.h"
+#include "checksum.h"
+#include "convolve.h"
+#include "edge.h"
+#include "histogram.h"
+#include "image.h"
+#include "log.h"
+#include "stb_image.h"
+#include "stb_image_write.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HDR_HAVE_X86_SIMD 1
+#endif
+
+// stb_image_write 的 zlib 压缩在 image.c 中编译，头文件没有声明
+unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+// 16位PNG的 zlib 压缩级别，与 stb_image_write 的默认值相同
+#define HDR_PNG_COMPRESSION 8
+
+/**
+ * @brief 判断文件是否是高位深图像（16位PNG/PSD/PNM 或 HDR）。
+ * @param path 图像文件的路径。
+ * @return 是返回1，否则返回0。
+ */
+int hdr_is_high_bit_depth(const char *path)
+{
+    return path && (stbi_is_hdr(path) || stbi_is_16_bit(path));
+}
+
+/**
+ * @brief 按位深解码文件（path 非NULL）或内存中的编码数据，统一转换为 float。
+ * @return 成功返回1，失败返回0（原因见 stbi_failure_reason）。
+ */
+static int hdr_decode(const char *path, const unsigned char *buffer, int size, hdr_image_t *img)
+{
+    memset(img, 0, sizeof(*img));
+
+    int w, h, c;
+    if (path ? stbi_is_hdr(path) : stbi_is_hdr_from_memory(buffer, size)) {
+        img->data = path ? stbi_loadf(path, &w, &h, &c, 0) : stbi_loadf_from_memory(buffer, size, &w, &h, &c, 0);
+        img->bit_depth = 32;
+    }
+    else if (path ? stbi_is_16_bit(path) : stbi_is_16_bit_from_memory(buffer, size)) {
+        unsigned short *raw =
+            path ? stbi_load_16(path, &w, &h, &c, 0) : stbi_load_16_from_memory(buffer, size, &w, &h, &c, 0);
+        if (raw) {
+            size_t count = (size_t)w * h * c;
+            img->data = (float *)malloc(count * sizeof(float));
+            for (size_t i = 0; img->data && i < count; i++)
+                img->data[i] = raw[i] * (1.0f / 65535.0f);
+            stbi_image_free(raw);
+        }
+        img->bit_depth = 16;
+    }
+    else {
+        unsigned char *raw =
+            path ? stbi_load(path, &w, &h, &c, 0) : stbi_load_from_memory(buffer, size, &w, &h, &c, 0);
+        if (raw) {
+            size_t count = (size_t)w * h * c;
+            img->data = (float *)malloc(count * sizeof(float));
+            for (size_t i = 0; img->data && i < count; i++)
+                img->data[i] = raw[i] * (1.0f / 255.0f);
+            stbi_image_free(raw);
+        }
+        img->bit_depth = 8;
+    }
+
+    if (!img->data)
+        return 0;
+    img->width = w;
+    img->height = h;
+    img->channels = c;
+    return 1;
+}
+
+/**
+ * @brief 按源文件的位深加载图像：HDR 用 stbi_loadf，16位用 stbi_load_16，其余用 stbi_load，统一转换为 float。
+ * @param path 图像文件的路径。
+ * @param img 输出的图像，用 hdr_image_free 释放。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_load(const char *path, hdr_image_t *img)
+{
+    if (!path || !img) {
+        LOG_ERROR("Invalid parameters for hdr_image_load");
+        return 0;
+    }
+    if (!hdr_decode(path, NULL, 0, img)) {
+        LOG_ERROR("Error loading image '%s': %s", path, stbi_failure_reason());
+        return 0;
+    }
+
+    LOG_DEBUG("Successfully loaded image '%s' (%dx%d, %d channels, %s)",
+              path,
+              img->width,
+              img->height,
+              img->channels,
+              img->bit_depth == 32 ? "float" : (img->bit_depth == 16 ? "16-bit" : "8-bit"));
+    return 1;
+}
+
+/**
+ * @brief 判断内存中的编码数据是否是高位深图像（16位PNG/PSD/PNM 或 HDR），用于链式处理模式的标准输入。
+ * @param buffer 编码数据。
+ * @param size 数据的字节数。
+ * @return 是返回1，否则返回0。
+ */
+int hdr_is_high_bit_depth_from_memory(const unsigned char *buffer, size_t size)
+{
+    return buffer && size > 0 && size <= 0x7fffffff &&
+           (stbi_is_hdr_from_memory(buffer, (int)size) || stbi_is_16_bit_from_memory(buffer, (int)size));
+}
+
+/**
+ * @brief 按位深解码内存中的编码数据，同 hdr_image_load。
+ * @param buffer 编码数据（例如 read_stream 读到的标准输入）。
+ * @param size 数据的字节数。
+ * @param img 输出的图像，用 hdr_image_free 释放。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_load_from_memory(const unsigned char *buffer, size_t size, hdr_image_t *img)
+{
+    if (!buffer || size == 0 || size > 0x7fffffff || !img) {
+        LOG_ERROR("Invalid parameters for hdr_image_load_from_memory");
+        return 0;
+    }
+    if (!hdr_decode(NULL, buffer, (int)size, img)) {
+        LOG_ERROR("Error decoding image stream: %s", stbi_failure_reason());
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief 释放 hdr_image_load 加载的图像。
+ * @param img 图像。
+ */
+void hdr_image_free(hdr_image_t *img)
+{
+    if (img) {
+        free(img->data);
+        img->data = NULL;
+    }
+}
+
+/**
+ * @brief 把一个值转换为 [0, 1] 内的显示值：HDR 的线性值先做伽马校正，再钳制。
+ */
+static float display_value(float v, int linear)
+{
+    if (linear && v > 0.0f)
+        v = powf(v, 1.0f / 2.2f);
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+static void put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/**
+ * @brief 写一个 PNG 块：长度、类型、数据和 CRC。
+ * @return 成功返回1，失败返回0。
+ */
+static int png_write_chunk(FILE *fp, const char *type, const unsigned char *data, size_t len)
+{
+    unsigned char header[8];
+    put_u32(header, (uint32_t)len);
+    memcpy(header + 4, type, 4);
+
+    uint32_t crc = crc32_update(crc32_update(0, header + 4, 4), data, len);
+    unsigned char trailer[4];
+    put_u32(trailer, crc);
+
+    return fwrite(header, 1, 8, fp) == 8 && (len == 0 || fwrite(data, 1, len, fp) == len) &&
+           fwrite(trailer, 1, 4, fp) == 4;
+}
+
+/**
+ * @brief 把16位PNG写到流。每行使用 Sub 滤波（按字节与左侧像素求差），再用 stb_image_write 的 zlib 压缩。
+ * @return 成功返回1，失败返回0。
+ */
+static int write_png16(FILE *fp, const hdr_image_t *img)
+{
+    static const unsigned char color_types[] = {0, 0, 4, 2, 6}; // 按通道数：灰度、灰度+Alpha、RGB、RGBA
+    int w = img->width, h = img->height, c = img->channels;
+    if (c < 1 || c > 4) {
+        LOG_ERROR("16-bit PNG supports 1-4 channels, got %d", c);
+        return 0;
+    }
+
+    size_t row_bytes = (size_t)w * c * 2;
+    size_t filtered_size = (row_bytes + 1) * h;
+    if (filtered_size > 0x7fffffff) {
+        LOG_ERROR("Image too large for 16-bit PNG output");
+        return 0;
+    }
+
+    unsigned char *filtered = (unsigned char *)malloc(filtered_size);
+    unsigned char *raw = (unsigned char *)malloc(row_bytes);
+    if (!filtered || !raw) {
+        LOG_ERROR("Memory allocation failed for PNG encoding");
+        free(filtered);
+        free(raw);
+        return 0;
+    }
+
+    int linear = img->bit_depth == 32;
+    int bpp = c * 2;
+    for (int y = 0; y < h; y++) {
+        const float *src = img->data + (size_t)y * w * c;
+        for (int i = 0; i < w * c; i++) {
+            unsigned int v = (unsigned int)(display_value(src[i], linear) * 65535.0f + 0.5f);
+            raw[2 * i] = (unsigned char)(v >> 8); // PNG 的16位样本是大端序
+            raw[2 * i + 1] = (unsigned char)v;
+        }
+
+        unsigned char *out = filtered + (size_t)y * (row_bytes + 1);
+        out[0] = 1; // Sub 滤波
+        for (size_t i = 0; i < row_bytes; i++)
+            out[1 + i] = (unsigned char)(raw[i] - (i >= (size_t)bpp ? raw[i - bpp] : 0));
+    }
+    free(raw);
+
+    int zlen = 0;
+    unsigned char *zdata = stbi_zlib_compress(filtered, (int)filtered_size, &zlen, HDR_PNG_COMPRESSION);
+    free(filtered);
+    if (!zdata) {
+        LOG_ERROR("PNG compression failed");
+        return 0;
+    }
+
+    unsigned char ihdr[13];
+    put_u32(ihdr, (uint32_t)w);
+    put_u32(ihdr + 4, (uint32_t)h);
+    ihdr[8] = 16;             // 位深
+    ihdr[9] = color_types[c]; // 颜色类型
+    ihdr[10] = 0;             // 压缩方式
+    ihdr[11] = 0;             // 滤波方式
+    ihdr[12] = 0;             // 不隔行
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    int ok = fwrite(signature, 1, 8, fp) == 8 && png_write_chunk(fp, "IHDR", ihdr, sizeof(ihdr)) &&
+             png_write_chunk(fp, "IDAT", zdata, (size_t)zlen) && png_write_chunk(fp, "IEND", NULL, 0);
+    free(zdata);
+    return ok;
+}
+
+/**
+ * @brief 把图像量化为8位，整数格式的输出共用：HDR 源图像的线性值先做伽马校正。
+ * @return 8位像素（用 free 释放），内存不足时返回NULL。
+ */
+static unsigned char *to_8bit(const hdr_image_t *img)
+{
+    size_t count = (size_t)img->width * img->height * img->channels;
+    unsigned char *bytes = (unsigned char *)malloc(count);
+    if (!bytes) {
+        LOG_ERROR("Memory allocation failed for 8-bit conversion");
+        return NULL;
+    }
+    int linear = img->bit_depth == 32;
+    for (size_t i = 0; i < count; i++)
+        bytes[i] = (unsigned char)(display_value(img->data[i], linear) * 255.0f + 0.5f);
+    return bytes;
+}
+
+/**
+ * @brief 保存图像，格式由扩展名决定：.png 写16位PNG，.hdr 写 Radiance HDR，其余格式量化到8位后用 save_image 保存。
+ * @param path 保存路径。
+ * @param img 图像。
+ * @param quality JPEG质量参数 (1-100)，仅对JPEG格式有效。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_save(const char *path, const hdr_image_t *img, int quality)
+{
+    if (!path || !img || !img->data || img->width <= 0 || img->height <= 0 || img->channels <= 0) {
+        LOG_ERROR("Invalid parameters for hdr_image_save");
+        return 0;
+    }
+
+    const char *ext = strrchr(path, '.');
+    if (ext && strcmp(ext, ".hdr") == 0) {
+        if (!stbi_write_hdr(path, img->width, img->height, img->channels, img->data)) {
+            LOG_ERROR("Error saving image to '%s'", path);
+            return 0;
+        }
+    }
+    else if (ext && strcmp(ext, ".png") == 0) {
+        FILE *fp = fopen(path, "wb");
+        int ok = fp && write_png16(fp, img);
+        if (fp && fclose(fp) != 0)
+            ok = 0;
+        if (!ok) {
+            LOG_ERROR("Error saving image to '%s'", path);
+            return 0;
+        }
+    }
+    else {
+        // 其余格式只支持8位
+        unsigned char *bytes = to_8bit(img);
+        if (!bytes)
+            return 0;
+        int ok = save_image(path, bytes, img->width, img->height, img->channels, quality);
+        free(bytes);
+        return ok;
+    }
+
+    LOG_DEBUG("Successfully saved image to '%s'", path);
+    return 1;
+}
+
+/**
+ * @brief 把图像编码写到流（链式处理模式写标准输出）："png" 写16位PNG，其余格式（见 write_image_to_stream）
+ *        量化到8位后写出。
+ * @param fp 输出流，应以二进制模式打开。
+ * @param format 输出格式："png"、"jpg"、"bmp" 或 "tga"。
+ * @param img 图像。
+ * @param quality JPEG质量参数 (1-100)，仅对JPEG格式有效。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_image_write_to_stream(FILE *fp, const char *format, const hdr_image_t *img, int quality)
+{
+    if (!fp || !format || !img || !img->data || img->width <= 0 || img->height <= 0 || img->channels <= 0) {
+        LOG_ERROR("Invalid parameters for hdr_image_write_to_stream");
+        return 0;
+    }
+
+    if (strcmp(format, "png") == 0) {
+        if (!write_png16(fp, img) || fflush(fp) != 0) {
+            LOG_ERROR("Error writing encoded image to stream");
+            return 0;
+        }
+        return 1;
+    }
+    unsigned char *bytes = to_8bit(img);
+    if (!bytes)
+        return 0;
+    int ok = write_image_to_stream(fp, format, bytes, img->width, img->height, img->channels, quality);
+    free(bytes);
+    return ok;
+}
+
+/**
+ * @brief acc[i] += w * src[i]，模糊和边缘检测的内层循环。
+ */
+#ifdef HDR_HAVE_X86_SIMD
+__attribute__((target("sse2")))
+#endif
+static void span_axpy(float *acc, const float *src, float w, int n)
+{
+    int x = 0;
+#ifdef HDR_HAVE_X86_SIMD
+    __m128 vw = _mm_set1_ps(w);
+    for (; x + 4 <= n; x += 4) {
+        __m128 v = _mm_mul_ps(vw, _mm_loadu_ps(src + x));
+        _mm_storeu_ps(acc + x, _mm_add_ps(_mm_loadu_ps(acc + x), v));
+    }
+#endif
+    for (; x < n; x++)
+        acc[x] += w * src[x];
+}
+
+/**
+ * @brief v[i] = 1 - v[i]。
+ */
+#ifdef HDR_HAVE_X86_SIMD
+__attribute__((target("sse2")))
+#endif
+static void span_invert(float *v, size_t n)
+{
+    size_t i = 0;
+#ifdef HDR_HAVE_X86_SIMD
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(v + i, _mm_sub_ps(one, _mm_loadu_ps(v + i)));
+#endif
+    for (; i < n; i++)
+        v[i] = 1.0f - v[i];
+}
+
+/**
+ * @brief 灰度化（与8位版本相同的亮度公式），Alpha 通道保持不变。
+ * @param img 图像。
+ */
+void hdr_grayscale(hdr_image_t *img)
+{
+    if (!img || !img->data || img->channels < 3)
+        return; // 不足三个通道的图像已经是灰度图
+
+    int c = img->channels;
+    size_t pixel_count = (size_t)img->width * img->height;
+    for (size_t i = 0; i < pixel_count; i++) {
+        float *p = img->data + i * c;
+        float gray = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+        p[0] = gray;
+        p[1] = gray;
+        p[2] = gray;
+    }
+}
+
+/**
+ * @brief 反色 (1 - 值)，与8位版本一样只处理前三个通道。
+ * @param img 图像。
+ */
+void hdr_invert(hdr_image_t *img)
+{
+    if (!img || !img->data)
+        return;
+
+    int c = img->channels;
+    size_t pixel_count = (size_t)img->width * img->height;
+    if (c <= 3) {
+        // 所有通道都要反转，按连续数组处理
+        span_invert(img->data, pixel_count * c);
+        return;
+    }
+
+    for (size_t i = 0; i < pixel_count; i++) {
+        float *p = img->data + i * c;
+        p[0] = 1.0f - p[0];
+        p[1] = 1.0f - p[1];
+        p[2] = 1.0f - p[2];
+    }
+}
+
+/**
+ * @brief 上下翻转图像。
+ * @param img 图像。
+ */
+void hdr_rotate(hdr_image_t *img)
+{
+    if (!img || !img->data)
+        return;
+
+    size_t row = (size_t)img->width * img->channels;
+    float *temp = (float *)malloc(row * sizeof(float));
+    if (!temp)
+        return;
+    for (int y = 0; y < img->height / 2; y++) {
+        float *top = img->data + (size_t)y * row;
+        float *bottom = img->data + (size_t)(img->height - 1 - y) * row;
+        memcpy(temp, top, row * sizeof(float));
+        memcpy(top, bottom, row * sizeof(float));
+        memcpy(bottom, temp, row * sizeof(float));
+    }
+    free(temp);
+}
+
+/**
+ * @brief 高斯模糊，权重与8位版本相同（conv_kernel_gaussian），边界按 BORDER_CLAMP 处理。
+ * @param img 图像。
+ * @param radius 模糊半径。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_blur(hdr_image_t *img, int radius)
+{
+    if (!img || !img->data || radius <= 0)
+        return 0;
+
+    conv_kernel_t *kernel = conv_kernel_gaussian(radius);
+    if (!kernel)
+        return 0;
+
+    int w = img->width, h = img->height, c = img->channels;
+    int taps = kernel->size;
+    int r = kernel->radius;
+    const float *weights = kernel->row;
+
+    // 一个通道平面、横向结果平面、填充后的行和纵向累加行
+    float *plane = (float *)malloc((size_t)w * h * sizeof(float));
+    float *horiz = (float *)malloc((size_t)w * h * sizeof(float));
+    float *padded = (float *)malloc((size_t)(w + 2 * r) * sizeof(float));
+    float *acc = (float *)malloc((size_t)w * sizeof(float));
+    if (!plane || !horiz || !padded || !acc) {
+        LOG_ERROR("Memory allocation failed for blur");
+        free(plane);
+        free(horiz);
+        free(padded);
+        free(acc);
+        conv_kernel_free(kernel);
+        return 0;
+    }
+
+    for (int ch = 0; ch < c; ch++) {
+        for (size_t i = 0; i < (size_t)w * h; i++)
+            plane[i] = img->data[i * c + ch];
+
+        // 横向：每个抽头对整行做一次向量化的乘加
+        for (int y = 0; y < h; y++) {
+            const float *row = plane + (size_t)y * w;
+            for (int i = 0; i < w + 2 * r; i++) {
+                int x = i - r;
+                padded[i] = row[x < 0 ? 0 : (x >= w ? w - 1 : x)];
+            }
+            float *out = horiz + (size_t)y * w;
+            memset(out, 0, (size_t)w * sizeof(float));
+            for (int k = 0; k < taps; k++)
+                span_axpy(out, padded + k, weights[k], w);
+        }
+
+        // 纵向：按行累加，所有访问都是连续的
+        for (int y = 0; y < h; y++) {
+            memset(acc, 0, (size_t)w * sizeof(float));
+            for (int k = 0; k < taps; k++) {
+                int sy = y + k - r;
+                sy = sy < 0 ? 0 : (sy >= h ? h - 1 : sy);
+                span_axpy(acc, horiz + (size_t)sy * w, weights[k], w);
+            }
+            float *dst = img->data + (size_t)y * w * c + ch;
+            for (int x = 0; x < w; x++)
+                dst[(size_t)x * c] = acc[x];
+        }
+    }
+
+    free(plane);
+    free(horiz);
+    free(padded);
+    free(acc);
+    conv_kernel_free(kernel);
+    return 1;
+}
+
+/**
+ * @brief 计算一行的 Sobel 梯度幅值（按8位尺度 ×255）。r0/r1/r2 是填充后的上、中、下三行，各比输出多2个元素。
+ */
+#ifdef HDR_HAVE_X86_SIMD
+__attribute__((target("sse2")))
+#endif
+static void sobel_row(const float *r0, const float *r1, const float *r2, float *out, int n)
+{
+    int x = 0;
+#ifdef HDR_HAVE_X86_SIMD
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    for (; x + 4 <= n; x += 4) {
+        __m128 a0 = _mm_loadu_ps(r0 + x), a1 = _mm_loadu_ps(r0 + x + 1), a2 = _mm_loadu_ps(r0 + x + 2);
+        __m128 b0 = _mm_loadu_ps(r1 + x), b2 = _mm_loadu_ps(r1 + x + 2);
+        __m128 c0 = _mm_loadu_ps(r2 + x), c1 = _mm_loadu_ps(r2 + x + 1), c2 = _mm_loadu_ps(r2 + x + 2);
+        __m128 gx = _mm_add_ps(_mm_add_ps(_mm_sub_ps(a2, a0), _mm_sub_ps(c2, c0)), _mm_mul_ps(two, _mm_sub_ps(b2, b0)));
+        __m128 gy = _mm_add_ps(_mm_add_ps(_mm_sub_ps(c0, a0), _mm_sub_ps(c2, a2)), _mm_mul_ps(two, _mm_sub_ps(c1, a1)));
+        __m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+        _mm_storeu_ps(out + x, _mm_mul_ps(mag, scale));
+    }
+#endif
+    for (; x < n; x++) {
+        float gx = (r0[x + 2] - r0[x]) + (r2[x + 2] - r2[x]) + 2.0f * (r1[x + 2] - r1[x]);
+        float gy = (r2[x] - r0[x]) + (r2[x + 2] - r0[x + 2]) + 2.0f * (r2[x + 1] - r0[x + 1]);
+        out[x] = sqrtf(gx * gx + gy * gy) * 255.0f;
+    }
+}
+
+/**
+ * @brief 反射边界（不重复边缘像素），与卷积引擎的 BORDER_REFLECT 一致；只处理越界1像素。
+ */
+static int reflect1(int i, int n)
+{
+    if (n == 1)
+        return 0;
+    return i < 0 ? 1 : (i >= n ? n - 2 : i);
+}
+
+/**
+ * @brief 在 float 亮度上做 Sobel 边缘检测和滞后阈值，结果写回图像（边缘为1，其余为0）。
+ * @param img 图像。
+ * @param threshold 阈值 (0-255)，或 EDGE_THRESHOLD_OTSU / EDGE_THRESHOLD_PERCENTILE。
+ * @return 成功返回1，失败返回0。
+ */
+int hdr_edge_detect(hdr_image_t *img, int threshold)
+{
+    if (!img || !img->data)
+        return 0;
+
+    if (threshold < EDGE_THRESHOLD_PERCENTILE)
+        threshold = 0;
+    if (threshold > 255)
+        threshold = 255;
+
+    int w = img->width, h = img->height, c = img->channels;
+    int pw = w + 2;
+
+    // 亮度平面四周各填充1像素；梯度幅值图四周各多1像素并保持为0，滞后阈值检查邻域时无需判断越界
+    float *luma = (float *)malloc((size_t)pw * (h + 2) * sizeof(float));
+    float *magnitude_data = (float *)calloc((size_t)pw * (h + 2), sizeof(float));
+    if (!luma || !magnitude_data) {
+        LOG_ERROR("Memory allocation failed for edge detection");
+        free(luma);
+        free(magnitude_data);
+        return 0;
+    }
+    float *magnitude = magnitude_data + pw + 1;
+
+    for (int y = 0; y < h + 2; y++) {
+        const float *row = img->data + (size_t)reflect1(y - 1, h) * w * c;
+        float *out = luma + (size_t)y * pw;
+        for (int x = 0; x < pw; x++) {
+            const float *p = row + (size_t)reflect1(x - 1, w) * c;
+            out[x] = c >= 3 ? 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] : p[0];
+        }
+    }
+
+    for (int y = 0; y < h; y++) {
+        const float *r0 = luma + (size_t)y * pw;
+        sobel_row(r0, r0 + pw, r0 + 2 * pw, magnitude + (size_t)y * pw, w);
+    }
+    free(luma);
+
+    // 自动阈值：对量化到 0-255 的梯度幅值直方图使用与8位版本相同的方法
+    if (threshold < 0) {
+        unsigned int hist[256] = {0};
+        for (int y = 0; y < h; y++) {
+            const float *m = magnitude + (size_t)y * pw;
+            for (int x = 0; x < w; x++)
+                hist[m[x] >= 255.0f ? 255 : (int)m[x]]++;
+        }
+        threshold = (threshold == EDGE_THRESHOLD_OTSU) ? histogram_otsu_threshold(hist)
+                                                        : histogram_percentile(hist, EDGE_AUTO_PERCENTILE);
+        if (threshold < 1)
+            threshold = 1;
+    }
+
+    float high_threshold = (float)threshold;
+    float low_threshold = threshold / 2.0f;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const float *m = magnitude + (size_t)y * pw + x;
+            int is_edge = *m > high_threshold;
+
+            // 弱边缘只在8邻域存在强边缘时保留
+            if (!is_edge && *m > low_threshold) {
+                for (int ny = -1; ny <= 1 && !is_edge; ny++) {
+                    for (int nx = -1; nx <= 1; nx++) {
+                        if ((nx || ny) && m[ny * pw + nx] > high_threshold) {
+                            is_edge = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            float *p = img->data + ((size_t)y * w + x) * c;
+            for (int ch = 0; ch < c; ch++)
+                p[ch] = is_edge ? 1.0f : 0.0f;
+        }
+    }
+
+    free(magnitude_data);
+    LOG_DEBUG("Sobel edge detection (float) with hysteresis completed (threshold: %d)", threshold);
+    return 1;
+}
+
+/**
+ * @brief 按顺序应用效果链。支持 grayscale、invert、blur、rotate 和 edge（只支持默认的边界模式），其余效果报错。
+ * @param img 图像。
+ * @param ops 操作数组。
+ * @param count 操作个数。
+ * @return 全部成功返回1，任一失败返回0。
+ */
+int hdr_apply_effects(hdr_image_t *img, const effect_op_t *ops, int count)
+{
+    if (!img || !img->data || !ops)
+        return 0;
+
+    for (int i = 0; i < count; i++) {
+        // 浮点版本的模糊固定按 BORDER_CLAMP、边缘检测固定按 BORDER_REFLECT 处理边界
+        border_mode_t border = ops[i].type == EFFECT_EDGE ? BORDER_REFLECT : BORDER_CLAMP;
+        if ((ops[i].type == EFFECT_BLUR || ops[i].type == EFFECT_EDGE) && ops[i].border != border) {
+            LOG_ERROR("Border modes other than the default are not supported for high bit depth images");
+            return 0;
+        }
+
+        int ok = 1;
+        switch (ops[i].type) {
+        case EFFECT_GRAYSCALE:
+            hdr_grayscale(img);
+            break;
+        case EFFECT_INVERT:
+            hdr_invert(img);
+            break;
+        case EFFECT_ROTATE:
+            hdr_rotate(img);
+            break;
+        case EFFECT_BLUR:
+            ok = hdr_blur(img, ops[i].param);
+            break;
+        case EFFECT_EDGE:
+            if (ops[i].param2 > 0) {
+                LOG_ERROR("Median pre-filter is not supported for high bit depth images");
+                return 0;
+            }
+            ok = hdr_edge_detect(img, ops[i].param);
+            break;
+        default:
+            LOG_ERROR("Effect '%s' is not supported for high bit depth images", effect_name(ops[i].type));
+            return 0;
+        }
+        if (!ok) {
+            LOG_ERROR("Effect '%s' failed", effect_name(ops[i].type));
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,252 @@
+#include "histogram.h"
+#include "parallel.h"
+#include <stdlib.h> // For calloc and free
+#include <string.h> // For memset
+
+/**
+ * @brief 把一段8位数据累加到直方图中。
+ * @param values 数据。
+ * @param count 数据个数。
+ * @param hist 累加目标（不清零）。
+ */
+void histogram_accumulate(const unsigned char *values, size_t count, unsigned int hist[256])
+{
+    if (!values || !hist)
+        return;
+
+    // 4份子直方图轮流计数，打断同一计数器上的读-改-写依赖链
+    unsigned int sub[4][256];
+    memset(sub, 0, sizeof(sub));
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        sub[0][values[i]]++;
+        sub[1][values[i + 1]]++;
+        sub[2][values[i + 2]]++;
+        sub[3][values[i + 3]]++;
+    }
+    for (; i < count; i++) {
+        sub[0][values[i]]++;
+    }
+
+    for (int v = 0; v < 256; v++) {
+        hist[v] += sub[0][v] + sub[1][v] + sub[2][v] + sub[3][v];
+    }
+}
+
+// 并行统计的上下文，每个行块有自己的私有直方图
+typedef struct
+{
+    const unsigned char *data;
+    int width;
+    int height;
+    int channels;
+    int blocks;              // 行块数
+    image_stats_t *partials; // 每个行块的部分结果
+} stats_job_t;
+
+/**
+ * @brief 统计 [begin, end) 号行块：同一遍扫描中得到亮度和各通道的直方图。
+ */
+static void stats_block_range(void *ctx, int begin, int end)
+{
+    const stats_job_t *job = (const stats_job_t *)ctx;
+    int ch = job->channels;
+    size_t row_bytes = (size_t)job->width * ch;
+
+    // 亮度按行先写入小缓冲区，再用交替子直方图统计
+    unsigned char *luma_row = (unsigned char *)malloc(job->width);
+    // 各通道同样用4份子直方图交替计数
+    unsigned int (*sub)[4][256] = calloc(ch, sizeof(*sub));
+    if (!luma_row || !sub) {
+        free(luma_row);
+        free(sub);
+        return;
+    }
+
+    for (int b = begin; b < end; b++) {
+        image_stats_t *part = &job->partials[b];
+        int y0 = (int)((long long)job->height * b / job->blocks);
+        int y1 = (int)((long long)job->height * (b + 1) / job->blocks);
+
+        for (int y = y0; y < y1; y++) {
+            const unsigned char *row = job->data + (size_t)y * row_bytes;
+
+            for (int x = 0; x < job->width; x++) {
+                const unsigned char *p = row + (size_t)x * ch;
+                for (int c = 0; c < ch; c++) {
+                    sub[c][x & 3][p[c]]++;
+                }
+                if (ch >= 3) {
+                    // 16位定点的 0.299/0.587/0.114，权重和为65536
+                    luma_row[x] = (unsigned char)((19595u * p[0] + 38470u * p[1] + 7471u * p[2]) >> 16);
+                }
+                else {
+                    luma_row[x] = p[0];
+                }
+            }
+            histogram_accumulate(luma_row, job->width, part->luma);
+        }
+
+        for (int c = 0; c < ch; c++) {
+            for (int v = 0; v < 256; v++) {
+                part->channel[c][v] = sub[c][0][v] + sub[c][1][v] + sub[c][2][v] + sub[c][3][v];
+            }
+        }
+        memset(sub, 0, ch * sizeof(*sub));
+    }
+
+    free(luma_row);
+    free(sub);
+}
+
+/**
+ * @brief 从直方图求最小值、最大值和均值。
+ */
+static void summarize_histogram(
+    const unsigned int hist[256], size_t total, unsigned char *min_value, unsigned char *max_value, double *mean)
+{
+    int lo = 0, hi = 255;
+    while (lo < 255 && hist[lo] == 0)
+        lo++;
+    while (hi > 0 && hist[hi] == 0)
+        hi--;
+
+    double sum = 0.0;
+    for (int v = 0; v < 256; v++) {
+        sum += (double)v * hist[v];
+    }
+
+    *min_value = (unsigned char)(lo <= hi ? lo : 0);
+    *max_value = (unsigned char)(lo <= hi ? hi : 0);
+    *mean = total ? sum / total : 0.0;
+}
+
+/**
+ * @brief 单遍计算图像的全部统计信息，按行分块并行，每个线程使用私有直方图，最后归并。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数 (1-4)。
+ * @param stats 输出的统计信息。
+ * @return 成功返回1，失败返回0。
+ */
+int compute_image_stats(const unsigned char *data, int width, int height, int channels, image_stats_t *stats)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || channels > 4 || !stats) {
+        return 0;
+    }
+
+    // 行块数与线程数相同，但每块至少32行，小图只用一个块
+    int blocks = parallel_thread_count();
+    if (blocks > height / 32)
+        blocks = height / 32;
+    if (blocks < 1)
+        blocks = 1;
+
+    image_stats_t *partials = (image_stats_t *)calloc(blocks, sizeof(image_stats_t));
+    if (!partials) {
+        return 0;
+    }
+
+    stats_job_t job = {data, width, height, channels, blocks, partials};
+    parallel_for(blocks, 1, stats_block_range, &job);
+
+    // 归并各行块的私有直方图
+    memset(stats, 0, sizeof(*stats));
+    stats->channels = channels;
+    stats->pixel_count = (size_t)width * height;
+    for (int b = 0; b < blocks; b++) {
+        for (int v = 0; v < 256; v++) {
+            stats->luma[v] += partials[b].luma[v];
+            for (int c = 0; c < channels; c++) {
+                stats->channel[c][v] += partials[b].channel[c][v];
+            }
+        }
+    }
+    free(partials);
+
+    summarize_histogram(stats->luma, stats->pixel_count, &stats->luma_min, &stats->luma_max, &stats->luma_mean);
+    for (int c = 0; c < channels; c++) {
+        summarize_histogram(stats->channel[c], stats->pixel_count, &stats->min[c], &stats->max[c], &stats->mean[c]);
+    }
+    return 1;
+}
+
+/**
+ * @brief 求直方图的百分位数。
+ * @param hist 直方图。
+ * @param percent 百分比 (0-100)。
+ * @return 累计计数首次达到 percent% 的取值。
+ */
+int histogram_percentile(const unsigned int hist[256], double percent)
+{
+    if (!hist)
+        return 0;
+
+    double total = 0.0;
+    for (int v = 0; v < 256; v++) {
+        total += hist[v];
+    }
+    if (total <= 0.0)
+        return 0;
+
+    if (percent < 0.0)
+        percent = 0.0;
+    if (percent > 100.0)
+        percent = 100.0;
+
+    double target = total * percent / 100.0;
+    double cumulative = 0.0;
+    for (int v = 0; v < 256; v++) {
+        cumulative += hist[v];
+        if (cumulative >= target && cumulative > 0.0) {
+            return v;
+        }
+    }
+    return 255;
+}
+
+/**
+ * @brief 用 Otsu 方法求使类间方差最大的二值化阈值。
+ * @param hist 直方图。
+ * @return 阈值 (0-255)，大于该值的属于前景。
+ */
+int histogram_otsu_threshold(const unsigned int hist[256])
+{
+    if (!hist)
+        return 0;
+
+    double total = 0.0, sum_all = 0.0;
+    for (int v = 0; v < 256; v++) {
+        total += hist[v];
+        sum_all += (double)v * hist[v];
+    }
+    if (total <= 0.0)
+        return 0;
+
+    double weight_bg = 0.0, sum_bg = 0.0;
+    double best_variance = -1.0;
+    int best = 0;
+
+    for (int t = 0; t < 256; t++) {
+        weight_bg += hist[t];
+        if (weight_bg == 0.0)
+            continue;
+        double weight_fg = total - weight_bg;
+        if (weight_fg == 0.0)
+            break;
+
+        sum_bg += (double)t * hist[t];
+        double mean_bg = sum_bg / weight_bg;
+        double mean_fg = (sum_all - sum_bg) / weight_fg;
+        double diff = mean_bg - mean_fg;
+        double variance = weight_bg * weight_fg * diff * diff;
+
+        if (variance > best_variance) {
+            best_variance = variance;
+            best = t;
+        }
+    }
+    return best;
+}
@@ -4,6 +4,9 @@
 #include "stb_image_write.h"
 
 #include "image.h"
+#include "pixel_cache.h"
+#include "pyramid.h"
+#include "log.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,26 +17,117 @@
  * @param width 指向存储图像宽度的变量的指针。
  * @param height 指向存储图像高度的变量的指针。
  * @param channels 指向存储图像通道数的变量的指针。
- * @return 成功返回图像数据指针，失败返回NULL。
+ * @return 成功返回图像数据指针（用 free_image 释放），失败返回NULL。
  */
 unsigned char *load_image(const char *path, int *width, int *height, int *channels)
 {
     if (!path || !width || !height || !channels) {
-        fprintf(stderr, "Invalid parameters for load_image\n");
+        LOG_ERROR("Invalid parameters for load_image");
         return NULL;
     }
 
-    // 使用 stb_image 加载图像
-    unsigned char *data = stbi_load(path, width, height, channels, 0);
+    // 开启解码缓存时经缓存加载（命中时直接映射缓存文件），否则使用 stb_image 加载图像
+    unsigned char *data = pixel_cache_enabled() ? pixel_cache_load(path, width, height, channels)
+                                                : stbi_load(path, width, height, channels, 0);
     if (!data) {
-        fprintf(stderr, "Error loading image '%s': %s\n", path, stbi_failure_reason());
+        LOG_ERROR("Error loading image '%s': %s", path, stbi_failure_reason());
         return NULL;
     }
 
-    printf("Successfully loaded image '%s' (%dx%d, %d channels)\n", path, *width, *height, *channels);
+    LOG_DEBUG("Successfully loaded image '%s' (%dx%d, %d channels)", path, *width, *height, *channels);
     return data;
 }
 
+/**
+ * @brief 加载图像并缩小，适用于只需要缩略图或 ASCII 字符画的任务：解码后立即逐级做2x2盒式平均，
+ *        每缩小一级就释放上一级，之后的处理只涉及缩小后的像素。缩小到 factor 倍为止，
+ *        长边再缩小一级就会小于 min_size 时提前停止。
+ * @param path 图像文件的路径。
+ * @param factor 最大缩小倍数（1/2/4/8，其他值按不超过它的最大2的幂处理）。
+ * @param min_size 缩小后长边的下限（像素），0 表示不限制。
+ * @param pyramid 输出的金字塔：只有缩小到的那一层有数据，其余各层只记录尺寸（第0层为原图尺寸），
+ *                可以直接交给 *_pyramid 字符画函数和 pyramid_thumbnail。没有缩小时第0层是解码结果，
+ *                需要用 free_image 释放；之后用 pyramid_free 释放其余各层。
+ * @return 成功返回1，失败返回0。
+ */
+int load_image_reduced(const char *path, int factor, int min_size, image_pyramid_t *pyramid)
+{
+    if (!pyramid)
+        return 0;
+    memset(pyramid, 0, sizeof(*pyramid));
+
+    int width, height, channels;
+    unsigned char *data = load_image(path, &width, &height, &channels);
+    if (!data)
+        return 0;
+    pyramid->channels = channels;
+    pyramid->width[0] = width;
+    pyramid->height[0] = height;
+    pyramid->data[0] = data;
+    pyramid->levels = 1;
+
+    // stb_image 不支持解码阶段的DCT缩放，因此在解码后立即缩小，
+    // 逐级缩小并尽早释放上一级，峰值内存只多出原图的1/4
+    for (int level = 1; level < PYRAMID_MAX_LEVELS && (1 << level) <= factor; level++) {
+        int pw = pyramid->width[level - 1];
+        int ph = pyramid->height[level - 1];
+        if ((pw < 2 && ph < 2) || ((pw > ph ? pw : ph) + 1) / 2 < min_size)
+            break;
+
+        unsigned char *reduced = downsample_2x(
+            pyramid->data[level - 1], pw, ph, channels, &pyramid->width[level], &pyramid->height[level]);
+        if (level == 1)
+            free_image(pyramid->data[0]);
+        else
+            free(pyramid->data[level - 1]);
+        pyramid->data[level - 1] = NULL;
+
+        if (!reduced) {
+            LOG_ERROR("Memory allocation failed while reducing '%s'", path);
+            pyramid_free(pyramid);
+            return 0;
+        }
+        pyramid->data[level] = reduced;
+        pyramid->levels = level + 1;
+    }
+
+    LOG_DEBUG("Reduced '%s' to %dx%d",
+              path,
+              pyramid->width[pyramid->levels - 1],
+              pyramid->height[pyramid->levels - 1]);
+    return 1;
+}
+
+/**
+ * @brief 释放 load_image 返回的图像数据：映射的缓存文件解除映射，其余用 stbi_image_free 释放。
+ * @param data 图像数据，可以为NULL。
+ */
+void free_image(unsigned char *data)
+{
+    if (!pixel_cache_release(data))
+        stbi_image_free(data);
+}
+
+/**
+ * @brief 调整 load_image 返回的图像数据的大小，语义同 realloc：映射的缓存文件复制到新分配的内存后解除映射。
+ * @param data 图像数据，可以为NULL。
+ * @param size 新的字节数。
+ * @return 成功返回新的图像数据（之后用 free_image 或 free 释放），失败返回NULL（原数据保持不变）。
+ */
+unsigned char *image_realloc(unsigned char *data, size_t size)
+{
+    size_t mapped = pixel_cache_mapped_size(data);
+    if (!mapped)
+        return (unsigned char *)realloc(data, size);
+
+    unsigned char *copy = (unsigned char *)malloc(size);
+    if (!copy)
+        return NULL;
+    memcpy(copy, data, mapped < size ? mapped : size);
+    pixel_cache_release(data);
+    return copy;
+}
+
 /**
  * @brief 将图像保存到指定路径。
  * @param path 保存图像文件的路径。
@@ -47,14 +141,14 @@ unsigned char *load_image(const char *path, int *width, int *height, int *channe
 int save_image(const char *path, unsigned char *data, int width, int height, int channels, int quality)
 {
     if (!path || !data || width <= 0 || height <= 0 || channels <= 0) {
-        fprintf(stderr, "Invalid parameters for save_image\n");
+        LOG_ERROR("Invalid parameters for save_image");
         return 0;
     }
 
     // 根据文件扩展名确定保存格式
     const char *ext = strrchr(path, '.');
     if (!ext) {
-        fprintf(stderr, "No file extension found in path '%s'\n", path);
+        LOG_ERROR("No file extension found in path '%s'", path);
         return 0;
     }
 
@@ -76,15 +170,163 @@ int save_image(const char *path, unsigned char *data, int width, int height, int
         result = stbi_write_tga(path, width, height, channels, data);
     }
     else {
-        fprintf(stderr, "Unsupported file format: %s\n", ext);
+        LOG_ERROR("Unsupported file format: %s", ext);
         return 0;
     }
 
     if (!result) {
-        fprintf(stderr, "Error saving image to '%s'\n", path);
+        LOG_ERROR("Error saving image to '%s'", path);
+        return 0;
+    }
+
+    LOG_DEBUG("Successfully saved image to '%s'", path);
+    return 1;
+}
+/**
+ * @brief 把整个输入流（如标准输入）读入内存。流的长度事先未知，按倍增方式读入。
+ * @param fp 输入流，应以二进制模式打开。
+ * @param size 指向存储读到的字节数的变量的指针。
+ * @return 成功返回数据（用 free 释放），读取失败、流为空或超过 2GB 时返回NULL。
+ */
+unsigned char *read_stream(FILE *fp, size_t *size)
+{
+    if (!fp || !size) {
+        LOG_ERROR("Invalid parameters for read_stream");
+        return NULL;
+    }
+
+    // 流的长度事先未知，按倍增方式读入内存
+    size_t capacity = 1 << 20;
+    size_t used = 0;
+    unsigned char *buffer = (unsigned char *)malloc(capacity);
+    while (buffer) {
+        used += fread(buffer + used, 1, capacity - used, fp);
+        if (used < capacity)
+            break;
+        unsigned char *grown = (unsigned char *)realloc(buffer, capacity * 2);
+        if (!grown) {
+            free(buffer);
+            buffer = NULL;
+            break;
+        }
+        buffer = grown;
+        capacity *= 2;
+    }
+    if (!buffer) {
+        LOG_ERROR("Memory allocation failed while reading image stream");
+        return NULL;
+    }
+    if (ferror(fp) || used == 0 || used > 0x7fffffff) {
+        LOG_ERROR("Error reading image stream");
+        free(buffer);
+        return NULL;
+    }
+    *size = used;
+    return buffer;
+}
+
+/**
+ * @brief 从内存中的编码数据解码8位图像。
+ * @param buffer 编码数据（例如 read_stream 读到的内容）。
+ * @param size 数据的字节数。
+ * @param width 指向存储图像宽度的变量的指针。
+ * @param height 指向存储图像高度的变量的指针。
+ * @param channels 指向存储图像通道数的变量的指针。
+ * @return 成功返回图像数据指针（用 stbi_image_free 或 free 释放），失败返回NULL。
+ */
+unsigned char *load_image_from_memory(const unsigned char *buffer, size_t size, int *width, int *height, int *channels)
+{
+    if (!buffer || size == 0 || size > 0x7fffffff || !width || !height || !channels) {
+        LOG_ERROR("Invalid parameters for load_image_from_memory");
+        return NULL;
+    }
+    unsigned char *data = stbi_load_from_memory(buffer, (int)size, width, height, channels, 0);
+    if (!data) {
+        LOG_ERROR("Error decoding image stream: %s", stbi_failure_reason());
+        return NULL;
+    }
+    return data;
+}
+
+/**
+ * @brief 读取整个输入流（如标准输入）并从内存解码图像。
+ * @param fp 输入流，应以二进制模式打开。
+ * @param width 指向存储图像宽度的变量的指针。
+ * @param height 指向存储图像高度的变量的指针。
+ * @param channels 指向存储图像通道数的变量的指针。
+ * @return 成功返回图像数据指针（用 stbi_image_free 或 free 释放），失败返回NULL。
+ */
+unsigned char *load_image_from_stream(FILE *fp, int *width, int *height, int *channels)
+{
+    if (!fp || !width || !height || !channels) {
+        LOG_ERROR("Invalid parameters for load_image_from_stream");
+        return NULL;
+    }
+    size_t size = 0;
+    unsigned char *buffer = read_stream(fp, &size);
+    if (!buffer)
+        return NULL;
+    unsigned char *data = load_image_from_memory(buffer, size, width, height, channels);
+    free(buffer);
+    return data;
+}
+
+// stb_image_write 回调的上下文
+typedef struct
+{
+    FILE *fp;
+    int failed;
+} stream_writer_t;
+
+static void write_stream_callback(void *context, void *data, int size)
+{
+    stream_writer_t *writer = (stream_writer_t *)context;
+    if (!writer->failed && fwrite(data, 1, size, writer->fp) != (size_t)size)
+        writer->failed = 1;
+}
+
+/**
+ * @brief 把图像编码后写入输出流（如标准输出），不经过临时文件。
+ * @param fp 输出流，应以二进制模式打开。
+ * @param format 编码格式："jpg"/"jpeg"、"png"、"bmp" 或 "tga"。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param quality JPEG质量参数 (1-100)，仅对JPEG格式有效。
+ * @return 成功返回1，失败返回0。
+ */
+int write_image_to_stream(
+    FILE *fp, const char *format, unsigned char *data, int width, int height, int channels, int quality)
+{
+    if (!fp || !format || !data || width <= 0 || height <= 0 || channels <= 0) {
+        LOG_ERROR("Invalid parameters for write_image_to_stream");
         return 0;
     }
 
-    printf("Successfully saved image to '%s'\n", path);
+    stream_writer_t writer = {fp, 0};
+    int result = 0;
+    if (strcmp(format, "jpg") == 0 || strcmp(format, "jpeg") == 0) {
+        result = stbi_write_jpg_to_func(write_stream_callback, &writer, width, height, channels, data, quality);
+    }
+    else if (strcmp(format, "png") == 0) {
+        result = stbi_write_png_to_func(
+            write_stream_callback, &writer, width, height, channels, data, width * channels);
+    }
+    else if (strcmp(format, "bmp") == 0) {
+        result = stbi_write_bmp_to_func(write_stream_callback, &writer, width, height, channels, data);
+    }
+    else if (strcmp(format, "tga") == 0) {
+        result = stbi_write_tga_to_func(write_stream_callback, &writer, width, height, channels, data);
+    }
+    else {
+        LOG_ERROR("Unsupported output format: %s", format);
+        return 0;
+    }
+
+    if (!result || writer.failed || fflush(fp) != 0) {
+        LOG_ERROR("Error writing encoded image to stream");
+        return 0;
+    }
     return 1;
-}
\ No newline at end of file
+}
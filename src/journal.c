@@ -0,0 +1,500 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // syncfs
+#endif
+#include "journal.h"
+#include "checksum.h"
+#include "log.h"
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// 单行记录的最大长度（输入名最长255字节）
+#define JOURNAL_LINE_MAX 1024
+
+// 追加记录时的互斥锁，同一进程中的全部日志共用
+#ifdef _WIN32
+static SRWLOCK journal_lock = SRWLOCK_INIT;
+#define JOURNAL_LOCK() AcquireSRWLockExclusive(&journal_lock)
+#define JOURNAL_UNLOCK() ReleaseSRWLockExclusive(&journal_lock)
+#else
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+#define JOURNAL_LOCK() pthread_mutex_lock(&journal_lock)
+#define JOURNAL_UNLOCK() pthread_mutex_unlock(&journal_lock)
+#endif
+
+/**
+ * @brief 当前的系统时间（自 1970 年起的微秒数），不同进程写入的记录按它比较先后。
+ */
+static long long now_us(void)
+{
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    long long t = (long long)(((unsigned long long)ft.dwHighDateTime << 32) | ft.dwLowDateTime);
+    return t / 10 - 11644473600000000ll;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * @brief 键 "<输出名>/<输入名>" 的64位 FNV-1a 哈希，不需要拼接字符串。
+ */
+static uint64_t key_hash(const char *output, const char *input)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (const unsigned char *p = (const unsigned char *)output; *p; p++)
+        h = (h ^ *p) * 1099511628211ull;
+    h = (h ^ '/') * 1099511628211ull;
+    for (const unsigned char *p = (const unsigned char *)input; *p; p++)
+        h = (h ^ *p) * 1099511628211ull;
+    return h;
+}
+
+/**
+ * @brief 追加一条重放的记录。
+ * @return 成功返回1，内存不足返回0。
+ */
+static int put_record(journal_t *journal, uint64_t key, long long time, const journal_record_t *record)
+{
+    if (journal->count == journal->capacity) {
+        int capacity = journal->capacity ? journal->capacity * 2 : 1024;
+        journal_entry_t *entries =
+            (journal_entry_t *)realloc(journal->entries, (size_t)capacity * sizeof(journal_entry_t));
+        if (!entries) {
+            LOG_ERROR("Memory allocation failed for journal");
+            return 0;
+        }
+        journal->entries = entries;
+        journal->capacity = capacity;
+    }
+    journal_entry_t *entry = &journal->entries[journal->count];
+    entry->key = key;
+    entry->time = time;
+    if (time > journal->last_time)
+        journal->last_time = time;
+    entry->seq = (uint32_t)journal->count++;
+    entry->record = *record;
+    return 1;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const journal_entry_t *x = (const journal_entry_t *)a;
+    const journal_entry_t *y = (const journal_entry_t *)b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->time != y->time)
+        return x->time < y->time ? -1 : 1;
+    return x->seq < y->seq ? -1 : (x->seq > y->seq);
+}
+
+/**
+ * @brief 按键排序，同一个键只保留写入时间最晚的一条（时间相同时保留最后重放的一条）。
+ */
+static void finish_replay(journal_t *journal)
+{
+    qsort(journal->entries, (size_t)journal->count, sizeof(journal_entry_t), compare_entries);
+    int kept = 0;
+    for (int i = 0; i < journal->count; i++) {
+        if (kept > 0 && journal->entries[kept - 1].key == journal->entries[i].key)
+            kept--;
+        journal->entries[kept++] = journal->entries[i];
+    }
+    journal->count = kept;
+}
+
+/**
+ * @brief 解析一行记录："<行CRC> <写入时间> <输出名> <输入字节数> <输入修改时间> <参数>
+ *        <输出字节数> <输出修改时间> <输出CRC> <输入名>"（一行），行 CRC 覆盖其后的全部内容。
+ * @param line 去掉换行符的一行。
+ * @param key 输出的键的哈希。
+ * @param time 输出的写入时间。
+ * @param record 输出的记录。
+ * @return 格式和校验都正确返回1，否则返回0。
+ */
+static int parse_record(const char *line, uint64_t *key, long long *time, journal_record_t *record)
+{
+    uint32_t line_crc;
+    char output[64];
+    int body = 0, name = 0;
+    if (sscanf(line, "%8" SCNx32 " %n", &line_crc, &body) != 1 || body != 9)
+        return 0;
+    if (crc32_update(0, line + body, strlen(line + body)) != line_crc)
+        return 0;
+    if (sscanf(line + body,
+               "%lld %63s %lld %lld %8" SCNx32 " %lld %lld %8" SCNx32 " %n",
+               time,
+               output,
+               &record->input_size,
+               &record->input_mtime,
+               &record->params,
+               &record->output_size,
+               &record->output_mtime,
+               &record->checksum,
+               &name) != 8 ||
+        name == 0 || line[body + name] == '\0')
+        return 0;
+    *key = key_hash(output, line + body + name);
+    return 1;
+}
+
+/**
+ * @brief 重放一个日志文件。
+ * @return 读入的记录数，内存不足时返回 -1。
+ */
+static int replay_file(journal_t *journal, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+
+    int loaded = 0, skipped = 0;
+    char line[JOURNAL_LINE_MAX];
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            // 超长的行或文件末尾写到一半的行
+            skipped++;
+            int c;
+            while (len == sizeof(line) - 1 && (c = fgetc(fp)) != EOF && c != '\n') {
+            }
+            continue;
+        }
+        line[len - 1] = '\0';
+        uint64_t key;
+        long long time;
+        journal_record_t record;
+        if (!parse_record(line, &key, &time, &record)) {
+            skipped++;
+            continue;
+        }
+        if (!put_record(journal, key, time, &record)) {
+            fclose(fp);
+            return -1;
+        }
+        loaded++;
+    }
+    fclose(fp);
+    if (skipped > 0)
+        LOG_INFO("Ignored %d incomplete or corrupt records in journal '%s'", skipped, path);
+    return loaded;
+}
+
+/**
+ * @brief 检查文件是否为空或以换行符结尾（上次写入没有在行中间中断）。
+ */
+static int ends_with_newline(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 1;
+    int ok = 1;
+    if (fseek(fp, -1, SEEK_END) == 0)
+        ok = fgetc(fp) == '\n';
+    fclose(fp);
+    return ok;
+}
+
+/**
+ * @brief 判断目录项是否为日志文件（以 .log 结尾）。
+ */
+static int is_log_name(const char *name)
+{
+    size_t len = strlen(name);
+    return len >= 5 && strcmp(name + len - 4, ".log") == 0;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void free_names(char **names, int count)
+{
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+}
+
+/**
+ * @brief 按文件名排序列出目录中的日志文件，重放顺序不依赖 readdir 的顺序。
+ * @param dir 日志目录。
+ * @param count 输出的文件数。
+ * @return 文件名数组（调用者用 free_names 释放），目录无法打开或内存不足时返回NULL。
+ */
+static char **list_logs(const char *dir, int *count)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        return NULL;
+    int n = 0, capacity = 16, ok = 1;
+    char **names = (char **)malloc((size_t)capacity * sizeof(char *));
+    struct dirent *entry;
+    while (names && ok && (entry = readdir(d)) != NULL) {
+        if (!is_log_name(entry->d_name))
+            continue;
+        if (n == capacity) {
+            char **grown = (char **)realloc(names, (size_t)capacity * 2 * sizeof(char *));
+            if (!(ok = grown != NULL))
+                break;
+            names = grown;
+            capacity *= 2;
+        }
+        if ((ok = (names[n] = strdup(entry->d_name)) != NULL))
+            n++;
+    }
+    closedir(d);
+    if (!names || !ok) {
+        LOG_ERROR("Memory allocation failed for journal");
+        free_names(names, n);
+        return NULL;
+    }
+    qsort(names, (size_t)n, sizeof(char *), compare_names);
+    *count = n;
+    return names;
+}
+
+/**
+ * @brief 删除日志目录中的全部日志文件（包括其他进程的日志），之后重放不到任何以往的记录。
+ * @param dir 日志目录，不存在时什么也不做。
+ * @return 成功返回1，有文件无法删除时返回0。
+ */
+int journal_clear(const char *dir)
+{
+    int count = 0;
+    char **names = list_logs(dir, &count);
+    if (!names) {
+        if (errno == ENOENT)
+            return 1;
+        LOG_ERROR("Error opening journal directory: %s", dir);
+        return 0;
+    }
+    int ok = 1;
+    char path[1024];
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        if (remove(path) != 0 && errno != ENOENT) {
+            LOG_ERROR("Error removing journal '%s'", path);
+            ok = 0;
+        }
+    }
+    free_names(names, count);
+    return ok;
+}
+
+/**
+ * @brief 打开日志：创建日志目录，重放其中的全部日志文件，打开本进程的日志文件用于追加。
+ * @param journal 日志。
+ * @param dir 日志目录。
+ * @param name 本进程的日志文件名（位于 dir 中，以 .log 结尾才会被重放）。
+ * @param sync_every 每追加多少条记录落盘一次，<=0 时为1。
+ * @param replay 0 表示不重放并删除目录中的全部日志文件（从头开始），非0 表示重放。
+ * @return 成功返回1，失败返回0。
+ */
+int journal_open(journal_t *journal, const char *dir, const char *name, int sync_every, int replay)
+{
+    memset(journal, 0, sizeof(*journal));
+    journal->sync_every = sync_every > 0 ? sync_every : 1;
+
+#ifdef _WIN32
+    if (_mkdir(dir) != 0 && errno != EEXIST) {
+#else
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+#endif
+        LOG_ERROR("Error creating journal directory: %s", dir);
+        return 0;
+    }
+
+    char path[1024];
+    if (replay) {
+        int count = 0;
+        char **names = list_logs(dir, &count);
+        if (!names) {
+            LOG_ERROR("Error opening journal directory: %s", dir);
+            return 0;
+        }
+        for (int i = 0; i < count; i++) {
+            snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+            if (replay_file(journal, path) < 0) {
+                free_names(names, count);
+                journal_close(journal);
+                return 0;
+            }
+        }
+        free_names(names, count);
+        finish_replay(journal);
+    }
+    else if (!journal_clear(dir)) {
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    // 上次写到一半的残行先补上换行符，新记录不会接在它后面（残行本身在重放时因校验失败被丢弃）
+    int torn = replay && !ends_with_newline(path);
+    journal->fp = fopen(path, replay ? "a" : "w");
+    if (!journal->fp) {
+        LOG_ERROR("Error opening journal '%s'", path);
+        journal_close(journal);
+        return 0;
+    }
+    if (torn)
+        fputc('\n', journal->fp);
+    return 1;
+}
+
+/**
+ * @brief 查找重放得到的记录。
+ * @param journal 日志。
+ * @param input 输入名。
+ * @param output 输出名。
+ * @return 记录，不存在时返回NULL。
+ */
+const journal_record_t *journal_find(const journal_t *journal, const char *input, const char *output)
+{
+    uint64_t key = key_hash(output, input);
+    int lo = 0, hi = journal->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (journal->entries[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < journal->count && journal->entries[lo].key == key ? &journal->entries[lo].record : NULL;
+}
+
+/**
+ * @brief 刷写日志文件，Linux 上同时刷写此前完成的全部输出。调用者持有锁。
+ */
+static int sync_locked(journal_t *journal)
+{
+    journal->pending = 0;
+    if (fflush(journal->fp) != 0)
+        return 0;
+#if defined(_WIN32)
+    return _commit(_fileno(journal->fp)) == 0;
+#elif defined(__linux__)
+    return syncfs(fileno(journal->fp)) == 0;
+#else
+    return fsync(fileno(journal->fp)) == 0;
+#endif
+}
+
+/**
+ * @brief 追加一条记录（多个线程可以同时调用）；每追加 sync_every 条落盘一次。
+ * @param journal 日志。
+ * @param input 输入名（不能包含换行符）。
+ * @param output 输出名（不能包含空白和 '/'）。
+ * @param record 记录。
+ * @return 成功返回1，失败返回0。
+ */
+int journal_append(journal_t *journal, const char *input, const char *output, const journal_record_t *record)
+{
+    // 写入时间在锁内取得，同一进程的记录按追加顺序严格递增
+    JOURNAL_LOCK();
+    long long time = now_us();
+    if (time <= journal->last_time)
+        time = journal->last_time + 1;
+    journal->last_time = time;
+
+    char body[JOURNAL_LINE_MAX];
+    int n = snprintf(body,
+                     sizeof(body),
+                     "%lld %s %lld %lld %08" PRIx32 " %lld %lld %08" PRIx32 " %s",
+                     time,
+                     output,
+                     record->input_size,
+                     record->input_mtime,
+                     record->params,
+                     record->output_size,
+                     record->output_mtime,
+                     record->checksum,
+                     input);
+    if (n < 0 || n >= (int)sizeof(body) - 10) {
+        JOURNAL_UNLOCK();
+        return 0;
+    }
+    uint32_t line_crc = crc32_update(0, body, (size_t)n);
+
+    // 每条记录立即写给操作系统，进程崩溃不会丢失记录；落盘（防止断电丢失）按 sync_every 批量进行
+    int ok = fprintf(journal->fp, "%08" PRIx32 " %s\n", line_crc, body) > 0 && fflush(journal->fp) == 0;
+    if (ok && ++journal->pending >= journal->sync_every)
+        ok = sync_locked(journal);
+    JOURNAL_UNLOCK();
+    if (!ok)
+        LOG_ERROR("Error writing journal record for %s", input);
+    return ok;
+}
+
+/**
+ * @brief 把已追加的记录和此前完成的输出落盘。
+ * @param journal 日志。
+ * @return 成功返回1，失败返回0。
+ */
+int journal_sync(journal_t *journal)
+{
+    JOURNAL_LOCK();
+    int ok = sync_locked(journal);
+    JOURNAL_UNLOCK();
+    return ok;
+}
+
+/**
+ * @brief 落盘并关闭日志，释放重放的记录。
+ * @param journal 日志。
+ */
+void journal_close(journal_t *journal)
+{
+    if (journal->fp) {
+        if (!journal_sync(journal))
+            LOG_ERROR("Error syncing journal");
+        fclose(journal->fp);
+        journal->fp = NULL;
+    }
+    free(journal->entries);
+    journal->entries = NULL;
+    journal->count = 0;
+    journal->capacity = 0;
+}
+
+/**
+ * @brief 计算文件的字节数和内容的 CRC-32。
+ * @param path 文件路径。
+ * @param size 输出的字节数。
+ * @param checksum 输出的 CRC-32。
+ * @return 成功返回1，文件无法读取时返回0。
+ */
+int journal_checksum_file(const char *path, long long *size, uint32_t *checksum)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    unsigned char buffer[1 << 16];
+    uint32_t crc = 0;
+    long long total = 0;
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        crc = crc32_update(crc, buffer, n);
+        total += (long long)n;
+    }
+    int ok = !ferror(fp);
+    fclose(fp);
+    *size = total;
+    *checksum = crc;
+    return ok;
+}
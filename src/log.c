@@ -0,0 +1,304 @@
+#include "log.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// 每个输出流的缓冲区大小，写满后整块写出
+#define LOG_BUFFER_SIZE 16384
+// 格式化消息的栈上缓冲区大小，更长的消息临时分配内存
+#define LOG_LINE_SIZE 1024
+
+// 一个输出流的缓冲区
+typedef struct
+{
+    char data[LOG_BUFFER_SIZE];
+    size_t used;
+} log_buffer_t;
+
+int log_max_level = LOG_LEVEL_INFO;
+static log_format_t log_format = LOG_FORMAT_TEXT;
+
+static log_buffer_t out_buffer; // 写标准输出
+static log_buffer_t err_buffer; // 写标准错误
+static time_t last_flush = 0;
+static int atexit_registered = 0;
+
+#ifdef _WIN32
+static SRWLOCK log_lock = SRWLOCK_INIT;
+#define LOG_LOCK() AcquireSRWLockExclusive(&log_lock)
+#define LOG_UNLOCK() ReleaseSRWLockExclusive(&log_lock)
+#else
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOG_LOCK() pthread_mutex_lock(&log_lock)
+#define LOG_UNLOCK() pthread_mutex_unlock(&log_lock)
+#endif
+
+static const char *level_names[] = {"error", "info", "debug"};
+
+/**
+ * @brief 判断某个级别是否会输出，用于跳过只为日志准备数据的代码。
+ * @param level 日志级别。
+ * @return 会输出返回1，否则返回0。
+ */
+int log_enabled(log_level_t level)
+{
+    return (int)level <= log_max_level;
+}
+
+/**
+ * @brief 设置输出的最高级别。
+ * @param level 日志级别。
+ */
+void log_set_level(log_level_t level)
+{
+    log_max_level = (int)level;
+}
+
+/**
+ * @brief 设置日志格式。
+ * @param format 日志格式。
+ */
+void log_set_format(log_format_t format)
+{
+    log_format = format;
+}
+
+/**
+ * @brief 解析级别名称：quiet/error、info、debug。
+ * @param name 名称。
+ * @param level 输出的级别。
+ * @return 成功返回1，名称无效返回0。
+ */
+int log_parse_level(const char *name, log_level_t *level)
+{
+    if (strcmp(name, "quiet") == 0 || strcmp(name, "error") == 0)
+        *level = LOG_LEVEL_ERROR;
+    else if (strcmp(name, "info") == 0)
+        *level = LOG_LEVEL_INFO;
+    else if (strcmp(name, "debug") == 0)
+        *level = LOG_LEVEL_DEBUG;
+    else
+        return 0;
+    return 1;
+}
+
+/**
+ * @brief 按环境变量 IMAGEPROC_LOG_LEVEL（级别名称）和 IMAGEPROC_LOG_FORMAT（text 或 json）配置日志。
+ */
+void log_configure_from_env(void)
+{
+    const char *level_env = getenv("IMAGEPROC_LOG_LEVEL");
+    if (level_env) {
+        log_level_t level;
+        if (log_parse_level(level_env, &level))
+            log_set_level(level);
+        else
+            LOG_ERROR("Invalid IMAGEPROC_LOG_LEVEL '%s' (expected quiet, error, info or debug)", level_env);
+    }
+
+    const char *format_env = getenv("IMAGEPROC_LOG_FORMAT");
+    if (format_env) {
+        if (strcmp(format_env, "json") == 0)
+            log_set_format(LOG_FORMAT_JSON);
+        else if (strcmp(format_env, "text") == 0)
+            log_set_format(LOG_FORMAT_TEXT);
+        else
+            LOG_ERROR("Invalid IMAGEPROC_LOG_FORMAT '%s' (expected text or json)", format_env);
+    }
+}
+
+/**
+ * @brief 把一个缓冲区写到对应的输出流（调用者持有锁）。
+ */
+static void flush_buffer(log_buffer_t *buffer)
+{
+    if (buffer->used == 0)
+        return;
+    // 每次写出时才取输出流，链式处理模式重定向标准输出后仍然写到正确的位置
+    FILE *fp = (buffer == &out_buffer) ? stdout : stderr;
+    fwrite(buffer->data, 1, buffer->used, fp);
+    fflush(fp);
+    buffer->used = 0;
+}
+
+/**
+ * @brief 追加到缓冲区，放不下时先写出；超过缓冲区大小的数据直接写到输出流（调用者持有锁）。
+ */
+static void buffer_append(log_buffer_t *buffer, const char *data, size_t len)
+{
+    if (buffer->used + len > LOG_BUFFER_SIZE)
+        flush_buffer(buffer);
+    if (len > LOG_BUFFER_SIZE) {
+        fwrite(data, 1, len, (buffer == &out_buffer) ? stdout : stderr);
+        return;
+    }
+    memcpy(buffer->data + buffer->used, data, len);
+    buffer->used += len;
+}
+
+/**
+ * @brief 追加 JSON 字符串的内容（不含两端的引号），转义引号、反斜杠和控制字符（调用者持有锁）。
+ */
+static void buffer_append_json(log_buffer_t *buffer, const char *text, size_t len)
+{
+    size_t run = 0; // 尚未追加的、不需要转义的字符数
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = (unsigned char)text[i];
+        if (ch != '"' && ch != '\\' && ch >= 0x20) {
+            run++;
+            continue;
+        }
+        buffer_append(buffer, text + i - run, run);
+        run = 0;
+
+        char escaped[8];
+        if (ch == '"' || ch == '\\')
+            snprintf(escaped, sizeof(escaped), "\\%c", ch);
+        else if (ch == '\n')
+            snprintf(escaped, sizeof(escaped), "\\n");
+        else if (ch == '\t')
+            snprintf(escaped, sizeof(escaped), "\\t");
+        else
+            snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+        buffer_append(buffer, escaped, strlen(escaped));
+    }
+    buffer_append(buffer, text + len - run, run);
+}
+
+/**
+ * @brief 当前 UTC 时间的 ISO 8601 字符串（精确到毫秒）。
+ */
+static void format_timestamp(char *out, size_t size)
+{
+#ifdef _WIN32
+    SYSTEMTIME st;
+    GetSystemTime(&st);
+    snprintf(out,
+             size,
+             "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+             st.wYear,
+             st.wMonth,
+             st.wDay,
+             st.wHour,
+             st.wMinute,
+             st.wSecond,
+             st.wMilliseconds);
+#else
+    struct timespec ts;
+    struct tm tm;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    gmtime_r(&ts.tv_sec, &tm);
+    size_t n = strftime(out, size, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(out + n, size - n, ".%03ldZ", ts.tv_nsec / 1000000);
+#endif
+}
+
+/**
+ * @brief 格式化并写入一行日志，应通过 LOG_ERROR/LOG_INFO/LOG_DEBUG 调用。
+ *
+ * 日志先写入进程内的缓冲区，缓冲区满、距上次写出超过一秒、输出错误或调用 log_flush 时才写到输出流；
+ * 是否超过一秒只在写日志和调用 log_flush_pending 时检查，长时间运行的循环应定期调用 log_flush_pending。
+ * 多个线程可以同时调用，每行日志完整输出，不会交错。
+ * @param level 日志级别。
+ * @param format printf 风格的格式字符串。
+ */
+void log_write(log_level_t level, const char *format, ...)
+{
+    if (!log_enabled(level))
+        return;
+
+    // 在锁外格式化消息
+    char stack_line[LOG_LINE_SIZE];
+    char *line = stack_line;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(stack_line, sizeof(stack_line), format, args);
+    va_end(args);
+    if (n < 0)
+        return;
+    if ((size_t)n >= sizeof(stack_line)) {
+        line = (char *)malloc((size_t)n + 1);
+        if (line) {
+            va_start(args, format);
+            vsnprintf(line, (size_t)n + 1, format, args);
+            va_end(args);
+        }
+        else {
+            line = stack_line;
+            n = sizeof(stack_line) - 1;
+        }
+    }
+    size_t len = (size_t)n;
+    while (len > 0 && line[len - 1] == '\n')
+        len--;
+
+    char timestamp[32] = "";
+    if (log_format == LOG_FORMAT_JSON)
+        format_timestamp(timestamp, sizeof(timestamp));
+
+    LOG_LOCK();
+    if (!atexit_registered) {
+        atexit(log_flush);
+        atexit_registered = 1;
+    }
+
+    log_buffer_t *buffer = (log_format == LOG_FORMAT_TEXT && level != LOG_LEVEL_ERROR) ? &out_buffer : &err_buffer;
+    if (log_format == LOG_FORMAT_JSON) {
+        char prefix[96];
+        int prefix_len = snprintf(
+            prefix, sizeof(prefix), "{\"time\":\"%s\",\"level\":\"%s\",\"msg\":\"", timestamp, level_names[level]);
+        buffer_append(buffer, prefix, (size_t)prefix_len);
+        buffer_append_json(buffer, line, len);
+        buffer_append(buffer, "\"}\n", 3);
+    }
+    else {
+        buffer_append(buffer, line, len);
+        buffer_append(buffer, "\n", 1);
+    }
+
+    // 错误立即写出（先写出之前缓冲的普通日志，保持先后顺序），其余日志在下一秒的日志或 log_flush_pending 时写出
+    time_t now = time(NULL);
+    if (level == LOG_LEVEL_ERROR || now != last_flush) {
+        flush_buffer(&out_buffer);
+        flush_buffer(&err_buffer);
+        last_flush = now;
+    }
+    LOG_UNLOCK();
+
+    if (line != stack_line)
+        free(line);
+}
+
+/**
+ * @brief 把缓冲的日志写到输出流。进程正常退出时会自动调用。
+ */
+void log_flush(void)
+{
+    LOG_LOCK();
+    flush_buffer(&out_buffer);
+    flush_buffer(&err_buffer);
+    LOG_UNLOCK();
+}
+
+/**
+ * @brief 距上次写出超过一秒时把缓冲的日志写到输出流。没有新日志时缓冲的日志不会自动写出，
+ *        由统计线程、服务主循环等定期调用，使日志最多缓冲约一秒。
+ */
+void log_flush_pending(void)
+{
+    LOG_LOCK();
+    time_t now = time(NULL);
+    if (now != last_flush) {
+        flush_buffer(&out_buffer);
+        flush_buffer(&err_buffer);
+        last_flush = now;
+    }
+    LOG_UNLOCK();
+}
@@ -1,4 +1,4 @@
-#include <stdio.h>  // 用于标准输入输出，如 printf, fprintf
+#include <stdio.h>  // 用于标准输入输出
 #include <stdlib.h> // 用于标准库函数，如 exit
 #include <string.h> // 用于字符串处理函数
 #include "stb_image.h"
@@ -9,6 +9,145 @@
 #include "edge.h"
 #include "rotate.h"
 #include "batch.h"
+#include "pyramid.h"
+#include "resize.h"
+#include "server.h"
+#include "stream.h"
+#include "log.h"
+
+/**
+ * @brief 处理一个全局日志选项：--quiet/-q 只输出错误，--verbose/-v 输出调试信息，--log-json 输出 JSON 行。
+ * @param arg 命令行参数。
+ * @return 是日志选项返回1，否则返回0。
+ */
+static int apply_log_option(const char *arg)
+{
+    if (strcmp(arg, "--quiet") == 0 || strcmp(arg, "-q") == 0)
+        log_set_level(LOG_LEVEL_ERROR);
+    else if (strcmp(arg, "--verbose") == 0 || strcmp(arg, "-v") == 0)
+        log_set_level(LOG_LEVEL_DEBUG);
+    else if (strcmp(arg, "--log-json") == 0)
+        log_set_format(LOG_FORMAT_JSON);
+    else
+        return 0;
+    return 1;
+}
+
+/**
+ * @brief 彩色字符画模式：ImageProcessor --ascii <input> [选项]，默认写标准输出，用于直接在终端中查看。
+ * @param argc 命令行参数数量。
+ * @param argv 命令行参数数组（argv[1] 为 --ascii）。
+ * @return 成功返回0，失败返回1。
+ */
+static int run_ascii_mode(int argc, char *argv[])
+{
+    static const char *style_names[] = {"simple", "extended", "blocks", "dense", "classic", "edges"};
+    static const char *color_names[] = {"none", "256", "truecolor"};
+    const char *output = NULL;
+    ascii_style_t style = ASCII_STYLE_EXTENDED;
+    ascii_color_t color = ASCII_COLOR_TRUECOLOR;
+    int background = 0;
+    int scale = 4;
+    float gamma = 0.8f;
+
+    int ok = argc >= 3;
+    for (int i = 3; ok && i < argc; i++) {
+        if (strcmp(argv[i], "--background") == 0) {
+            background = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            ok = 0;
+            break;
+        }
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--output") == 0) {
+            output = value;
+        }
+        else if (strcmp(argv[i - 1], "--scale") == 0) {
+            scale = atoi(value);
+            ok = scale > 0;
+        }
+        else if (strcmp(argv[i - 1], "--gamma") == 0) {
+            gamma = (float)atof(value);
+            ok = gamma > 0.0f;
+        }
+        else if (strcmp(argv[i - 1], "--style") == 0) {
+            ok = 0;
+            for (int k = 0; k < 6 && !ok; k++)
+                if (strcmp(value, style_names[k]) == 0) {
+                    style = (ascii_style_t)k;
+                    ok = 1;
+                }
+        }
+        else if (strcmp(argv[i - 1], "--color") == 0) {
+            ok = 0;
+            for (int k = 0; k < 3 && !ok; k++)
+                if (strcmp(value, color_names[k]) == 0) {
+                    color = (ascii_color_t)k;
+                    ok = 1;
+                }
+        }
+        else {
+            ok = 0;
+        }
+    }
+    if (!ok) {
+        LOG_ERROR("Usage: %s --ascii <input> [--output file] [--style simple|extended|blocks|dense|classic|edges] "
+                  "[--color none|256|truecolor] [--background] [--scale N] [--gamma G]",
+                  argv[0]);
+        return 1;
+    }
+
+    // 只需要字符画：解码后立即缩小到块大小允许的最大倍数（最多8倍），全分辨率的像素不再参与处理，
+    // 结果与单文件模式在完整金字塔上采样相同
+    int factor = 1;
+    while (factor < 8 && scale % (factor * 2) == 0)
+        factor *= 2;
+    image_pyramid_t pyramid;
+    if (!load_image_reduced(argv[2], factor, 0, &pyramid))
+        return 1;
+    ok = image_to_ascii_color_pyramid(&pyramid, output, scale, style, gamma, color, background);
+    free_image(pyramid.data[0]);
+    pyramid_free(&pyramid);
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief 缩略图模式：ImageProcessor --thumbnail <input> <output> [--size N]，只生成一幅长边不超过 N 的缩略图。
+ * @param argc 命令行参数数量。
+ * @param argv 命令行参数数组（argv[1] 为 --thumbnail）。
+ * @return 成功返回0，失败返回1。
+ */
+static int run_thumbnail_mode(int argc, char *argv[])
+{
+    int size = PYRAMID_THUMBNAIL_SIZE;
+    int ok = argc == 4 || argc == 6;
+    if (ok && argc == 6) {
+        char *end;
+        long value = strtol(argv[5], &end, 10);
+        ok = strcmp(argv[4], "--size") == 0 && end != argv[5] && *end == '\0' && value >= 1 && value <= 65536;
+        size = (int)value;
+    }
+    if (!ok) {
+        LOG_ERROR("Usage: %s --thumbnail <input> <output> [--size N]", argv[0]);
+        return 1;
+    }
+
+    // 解码后立即按2倍逐级缩小，直到长边再缩小一级就会小于上限，最后一步才精确缩放到上限
+    image_pyramid_t pyramid;
+    if (!load_image_reduced(argv[2], 8, size, &pyramid))
+        return 1;
+    int width, height;
+    unsigned char *thumbnail = pyramid_thumbnail(&pyramid, size, &width, &height);
+    ok = thumbnail && save_image(argv[3], thumbnail, width, height, pyramid.channels, 90);
+    if (ok)
+        LOG_INFO("Saved %dx%d thumbnail to '%s'", width, height, argv[3]);
+    free(thumbnail);
+    free_image(pyramid.data[0]);
+    pyramid_free(&pyramid);
+    return ok ? 0 : 1;
+}
 
 /**
  * @brief 主函数，程序入口点。
@@ -18,18 +157,158 @@
  */
 int main(int argc, char *argv[])
 {
+    // 日志先按环境变量配置，出现在模式之前的 --quiet/--verbose/--log-json 选项优先
+    log_configure_from_env();
+    int skipped = 0;
+    while (1 + skipped < argc && apply_log_option(argv[1 + skipped]))
+        skipped++;
+    if (skipped > 0) {
+        argv[skipped] = argv[0];
+        argv += skipped;
+        argc -= skipped;
+    }
+
     // 检查命令行参数
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <input_image> [output_dir]\n", argv[0]);
-        fprintf(stderr, "       %s --batch    (批量处理batch_input目录中的所有图像)\n", argv[0]);
+        LOG_ERROR("Usage: %s [--quiet|--verbose] [--log-json] <input_image> [output_dir]", argv[0]);
+        LOG_ERROR("       %s --batch [--edge-ops <effects>] [--ops <effects>] [--dedupe <0-64>] [--fresh | --verify]"
+                  "    (批量处理batch_input目录中的所有图像，默认跳过以往运行已完成的输出)",
+                  argv[0]);
+        LOG_ERROR("       %s --batch [--workers N] [--shard i/N] [--claim <run-id>] ..."
+                  "    (多个进程分担批处理)",
+                  argv[0]);
+        LOG_ERROR("       %s --serve <socket_path> [workers]    (常驻服务模式，通过Unix域套接字接收请求)", argv[0]);
+        LOG_ERROR("       %s --ascii <input> [--color none|256|truecolor] [--style name] [--output file] ..."
+                  "    (彩色字符画，缺省时写标准输出)",
+                  argv[0]);
+        LOG_ERROR("       %s --thumbnail <input> <output> [--size N]    (只生成缩略图，长边默认不超过128)", argv[0]);
+        LOG_ERROR("       %s --ops <effects> [--input in] [--output out] [--format png|jpg|bmp|tga] [--quality N]"
+                  "    (链式处理，缺省时读标准输入、写标准输出)",
+                  argv[0]);
         return 1;
     }
 
     // 检查是否是批处理模式
     if (strcmp(argv[1], "--batch") == 0) {
-        printf("Starting batch processing mode...\n");
-        batch_process();
-        return 0;
+        const char *edge_ops = NULL;
+        const char *ops = NULL;
+        int dedupe = -1;
+        int workers = 0;
+        batch_shard_t shard = {0, 0, NULL, -1};
+        int resume = BATCH_RESUME;
+        int ok = 1;
+        for (int i = 2; ok && i < argc; i += 2) {
+            if (strcmp(argv[i], "--fresh") == 0 && resume == BATCH_RESUME) {
+                // 不带参数的选项
+                resume = BATCH_FRESH;
+                i--;
+            }
+            else if (strcmp(argv[i], "--verify") == 0 && resume == BATCH_RESUME) {
+                resume = BATCH_RESUME_VERIFY;
+                i--;
+            }
+            else if (i + 1 < argc && strcmp(argv[i], "--edge-ops") == 0 && !edge_ops) {
+                edge_ops = argv[i + 1];
+            }
+            else if (i + 1 < argc && strcmp(argv[i], "--ops") == 0 && !ops) {
+                ops = argv[i + 1];
+            }
+            else if (i + 1 < argc && strcmp(argv[i], "--dedupe") == 0 && dedupe < 0) {
+                char *end;
+                long distance = strtol(argv[i + 1], &end, 10);
+                ok = end != argv[i + 1] && *end == '\0' && distance >= 0 && distance <= 64;
+                dedupe = (int)distance;
+            }
+            else if (i + 1 < argc && strcmp(argv[i], "--workers") == 0 && workers == 0) {
+                char *end;
+                long count = strtol(argv[i + 1], &end, 10);
+                ok = end != argv[i + 1] && *end == '\0' && count >= 1 && count <= BATCH_MAX_WORKERS;
+                workers = (int)count;
+            }
+            else if (i + 1 < argc && strcmp(argv[i], "--shard") == 0 && shard.shard_count == 0) {
+                // 分片 "i/N"：处理文件名哈希对 N 取余等于 i 的图像
+                char *end;
+                long index = strtol(argv[i + 1], &end, 10);
+                long count = end != argv[i + 1] && *end == '/' ? strtol(end + 1, &end, 10) : 0;
+                ok = *end == '\0' && count >= 1 && index >= 0 && index < count;
+                shard.shard_index = (int)index;
+                shard.shard_count = (int)count;
+            }
+            else if (i + 1 < argc && strcmp(argv[i], "--claim") == 0 && !shard.claim_id) {
+                shard.claim_id = argv[i + 1];
+            }
+            else {
+                ok = 0;
+            }
+        }
+        // 去重索引只属于一个进程；--workers 自己为子进程分片
+        if (dedupe >= 0 && (workers > 0 || shard.shard_count > 0 || shard.claim_id))
+            ok = 0;
+        if (workers > 0 && shard.shard_count > 0)
+            ok = 0;
+        if (!ok) {
+            LOG_ERROR(
+                "Usage: %s --batch [--edge-ops <effects>] [--ops <effects>] [--dedupe <0-64>] [--fresh | --verify]",
+                argv[0]);
+            LOG_ERROR("       %s --batch [--edge-ops <effects>] [--ops <effects>] [--workers N] [--claim <run-id>]",
+                      argv[0]);
+            LOG_ERROR("       %s --batch [--edge-ops <effects>] [--ops <effects>] [--shard i/N | --claim <run-id>]",
+                      argv[0]);
+            return 1;
+        }
+        LOG_INFO("Starting batch processing mode...");
+        if (workers > 0)
+            return batch_run_workers(edge_ops, ops, workers, shard.claim_id, resume) ? 0 : 1;
+        const batch_shard_t *part = shard.shard_count > 0 || shard.claim_id ? &shard : NULL;
+        return batch_process(edge_ops, ops, dedupe, part, resume) ? 0 : 1;
+    }
+
+    // 检查是否是链式处理模式：一个缓冲区上依次应用效果链，最后只编码一次
+    if (strcmp(argv[1], "--ops") == 0) {
+        if (argc < 3 || argc % 2 == 0) {
+            LOG_ERROR("Usage: %s --ops <effects> [--input in] [--output out] [--format png|jpg|bmp|tga] [--quality N]",
+                      argv[0]);
+            return 1;
+        }
+        const char *input = NULL;
+        const char *output = NULL;
+        const char *format = "png";
+        int quality = 90;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "--input") == 0)
+                input = argv[i + 1];
+            else if (strcmp(argv[i], "--output") == 0)
+                output = argv[i + 1];
+            else if (strcmp(argv[i], "--format") == 0)
+                format = argv[i + 1];
+            else if (strcmp(argv[i], "--quality") == 0)
+                quality = atoi(argv[i + 1]);
+            else {
+                LOG_ERROR("Unknown option: %s", argv[i]);
+                return 1;
+            }
+        }
+        return stream_process(argv[2], input, output, format, quality) ? 0 : 1;
+    }
+
+    // 检查是否是彩色字符画模式
+    if (strcmp(argv[1], "--ascii") == 0) {
+        return run_ascii_mode(argc, argv);
+    }
+
+    // 检查是否是缩略图模式
+    if (strcmp(argv[1], "--thumbnail") == 0) {
+        return run_thumbnail_mode(argc, argv);
+    }
+
+    // 检查是否是服务模式
+    if (strcmp(argv[1], "--serve") == 0) {
+        if (argc < 3) {
+            LOG_ERROR("Usage: %s --serve <socket_path> [workers]", argv[0]);
+            return 1;
+        }
+        int workers = (argc >= 4) ? atoi(argv[3]) : 0;
+        return serve_run(argv[2], workers) ? 0 : 1;
     }
 
     // 输出目录，默认为当前目录
@@ -47,6 +326,7 @@ int main(int argc, char *argv[])
     char ascii_output_dense[256];
     char ascii_output_high_contrast[256];
     char ascii_output_classic[256];
+    char ascii_output_edges[256];
 
     sprintf(grayscale_output, "%s/grayscale_output.jpg", output_dir);
     sprintf(blur_output, "%s/blur_output.jpg", output_dir);
@@ -59,6 +339,7 @@ int main(int argc, char *argv[])
     sprintf(ascii_output_dense, "%s/ascii_output_dense.txt", output_dir);
     sprintf(ascii_output_high_contrast, "%s/ascii_output_high_contrast.txt", output_dir);
     sprintf(ascii_output_classic, "%s/ascii_output_classic.txt", output_dir);
+    sprintf(ascii_output_edges, "%s/ascii_output_edges.txt", output_dir);
 
     int width, height, channels;
     // 使用封装的 load_image 函数加载原始图像
@@ -73,11 +354,11 @@ int main(int argc, char *argv[])
     if (grayscale_data) {
         memcpy(grayscale_data, original_data, width * height * channels);
         grayscale(grayscale_data, width, height, channels);
-        printf("Applied grayscale filter.\n");
+        LOG_INFO("Applied grayscale filter.");
 
         // 使用封装的 save_image 函数保存图像
         if (save_image(grayscale_output, grayscale_data, width, height, channels, 100)) {
-            printf("Saved grayscale image to '%s'\n", grayscale_output);
+            LOG_INFO("Saved grayscale image to '%s'", grayscale_output);
         }
         free(grayscale_data);
     }
@@ -88,11 +369,11 @@ int main(int argc, char *argv[])
         memcpy(blur_data, original_data, width * height * channels);
         int blur_radius = 10; // 可以调整模糊半径
         blur(blur_data, width, height, channels, blur_radius);
-        printf("Applied Gaussian blur with radius %d.\n", blur_radius);
+        LOG_INFO("Applied Gaussian blur with radius %d.", blur_radius);
 
         // 使用封装的 save_image 函数保存图像
         if (save_image(blur_output, blur_data, width, height, channels, 100)) {
-            printf("Saved blurred image to '%s'\n", blur_output);
+            LOG_INFO("Saved blurred image to '%s'", blur_output);
         }
         free(blur_data);
     }
@@ -102,11 +383,11 @@ int main(int argc, char *argv[])
     if (invert_data) {
         memcpy(invert_data, original_data, width * height * channels);
         invert(invert_data, width, height, channels);
-        printf("Applied invert filter.\n");
+        LOG_INFO("Applied invert filter.");
 
         // 使用封装的 save_image 函数保存图像
         if (save_image(invert_output, invert_data, width, height, channels, 100)) {
-            printf("Saved inverted image to '%s'\n", invert_output);
+            LOG_INFO("Saved inverted image to '%s'", invert_output);
         }
         free(invert_data);
     }
@@ -116,11 +397,11 @@ int main(int argc, char *argv[])
     if (rotate_data) {
         memcpy(rotate_data, original_data, width * height * channels);
         rotate_image(rotate_data, width, height, channels);
-        printf("Applied rotation.\n");
+        LOG_INFO("Applied rotation.");
 
         // 使用封装的 save_image 函数保存图像
         if (save_image(rotate_output, rotate_data, width, height, channels, 100)) {
-            printf("Saved rotated image to '%s'\n", rotate_output);
+            LOG_INFO("Saved rotated image to '%s'", rotate_output);
         }
         free(rotate_data);
     }
@@ -130,54 +411,98 @@ int main(int argc, char *argv[])
     sprintf(edge_output, "%s/edge_output.jpg", output_dir);
 
     // 应用增强版Sobel边缘检测，使用双阈值滞后处理
-    int edge_threshold = 50; // 降低阈值，可以检测更多边缘
-    unsigned char *edge_data = sobel_edge_detect(original_data, width, height, channels, edge_threshold);
+    // 阈值由梯度幅值直方图的 Otsu 方法自动选择，不再使用固定值
+    // 梯度场只计算一次，边缘检测和边缘方向风格的ASCII字符画共用
+    int edge_threshold = EDGE_THRESHOLD_OTSU;
+    sobel_gradient_t gradient;
+    int have_gradient = sobel_gradient_compute(original_data, width, height, channels, 0, &gradient);
+    unsigned char *edge_data = have_gradient ? sobel_edge_detect_gradient(&gradient, edge_threshold, channels) : NULL;
     if (edge_data) {
-        printf("Applied enhanced Sobel edge detection with threshold %d.\n", edge_threshold);
-        printf("(Uses hysteresis thresholding for better edge connectivity)\n");
+        LOG_INFO("Applied enhanced Sobel edge detection with automatic (Otsu) threshold.");
+        LOG_INFO("(Uses hysteresis thresholding for better edge connectivity)");
 
         // 保存边缘检测结果
         if (save_image(edge_output, edge_data, width, height, channels, 100)) {
-            printf("Saved edge detection result to '%s'\n", edge_output);
+            LOG_INFO("Saved edge detection result to '%s'", edge_output);
         }
         free(edge_data);
     }
 
-    // 6. 生成ASCII字符画 - 多种风格
-    if (original_data) {
+    // 6. 缩放处理：用Lanczos3滤波缩小到一半，作为网页展示用的缩小版本
+    char resize_output[256];
+    sprintf(resize_output, "%s/resize_output.jpg", output_dir);
+
+    int resize_width = (width + 1) / 2;
+    int resize_height = (height + 1) / 2;
+    unsigned char *resize_data =
+        resize_image(original_data, width, height, channels, resize_width, resize_height, RESIZE_FILTER_LANCZOS3);
+    if (resize_data) {
+        LOG_INFO("Applied Lanczos3 resize to %dx%d.", resize_width, resize_height);
+
+        if (save_image(resize_output, resize_data, resize_width, resize_height, channels, 100)) {
+            LOG_INFO("Saved resized image to '%s'", resize_output);
+        }
+        free(resize_data);
+    }
+
+    // 构建缩小金字塔 (1x/2x/4x/8x)，ASCII字符画和缩略图直接在缩小后的图像上采样
+    image_pyramid_t pyramid;
+    int have_pyramid = pyramid_build(&pyramid, original_data, width, height, channels, 8);
+
+    // 7. 生成ASCII字符画 - 多种风格
+    if (original_data && have_pyramid) {
         // 生成简单风格的ASCII字符画
-        image_to_ascii(original_data, width, height, channels, ascii_output_simple, 5);
+        image_to_ascii_pyramid(&pyramid, ascii_output_simple, 5);
 
         // 生成扩展风格的ASCII字符画（更多字符，高对比度）
-        image_to_ascii_styled(
-            original_data, width, height, channels, ascii_output_extended, 5, ASCII_STYLE_EXTENDED, 0.6f);
+        image_to_ascii_styled_pyramid(&pyramid, ascii_output_extended, 5, ASCII_STYLE_EXTENDED, 0.6f);
 
         // 生成块状风格的ASCII字符画（最佳对比度）
-        image_to_ascii_styled(original_data, width, height, channels, ascii_output_blocks, 8, ASCII_STYLE_BLOCKS, 0.8f);
+        image_to_ascii_styled_pyramid(&pyramid, ascii_output_blocks, 8, ASCII_STYLE_BLOCKS, 0.8f);
 
         // 生成密集风格的ASCII字符画（高对比度）
-        image_to_ascii_styled(original_data, width, height, channels, ascii_output_dense, 6, ASCII_STYLE_DENSE, 0.5f);
+        image_to_ascii_styled_pyramid(&pyramid, ascii_output_dense, 6, ASCII_STYLE_DENSE, 0.5f);
 
         // 生成超高对比度版本
-        image_to_ascii_styled(
-            original_data, width, height, channels, ascii_output_high_contrast, 4, ASCII_STYLE_EXTENDED, 0.4f);
+        image_to_ascii_styled_pyramid(&pyramid, ascii_output_high_contrast, 4, ASCII_STYLE_EXTENDED, 0.4f);
 
         // 生成经典兼容版本（完全ASCII兼容，无乱码）
-        image_to_ascii_styled(
-            original_data, width, height, channels, ascii_output_classic, 6, ASCII_STYLE_CLASSIC, 0.7f);
+        image_to_ascii_styled_pyramid(&pyramid, ascii_output_classic, 6, ASCII_STYLE_CLASSIC, 0.7f);
+
+        // 生成边缘方向版本（轮廓使用 | / - \ _，复用边缘检测的梯度场）
+        image_to_ascii_edges_pyramid(&pyramid, have_gradient ? &gradient : NULL, ascii_output_edges, 5, 0.6f);
 
-        printf("Generated ASCII art in multiple high-contrast styles:\n");
-        printf("  - ascii_output_simple.txt (块状ASCII兼容字符集)\n");
-        printf("  - ascii_output_extended.txt (13-character extended set, gamma=0.6)\n");
-        printf("  - ascii_output_blocks.txt (ASCII block characters, gamma=0.8, no Unicode)\n");
-        printf("  - ascii_output_dense.txt (15-character dense set, gamma=0.5)\n");
-        printf("  - ascii_output_high_contrast.txt (ultra high contrast, gamma=0.4)\n");
-        printf("  - ascii_output_classic.txt (classic 9-character set, gamma=0.7, fully compatible)\n");
+        LOG_INFO("Generated ASCII art in multiple high-contrast styles:");
+        LOG_INFO("  - ascii_output_simple.txt (块状ASCII兼容字符集)");
+        LOG_INFO("  - ascii_output_extended.txt (13-character extended set, gamma=0.6)");
+        LOG_INFO("  - ascii_output_blocks.txt (ASCII block characters, gamma=0.8, no Unicode)");
+        LOG_INFO("  - ascii_output_dense.txt (15-character dense set, gamma=0.5)");
+        LOG_INFO("  - ascii_output_high_contrast.txt (ultra high contrast, gamma=0.4)");
+        LOG_INFO("  - ascii_output_classic.txt (classic 9-character set, gamma=0.7, fully compatible)");
+        LOG_INFO("  - ascii_output_edges.txt (edge-direction glyphs over the extended set, gamma=0.6)");
+    }
+    if (have_gradient)
+        sobel_gradient_free(&gradient);
+
+    // 8. 缩略图：取金字塔中长边不超过上限的一层，原图过大时再缩放到上限
+    if (have_pyramid) {
+        char thumbnail_output[256];
+        sprintf(thumbnail_output, "%s/thumbnail_output.jpg", output_dir);
 
-        // 释放图像数据
-        stbi_image_free(original_data);
+        int thumbnail_width, thumbnail_height;
+        unsigned char *thumbnail_data =
+            pyramid_thumbnail(&pyramid, PYRAMID_THUMBNAIL_SIZE, &thumbnail_width, &thumbnail_height);
+        if (thumbnail_data &&
+            save_image(thumbnail_output, thumbnail_data, thumbnail_width, thumbnail_height, channels, 90)) {
+            LOG_INFO("Saved %dx%d thumbnail to '%s'", thumbnail_width, thumbnail_height, thumbnail_output);
+        }
+        free(thumbnail_data);
+        pyramid_free(&pyramid);
     }
 
-    printf("All processing completed.\n");
+    // 释放图像数据
+    free_image(original_data);
+
+    LOG_INFO("All processing completed.");
     return 0;
 }
@@ -0,0 +1,395 @@
+#include "median.h"
+#include "log.h"
+#include "parallel.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 每个任务的最少输出行数：直方图方法在每个任务开始时要为每一列建立一次列直方图
+#define MEDIAN_MIN_ROWS 32
+// 排序网络一次处理的字节数（一个 SSE2 寄存器）
+#define MEDIAN_LANES 16
+
+// 一次中值滤波的共享状态
+typedef struct
+{
+    const unsigned char *data;
+    int width, height, channels, stride;
+    image_rect_t roi;
+    int radius;
+    unsigned char *dst;
+    int dst_stride;
+    int failed; // 任一任务分配临时缓冲区失败时置1
+} median_job_t;
+
+/*
+ * 中值选择网络：S(a, b) 把 v[a]、v[b] 排成升序，MN(a, b) 只把较小值写回 v[a]，MX(a, b) 只把较大值写回 v[b]。
+ * 9 输入的网络来自 Paeth/Devillard，中值在 v[4]；25 输入的网络由 Batcher 奇偶归并排序剪枝得到
+ * （去掉与填充元素的比较和不影响中值的比较器，只有一个输出有用时只算 min 或 max），中值在 v[12]。
+ * 两者都按 0-1 原理对全部 2^9、2^25 个0/1输入验证过。
+ */
+#define MEDIAN_NETWORK_9(S, MN, MX)                                                                                    \
+    S(1, 2) S(4, 5) S(7, 8) S(0, 1) S(3, 4) S(6, 7) S(1, 2) S(4, 5) S(7, 8) MX(0, 3) MN(5, 8) S(4, 7) MX(3, 6)         \
+    MX(1, 4) MN(2, 5) MN(4, 7) S(4, 2) MX(6, 4) MN(4, 2)
+
+#define MEDIAN_NETWORK_25(S, MN, MX)                                                                                   \
+    S(0, 1) S(2, 3) S(0, 2) S(1, 3) S(1, 2) S(4, 5) S(6, 7) S(4, 6) S(5, 7) S(5, 6) S(0, 4) S(2, 6) S(2, 4) S(1, 5)    \
+    S(3, 7) S(3, 5) S(1, 2) S(3, 4) S(5, 6) S(8, 9) S(10, 11) S(8, 10) S(9, 11) S(9, 10) S(12, 13) S(14, 15)           \
+    S(12, 14) S(13, 15) S(13, 14) S(8, 12) S(10, 14) S(10, 12) S(9, 13) S(11, 15) S(11, 13) S(9, 10) S(11, 12)         \
+    S(13, 14) S(0, 8) S(4, 12) S(4, 8) S(2, 10) S(6, 14) S(6, 10) S(2, 4) S(6, 8) S(10, 12) S(1, 9) S(5, 13) S(5, 9)   \
+    S(3, 11) MN(7, 15) S(7, 11) S(3, 5) S(7, 9) S(11, 13) S(1, 2) S(3, 4) S(5, 6) S(7, 8) S(9, 10) S(11, 12)           \
+    MN(13, 14) S(16, 17) S(18, 19) S(16, 18) S(17, 19) S(17, 18) S(20, 21) S(22, 23) S(20, 22) S(21, 23) S(21, 22)     \
+    S(16, 20) S(18, 22) S(18, 20) S(17, 21) S(19, 23) S(19, 21) S(17, 18) S(19, 20) S(21, 22) S(16, 24) S(20, 24)      \
+    S(18, 20) S(22, 24) S(19, 21) S(17, 18) S(19, 20) S(21, 22) S(23, 24) MX(0, 16) MN(8, 24) MX(8, 16) MX(4, 20)      \
+    MN(12, 20) MN(12, 16) MX(2, 18) MN(10, 18) MN(6, 22) MX(6, 10) MX(10, 12) MX(1, 17) MX(9, 17) MX(5, 21)            \
+    MN(13, 21) MN(13, 17) MX(3, 19) MN(11, 19) MN(7, 23) MX(7, 11) MN(11, 13) MX(11, 12)
+
+#define SCALAR_S(a, b)                                                                                                 \
+    {                                                                                                                  \
+        unsigned char t_ = v[a];                                                                                       \
+        v[a] = t_ < v[b] ? t_ : v[b];                                                                                  \
+        v[b] = t_ < v[b] ? v[b] : t_;                                                                                  \
+    }
+#define SCALAR_MN(a, b) v[a] = v[a] < v[b] ? v[a] : v[b];
+#define SCALAR_MX(a, b) v[b] = v[a] < v[b] ? v[b] : v[a];
+
+#if defined(__SSE2__)
+#define VECTOR_S(a, b)                                                                                                 \
+    {                                                                                                                  \
+        __m128i t_ = v[a];                                                                                             \
+        v[a] = _mm_min_epu8(t_, v[b]);                                                                                 \
+        v[b] = _mm_max_epu8(t_, v[b]);                                                                                 \
+    }
+#define VECTOR_MN(a, b) v[a] = _mm_min_epu8(v[a], v[b]);
+#define VECTOR_MX(a, b) v[b] = _mm_max_epu8(v[a], v[b]);
+#endif
+
+/*
+ * 用排序网络计算一行输出：rows 是窗口内已按钳制边界展开的 side 个源行，输出字节 j 的窗口元素
+ * 位于 rows[dy] + j + dx * channels。交错数据的各通道都按字节独立处理，SSE2 下每次16个字节。
+ */
+#if defined(__SSE2__)
+#define MEDIAN_DEFINE_ROW(name, side, NETWORK)                                                                         \
+    static void name(const unsigned char *const *rows, int channels, size_t n, unsigned char *out)                     \
+    {                                                                                                                  \
+        size_t j = 0;                                                                                                  \
+        for (; j + MEDIAN_LANES <= n; j += MEDIAN_LANES) {                                                             \
+            __m128i v[(side) * (side)];                                                                                \
+            for (int dy = 0; dy < (side); dy++)                                                                        \
+                for (int dx = 0; dx < (side); dx++)                                                                    \
+                    v[dy * (side) + dx] =                                                                              \
+                        _mm_loadu_si128((const __m128i *)(rows[dy] + j + (size_t)dx * channels));                      \
+            NETWORK(VECTOR_S, VECTOR_MN, VECTOR_MX)                                                                    \
+            _mm_storeu_si128((__m128i *)(out + j), v[(side) * (side) / 2]);                                            \
+        }                                                                                                              \
+        for (; j < n; j++) {                                                                                           \
+            unsigned char v[(side) * (side)];                                                                          \
+            for (int dy = 0; dy < (side); dy++)                                                                        \
+                for (int dx = 0; dx < (side); dx++)                                                                    \
+                    v[dy * (side) + dx] = rows[dy][j + (size_t)dx * channels];                                         \
+            NETWORK(SCALAR_S, SCALAR_MN, SCALAR_MX)                                                                    \
+            out[j] = v[(side) * (side) / 2];                                                                           \
+        }                                                                                                              \
+    }
+#else
+#define MEDIAN_DEFINE_ROW(name, side, NETWORK)                                                                         \
+    static void name(const unsigned char *const *rows, int channels, size_t n, unsigned char *out)                     \
+    {                                                                                                                  \
+        for (size_t j = 0; j < n; j++) {                                                                               \
+            unsigned char v[(side) * (side)];                                                                          \
+            for (int dy = 0; dy < (side); dy++)                                                                        \
+                for (int dx = 0; dx < (side); dx++)                                                                    \
+                    v[dy * (side) + dx] = rows[dy][j + (size_t)dx * channels];                                         \
+            NETWORK(SCALAR_S, SCALAR_MN, SCALAR_MX)                                                                    \
+            out[j] = v[(side) * (side) / 2];                                                                           \
+        }                                                                                                              \
+    }
+#endif
+
+MEDIAN_DEFINE_ROW(median3_row, 3, MEDIAN_NETWORK_9)
+MEDIAN_DEFINE_ROW(median5_row, 5, MEDIAN_NETWORK_25)
+
+static inline int clamp_index(int v, int n)
+{
+    return v < 0 ? 0 : (v >= n ? n - 1 : v);
+}
+
+/**
+ * @brief 把源图像第 y 行（钳制到图像内）中 [roi.x - r, roi.x + roi.w + r) 的像素展开到 out，图像外的列按钳制取值。
+ */
+static void pad_row(const median_job_t *job, int y, unsigned char *out)
+{
+    int c = job->channels;
+    int r = job->radius;
+    const unsigned char *row = job->data + (size_t)clamp_index(y, job->height) * job->stride;
+    int x0 = job->roi.x - r;
+    int x1 = job->roi.x + job->roi.w + r;
+    // 图像内的部分整段复制，两端越界的少量像素逐个钳制
+    int in0 = x0 < 0 ? 0 : x0;
+    int in1 = x1 > job->width ? job->width : x1;
+    for (int x = x0; x < in0; x++)
+        memcpy(out + (size_t)(x - x0) * c, row, (size_t)c);
+    memcpy(out + (size_t)(in0 - x0) * c, row + (size_t)in0 * c, (size_t)(in1 - in0) * c);
+    for (int x = in1; x < x1; x++)
+        memcpy(out + (size_t)(x - x0) * c, row + (size_t)(job->width - 1) * c, (size_t)c);
+}
+
+/**
+ * @brief 排序网络路径（半径1或2）：展开后的源行放在 2r+1 行的环形缓冲区中，每个源行只展开一次。
+ */
+static void network_rows(void *arg, int begin, int end)
+{
+    median_job_t *job = (median_job_t *)arg;
+    int r = job->radius;
+    int side = 2 * r + 1;
+    // 每行末尾多留一个寄存器宽度，最后一个不完整的向量读取时不越界
+    size_t padded_bytes = (size_t)(job->roi.w + 2 * r) * job->channels + MEDIAN_LANES;
+    unsigned char *ring = (unsigned char *)malloc(padded_bytes * side);
+    if (!ring) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // 相对 roi.y 的第 sy 行存放在环形缓冲区的第 sy mod side 行
+#define RING_ROW(sy) (ring + (size_t)((((sy) % side) + side) % side) * padded_bytes)
+    for (int sy = begin - r; sy < begin + r; sy++)
+        pad_row(job, job->roi.y + sy, RING_ROW(sy));
+
+    size_t row_bytes = (size_t)job->roi.w * job->channels;
+    for (int y = begin; y < end; y++) {
+        pad_row(job, job->roi.y + y + r, RING_ROW(y + r));
+        const unsigned char *rows[5];
+        for (int dy = 0; dy < side; dy++)
+            rows[dy] = RING_ROW(y - r + dy);
+        unsigned char *out = job->dst + (size_t)y * job->dst_stride;
+        if (r == 1)
+            median3_row(rows, job->channels, row_bytes, out);
+        else
+            median5_row(rows, job->channels, row_bytes, out);
+    }
+#undef RING_ROW
+    free(ring);
+}
+
+/**
+ * @brief h += add - sub（16位计数，逐桶）。
+ */
+static inline void hist_slide(uint16_t *h, const uint16_t *add, const uint16_t *sub, int n)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(add + i));
+        __m128i s = _mm_loadu_si128((const __m128i *)(sub + i));
+        __m128i v = _mm_loadu_si128((const __m128i *)(h + i));
+        _mm_storeu_si128((__m128i *)(h + i), _mm_add_epi16(v, _mm_sub_epi16(a, s)));
+    }
+#endif
+    for (; i < n; i++)
+        h[i] = (uint16_t)(h[i] + add[i] - sub[i]);
+}
+
+/**
+ * @brief 在核直方图中查找第 rank 小（从0开始）的值：先在16桶的粗直方图中定位，再在对应的16个细桶中查找。
+ */
+static inline unsigned char hist_select(const uint16_t *fine, const uint16_t *coarse, int rank)
+{
+    int sum = 0;
+    int b = 0;
+    while (sum + coarse[b] <= rank)
+        sum += coarse[b++];
+    const uint16_t *f = fine + b * 16;
+    int v = 0;
+    while (sum + f[v] <= rank)
+        sum += f[v++];
+    return (unsigned char)(b * 16 + v);
+}
+
+/**
+ * @brief 直方图路径（Perreault–Hébert）：列直方图随输出行下移增量更新，核直方图随窗口右移增量更新。
+ *
+ * 列直方图覆盖 [roi.x - r, roi.x + roi.w + r) 的每一列（图像外的列按钳制对应到边界列），
+ * 每列每个通道一个256桶的细直方图和一个16桶的粗直方图。
+ */
+static void histogram_rows(void *arg, int begin, int end)
+{
+    median_job_t *job = (median_job_t *)arg;
+    int r = job->radius;
+    int c = job->channels;
+    int cols = job->roi.w + 2 * r;
+    int x0 = job->roi.x - r;
+    int rank = (2 * r + 1) * (2 * r + 1) / 2;
+
+    uint16_t *col_fine = (uint16_t *)calloc((size_t)cols * c * 256, sizeof(uint16_t));
+    uint16_t *col_coarse = (uint16_t *)calloc((size_t)cols * c * 16, sizeof(uint16_t));
+    uint16_t *kernel_fine = (uint16_t *)malloc((size_t)c * 256 * sizeof(uint16_t));
+    uint16_t *kernel_coarse = (uint16_t *)malloc((size_t)c * 16 * sizeof(uint16_t));
+    // 每个列直方图对应的源像素在行内的字节偏移
+    size_t *col_offset = (size_t *)malloc((size_t)cols * sizeof(size_t));
+    if (!col_fine || !col_coarse || !kernel_fine || !kernel_coarse || !col_offset) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        free(col_fine);
+        free(col_coarse);
+        free(kernel_fine);
+        free(kernel_coarse);
+        free(col_offset);
+        return;
+    }
+    for (int i = 0; i < cols; i++)
+        col_offset[i] = (size_t)clamp_index(x0 + i, job->width) * c;
+
+    // 第一行输出的列直方图：源行 [begin - r, begin + r]（钳制）
+    for (int dy = -r; dy <= r; dy++) {
+        const unsigned char *row =
+            job->data + (size_t)clamp_index(job->roi.y + begin + dy, job->height) * job->stride;
+        for (int i = 0; i < cols; i++) {
+            for (int ch = 0; ch < c; ch++) {
+                unsigned char v = row[col_offset[i] + ch];
+                size_t h = (size_t)i * c + ch;
+                col_fine[h * 256 + v]++;
+                col_coarse[h * 16 + (v >> 4)]++;
+            }
+        }
+    }
+
+    for (int y = begin; y < end; y++) {
+        // 下移一行：每列减去离开窗口的源行、加上进入窗口的源行（钳制后是同一行时不变）
+        if (y > begin) {
+            int out_y = clamp_index(job->roi.y + y - 1 - r, job->height);
+            int in_y = clamp_index(job->roi.y + y + r, job->height);
+            if (out_y != in_y) {
+                const unsigned char *out_row = job->data + (size_t)out_y * job->stride;
+                const unsigned char *in_row = job->data + (size_t)in_y * job->stride;
+                for (int i = 0; i < cols; i++) {
+                    for (int ch = 0; ch < c; ch++) {
+                        unsigned char old_v = out_row[col_offset[i] + ch];
+                        unsigned char new_v = in_row[col_offset[i] + ch];
+                        size_t h = (size_t)i * c + ch;
+                        col_fine[h * 256 + old_v]--;
+                        col_coarse[h * 16 + (old_v >> 4)]--;
+                        col_fine[h * 256 + new_v]++;
+                        col_coarse[h * 16 + (new_v >> 4)]++;
+                    }
+                }
+            }
+        }
+
+        // 每行第一个窗口的核直方图由前 2r+1 个列直方图相加得到
+        memset(kernel_fine, 0, (size_t)c * 256 * sizeof(uint16_t));
+        memset(kernel_coarse, 0, (size_t)c * 16 * sizeof(uint16_t));
+        for (int i = 0; i <= 2 * r; i++) {
+            for (int ch = 0; ch < c; ch++) {
+                size_t h = (size_t)i * c + ch;
+                for (int b = 0; b < 256; b++)
+                    kernel_fine[ch * 256 + b] += col_fine[h * 256 + b];
+                for (int b = 0; b < 16; b++)
+                    kernel_coarse[ch * 16 + b] += col_coarse[h * 16 + b];
+            }
+        }
+
+        unsigned char *out = job->dst + (size_t)y * job->dst_stride;
+        for (int x = 0; x < job->roi.w; x++) {
+            for (int ch = 0; ch < c; ch++)
+                out[(size_t)x * c + ch] = hist_select(kernel_fine + ch * 256, kernel_coarse + ch * 16, rank);
+            if (x + 1 == job->roi.w)
+                break;
+            // 右移一列：加上进入窗口的列直方图，减去离开窗口的列直方图
+            size_t add = (size_t)(x + 2 * r + 1) * c;
+            size_t sub = (size_t)x * c;
+            for (int ch = 0; ch < c; ch++) {
+                hist_slide(kernel_fine + ch * 256, col_fine + (add + ch) * 256, col_fine + (sub + ch) * 256, 256);
+                hist_slide(kernel_coarse + ch * 16, col_coarse + (add + ch) * 16, col_coarse + (sub + ch) * 16, 16);
+            }
+        }
+    }
+
+    free(col_fine);
+    free(col_coarse);
+    free(kernel_fine);
+    free(kernel_coarse);
+    free(col_offset);
+}
+
+/**
+ * @brief 对图像中的矩形区域做中值滤波，窗口为 (2*radius+1) x (2*radius+1)，图像边界外按钳制取值。
+ *
+ * 半径1和2（3x3、5x5）使用剪枝后的中值选择网络，SSE2 下一次处理16个字节（任意通道数的交错数据都按字节处理）；
+ * 更大的半径使用 Perreault–Hébert 方法：每列维护一个列直方图，输出行下移时每列只加一个像素、减一个像素，
+ * 窗口右移时核直方图加上新进入的列直方图、减去移出的列直方图，再借助16桶的粗直方图查找中值，
+ * 每像素的开销与半径无关。按行分块并行。
+ * @param data 整幅图像的像素数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param stride 图像的行步长（字节）。
+ * @param roi 处理区域，超出图像的部分会被裁剪。
+ * @param radius 窗口半径，0 到 MEDIAN_MAX_RADIUS。
+ * @param dst 输出区域左上角像素的地址，不能与 data 重叠。
+ * @param dst_stride 输出的行步长（字节）。
+ * @return 成功返回1，失败返回0。
+ */
+int median_filter_roi(const unsigned char *data,
+                      int width,
+                      int height,
+                      int channels,
+                      int stride,
+                      image_rect_t roi,
+                      int radius,
+                      unsigned char *dst,
+                      int dst_stride)
+{
+    if (!data || !dst || width <= 0 || height <= 0 || channels <= 0 || !image_rect_clip(&roi, width, height)) {
+        LOG_ERROR("Invalid parameters for median_filter_roi");
+        return 0;
+    }
+    if (radius < 0 || radius > MEDIAN_MAX_RADIUS) {
+        LOG_ERROR("Median radius %d is out of range (0-%d)", radius, MEDIAN_MAX_RADIUS);
+        return 0;
+    }
+
+    if (radius == 0) {
+        for (int y = 0; y < roi.h; y++) {
+            memcpy(dst + (size_t)y * dst_stride,
+                   data + (size_t)(roi.y + y) * stride + (size_t)roi.x * channels,
+                   (size_t)roi.w * channels);
+        }
+        return 1;
+    }
+
+    median_job_t job = {data, width, height, channels, stride, roi, radius, dst, dst_stride, 0};
+    parallel_for(roi.h, MEDIAN_MIN_ROWS, radius <= 2 ? network_rows : histogram_rows, &job);
+    return !job.failed;
+}
+
+/**
+ * @brief 对整幅图像做中值滤波，原地写回。
+ * @param data 图像的像素数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param radius 窗口半径，0 到 MEDIAN_MAX_RADIUS。
+ * @return 成功返回1，失败返回0。
+ */
+int median_filter(unsigned char *data, int width, int height, int channels, int radius)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0) {
+        return 0;
+    }
+
+    // 每个输出像素都要读取原始邻域，结果先写入新缓冲区再复制回去
+    size_t size = (size_t)width * height * channels;
+    unsigned char *result = (unsigned char *)malloc(size);
+    if (!result) {
+        LOG_ERROR("Memory allocation failed in median_filter");
+        return 0;
+    }
+    image_rect_t full = {0, 0, width, height};
+    int ok = median_filter_roi(data, width, height, channels, width * channels, full, radius, result, width * channels);
+    if (ok)
+        memcpy(data, result, size);
+    free(result);
+    return ok;
+}
@@ -0,0 +1,480 @@
+#include "metrics.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// 后台线程检查停止标志的间隔（毫秒）
+#define METRICS_POLL_MS 100
+// 延迟直方图第一个桶的上界（纳秒）
+#define METRICS_FIRST_BUCKET_NS 250000ull
+
+// 一个线程的全部计数器，只包含 uint64_t，汇总时按数组逐项相加
+typedef struct
+{
+    uint64_t effect_runs[METRICS_EFFECT_COUNT];
+    uint64_t effect_pixels[METRICS_EFFECT_COUNT];
+    uint64_t effect_ns[METRICS_EFFECT_COUNT];
+    uint64_t stage_buckets[METRICS_STAGE_COUNT][METRICS_LATENCY_BUCKETS];
+    uint64_t stage_count[METRICS_STAGE_COUNT];
+    uint64_t stage_ns[METRICS_STAGE_COUNT];
+    uint64_t stage_bytes[METRICS_STAGE_COUNT];
+    uint64_t stage_failures[METRICS_STAGE_COUNT];
+    uint64_t images_ok;
+    uint64_t images_failed;
+} metrics_counters_t;
+
+// 按缓存行对齐，各线程只写自己的计数槽，热路径上没有跨核的缓存行争用
+typedef struct
+{
+    metrics_counters_t c;
+} __attribute__((aligned(64))) metrics_slot_t;
+
+static metrics_slot_t slots[METRICS_MAX_THREADS];
+static int slot_next = 0;
+static __thread metrics_counters_t *thread_slot = NULL;
+
+// 图像数量的计数（用于计算等待中和处理中的图像数）
+static int images_total = 0;
+static int images_started = 0;
+static int images_finished = 0;
+
+// 后台输出线程的状态
+static uint64_t start_ns = 0;
+static char stats_file[512];
+static int report_interval = 0;
+static int reporter_stop = 0;
+static int reporter_running = 0;
+#ifdef _WIN32
+static HANDLE reporter_thread;
+#else
+static pthread_t reporter_thread;
+#endif
+
+// 上一次状态行的汇总，用于计算区间速率
+static metrics_counters_t last_report;
+static uint64_t last_report_ns = 0;
+
+static const char *effect_names[METRICS_EFFECT_COUNT] = {
+    "grayscale", "blur", "invert", "rotate", "edge", "resize", "ascii", "thumbnail", "ops", "hash"};
+static const char *stage_names[METRICS_STAGE_COUNT] = {"decode", "encode"};
+
+#define COUNTER_ADD(field, value) __atomic_fetch_add(&(field), (uint64_t)(value), __ATOMIC_RELAXED)
+
+/**
+ * @brief 单调时钟的当前时间（纳秒）。
+ * @return 纳秒数。
+ */
+uint64_t metrics_now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart * (1e9 / frequency.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief 当前线程的计数槽，第一次调用时领取一个。
+ */
+static metrics_counters_t *counters(void)
+{
+    if (!thread_slot) {
+        int index = __atomic_fetch_add(&slot_next, 1, __ATOMIC_RELAXED);
+        thread_slot = &slots[index % METRICS_MAX_THREADS].c;
+    }
+    return thread_slot;
+}
+
+/**
+ * @brief 把所有线程的计数汇总到 sum。
+ */
+static void collect(metrics_counters_t *sum)
+{
+    int used = __atomic_load_n(&slot_next, __ATOMIC_RELAXED);
+    if (used > METRICS_MAX_THREADS)
+        used = METRICS_MAX_THREADS;
+
+    const size_t fields = sizeof(metrics_counters_t) / sizeof(uint64_t);
+    uint64_t *out = (uint64_t *)sum;
+    memset(sum, 0, sizeof(*sum));
+    for (int i = 0; i < used; i++) {
+        uint64_t *in = (uint64_t *)&slots[i].c;
+        for (size_t f = 0; f < fields; f++)
+            out[f] += __atomic_load_n(&in[f], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 耗时所在的延迟直方图桶。
+ */
+static int latency_bucket(uint64_t ns)
+{
+    uint64_t bound = METRICS_FIRST_BUCKET_NS;
+    int bucket = 0;
+    while (bucket < METRICS_LATENCY_BUCKETS - 1 && ns > bound) {
+        bound <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief 记录一次效果的运行。
+ * @param effect 效果。
+ * @param pixels 处理的像素数。
+ * @param ns 耗时（纳秒）。
+ */
+void metrics_record_effect(metrics_effect_t effect, long long pixels, uint64_t ns)
+{
+    if ((int)effect < 0 || effect >= METRICS_EFFECT_COUNT)
+        return;
+    metrics_counters_t *c = counters();
+    COUNTER_ADD(c->effect_runs[effect], 1);
+    COUNTER_ADD(c->effect_pixels[effect], pixels);
+    COUNTER_ADD(c->effect_ns[effect], ns);
+}
+
+/**
+ * @brief 记录一次解码或编码：累加字节数并把耗时计入延迟直方图。
+ * @param stage 阶段。
+ * @param bytes 读取（解码）或写出（编码）的字节数。
+ * @param ns 耗时（纳秒）。
+ * @param ok 是否成功，失败时只计入失败次数。
+ */
+void metrics_record_stage(metrics_stage_t stage, long long bytes, uint64_t ns, int ok)
+{
+    if ((int)stage < 0 || stage >= METRICS_STAGE_COUNT)
+        return;
+    metrics_counters_t *c = counters();
+    if (!ok) {
+        COUNTER_ADD(c->stage_failures[stage], 1);
+        return;
+    }
+    COUNTER_ADD(c->stage_buckets[stage][latency_bucket(ns)], 1);
+    COUNTER_ADD(c->stage_count[stage], 1);
+    COUNTER_ADD(c->stage_ns[stage], ns);
+    COUNTER_ADD(c->stage_bytes[stage], bytes);
+}
+
+/**
+ * @brief 标记一幅图像开始处理（等待中的图像数减一，处理中的图像数加一）。
+ */
+void metrics_image_begin(void)
+{
+    __atomic_fetch_add(&images_started, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 标记一幅图像由其他进程处理（从图像总数中去掉，不计入完成的图像）。
+ */
+void metrics_image_skip(void)
+{
+    __atomic_fetch_sub(&images_total, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 标记一幅图像处理结束。
+ * @param ok 是否成功。
+ */
+void metrics_image_end(int ok)
+{
+    metrics_counters_t *c = counters();
+    if (ok)
+        COUNTER_ADD(c->images_ok, 1);
+    else
+        COUNTER_ADD(c->images_failed, 1);
+    __atomic_fetch_add(&images_finished, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 由直方图估计百分位延迟（毫秒），取所在桶的上界。
+ */
+static double latency_percentile_ms(const uint64_t buckets[METRICS_LATENCY_BUCKETS], uint64_t count, double q)
+{
+    if (count == 0)
+        return 0.0;
+    uint64_t target = (uint64_t)(q * count + 0.5);
+    if (target < 1)
+        target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target)
+            return (double)(METRICS_FIRST_BUCKET_NS << i) / 1e6;
+    }
+    return (double)(METRICS_FIRST_BUCKET_NS << (METRICS_LATENCY_BUCKETS - 1)) / 1e6;
+}
+
+/**
+ * @brief 以 INFO 级别输出一行状态：速率按上一次状态行以来的区间计算，最终状态行按整个运行计算。
+ */
+static void print_status(int final)
+{
+    // quiet 模式下不输出状态行，也就不必汇总
+    if (!log_enabled(LOG_LEVEL_INFO))
+        return;
+
+    metrics_counters_t now;
+    collect(&now);
+    uint64_t t = metrics_now_ns();
+
+    const metrics_counters_t *base = final ? NULL : &last_report;
+    double seconds = (t - (final ? start_ns : last_report_ns)) / 1e9;
+    if (seconds <= 0.0)
+        seconds = 1e-9;
+
+    uint64_t images = now.images_ok + now.images_failed;
+    uint64_t base_images = base ? base->images_ok + base->images_failed : 0;
+    int total = __atomic_load_n(&images_total, __ATOMIC_RELAXED);
+    int started = __atomic_load_n(&images_started, __ATOMIC_RELAXED);
+    int finished = __atomic_load_n(&images_finished, __ATOMIC_RELAXED);
+
+    const uint64_t *decode = now.stage_buckets[METRICS_STAGE_DECODE];
+    const uint64_t *encode = now.stage_buckets[METRICS_STAGE_ENCODE];
+    uint64_t decodes = now.stage_count[METRICS_STAGE_DECODE];
+    uint64_t encodes = now.stage_count[METRICS_STAGE_ENCODE];
+
+    char line[1024];
+    int n = snprintf(line,
+                     sizeof(line),
+                     "[stats] %.1fs images %llu/%d (%llu failed, %d in flight, %d pending) %.2f img/s"
+                     ", decode p50 %.1fms p99 %.1fms, encode p50 %.1fms p99 %.1fms, written %.1f MB",
+                     (t - start_ns) / 1e9,
+                     (unsigned long long)images,
+                     total,
+                     (unsigned long long)now.images_failed,
+                     started - finished,
+                     total - started,
+                     (images - base_images) / seconds,
+                     latency_percentile_ms(decode, decodes, 0.5),
+                     latency_percentile_ms(decode, decodes, 0.99),
+                     latency_percentile_ms(encode, encodes, 0.5),
+                     latency_percentile_ms(encode, encodes, 0.99),
+                     now.stage_bytes[METRICS_STAGE_ENCODE] / 1e6);
+
+    // 各效果的吞吐量按效果自身的耗时计算，不受其他阶段影响
+    for (int e = 0; e < METRICS_EFFECT_COUNT && n > 0 && (size_t)n < sizeof(line); e++) {
+        uint64_t pixels = now.effect_pixels[e] - (base ? base->effect_pixels[e] : 0);
+        uint64_t ns = now.effect_ns[e] - (base ? base->effect_ns[e] : 0);
+        if (ns > 0)
+            n += snprintf(line + n,
+                          sizeof(line) - n,
+                          "%s %s %.1f MP/s",
+                          e ? "," : " |",
+                          effect_names[e],
+                          pixels * 1e3 / ns);
+    }
+
+    LOG_INFO("%s", line);
+    last_report = now;
+    last_report_ns = t;
+}
+
+/**
+ * @brief 输出一个带单个标签的整数样本。
+ */
+static void write_labeled(FILE *fp, const char *metric, const char *label, const char *value, uint64_t count)
+{
+    fprintf(fp, "%s{%s=\"%s\"} %llu\n", metric, label, value, (unsigned long long)count);
+}
+
+/**
+ * @brief 以 Prometheus 文本格式输出当前的全部计数。
+ * @param fp 输出流。
+ * @return 成功返回1，失败返回0。
+ */
+int metrics_write_prometheus(FILE *fp)
+{
+    metrics_counters_t s;
+    collect(&s);
+    int total = __atomic_load_n(&images_total, __ATOMIC_RELAXED);
+    int started = __atomic_load_n(&images_started, __ATOMIC_RELAXED);
+    int finished = __atomic_load_n(&images_finished, __ATOMIC_RELAXED);
+
+    fprintf(fp, "# HELP imageproc_uptime_seconds Seconds since the batch run started.\n");
+    fprintf(fp, "# TYPE imageproc_uptime_seconds gauge\n");
+    fprintf(fp, "imageproc_uptime_seconds %.3f\n", (metrics_now_ns() - start_ns) / 1e9);
+
+    fprintf(fp, "# HELP imageproc_images_total Images finished, by result.\n");
+    fprintf(fp, "# TYPE imageproc_images_total counter\n");
+    fprintf(fp, "imageproc_images_total{result=\"ok\"} %llu\n", (unsigned long long)s.images_ok);
+    fprintf(fp, "imageproc_images_total{result=\"failed\"} %llu\n", (unsigned long long)s.images_failed);
+
+    fprintf(fp, "# HELP imageproc_images_queued Images waiting to be processed.\n");
+    fprintf(fp, "# TYPE imageproc_images_queued gauge\n");
+    fprintf(fp, "imageproc_images_queued %d\n", total - started);
+    fprintf(fp, "# HELP imageproc_images_in_flight Images being processed.\n");
+    fprintf(fp, "# TYPE imageproc_images_in_flight gauge\n");
+    fprintf(fp, "imageproc_images_in_flight %d\n", started - finished);
+
+    fprintf(fp, "# HELP imageproc_effect_runs_total Effect invocations.\n");
+    fprintf(fp, "# TYPE imageproc_effect_runs_total counter\n");
+    for (int e = 0; e < METRICS_EFFECT_COUNT; e++)
+        write_labeled(fp, "imageproc_effect_runs_total", "effect", effect_names[e], s.effect_runs[e]);
+    fprintf(fp, "# HELP imageproc_effect_pixels_total Pixels processed by each effect.\n");
+    fprintf(fp, "# TYPE imageproc_effect_pixels_total counter\n");
+    for (int e = 0; e < METRICS_EFFECT_COUNT; e++)
+        write_labeled(fp, "imageproc_effect_pixels_total", "effect", effect_names[e], s.effect_pixels[e]);
+    fprintf(fp, "# HELP imageproc_effect_seconds_total Time spent in each effect.\n");
+    fprintf(fp, "# TYPE imageproc_effect_seconds_total counter\n");
+    for (int e = 0; e < METRICS_EFFECT_COUNT; e++)
+        fprintf(fp, "imageproc_effect_seconds_total{effect=\"%s\"} %.6f\n", effect_names[e], s.effect_ns[e] / 1e9);
+
+    fprintf(fp, "# HELP imageproc_bytes_total Bytes read by decoding and written by encoding.\n");
+    fprintf(fp, "# TYPE imageproc_bytes_total counter\n");
+    write_labeled(fp, "imageproc_bytes_total", "direction", "read", s.stage_bytes[METRICS_STAGE_DECODE]);
+    write_labeled(fp, "imageproc_bytes_total", "direction", "written", s.stage_bytes[METRICS_STAGE_ENCODE]);
+
+    fprintf(fp, "# HELP imageproc_stage_failures_total Failed decodes and encodes.\n");
+    fprintf(fp, "# TYPE imageproc_stage_failures_total counter\n");
+    for (int st = 0; st < METRICS_STAGE_COUNT; st++)
+        write_labeled(fp, "imageproc_stage_failures_total", "stage", stage_names[st], s.stage_failures[st]);
+
+    fprintf(fp, "# HELP imageproc_stage_latency_seconds Decode and encode latency.\n");
+    fprintf(fp, "# TYPE imageproc_stage_latency_seconds histogram\n");
+    for (int st = 0; st < METRICS_STAGE_COUNT; st++) {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRICS_LATENCY_BUCKETS - 1; b++) {
+            cumulative += s.stage_buckets[st][b];
+            fprintf(fp,
+                    "imageproc_stage_latency_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                    stage_names[st],
+                    (double)(METRICS_FIRST_BUCKET_NS << b) / 1e9,
+                    (unsigned long long)cumulative);
+        }
+        fprintf(fp,
+                "imageproc_stage_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+                stage_names[st],
+                (unsigned long long)s.stage_count[st]);
+        fprintf(fp, "imageproc_stage_latency_seconds_sum{stage=\"%s\"} %.6f\n", stage_names[st], s.stage_ns[st] / 1e9);
+        write_labeled(fp, "imageproc_stage_latency_seconds_count", "stage", stage_names[st], s.stage_count[st]);
+    }
+    return !ferror(fp);
+}
+
+/**
+ * @brief 写统计文件：先写临时文件再重命名，读取方不会看到写了一半的文件。
+ */
+static void write_stats_file(void)
+{
+    if (!stats_file[0])
+        return;
+
+    char temp_path[sizeof(stats_file) + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", stats_file);
+    FILE *fp = fopen(temp_path, "w");
+    if (!fp) {
+        LOG_ERROR("Error writing stats file '%s'", temp_path);
+        return;
+    }
+    int ok = metrics_write_prometheus(fp);
+    if (fclose(fp) != 0 || !ok) {
+        LOG_ERROR("Error writing stats file '%s'", temp_path);
+        remove(temp_path);
+        return;
+    }
+#ifdef _WIN32
+    // Windows 的 rename 不会覆盖已有文件
+    remove(stats_file);
+#endif
+    if (rename(temp_path, stats_file) != 0)
+        LOG_ERROR("Error replacing stats file '%s'", stats_file);
+}
+
+static void sleep_ms(int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/**
+ * @brief 后台线程：定期写出缓冲的日志（处理一幅大图像时可能长时间没有新日志），
+ *        report_interval 大于0时每隔 report_interval 秒输出一行状态并更新统计文件。
+ */
+#ifdef _WIN32
+static DWORD WINAPI reporter_main(LPVOID arg)
+#else
+static void *reporter_main(void *arg)
+#endif
+{
+    (void)arg;
+    int waited = 0;
+    while (!__atomic_load_n(&reporter_stop, __ATOMIC_ACQUIRE)) {
+        sleep_ms(METRICS_POLL_MS);
+        log_flush_pending();
+        waited += METRICS_POLL_MS;
+        if (report_interval > 0 && waited >= report_interval * 1000) {
+            print_status(0);
+            write_stats_file();
+            waited = 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 开始一次计数：清零所有计数器，启动后台线程定期写出缓冲的日志，并按间隔输出状态行和统计文件。
+ * @param total_images 本次要处理的图像总数（用于计算等待中的图像数）。
+ * @param stats_path 统计文件路径（Prometheus 文本格式，原子替换），NULL 表示不写文件。
+ * @param interval_seconds 输出间隔（秒），<=0 时只在 metrics_stop 时输出一次。
+ */
+void metrics_start(int total_images, const char *stats_path, int interval_seconds)
+{
+    memset(slots, 0, sizeof(slots));
+    memset(&last_report, 0, sizeof(last_report));
+    images_total = total_images;
+    images_started = 0;
+    images_finished = 0;
+    start_ns = metrics_now_ns();
+    last_report_ns = start_ns;
+
+    stats_file[0] = '\0';
+    if (stats_path)
+        snprintf(stats_file, sizeof(stats_file), "%s", stats_path);
+
+    report_interval = interval_seconds;
+    reporter_stop = 0;
+    reporter_running = 0;
+#ifdef _WIN32
+    reporter_thread = CreateThread(NULL, 0, reporter_main, NULL, 0, NULL);
+    reporter_running = reporter_thread != NULL;
+#else
+    reporter_running = pthread_create(&reporter_thread, NULL, reporter_main, NULL) == 0;
+#endif
+}
+
+/**
+ * @brief 结束计数：停止后台线程，输出最终的状态行并写最后一次统计文件。
+ */
+void metrics_stop(void)
+{
+    if (reporter_running) {
+        __atomic_store_n(&reporter_stop, 1, __ATOMIC_RELEASE);
+#ifdef _WIN32
+        WaitForSingleObject(reporter_thread, INFINITE);
+        CloseHandle(reporter_thread);
+#else
+        pthread_join(reporter_thread, NULL);
+#endif
+        reporter_running = 0;
+    }
+    print_status(1);
+    write_stats_file();
+}
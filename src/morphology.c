@@ -0,0 +1,362 @@
+#include "morphology.h"
+#include "parallel.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 灰度图纵向一遍每个任务处理的列宽（字节），二值图为 MORPH_BAND_WORDS 个64位字
+#define MORPH_BAND_BYTES 256
+#define MORPH_BAND_WORDS 16
+// 横向一遍每个任务的最少行数
+#define MORPH_MIN_ROWS 16
+
+// 一次形态学运算的共享状态
+typedef struct
+{
+    unsigned char *data;
+    uint64_t *bits; // 二值图按位打包后的数据，每行 words 个字；灰度图为NULL
+    int width, height, channels;
+    int words;  // 二值图每行的字数
+    int k;      // 当前一遍的结构元素长度
+    int is_max; // 当前一遍是膨胀（最大值/OR）还是腐蚀（最小值/AND）
+    int failed; // 任一任务分配临时缓冲区失败时置1
+} morph_job_t;
+
+#define MORPH_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MORPH_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MORPH_OR(a, b) ((a) | (b))
+#define MORPH_AND(a, b) ((a) & (b))
+
+/*
+ * van Herk/Gil-Werman 一维滑动最大/最小值，原地写回。序列有 n 个元素，第 i 个元素从 data + i * step 开始，
+ * 由 cols 个相互独立的列组成（横向一遍为一个像素的各通道，纵向一遍为一段连续的行数据）。
+ * 序列两端各补齐到 anchor 和 k - 1 - anchor 个 fill（运算的单位元），补齐后的序列按 k 个元素分块，
+ * g 为块内前缀、hb 为块内后缀，窗口 [x, x + k - 1] 的结果为 OP(hb[x], g[x + k - 1])。
+ * g 和 hb 各需要 (n + k - 1) * cols 个元素。
+ */
+#define MORPH_DEFINE_VHGW(name, type, OP)                                                                              \
+    static void name(type *data, size_t step, int n, int cols, int k, type fill, type *g, type *hb)                    \
+    {                                                                                                                  \
+        int anchor = k / 2;                                                                                            \
+        int total = n + k - 1;                                                                                         \
+        for (int i = 0; i < total; i++) {                                                                              \
+            int x = i - anchor;                                                                                        \
+            type *gi = g + (size_t)i * cols;                                                                           \
+            if (i % k == 0) {                                                                                          \
+                for (int j = 0; j < cols; j++)                                                                         \
+                    gi[j] = fill;                                                                                      \
+            }                                                                                                          \
+            else {                                                                                                     \
+                memcpy(gi, gi - cols, (size_t)cols * sizeof(type));                                                    \
+            }                                                                                                          \
+            if (x >= 0 && x < n) {                                                                                     \
+                const type *s = data + (size_t)x * step;                                                               \
+                for (int j = 0; j < cols; j++)                                                                         \
+                    gi[j] = OP(gi[j], s[j]);                                                                           \
+            }                                                                                                          \
+        }                                                                                                              \
+        for (int i = total - 1; i >= 0; i--) {                                                                         \
+            int x = i - anchor;                                                                                        \
+            type *hi = hb + (size_t)i * cols;                                                                          \
+            if (i % k == k - 1 || i == total - 1) {                                                                    \
+                for (int j = 0; j < cols; j++)                                                                         \
+                    hi[j] = fill;                                                                                      \
+            }                                                                                                          \
+            else {                                                                                                     \
+                memcpy(hi, hi + cols, (size_t)cols * sizeof(type));                                                    \
+            }                                                                                                          \
+            if (x >= 0 && x < n) {                                                                                     \
+                const type *s = data + (size_t)x * step;                                                               \
+                for (int j = 0; j < cols; j++)                                                                         \
+                    hi[j] = OP(hi[j], s[j]);                                                                           \
+            }                                                                                                          \
+        }                                                                                                              \
+        for (int x = 0; x < n; x++) {                                                                                  \
+            type *d = data + (size_t)x * step;                                                                         \
+            const type *hx = hb + (size_t)x * cols;                                                                    \
+            const type *gx = g + (size_t)(x + k - 1) * cols;                                                           \
+            for (int j = 0; j < cols; j++)                                                                             \
+                d[j] = OP(hx[j], gx[j]);                                                                               \
+        }                                                                                                              \
+    }
+
+MORPH_DEFINE_VHGW(vhgw_max_u8, unsigned char, MORPH_MAX)
+MORPH_DEFINE_VHGW(vhgw_min_u8, unsigned char, MORPH_MIN)
+MORPH_DEFINE_VHGW(vhgw_or_u64, uint64_t, MORPH_OR)
+MORPH_DEFINE_VHGW(vhgw_and_u64, uint64_t, MORPH_AND)
+
+/**
+ * @brief 判断图像是否为二值图：每个样本都是0或255，且同一像素的各通道相同（例如边缘检测的输出）。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @return 是二值图返回1，否则返回0。
+ */
+int morphology_is_binary(const unsigned char *data, int width, int height, int channels)
+{
+    size_t pixels = (size_t)width * height;
+    for (size_t i = 0; i < pixels; i++) {
+        const unsigned char *p = data + i * channels;
+        if (p[0] != 0 && p[0] != 255)
+            return 0;
+        for (int ch = 1; ch < channels; ch++) {
+            if (p[ch] != p[0])
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 灰度图横向一遍：每行做一次一维滑动最大/最小值。
+ */
+static void gray_rows(void *arg, int begin, int end)
+{
+    morph_job_t *job = (morph_job_t *)arg;
+    int c = job->channels;
+    size_t scratch = (size_t)(job->width + job->k - 1) * c;
+    unsigned char *g = (unsigned char *)malloc(scratch * 2);
+    if (!g) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (int y = begin; y < end; y++) {
+        unsigned char *row = job->data + (size_t)y * job->width * c;
+        if (job->is_max)
+            vhgw_max_u8(row, (size_t)c, job->width, c, job->k, 0, g, g + scratch);
+        else
+            vhgw_min_u8(row, (size_t)c, job->width, c, job->k, 255, g, g + scratch);
+    }
+    free(g);
+}
+
+/**
+ * @brief 灰度图纵向一遍：按列带处理，每个列带内各行的一段连续数据作为序列的一个元素，内层循环是连续访问。
+ */
+static void gray_columns(void *arg, int begin, int end)
+{
+    morph_job_t *job = (morph_job_t *)arg;
+    size_t row_bytes = (size_t)job->width * job->channels;
+    size_t scratch = (size_t)(job->height + job->k - 1) * MORPH_BAND_BYTES;
+    unsigned char *g = (unsigned char *)malloc(scratch * 2);
+    if (!g) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (int band = begin; band < end; band++) {
+        size_t x0 = (size_t)band * MORPH_BAND_BYTES;
+        int cols = (int)(row_bytes - x0 < MORPH_BAND_BYTES ? row_bytes - x0 : MORPH_BAND_BYTES);
+        if (job->is_max)
+            vhgw_max_u8(job->data + x0, row_bytes, job->height, cols, job->k, 0, g, g + scratch);
+        else
+            vhgw_min_u8(job->data + x0, row_bytes, job->height, cols, job->k, 255, g, g + scratch);
+    }
+    free(g);
+}
+
+/**
+ * @brief 取按位打包的一行中的第 i 个字，超出一行时返回 fill。
+ */
+static inline uint64_t word_at(const uint64_t *row, int words, long i, uint64_t fill)
+{
+    return i < words ? row[i] : fill;
+}
+
+/**
+ * @brief 移位一行按位打包的像素：out 的第 x 位等于 src 的第 x + shift 位（shift >= 0），超出一行的位置取 fill。
+ */
+static void shift_bits(const uint64_t *src, int words, uint64_t *out, int out_words, long shift, uint64_t fill)
+{
+    long q = shift / 64;
+    int b = (int)(shift % 64);
+    for (int i = 0; i < out_words; i++) {
+        uint64_t lo = word_at(src, words, i + q, fill);
+        if (b == 0) {
+            out[i] = lo;
+        }
+        else {
+            uint64_t hi = word_at(src, words, i + q + 1, fill);
+            out[i] = (lo >> b) | (hi << (64 - b));
+        }
+    }
+}
+
+/**
+ * @brief 二值图横向一遍：用倍增合并，F 依次为长度 1、2、4…… 的窗口，按 k 的二进制位把对应长度的 F
+ *        移位后合并到结果中。每行只需 O(log k) 次整字运算，每个字处理64个像素。
+ */
+static void bits_rows(void *arg, int begin, int end)
+{
+    morph_job_t *job = (morph_job_t *)arg;
+    int words = job->words;
+    int anchor = job->k / 2;
+    // 行前补 pad 个字，窗口向左超出图像的部分也有存储位置，所有移位都是非负的
+    int pad = (anchor + 63) / 64;
+    int padded = words + pad;
+    uint64_t fill = job->is_max ? 0 : ~(uint64_t)0;
+    uint64_t *f = (uint64_t *)malloc((size_t)padded * 3 * sizeof(uint64_t));
+    if (!f) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    uint64_t *tmp = f + padded;
+    uint64_t *acc = tmp + padded;
+
+    // 最后一个字中超出图像宽度的位在横向合并时会移入图像，先置为单位元
+    int tail = job->width % 64;
+    uint64_t tail_mask = tail ? ((uint64_t)1 << tail) - 1 : ~(uint64_t)0;
+
+    for (int y = begin; y < end; y++) {
+        uint64_t *row = job->bits + (size_t)y * words;
+        row[words - 1] = job->is_max ? (row[words - 1] & tail_mask) : (row[words - 1] | ~tail_mask);
+        for (int i = 0; i < pad; i++)
+            f[i] = fill;
+        memcpy(f + pad, row, (size_t)words * sizeof(uint64_t));
+        for (int i = 0; i < padded; i++)
+            acc[i] = fill;
+
+        long offset = 0; // acc 的第 p 位是 [p, p + offset - 1] 的合并结果
+        long span = 1;   // f 的第 p 位是 [p, p + span - 1] 的合并结果
+        for (int remaining = job->k;;) {
+            if (remaining & 1) {
+                shift_bits(f, padded, tmp, padded, offset, fill);
+                for (int i = 0; i < padded; i++)
+                    acc[i] = job->is_max ? (acc[i] | tmp[i]) : (acc[i] & tmp[i]);
+                offset += span;
+            }
+            remaining >>= 1;
+            if (!remaining)
+                break;
+            shift_bits(f, padded, tmp, padded, span, fill);
+            for (int i = 0; i < padded; i++)
+                f[i] = job->is_max ? (f[i] | tmp[i]) : (f[i] & tmp[i]);
+            span *= 2;
+        }
+        // 像素 x 的窗口 [x - anchor, x - anchor + k - 1] 从补齐后的第 x + 64 * pad - anchor 位开始
+        shift_bits(acc, padded, row, words, 64L * pad - anchor, fill);
+    }
+    free(f);
+}
+
+/**
+ * @brief 二值图纵向一遍：按字的列带做 van Herk/Gil-Werman，每次 OR/AND 同时处理64个像素。
+ */
+static void bits_columns(void *arg, int begin, int end)
+{
+    morph_job_t *job = (morph_job_t *)arg;
+    size_t scratch = (size_t)(job->height + job->k - 1) * MORPH_BAND_WORDS;
+    uint64_t *g = (uint64_t *)malloc(scratch * 2 * sizeof(uint64_t));
+    if (!g) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (int band = begin; band < end; band++) {
+        int x0 = band * MORPH_BAND_WORDS;
+        int cols = job->words - x0 < MORPH_BAND_WORDS ? job->words - x0 : MORPH_BAND_WORDS;
+        if (job->is_max)
+            vhgw_or_u64(job->bits + x0, (size_t)job->words, job->height, cols, job->k, 0, g, g + scratch);
+        else
+            vhgw_and_u64(job->bits + x0, (size_t)job->words, job->height, cols, job->k, ~(uint64_t)0, g, g + scratch);
+    }
+    free(g);
+}
+
+static void pack_rows(void *arg, int begin, int end)
+{
+    morph_job_t *job = (morph_job_t *)arg;
+    int c = job->channels;
+    for (int y = begin; y < end; y++) {
+        const unsigned char *src = job->data + (size_t)y * job->width * c;
+        uint64_t *row = job->bits + (size_t)y * job->words;
+        memset(row, 0, (size_t)job->words * sizeof(uint64_t));
+        for (int x = 0; x < job->width; x++)
+            row[x / 64] |= (uint64_t)(src[(size_t)x * c] != 0) << (x % 64);
+    }
+}
+
+static void unpack_rows(void *arg, int begin, int end)
+{
+    morph_job_t *job = (morph_job_t *)arg;
+    int c = job->channels;
+    for (int y = begin; y < end; y++) {
+        unsigned char *dst = job->data + (size_t)y * job->width * c;
+        const uint64_t *row = job->bits + (size_t)y * job->words;
+        for (int x = 0; x < job->width; x++)
+            memset(dst + (size_t)x * c, (row[x / 64] >> (x % 64)) & 1 ? 255 : 0, (size_t)c);
+    }
+}
+
+/**
+ * @brief 一次膨胀或腐蚀：先横向后纵向，长度为1的方向跳过。
+ */
+static void morph_pass(morph_job_t *job, int is_max, int kernel_width, int kernel_height)
+{
+    job->is_max = is_max;
+    if (kernel_width > 1) {
+        job->k = kernel_width;
+        parallel_for(job->height, MORPH_MIN_ROWS, job->bits ? bits_rows : gray_rows, job);
+    }
+    if (kernel_height > 1) {
+        job->k = kernel_height;
+        int bands = job->bits ? (job->words + MORPH_BAND_WORDS - 1) / MORPH_BAND_WORDS
+                              : (int)(((size_t)job->width * job->channels + MORPH_BAND_BYTES - 1) / MORPH_BAND_BYTES);
+        parallel_for(bands, 1, job->bits ? bits_columns : gray_columns, job);
+    }
+}
+
+/**
+ * @brief 使用矩形结构元素对图像做形态学运算，原地写回。
+ *
+ * 矩形结构元素可分离为横向和纵向两遍一维最大/最小值滤波，每遍使用 van Herk/Gil-Werman 算法：
+ * 序列按结构元素长度分块，计算块内前缀和后缀的最大/最小值，每个输出只需合并一个后缀和一个前缀，
+ * 每像素的比较次数与结构元素大小无关。图像外的位置不参与运算。
+ * 二值图（见 morphology_is_binary）按位打包，每个64位字存64个像素，纵向一遍对整字做 OR/AND，
+ * 横向一遍用倍增的移位合并，结果与逐像素计算完全相同。两遍都拆分到多个线程执行。
+ * @param data 图像数据（交错布局、紧密排列）。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param op 形态学运算。
+ * @param kernel_width 结构元素宽度（锚点在 kernel_width / 2）。
+ * @param kernel_height 结构元素高度（锚点在 kernel_height / 2）。
+ * @return 成功返回1，失败返回0。
+ */
+int morphology(unsigned char *data,
+               int width,
+               int height,
+               int channels,
+               morph_op_t op,
+               int kernel_width,
+               int kernel_height)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || kernel_width <= 0 || kernel_height <= 0) {
+        return 0;
+    }
+
+    morph_job_t job = {0};
+    job.data = data;
+    job.width = width;
+    job.height = height;
+    job.channels = channels;
+    if (morphology_is_binary(data, width, height, channels)) {
+        job.words = (width + 63) / 64;
+        job.bits = (uint64_t *)malloc((size_t)job.words * height * sizeof(uint64_t));
+        if (!job.bits)
+            return 0;
+        parallel_for(height, MORPH_MIN_ROWS, pack_rows, &job);
+    }
+
+    // 开运算先腐蚀后膨胀，闭运算先膨胀后腐蚀
+    int first_max = (op == MORPH_DILATE || op == MORPH_CLOSE);
+    morph_pass(&job, first_max, kernel_width, kernel_height);
+    if (op == MORPH_OPEN || op == MORPH_CLOSE)
+        morph_pass(&job, !first_max, kernel_width, kernel_height);
+
+    if (job.bits) {
+        if (!job.failed)
+            parallel_for(height, MORPH_MIN_ROWS, unpack_rows, &job);
+        free(job.bits);
+    }
+    return !job.failed;
+}
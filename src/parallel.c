@@ -0,0 +1,181 @@
+#include "parallel.h"
+#include "scheduler.h"
+#include <stdlib.h> // For getenv, atoi
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// 同时运行的最大线程数
+#define PARALLEL_MAX_THREADS 64
+// 在调度器中运行时，每个线程平均分到的区间数（区间更多时快的线程可以多窃取几个）
+#define PARALLEL_TASKS_PER_THREAD 4
+
+// 单个线程处理的区间
+typedef struct
+{
+    parallel_range_fn fn;
+    void *ctx;
+    int begin;
+    int end;
+} parallel_job_t;
+
+/**
+ * @brief 获取并行任务使用的线程数。
+ * @return 线程数（至少为1）。
+ */
+int parallel_thread_count(void)
+{
+    // 调度器的多个工作线程可能同时第一次调用，结果相同，用原子读写避免数据竞争
+    static int cached = 0;
+    int value = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+    if (value > 0)
+        return value;
+
+    int count = 0;
+    const char *env = getenv("IMAGEPROC_THREADS");
+    if (env) {
+        count = atoi(env);
+    }
+    if (count <= 0) {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        count = (int)info.dwNumberOfProcessors;
+#else
+        count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    if (count < 1)
+        count = 1;
+    if (count > PARALLEL_MAX_THREADS)
+        count = PARALLEL_MAX_THREADS;
+
+    __atomic_store_n(&cached, count, __ATOMIC_RELAXED);
+    return count;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI parallel_thread_main(LPVOID arg)
+{
+    parallel_job_t *job = (parallel_job_t *)arg;
+    job->fn(job->ctx, job->begin, job->end);
+    return 0;
+}
+#else
+static void *parallel_thread_main(void *arg)
+{
+    parallel_job_t *job = (parallel_job_t *)arg;
+    job->fn(job->ctx, job->begin, job->end);
+    return NULL;
+}
+#endif
+
+static void parallel_task_main(void *arg)
+{
+    parallel_job_t *job = (parallel_job_t *)arg;
+    job->fn(job->ctx, job->begin, job->end);
+}
+
+/**
+ * @brief 在调度器的工作线程中执行 parallel_for：区间作为任务压入当前线程的队列，由空闲线程窃取，
+ * 不再另开线程，避免与调度器的线程叠加造成超额订阅。
+ */
+static void parallel_for_tasks(scheduler_t *sched, int count, int min_chunk, parallel_range_fn fn, void *ctx)
+{
+    int jobs = scheduler_thread_count(sched) * PARALLEL_TASKS_PER_THREAD;
+    if (jobs > PARALLEL_MAX_THREADS * PARALLEL_TASKS_PER_THREAD)
+        jobs = PARALLEL_MAX_THREADS * PARALLEL_TASKS_PER_THREAD;
+    if (jobs > count / min_chunk)
+        jobs = count / min_chunk;
+    if (jobs <= 1) {
+        fn(ctx, 0, count);
+        return;
+    }
+
+    parallel_job_t job[PARALLEL_MAX_THREADS * PARALLEL_TASKS_PER_THREAD];
+    task_group_t group;
+    task_group_init(&group);
+    for (int i = 0; i < jobs; i++) {
+        job[i].fn = fn;
+        job[i].ctx = ctx;
+        job[i].begin = (int)((long long)count * i / jobs);
+        job[i].end = (int)((long long)count * (i + 1) / jobs);
+        if (i > 0)
+            scheduler_spawn(sched, &group, parallel_task_main, &job[i]);
+    }
+    parallel_task_main(&job[0]);
+    scheduler_wait(sched, &group);
+}
+
+/**
+ * @brief 把 [0, count) 切分成若干连续区间并在多个线程上执行。
+ * @param count 元素总数。
+ * @param min_chunk 每个区间的最小元素数。
+ * @param fn 区间回调。
+ * @param ctx 传给回调的上下文。
+ */
+void parallel_for(int count, int min_chunk, parallel_range_fn fn, void *ctx)
+{
+    if (!fn || count <= 0)
+        return;
+    if (min_chunk < 1)
+        min_chunk = 1;
+
+    scheduler_t *sched = scheduler_current();
+    if (sched) {
+        parallel_for_tasks(sched, count, min_chunk, fn, ctx);
+        return;
+    }
+
+    int jobs = parallel_thread_count();
+    if (jobs > count / min_chunk)
+        jobs = count / min_chunk;
+    if (jobs <= 1) {
+        fn(ctx, 0, count);
+        return;
+    }
+
+    parallel_job_t job[PARALLEL_MAX_THREADS];
+    for (int i = 0; i < jobs; i++) {
+        job[i].fn = fn;
+        job[i].ctx = ctx;
+        job[i].begin = (int)((long long)count * i / jobs);
+        job[i].end = (int)((long long)count * (i + 1) / jobs);
+    }
+
+    // 第0个区间由调用线程自己处理，其余区间各开一个线程；线程创建失败时退回串行执行
+#ifdef _WIN32
+    HANDLE threads[PARALLEL_MAX_THREADS];
+    for (int i = 1; i < jobs; i++) {
+        threads[i] = CreateThread(NULL, 0, parallel_thread_main, &job[i], 0, NULL);
+        if (!threads[i]) {
+            parallel_thread_main(&job[i]);
+        }
+    }
+    parallel_thread_main(&job[0]);
+    for (int i = 1; i < jobs; i++) {
+        if (threads[i]) {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+#else
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    int started[PARALLEL_MAX_THREADS] = {0};
+    for (int i = 1; i < jobs; i++) {
+        started[i] = pthread_create(&threads[i], NULL, parallel_thread_main, &job[i]) == 0;
+        if (!started[i]) {
+            parallel_thread_main(&job[i]);
+        }
+    }
+    parallel_thread_main(&job[0]);
+    for (int i = 1; i < jobs; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+#endif
+}
@@ -0,0 +1,572 @@
+#include "phash.h"
+#include "log.h"
+#include "pixel_kernels.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// pHash 的缩略图边长和参与比较的低频系数范围（第1-8行、第1-8列，跳过直流分量所在的第0行和第0列）
+#define PHASH_GRID 32
+#define PHASH_COEFFS 8
+// dHash 的缩略图：9列8行，每行相邻两格比较得到8位
+#define DHASH_COLS 9
+#define DHASH_ROWS 8
+
+/**
+ * @brief 统计64位整数中为1的位数。
+ */
+static int popcount64(uint64_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * @brief 把 [0, size) 均分为 bins 段，第 b 段为 [begin[b], end[b])；尺寸小于段数时每段至少包含一个像素。
+ */
+static void split_range(int size, int bins, int *begin, int *end)
+{
+    for (int b = 0; b < bins; b++) {
+        begin[b] = (int)((long long)b * size / bins);
+        end[b] = (int)((long long)(b + 1) * size / bins);
+        if (end[b] <= begin[b])
+            end[b] = begin[b] + 1;
+        if (begin[b] >= size) {
+            begin[b] = size - 1;
+            end[b] = size;
+        }
+    }
+}
+
+/**
+ * @brief 按 qsort 的约定比较两个 double。
+ */
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief 计算图像的感知哈希。
+ * @param data 图像数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param hash 输出的哈希。
+ * @return 成功返回1，失败返回0。
+ */
+int image_hash_compute(const unsigned char *data, int width, int height, int channels, image_hash_t *hash)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || !hash) {
+        LOG_ERROR("Invalid parameters for image_hash_compute");
+        return 0;
+    }
+
+    unsigned char *luma = (unsigned char *)malloc((size_t)width);
+    uint32_t *prefix = (uint32_t *)malloc(((size_t)width + 1) * sizeof(uint32_t));
+    if (!luma || !prefix) {
+        LOG_ERROR("Memory allocation failed in image_hash_compute");
+        free(luma);
+        free(prefix);
+        return 0;
+    }
+
+    // 两个网格各自的行、列分段
+    int col_begin[PHASH_GRID], col_end[PHASH_GRID], row_begin[PHASH_GRID], row_end[PHASH_GRID];
+    int dcol_begin[DHASH_COLS], dcol_end[DHASH_COLS], drow_begin[DHASH_ROWS], drow_end[DHASH_ROWS];
+    split_range(width, PHASH_GRID, col_begin, col_end);
+    split_range(height, PHASH_GRID, row_begin, row_end);
+    split_range(width, DHASH_COLS, dcol_begin, dcol_end);
+    split_range(height, DHASH_ROWS, drow_begin, drow_end);
+
+    // 每格累加各抽取行上该列段的平均亮度，每个行段记录抽取的行数
+    double grid[PHASH_GRID][PHASH_GRID] = {{0}};
+    double grid_count[PHASH_GRID] = {0};
+    double dgrid[DHASH_ROWS][DHASH_COLS] = {{0}};
+    double dgrid_count[DHASH_ROWS] = {0};
+
+    const pixel_kernels_t *kernels = pixel_kernels_for(channels);
+    int step = height > PHASH_SAMPLE_ROWS ? height / PHASH_SAMPLE_ROWS : 1;
+    for (int y = 0; y < height; y += step) {
+        kernels->luma(data + (size_t)y * width * channels, luma, width, channels);
+        // 前缀和把任意列段的亮度和变成一次减法
+        prefix[0] = 0;
+        for (int x = 0; x < width; x++)
+            prefix[x + 1] = prefix[x] + luma[x];
+
+        for (int r = 0; r < PHASH_GRID; r++) {
+            if (y < row_begin[r] || y >= row_end[r])
+                continue;
+            for (int c = 0; c < PHASH_GRID; c++)
+                grid[r][c] += (double)(prefix[col_end[c]] - prefix[col_begin[c]]) / (col_end[c] - col_begin[c]);
+            grid_count[r] += 1.0;
+        }
+        for (int r = 0; r < DHASH_ROWS; r++) {
+            if (y < drow_begin[r] || y >= drow_end[r])
+                continue;
+            for (int c = 0; c < DHASH_COLS; c++)
+                dgrid[r][c] += (double)(prefix[dcol_end[c]] - prefix[dcol_begin[c]]) / (dcol_end[c] - dcol_begin[c]);
+            dgrid_count[r] += 1.0;
+        }
+    }
+    free(luma);
+    free(prefix);
+
+    // 每个行段至少有 PHASH_SAMPLE_ROWS / PHASH_GRID 个抽取行（图像不足 PHASH_SAMPLE_ROWS 行时读取每一行），
+    // 因此每格都有样本，除以行数即得到平均亮度
+    for (int r = 0; r < PHASH_GRID; r++)
+        for (int c = 0; c < PHASH_GRID; c++)
+            grid[r][c] /= grid_count[r] > 0.0 ? grid_count[r] : 1.0;
+    for (int r = 0; r < DHASH_ROWS; r++)
+        for (int c = 0; c < DHASH_COLS; c++)
+            dgrid[r][c] /= dgrid_count[r] > 0.0 ? dgrid_count[r] : 1.0;
+
+    // dHash：每行左格比右格暗时置1
+    uint64_t dhash = 0;
+    for (int r = 0; r < DHASH_ROWS; r++) {
+        for (int c = 0; c + 1 < DHASH_COLS; c++) {
+            dhash = (dhash << 1) | (dgrid[r][c] < dgrid[r][c + 1]);
+        }
+    }
+
+    // pHash：可分离的 DCT-II，只计算需要的低频系数
+    double cos_table[PHASH_COEFFS + 1][PHASH_GRID];
+    for (int u = 0; u <= PHASH_COEFFS; u++)
+        for (int x = 0; x < PHASH_GRID; x++)
+            cos_table[u][x] = cos((2 * x + 1) * u * M_PI / (2 * PHASH_GRID));
+
+    double rows[PHASH_GRID][PHASH_COEFFS];
+    for (int y = 0; y < PHASH_GRID; y++) {
+        for (int u = 0; u < PHASH_COEFFS; u++) {
+            double sum = 0.0;
+            for (int x = 0; x < PHASH_GRID; x++)
+                sum += grid[y][x] * cos_table[u + 1][x];
+            rows[y][u] = sum;
+        }
+    }
+    double coeffs[PHASH_COEFFS * PHASH_COEFFS];
+    for (int v = 0; v < PHASH_COEFFS; v++) {
+        for (int u = 0; u < PHASH_COEFFS; u++) {
+            double sum = 0.0;
+            for (int y = 0; y < PHASH_GRID; y++)
+                sum += rows[y][u] * cos_table[v + 1][y];
+            coeffs[v * PHASH_COEFFS + u] = sum;
+        }
+    }
+
+    double sorted[PHASH_COEFFS * PHASH_COEFFS];
+    memcpy(sorted, coeffs, sizeof(sorted));
+    qsort(sorted, PHASH_COEFFS * PHASH_COEFFS, sizeof(double), compare_double);
+    double median = (sorted[31] + sorted[32]) / 2.0;
+    uint64_t phash = 0;
+    for (int i = 0; i < PHASH_COEFFS * PHASH_COEFFS; i++)
+        phash = (phash << 1) | (coeffs[i] > median);
+
+    hash->dhash = dhash;
+    hash->phash = phash;
+    return 1;
+}
+
+/**
+ * @brief 两个哈希的距离：dHash 和 pHash 汉明距离中较大的一个。
+ * @param a 第一个哈希。
+ * @param b 第二个哈希。
+ * @return 距离（0-64）。
+ */
+int image_hash_distance(image_hash_t a, image_hash_t b)
+{
+    int d = popcount64(a.dhash ^ b.dhash);
+    int p = popcount64(a.phash ^ b.phash);
+    return d > p ? d : p;
+}
+
+/**
+ * @brief 哈希的第 b 段（0-3 为 dHash 的4个16位段，4-7 为 pHash 的）。
+ */
+static unsigned band_value(image_hash_t hash, int b)
+{
+    uint64_t v = b < HASH_INDEX_BANDS / 2 ? hash.dhash : hash.phash;
+    return (unsigned)(v >> (HASH_INDEX_BAND_BITS * (b % (HASH_INDEX_BANDS / 2)))) & (HASH_INDEX_BUCKETS - 1);
+}
+
+// 条目 k 在第 b 段的桶链表中的前驱和后继（-1 表示没有）
+#define BAND_PREV(index, k, b) ((index)->band_links[((size_t)(k) * HASH_INDEX_BANDS + (b)) * 2])
+#define BAND_NEXT(index, k, b) ((index)->band_links[((size_t)(k) * HASH_INDEX_BANDS + (b)) * 2 + 1])
+#define BAND_HEAD(index, b, v) ((index)->band_heads[(size_t)(b) * HASH_INDEX_BUCKETS + (v)])
+
+/**
+ * @brief 把条目 k 插入它的哈希各段所在的桶。
+ */
+static void link_entry(hash_index_t *index, int k)
+{
+    for (int b = 0; b < HASH_INDEX_BANDS; b++) {
+        int *head = &BAND_HEAD(index, b, band_value(index->entries[k].hash, b));
+        BAND_PREV(index, k, b) = -1;
+        BAND_NEXT(index, k, b) = *head;
+        if (*head >= 0)
+            BAND_PREV(index, *head, b) = k;
+        *head = k;
+    }
+}
+
+/**
+ * @brief 把条目 k 从各段的桶中取出。
+ */
+static void unlink_entry(hash_index_t *index, int k)
+{
+    for (int b = 0; b < HASH_INDEX_BANDS; b++) {
+        int prev = BAND_PREV(index, k, b), next = BAND_NEXT(index, k, b);
+        if (prev >= 0)
+            BAND_NEXT(index, prev, b) = next;
+        else
+            BAND_HEAD(index, b, band_value(index->entries[k].hash, b)) = next;
+        if (next >= 0)
+            BAND_PREV(index, next, b) = prev;
+    }
+}
+
+/**
+ * @brief 条目从下标 from 移到 to 后，让桶链表中的相邻条目和链表头指向新的下标。
+ */
+static void relocate_entry(hash_index_t *index, int from, int to)
+{
+    for (int b = 0; b < HASH_INDEX_BANDS; b++) {
+        int prev = BAND_PREV(index, from, b), next = BAND_NEXT(index, from, b);
+        BAND_PREV(index, to, b) = prev;
+        BAND_NEXT(index, to, b) = next;
+        if (prev >= 0)
+            BAND_NEXT(index, prev, b) = to;
+        else
+            BAND_HEAD(index, b, band_value(index->entries[to].hash, b)) = to;
+        if (next >= 0)
+            BAND_PREV(index, next, b) = to;
+    }
+}
+
+/**
+ * @brief 名称的32位 FNV-1a 哈希。
+ */
+static uint32_t name_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+        h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+/**
+ * @brief 在名称表中线性探测：返回存有该名称的槽，不存在时返回探测到的第一个空槽。
+ */
+static int name_slot(const hash_index_t *index, const char *name)
+{
+    int slot = (int)(name_hash(name) & (uint32_t)index->name_mask);
+    while (index->name_slots[slot] >= 0 && strcmp(index->entries[index->name_slots[slot]].name, name) != 0)
+        slot = (slot + 1) & index->name_mask;
+    return slot;
+}
+
+/**
+ * @brief 清空名称表的一个槽，并把其后探测链上的条目前移填补空位（不使用删除标记）。
+ */
+static void name_erase(hash_index_t *index, int slot)
+{
+    int mask = index->name_mask;
+    int hole = slot;
+    for (int i = (slot + 1) & mask; index->name_slots[i] >= 0; i = (i + 1) & mask) {
+        int home = (int)(name_hash(index->entries[index->name_slots[i]].name) & (uint32_t)mask);
+        // 空位在这个条目的探测路径上（从起始槽到当前槽之间）时才能前移
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            index->name_slots[hole] = index->name_slots[i];
+            hole = i;
+        }
+    }
+    index->name_slots[hole] = -1;
+}
+
+/**
+ * @brief 保证名称表的负载不超过一半，需要时加倍并重新插入全部条目。
+ * @return 成功返回1，内存不足返回0。
+ */
+static int reserve_names(hash_index_t *index, int count)
+{
+    int size = index->name_slots ? index->name_mask + 1 : 0;
+    if (count * 2 <= size)
+        return 1;
+    int new_size = size ? size : 128;
+    while (count * 2 > new_size)
+        new_size *= 2;
+    int *slots = (int *)malloc((size_t)new_size * sizeof(int));
+    if (!slots)
+        return 0;
+    memset(slots, 0xff, (size_t)new_size * sizeof(int));
+    free(index->name_slots);
+    index->name_slots = slots;
+    index->name_mask = new_size - 1;
+    for (int i = 0; i < index->count; i++)
+        index->name_slots[name_slot(index, index->entries[i].name)] = i;
+    return 1;
+}
+
+/**
+ * @brief 初始化空索引。
+ * @param index 索引。
+ */
+void hash_index_init(hash_index_t *index)
+{
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * @brief 释放索引的全部条目。
+ * @param index 索引。
+ */
+void hash_index_free(hash_index_t *index)
+{
+    if (!index)
+        return;
+    for (int i = 0; i < index->count; i++)
+        free(index->entries[i].name);
+    free(index->entries);
+    free(index->name_slots);
+    free(index->band_heads);
+    free(index->band_links);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * @brief 添加条目；已有同名条目时替换它的哈希和编号。
+ * @param index 索引。
+ * @param hash 哈希。
+ * @param name 图像标识。
+ * @param id 调用者的编号。
+ * @return 成功返回条目的下标，失败返回 -1。
+ */
+int hash_index_add(hash_index_t *index, image_hash_t hash, const char *name, int id)
+{
+    if (!index || !name)
+        return -1;
+
+    int k = hash_index_lookup_name(index, name);
+    if (k >= 0) {
+        unlink_entry(index, k);
+        index->entries[k].hash = hash;
+        index->entries[k].id = id;
+        link_entry(index, k);
+        return k;
+    }
+
+    if (!index->band_heads) {
+        index->band_heads = (int *)malloc((size_t)HASH_INDEX_BANDS * HASH_INDEX_BUCKETS * sizeof(int));
+        if (!index->band_heads) {
+            LOG_ERROR("Memory allocation failed for hash index");
+            return -1;
+        }
+        memset(index->band_heads, 0xff, (size_t)HASH_INDEX_BANDS * HASH_INDEX_BUCKETS * sizeof(int));
+    }
+    if (index->count == index->capacity) {
+        int capacity = index->capacity ? index->capacity * 2 : 64;
+        hash_index_entry_t *entries =
+            (hash_index_entry_t *)realloc(index->entries, (size_t)capacity * sizeof(hash_index_entry_t));
+        if (entries)
+            index->entries = entries;
+        int *links = (int *)realloc(index->band_links, (size_t)capacity * HASH_INDEX_BANDS * 2 * sizeof(int));
+        if (links)
+            index->band_links = links;
+        if (!entries || !links) {
+            LOG_ERROR("Memory allocation failed for hash index");
+            return -1;
+        }
+        index->capacity = capacity;
+    }
+    if (!reserve_names(index, index->count + 1)) {
+        LOG_ERROR("Memory allocation failed for hash index");
+        return -1;
+    }
+
+    k = index->count;
+    hash_index_entry_t *entry = &index->entries[k];
+    entry->name = (char *)malloc(strlen(name) + 1);
+    if (!entry->name) {
+        LOG_ERROR("Memory allocation failed for hash index");
+        return -1;
+    }
+    strcpy(entry->name, name);
+    entry->hash = hash;
+    entry->id = id;
+    index->name_slots[name_slot(index, name)] = k;
+    link_entry(index, k);
+    return index->count++;
+}
+
+/**
+ * @brief 删除一个条目（最后一个条目移到它的位置）。
+ * @param index 索引。
+ * @param k 条目的下标。
+ */
+void hash_index_remove(hash_index_t *index, int k)
+{
+    if (!index || k < 0 || k >= index->count)
+        return;
+    name_erase(index, name_slot(index, index->entries[k].name));
+    unlink_entry(index, k);
+    free(index->entries[k].name);
+
+    int last = --index->count;
+    if (k != last) {
+        index->entries[k] = index->entries[last];
+        relocate_entry(index, last, k);
+        index->name_slots[name_slot(index, index->entries[k].name)] = k;
+    }
+}
+
+/**
+ * @brief 按名称查找条目。
+ * @param index 索引。
+ * @param name 图像标识。
+ * @return 条目的下标，不存在时返回 -1。
+ */
+int hash_index_lookup_name(const hash_index_t *index, const char *name)
+{
+    if (!index || !name || !index->name_slots)
+        return -1;
+    return index->name_slots[name_slot(index, name)];
+}
+
+/**
+ * @brief 比较条目 i 与目前最近的条目：距离更近，或距离相同而下标更小时取代它。
+ */
+static void consider_entry(const hash_index_t *index, image_hash_t hash, int i, int *best, int *best_distance)
+{
+    int d = image_hash_distance(hash, index->entries[i].hash);
+    if (d < *best_distance || (d == *best_distance && i < *best)) {
+        *best = i;
+        *best_distance = d;
+    }
+}
+
+/**
+ * @brief 查找与给定哈希距离最近且不超过 max_distance 的条目；距离相同时返回下标最小的条目。
+ *
+ * 距离不超过 max_distance 时，dHash 与 pHash 的汉明距离之和不超过 2*max_distance，
+ * 按鸽巢原理8个段中至少有一段的距离不超过 max_distance/4，只需查看与查询的某一段相差这么多位的桶。
+ * 要查看的桶比条目还多（索引很小或距离很大）时直接线性扫描。
+ * @param index 索引。
+ * @param hash 哈希。
+ * @param max_distance 允许的最大距离。
+ * @param distance 输出找到的条目的距离，可以为 NULL。
+ * @return 条目的下标，没有足够接近的条目时返回 -1。
+ */
+int hash_index_find(const hash_index_t *index, image_hash_t hash, int max_distance, int *distance)
+{
+    int best = -1;
+    int best_distance = max_distance + 1;
+    if (!index || max_distance < 0)
+        return -1;
+
+    int radius = max_distance / 4;
+    long long buckets = 0, combinations = 1;
+    for (int w = 0; w <= radius && w <= HASH_INDEX_BAND_BITS; w++) {
+        buckets += combinations;
+        combinations = combinations * (HASH_INDEX_BAND_BITS - w) / (w + 1);
+    }
+    if (radius >= HASH_INDEX_BAND_BITS || buckets * HASH_INDEX_BANDS >= index->count) {
+        for (int i = 0; i < index->count && best_distance > 0; i++)
+            consider_entry(index, hash, i, &best, &best_distance);
+    }
+    else {
+        for (int b = 0; b < HASH_INDEX_BANDS; b++) {
+            unsigned v = band_value(hash, b);
+            // 依次枚举恰有 w 位为1的16位掩码（Gosper 方法）
+            for (int w = 0; w <= radius; w++) {
+                for (unsigned mask = (1u << w) - 1; mask < HASH_INDEX_BUCKETS;) {
+                    for (int i = BAND_HEAD(index, b, v ^ mask); i >= 0; i = BAND_NEXT(index, i, b))
+                        consider_entry(index, hash, i, &best, &best_distance);
+                    if (w == 0)
+                        break;
+                    unsigned low = mask & (~mask + 1), high = mask + low;
+                    mask = (((high ^ mask) >> 2) / low) | high;
+                }
+            }
+        }
+    }
+    if (best >= 0 && distance)
+        *distance = best_distance;
+    return best;
+}
+
+/**
+ * @brief 从文本文件读入条目，读入的条目编号为 -1。
+ * @param index 索引。
+ * @param path 索引文件路径。
+ * @return 读入的条目数，文件不存在时返回0，读取失败返回 -1。
+ */
+int hash_index_load(hash_index_t *index, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+
+    int loaded = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        image_hash_t hash;
+        int name_offset = 0;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (sscanf(line, "%16" SCNx64 " %16" SCNx64 " %n", &hash.dhash, &hash.phash, &name_offset) != 2 ||
+            name_offset == 0 || line[name_offset] == '\0') {
+            LOG_ERROR("Ignoring malformed line in hash index '%s'", path);
+            continue;
+        }
+        if (hash_index_add(index, hash, line + name_offset, -1) < 0) {
+            fclose(fp);
+            return -1;
+        }
+        loaded++;
+    }
+    fclose(fp);
+    return loaded;
+}
+
+/**
+ * @brief 把全部条目写入文本文件：先写临时文件再重命名。
+ * @param index 索引。
+ * @param path 索引文件路径。
+ * @return 成功返回1，失败返回0。
+ */
+int hash_index_save(const hash_index_t *index, const char *path)
+{
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) {
+        LOG_ERROR("Error opening hash index '%s'", tmp_path);
+        return 0;
+    }
+    for (int i = 0; i < index->count; i++) {
+        const hash_index_entry_t *e = &index->entries[i];
+        fprintf(fp, "%016" PRIx64 " %016" PRIx64 " %s\n", e->hash.dhash, e->hash.phash, e->name);
+    }
+    int ok = !ferror(fp);
+    ok = (fclose(fp) == 0) && ok;
+    if (ok)
+        ok = rename(tmp_path, path) == 0;
+    if (!ok) {
+        LOG_ERROR("Error writing hash index '%s'", path);
+        remove(tmp_path);
+    }
+    return ok;
+}
@@ -0,0 +1,376 @@
+#include "pixel_cache.h"
+#include "log.h"
+#include "stb_image.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+
+/**
+ * @brief Windows 下没有 mmap，不支持解码缓存。
+ */
+int pixel_cache_set_dir(const char *dir)
+{
+    if (dir)
+        LOG_ERROR("The decoded pixel cache is not supported on Windows");
+    return dir == NULL;
+}
+
+int pixel_cache_enabled(void)
+{
+    return 0;
+}
+
+unsigned char *pixel_cache_load(const char *path, int *width, int *height, int *channels)
+{
+    return stbi_load(path, width, height, channels, 0);
+}
+
+size_t pixel_cache_mapped_size(const unsigned char *data)
+{
+    (void)data;
+    return 0;
+}
+
+int pixel_cache_release(unsigned char *data)
+{
+    (void)data;
+    return 0;
+}
+
+#else
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// 同时存在的映射数的上限，超过时新的条目按普通内存返回（读入而不映射）
+#define PIXEL_CACHE_MAX_MAPPINGS 256
+// 缓存目录路径的最大长度
+#define PIXEL_CACHE_DIR_MAX 512
+// 缓存条目路径的最大长度：目录、'/'、16位十六进制哈希和 ".ipx"
+#define PIXEL_CACHE_PATH_MAX (PIXEL_CACHE_DIR_MAX + 32)
+
+// 一个映射的缓存文件
+typedef struct
+{
+    unsigned char *base; // 映射的起始地址（文件头），NULL 表示空槽
+    size_t length;       // 映射的总字节数
+} pixel_cache_mapping_t;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static char cache_dir[PIXEL_CACHE_DIR_MAX];
+static int cache_state = 0; // 0 尚未按环境变量配置，1 关闭，2 开启
+static pixel_cache_mapping_t mappings[PIXEL_CACHE_MAX_MAPPINGS];
+
+/**
+ * @brief 设置解码缓存目录（不存在时创建）；NULL 表示关闭缓存。
+ * @param dir 缓存目录。
+ * @return 成功返回1，目录路径过长或无法创建返回0（缓存保持关闭）。
+ */
+int pixel_cache_set_dir(const char *dir)
+{
+    int ok = 1;
+    pthread_mutex_lock(&cache_lock);
+    cache_state = 1;
+    if (dir && dir[0]) {
+        if (strlen(dir) >= sizeof(cache_dir)) {
+            LOG_ERROR("Pixel cache directory path too long: %s", dir);
+            ok = 0;
+        }
+        else if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+            LOG_ERROR("Error creating pixel cache directory: %s", dir);
+            ok = 0;
+        }
+        else {
+            snprintf(cache_dir, sizeof(cache_dir), "%s", dir);
+            cache_state = 2;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return ok;
+}
+
+/**
+ * @brief 缓存是否开启（第一次调用时按环境变量 IMAGEPROC_PIXEL_CACHE 配置）。
+ * @return 开启返回1，否则返回0。
+ */
+int pixel_cache_enabled(void)
+{
+    int state = __atomic_load_n(&cache_state, __ATOMIC_ACQUIRE);
+    if (state == 0) {
+        pthread_mutex_lock(&cache_lock);
+        int configured = cache_state != 0;
+        pthread_mutex_unlock(&cache_lock);
+        if (!configured)
+            pixel_cache_set_dir(getenv("IMAGEPROC_PIXEL_CACHE"));
+        state = __atomic_load_n(&cache_state, __ATOMIC_ACQUIRE);
+    }
+    return state == 2;
+}
+
+/**
+ * @brief 源文件内容的64位哈希：每次处理8字节，最后做 MurmurHash3 的 fmix64 混合，速度远高于解码。
+ */
+static uint64_t content_hash(const unsigned char *data, size_t size)
+{
+    const uint64_t k1 = 0x87c37b91114253d5ull, k2 = 0x4cf5ad432745937full;
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ (size * k1);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, data + i, 8);
+        w *= k1;
+        w = (w << 31) | (w >> 33);
+        h ^= w * k2;
+        h = ((h << 27) | (h >> 37)) * 5 + 0x52dce729;
+    }
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < size; j++)
+        tail |= (uint64_t)data[i + j] << (8 * j);
+    h ^= tail * k2;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief 读入整个源文件。
+ * @return 文件内容（用 free 释放），失败返回NULL。
+ */
+static unsigned char *read_source(const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+    unsigned char *data = NULL;
+    long length = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    if (length > 0 && length < INT32_MAX && fseek(fp, 0, SEEK_SET) == 0) {
+        data = (unsigned char *)malloc((size_t)length);
+        if (data && fread(data, 1, (size_t)length, fp) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(fp);
+    *size = (size_t)(length > 0 ? length : 0);
+    return data;
+}
+
+/**
+ * @brief 缓存条目的路径："<缓存目录>/<源内容哈希>.ipx"，内容相同的源文件共用一个条目，
+ *        源文件改变后哈希不同，旧条目自然失效。
+ */
+static void entry_path(uint64_t hash, char *path, size_t size)
+{
+    pthread_mutex_lock(&cache_lock);
+    snprintf(path, size, "%s/%016" PRIx64 ".ipx", cache_dir, hash);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * @brief 登记一个映射。
+ * @return 成功返回1，登记表已满返回0。
+ */
+static int register_mapping(unsigned char *base, size_t length)
+{
+    int ok = 0;
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < PIXEL_CACHE_MAX_MAPPINGS && !ok; i++) {
+        if (!mappings[i].base) {
+            mappings[i].base = base;
+            mappings[i].length = length;
+            ok = 1;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return ok;
+}
+
+/**
+ * @brief 映射一个缓存条目并校验文件头。
+ * @return 像素数据（映射内），条目不存在、已损坏或与源文件不符时返回NULL。
+ */
+static unsigned char *map_entry(const char *path, uint64_t hash, size_t source_size, int *w, int *h, int *c)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    pixel_cache_header_t header;
+    struct stat st;
+    int valid = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                memcmp(header.magic, "IPXCACHE", 8) == 0 && header.version == 1 &&
+                header.header_size == PIXEL_CACHE_HEADER_SIZE && header.source_hash == hash &&
+                header.source_size == source_size && header.width > 0 && header.height > 0 && header.channels >= 1 &&
+                header.channels <= 4 &&
+                header.data_size == (uint64_t)header.width * header.height * header.channels &&
+                (uint64_t)st.st_size == header.header_size + header.data_size;
+    if (!valid) {
+        close(fd);
+        LOG_DEBUG("Ignoring invalid pixel cache entry '%s'", path);
+        return NULL;
+    }
+
+    // 私有的写时复制映射：效果可以原地修改返回的图像，缓存文件保持不变
+    size_t length = (size_t)st.st_size;
+    unsigned char *base = (unsigned char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+    if (!register_mapping(base, length)) {
+        munmap(base, length);
+        return NULL;
+    }
+
+    *w = (int)header.width;
+    *h = (int)header.height;
+    *c = (int)header.channels;
+    return base + header.header_size;
+}
+
+/**
+ * @brief 写入一个缓存条目：先写同一目录中的临时文件再改名，并发的写入者和读取者不会看到写了一半的条目。
+ */
+static void store_entry(const char *path,
+                        uint64_t hash,
+                        size_t source_size,
+                        const unsigned char *data,
+                        int w,
+                        int h,
+                        int c)
+{
+    unsigned char header_block[PIXEL_CACHE_HEADER_SIZE] = {0};
+    pixel_cache_header_t header = {{'I', 'P', 'X', 'C', 'A', 'C', 'H', 'E'},
+                                   1,
+                                   PIXEL_CACHE_HEADER_SIZE,
+                                   (uint32_t)w,
+                                   (uint32_t)h,
+                                   (uint32_t)c,
+                                   PIXEL_CACHE_TILE_ROWS,
+                                   hash,
+                                   (uint64_t)source_size,
+                                   (uint64_t)w * h * c};
+    memcpy(header_block, &header, sizeof(header));
+
+    // 临时文件名是条目路径加上 ".<进程号>.tmp"，路径过长时放弃写入，不能截断后改名到错误的位置
+    char tmp[PIXEL_CACHE_PATH_MAX + 32];
+    int length = snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    if (length < 0 || (size_t)length >= sizeof(tmp)) {
+        LOG_ERROR("Pixel cache path too long: %s", path);
+        return;
+    }
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        LOG_ERROR("Error creating pixel cache entry '%s'", tmp);
+        return;
+    }
+    // 按分块顺序写出；分块是整行宽的行带，写出的就是行主序的像素
+    size_t tile_bytes = (size_t)w * c * PIXEL_CACHE_TILE_ROWS;
+    int ok = fwrite(header_block, 1, sizeof(header_block), fp) == sizeof(header_block);
+    for (size_t offset = 0; ok && offset < header.data_size; offset += tile_bytes) {
+        size_t n = header.data_size - offset < tile_bytes ? (size_t)(header.data_size - offset) : tile_bytes;
+        ok = fwrite(data + offset, 1, n, fp) == n;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (ok)
+        ok = rename(tmp, path) == 0;
+    if (!ok) {
+        LOG_ERROR("Error writing pixel cache entry '%s'", path);
+        remove(tmp);
+    }
+}
+
+/**
+ * @brief 经缓存加载图像：命中时映射缓存条目，否则解码并写入缓存。
+ * @param path 源文件路径。
+ * @param width 输出的图像宽度。
+ * @param height 输出的图像高度。
+ * @param channels 输出的图像通道数。
+ * @return 成功返回图像数据（用 free_image 释放），失败返回NULL。
+ */
+unsigned char *pixel_cache_load(const char *path, int *width, int *height, int *channels)
+{
+    size_t source_size = 0;
+    unsigned char *source = read_source(path, &source_size);
+    if (!source)
+        return stbi_load(path, width, height, channels, 0);
+
+    uint64_t hash = content_hash(source, source_size);
+    char entry[PIXEL_CACHE_PATH_MAX];
+    entry_path(hash, entry, sizeof(entry));
+    unsigned char *data = map_entry(entry, hash, source_size, width, height, channels);
+    if (data) {
+        free(source);
+        LOG_DEBUG("Mapped decoded pixels of '%s' from '%s'", path, entry);
+        return data;
+    }
+
+    // 未命中：从已读入的内容解码，不再读一次文件
+    data = stbi_load_from_memory(source, (int)source_size, width, height, channels, 0);
+    free(source);
+    if (data)
+        store_entry(entry, hash, source_size, data, *width, *height, *channels);
+    return data;
+}
+
+/**
+ * @brief 查找图像数据所在的映射。调用者持有锁。
+ */
+static pixel_cache_mapping_t *find_mapping(const unsigned char *data)
+{
+    for (int i = 0; i < PIXEL_CACHE_MAX_MAPPINGS; i++) {
+        if (mappings[i].base && mappings[i].base + PIXEL_CACHE_HEADER_SIZE == data)
+            return &mappings[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief 查询图像数据是否为映射的缓存文件。
+ * @param data 图像数据。
+ * @return 映射的像素数据字节数，不是映射时返回0。
+ */
+size_t pixel_cache_mapped_size(const unsigned char *data)
+{
+    if (!data)
+        return 0;
+    pthread_mutex_lock(&cache_lock);
+    pixel_cache_mapping_t *mapping = find_mapping(data);
+    size_t size = mapping ? mapping->length - PIXEL_CACHE_HEADER_SIZE : 0;
+    pthread_mutex_unlock(&cache_lock);
+    return size;
+}
+
+/**
+ * @brief 解除映射的缓存文件。
+ * @param data 图像数据。
+ * @return data 是映射的缓存文件（已解除映射）返回1，否则返回0。
+ */
+int pixel_cache_release(unsigned char *data)
+{
+    if (!data)
+        return 0;
+    pthread_mutex_lock(&cache_lock);
+    pixel_cache_mapping_t *mapping = find_mapping(data);
+    pixel_cache_mapping_t released = {NULL, 0};
+    if (mapping) {
+        released = *mapping;
+        mapping->base = NULL;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    if (!released.base)
+        return 0;
+    munmap(released.base, released.length);
+    return 1;
+}
+
+#endif
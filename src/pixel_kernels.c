@@ -0,0 +1,100 @@
+#include "pixel_kernels.h"
+#include <string.h> // For memmove
+
+/*
+ * 生成一组逐行处理函数。CH 为常量时每个像素的通道访问都是固定偏移，内层循环完全展开；
+ * 通用版本把 CH 写成 channels，使用运行时通道数。
+ */
+#define PIXEL_DEFINE_KERNELS(suffix, CH)                                                                               \
+    static void luma_row_##suffix(const unsigned char *src, unsigned char *dst, int width, int channels)              \
+    {                                                                                                                  \
+        (void)channels;                                                                                                \
+        for (int x = 0; x < width; x++) {                                                                              \
+            const unsigned char *p = src + x * (CH);                                                                   \
+            dst[x] = (CH) >= 3 ? (unsigned char)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]) : p[0];                \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    static void grayscale_row_##suffix(const unsigned char *src, unsigned char *dst, int width, int channels)         \
+    {                                                                                                                  \
+        (void)channels;                                                                                                \
+        /* 不足三个通道的图像已经是灰度图，只需复制 */                                                                 \
+        if ((CH) < 3) {                                                                                                \
+            if (dst != src)                                                                                            \
+                memmove(dst, src, (size_t)width * (CH));                                                               \
+            return;                                                                                                    \
+        }                                                                                                              \
+        for (int x = 0; x < width; x++) {                                                                              \
+            const unsigned char *p = src + x * (CH);                                                                   \
+            unsigned char *q = dst + x * (CH);                                                                         \
+            unsigned char gray = (unsigned char)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]);                       \
+            for (int c = 3; c < (CH); c++)                                                                             \
+                q[c] = p[c];                                                                                           \
+            q[0] = gray;                                                                                               \
+            q[1] = gray;                                                                                               \
+            q[2] = gray;                                                                                               \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    static void invert_row_##suffix(const unsigned char *src, unsigned char *dst, int width, int channels)            \
+    {                                                                                                                  \
+        (void)channels;                                                                                                \
+        for (int x = 0; x < width; x++) {                                                                              \
+            const unsigned char *p = src + x * (CH);                                                                   \
+            unsigned char *q = dst + x * (CH);                                                                         \
+            for (int c = 0; c < (CH); c++)                                                                             \
+                q[c] = c < 3 ? (unsigned char)(255 - p[c]) : p[c];                                                     \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    static void deinterleave_row_##suffix(                                                                             \
+        const unsigned char *src, unsigned char *const *planes, int x, int width, int channels)                        \
+    {                                                                                                                  \
+        (void)channels;                                                                                                \
+        for (; x < width; x++) {                                                                                       \
+            for (int c = 0; c < (CH); c++)                                                                             \
+                planes[c][x] = src[x * (CH) + c];                                                                      \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    static void interleave_row_##suffix(                                                                               \
+        const unsigned char *const *planes, unsigned char *dst, int x, int width, int channels)                        \
+    {                                                                                                                  \
+        (void)channels;                                                                                                \
+        for (; x < width; x++) {                                                                                       \
+            for (int c = 0; c < (CH); c++)                                                                             \
+                dst[x * (CH) + c] = planes[c][x];                                                                      \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    static const pixel_kernels_t pixel_kernels_##suffix = {                                                            \
+        luma_row_##suffix,                                                                                             \
+        grayscale_row_##suffix,                                                                                        \
+        invert_row_##suffix,                                                                                           \
+        deinterleave_row_##suffix,                                                                                     \
+        interleave_row_##suffix,                                                                                       \
+    };
+
+PIXEL_DEFINE_KERNELS(c1, 1)
+PIXEL_DEFINE_KERNELS(c3, 3)
+PIXEL_DEFINE_KERNELS(c4, 4)
+PIXEL_DEFINE_KERNELS(cn, channels)
+
+/**
+ * @brief 按通道数选择逐行处理函数表。
+ * @param channels 通道数（>0）。
+ * @return 函数表，1/3/4 通道返回特化版本，其余返回通用版本。
+ */
+const pixel_kernels_t *pixel_kernels_for(int channels)
+{
+    switch (channels) {
+    case 1:
+        return &pixel_kernels_c1;
+    case 3:
+        return &pixel_kernels_c3;
+    case 4:
+        return &pixel_kernels_c4;
+    default:
+        return &pixel_kernels_cn;
+    }
+}
@@ -0,0 +1,474 @@
+#include "planar.h"
+#include "pixel_kernels.h"
+#include <stddef.h> // For size_t
+#include <stdlib.h> // For malloc and free
+#include <string.h> // For memcpy
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PLANAR_HAVE_X86_SIMD 1
+#endif
+
+// 平面行步长的对齐字节数，保证每行起点适合向量加载
+#define PLANE_ROW_ALIGN 32
+
+/**
+ * @brief 将矩形裁剪到图像范围内。
+ * @param rect 待裁剪的矩形，原地修改。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @return 裁剪后矩形非空返回1，否则返回0。
+ */
+int image_rect_clip(image_rect_t *rect, int width, int height)
+{
+    if (!rect)
+        return 0;
+
+    int x0 = rect->x < 0 ? 0 : rect->x;
+    int y0 = rect->y < 0 ? 0 : rect->y;
+    int x1 = rect->x + rect->w > width ? width : rect->x + rect->w;
+    int y1 = rect->y + rect->h > height ? height : rect->y + rect->h;
+
+    rect->x = x0;
+    rect->y = y0;
+    rect->w = x1 > x0 ? x1 - x0 : 0;
+    rect->h = y1 > y0 ? y1 - y0 : 0;
+    return rect->w > 0 && rect->h > 0;
+}
+
+/**
+ * @brief 分配一幅指定布局的图像，行步长按32字节对齐。
+ * @param img 输出的图像结构。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param layout 内存布局。
+ * @return 成功返回1，失败返回0。
+ */
+int image_buffer_alloc(image_buffer_t *img, int width, int height, int channels, image_layout_t layout)
+{
+    if (!img || width <= 0 || height <= 0 || channels <= 0 || channels > IMAGE_MAX_CHANNELS) {
+        return 0;
+    }
+
+    memset(img, 0, sizeof(*img));
+
+    int row_bytes = (layout == IMAGE_LAYOUT_PLANAR) ? width : width * channels;
+    int stride = (row_bytes + PLANE_ROW_ALIGN - 1) / PLANE_ROW_ALIGN * PLANE_ROW_ALIGN;
+    int plane_count = (layout == IMAGE_LAYOUT_PLANAR) ? channels : 1;
+    size_t plane_size = (size_t)stride * height;
+
+    unsigned char *storage = (unsigned char *)malloc(plane_size * plane_count);
+    if (!storage) {
+        return 0;
+    }
+
+    img->width = width;
+    img->height = height;
+    img->channels = channels;
+    img->stride = stride;
+    img->layout = layout;
+    img->storage = storage;
+
+    if (layout == IMAGE_LAYOUT_PLANAR) {
+        for (int c = 0; c < channels; c++) {
+            img->planes[c] = storage + plane_size * c;
+        }
+    }
+    else {
+        img->data = storage;
+    }
+    return 1;
+}
+
+/**
+ * @brief 将已有的交错像素缓冲区包装为图像结构（不复制数据）。
+ * @param img 输出的图像结构。
+ * @param data 交错像素数据。
+ * @param width 图像宽度。
+ * @param height 图像高度。
+ * @param channels 图像通道数。
+ * @param stride 行步长（字节），传0表示紧密排列 (width * channels)。
+ */
+void image_buffer_wrap(image_buffer_t *img, unsigned char *data, int width, int height, int channels, int stride)
+{
+    if (!img)
+        return;
+
+    memset(img, 0, sizeof(*img));
+    img->width = width;
+    img->height = height;
+    img->channels = channels;
+    img->stride = stride > 0 ? stride : width * channels;
+    img->layout = IMAGE_LAYOUT_INTERLEAVED;
+    img->data = data;
+}
+
+/**
+ * @brief 取图像中的一个子矩形视图（不复制数据，与原图共享内存）。
+ * @param src 源图像。
+ * @param x 子矩形左上角横坐标。
+ * @param y 子矩形左上角纵坐标。
+ * @param w 子矩形宽度。
+ * @param h 子矩形高度。
+ * @param view 输出的视图。
+ * @return 成功返回1，矩形越界返回0。
+ */
+int image_buffer_view(const image_buffer_t *src, int x, int y, int w, int h, image_buffer_t *view)
+{
+    if (!src || !view || x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > src->width || y + h > src->height) {
+        return 0;
+    }
+
+    *view = *src;
+    view->width = w;
+    view->height = h;
+    view->storage = NULL; // 视图不拥有内存
+
+    if (src->layout == IMAGE_LAYOUT_PLANAR) {
+        for (int c = 0; c < src->channels; c++) {
+            view->planes[c] = src->planes[c] + (size_t)y * src->stride + x;
+        }
+    }
+    else {
+        view->data = src->data + (size_t)y * src->stride + (size_t)x * src->channels;
+    }
+    return 1;
+}
+
+/**
+ * @brief 释放 image_buffer_alloc 分配的内存，包装或视图结构不会释放外部数据。
+ * @param img 图像结构。
+ */
+void image_buffer_free(image_buffer_t *img)
+{
+    if (!img)
+        return;
+
+    free(img->storage);
+    memset(img, 0, sizeof(*img));
+}
+
+#ifdef PLANAR_HAVE_X86_SIMD
+/**
+ * @brief 构建三通道拆分用的 pshufb 掩码。
+ * @param masks 输出掩码，masks[c][k] 从第 k 个16字节块中取出通道 c 的字节。
+ */
+static void build_deinterleave3_masks(unsigned char masks[3][3][16])
+{
+    memset(masks, 0x80, 3 * 3 * 16);
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 16; i++) {
+            int s = 3 * i + c; // 第 i 个像素的通道 c 在48字节块中的位置
+            masks[c][s / 16][i] = (unsigned char)(s % 16);
+        }
+    }
+}
+
+/**
+ * @brief 构建三通道合并用的 pshufb 掩码。
+ * @param masks 输出掩码，masks[k][c] 将通道 c 的字节放到第 k 个16字节输出块中。
+ */
+static void build_interleave3_masks(unsigned char masks[3][3][16])
+{
+    memset(masks, 0x80, 3 * 3 * 16);
+    for (int k = 0; k < 3; k++) {
+        for (int j = 0; j < 16; j++) {
+            int s = 16 * k + j;
+            masks[k][s % 3][j] = (unsigned char)(s / 3);
+        }
+    }
+}
+
+/**
+ * @brief SSSE3 三通道拆分，一次处理16个像素，返回已处理的像素数。
+ */
+__attribute__((target("ssse3"))) static int
+deinterleave3_ssse3(const unsigned char *src, unsigned char *p0, unsigned char *p1, unsigned char *p2, int width)
+{
+    unsigned char m[3][3][16];
+    build_deinterleave3_masks(m);
+
+    __m128i mask[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 3; k++) {
+            mask[c][k] = _mm_loadu_si128((const __m128i *)m[c][k]);
+        }
+    }
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const unsigned char *s = src + x * 3;
+        __m128i a0 = _mm_loadu_si128((const __m128i *)s);
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(s + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i *)(s + 32));
+
+        __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, mask[0][0]), _mm_shuffle_epi8(a1, mask[0][1])),
+                                 _mm_shuffle_epi8(a2, mask[0][2]));
+        __m128i g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, mask[1][0]), _mm_shuffle_epi8(a1, mask[1][1])),
+                                 _mm_shuffle_epi8(a2, mask[1][2]));
+        __m128i b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, mask[2][0]), _mm_shuffle_epi8(a1, mask[2][1])),
+                                 _mm_shuffle_epi8(a2, mask[2][2]));
+
+        _mm_storeu_si128((__m128i *)(p0 + x), r);
+        _mm_storeu_si128((__m128i *)(p1 + x), g);
+        _mm_storeu_si128((__m128i *)(p2 + x), b);
+    }
+    return x;
+}
+
+/**
+ * @brief SSSE3 三通道合并，一次处理16个像素，返回已处理的像素数。
+ */
+__attribute__((target("ssse3"))) static int interleave3_ssse3(
+    const unsigned char *p0, const unsigned char *p1, const unsigned char *p2, unsigned char *dst, int width)
+{
+    unsigned char m[3][3][16];
+    build_interleave3_masks(m);
+
+    __m128i mask[3][3];
+    for (int k = 0; k < 3; k++) {
+        for (int c = 0; c < 3; c++) {
+            mask[k][c] = _mm_loadu_si128((const __m128i *)m[k][c]);
+        }
+    }
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r = _mm_loadu_si128((const __m128i *)(p0 + x));
+        __m128i g = _mm_loadu_si128((const __m128i *)(p1 + x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p2 + x));
+        unsigned char *d = dst + x * 3;
+
+        for (int k = 0; k < 3; k++) {
+            __m128i out = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, mask[k][0]), _mm_shuffle_epi8(g, mask[k][1])),
+                                       _mm_shuffle_epi8(b, mask[k][2]));
+            _mm_storeu_si128((__m128i *)(d + 16 * k), out);
+        }
+    }
+    return x;
+}
+
+/**
+ * @brief SSSE3 四通道拆分：先在每4个像素内按通道聚集，再做4x4的32位转置。
+ */
+__attribute__((target("ssse3"))) static int deinterleave4_ssse3(const unsigned char *src,
+                                                                 unsigned char *p0,
+                                                                 unsigned char *p1,
+                                                                 unsigned char *p2,
+                                                                 unsigned char *p3,
+                                                                 int width)
+{
+    const __m128i gather = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const unsigned char *s = src + x * 4;
+        __m128i v0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)s), gather);
+        __m128i v1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 16)), gather);
+        __m128i v2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 32)), gather);
+        __m128i v3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 48)), gather);
+
+        __m128i t0 = _mm_unpacklo_epi32(v0, v1); // r0-3 r4-7 g0-3 g4-7
+        __m128i t1 = _mm_unpacklo_epi32(v2, v3); // r8-11 r12-15 g8-11 g12-15
+        __m128i t2 = _mm_unpackhi_epi32(v0, v1); // b0-3 b4-7 a0-3 a4-7
+        __m128i t3 = _mm_unpackhi_epi32(v2, v3); // b8-11 b12-15 a8-11 a12-15
+
+        _mm_storeu_si128((__m128i *)(p0 + x), _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)(p1 + x), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)(p2 + x), _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i *)(p3 + x), _mm_unpackhi_epi64(t2, t3));
+    }
+    return x;
+}
+
+/**
+ * @brief SSE2 四通道合并：按字节、再按16位交错即可得到RGBA顺序。
+ */
+__attribute__((target("sse2"))) static int interleave4_sse2(const unsigned char *p0,
+                            const unsigned char *p1,
+                            const unsigned char *p2,
+                            const unsigned char *p3,
+                            unsigned char *dst,
+                            int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r = _mm_loadu_si128((const __m128i *)(p0 + x));
+        __m128i g = _mm_loadu_si128((const __m128i *)(p1 + x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p2 + x));
+        __m128i a = _mm_loadu_si128((const __m128i *)(p3 + x));
+
+        __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+        __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+        __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+        __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+        unsigned char *d = dst + x * 4;
+
+        _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128((__m128i *)(d + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128((__m128i *)(d + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+        _mm_storeu_si128((__m128i *)(d + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+    }
+    return x;
+}
+
+/**
+ * @brief 运行时检测CPU是否支持SSSE3（结果缓存）。
+ */
+static int cpu_has_ssse3(void)
+{
+    // 多个线程可能同时第一次调用，结果相同，用原子读写避免数据竞争
+    static int cached = -1;
+    int value = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+    if (value < 0) {
+        __builtin_cpu_init();
+        value = __builtin_cpu_supports("ssse3") ? 1 : 0;
+        __atomic_store_n(&cached, value, __ATOMIC_RELAXED);
+    }
+    return value;
+}
+#endif
+
+/**
+ * @brief 将交错像素行拆分为独立的通道平面。
+ * @param src 交错像素数据。
+ * @param src_stride 交错数据的行步长（字节）。
+ * @param planes 各通道平面的起点。
+ * @param plane_stride 平面的行步长（字节）。
+ * @param width 宽度。
+ * @param height 高度。
+ * @param channels 通道数 (1-4)。
+ */
+void deinterleave_rows(const unsigned char *src,
+                       int src_stride,
+                       unsigned char *const *planes,
+                       int plane_stride,
+                       int width,
+                       int height,
+                       int channels)
+{
+    if (!src || !planes || width <= 0 || height <= 0 || channels <= 0 || channels > IMAGE_MAX_CHANNELS) {
+        return;
+    }
+
+    const pixel_kernels_t *kernels = pixel_kernels_for(channels);
+    for (int y = 0; y < height; y++) {
+        const unsigned char *s = src + (size_t)y * src_stride;
+        size_t offset = (size_t)y * plane_stride;
+
+        if (channels == 1) {
+            memcpy(planes[0] + offset, s, width);
+            continue;
+        }
+
+        int x = 0;
+#ifdef PLANAR_HAVE_X86_SIMD
+        if (cpu_has_ssse3()) {
+            if (channels == 3) {
+                x = deinterleave3_ssse3(s, planes[0] + offset, planes[1] + offset, planes[2] + offset, width);
+            }
+            else if (channels == 4) {
+                x = deinterleave4_ssse3(
+                    s, planes[0] + offset, planes[1] + offset, planes[2] + offset, planes[3] + offset, width);
+            }
+        }
+#endif
+        // 剩余像素（或不支持SIMD时的全部像素）用按通道数特化的标量代码处理
+        unsigned char *row_planes[IMAGE_MAX_CHANNELS];
+        for (int c = 0; c < channels; c++)
+            row_planes[c] = planes[c] + offset;
+        kernels->deinterleave(s, row_planes, x, width, channels);
+    }
+}
+
+/**
+ * @brief 将独立的通道平面合并为交错像素行。
+ * @param planes 各通道平面的起点。
+ * @param plane_stride 平面的行步长（字节）。
+ * @param dst 交错像素数据。
+ * @param dst_stride 交错数据的行步长（字节）。
+ * @param width 宽度。
+ * @param height 高度。
+ * @param channels 通道数 (1-4)。
+ */
+void interleave_rows(const unsigned char *const *planes,
+                     int plane_stride,
+                     unsigned char *dst,
+                     int dst_stride,
+                     int width,
+                     int height,
+                     int channels)
+{
+    if (!planes || !dst || width <= 0 || height <= 0 || channels <= 0 || channels > IMAGE_MAX_CHANNELS) {
+        return;
+    }
+
+    const pixel_kernels_t *kernels = pixel_kernels_for(channels);
+    for (int y = 0; y < height; y++) {
+        unsigned char *d = dst + (size_t)y * dst_stride;
+        size_t offset = (size_t)y * plane_stride;
+
+        if (channels == 1) {
+            memcpy(d, planes[0] + offset, width);
+            continue;
+        }
+
+        int x = 0;
+#ifdef PLANAR_HAVE_X86_SIMD
+        if (channels == 3 && cpu_has_ssse3()) {
+            x = interleave3_ssse3(planes[0] + offset, planes[1] + offset, planes[2] + offset, d, width);
+        }
+        else if (channels == 4) {
+            x = interleave4_sse2(planes[0] + offset, planes[1] + offset, planes[2] + offset, planes[3] + offset, d, width);
+        }
+#endif
+        const unsigned char *row_planes[IMAGE_MAX_CHANNELS];
+        for (int c = 0; c < channels; c++)
+            row_planes[c] = planes[c] + offset;
+        kernels->interleave(row_planes, d, x, width, channels);
+    }
+}
+
+/**
+ * @brief 将交错图像转换为新分配的平面图像。
+ * @param src 交错布局的源图像。
+ * @param dst 输出的平面图像，调用者负责用 image_buffer_free 释放。
+ * @return 成功返回1，失败返回0。
+ */
+int image_buffer_to_planar(const image_buffer_t *src, image_buffer_t *dst)
+{
+    if (!src || !dst || src->layout != IMAGE_LAYOUT_INTERLEAVED || !src->data) {
+        return 0;
+    }
+
+    if (!image_buffer_alloc(dst, src->width, src->height, src->channels, IMAGE_LAYOUT_PLANAR)) {
+        return 0;
+    }
+
+    deinterleave_rows(src->data, src->stride, dst->planes, dst->stride, src->width, src->height, src->channels);
+    return 1;
+}
+
+/**
+ * @brief 将平面图像写回交错布局的目标图像（两者尺寸和通道数必须一致）。
+ * @param src 平面布局的源图像。
+ * @param dst 交错布局的目标图像。
+ * @return 成功返回1，失败返回0。
+ */
+int image_buffer_to_interleaved(const image_buffer_t *src, image_buffer_t *dst)
+{
+    if (!src || !dst || src->layout != IMAGE_LAYOUT_PLANAR || dst->layout != IMAGE_LAYOUT_INTERLEAVED ||
+        src->width != dst->width || src->height != dst->height || src->channels != dst->channels || !dst->data) {
+        return 0;
+    }
+
+    interleave_rows((const unsigned char *const *)src->planes,
+                    src->stride,
+                    dst->data,
+                    dst->stride,
+                    src->width,
+                    src->height,
+                    src->channels);
+    return 1;
+}
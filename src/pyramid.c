@@ -0,0 +1,204 @@
+#include "pyramid.h"
+#include "resize.h"
+#include <stddef.h> // For size_t
+#include <stdlib.h> // For malloc and free
+#include <string.h> // For memset
+
+/**
+ * @brief 用2x2盒式平均将图像缩小一半（奇数尺寸向上取整，末行/末列与自身平均）。
+ * @param src 源图像数据。
+ * @param width 源图像宽度。
+ * @param height 源图像高度。
+ * @param channels 通道数。
+ * @param out_width 输出宽度。
+ * @param out_height 输出高度。
+ * @return 成功返回新分配的缩小图像，调用者负责释放；失败返回NULL。
+ */
+unsigned char *downsample_2x(
+    const unsigned char *src, int width, int height, int channels, int *out_width, int *out_height)
+{
+    if (!src || width <= 0 || height <= 0 || channels <= 0 || !out_width || !out_height) {
+        return NULL;
+    }
+
+    int ow = (width + 1) / 2;
+    int oh = (height + 1) / 2;
+    size_t row_bytes = (size_t)width * channels;
+
+    unsigned char *dst = (unsigned char *)malloc((size_t)ow * oh * channels);
+    // 两行纵向求和的中间结果，宽度补齐为偶数以便横向成对相加
+    unsigned short *row_sum = (unsigned short *)malloc(((size_t)ow * 2) * channels * sizeof(unsigned short));
+    if (!dst || !row_sum) {
+        free(dst);
+        free(row_sum);
+        return NULL;
+    }
+
+    for (int y = 0; y < oh; y++) {
+        const unsigned char *r0 = src + (size_t)(2 * y) * row_bytes;
+        const unsigned char *r1 = (2 * y + 1 < height) ? r0 + row_bytes : r0;
+
+        // 纵向相加：连续内存上的逐元素运算，编译器可以直接向量化
+        for (size_t i = 0; i < row_bytes; i++) {
+            row_sum[i] = (unsigned short)(r0[i] + r1[i]);
+        }
+        // 奇数宽度时复制最后一列，使横向配对不必判断边界
+        if (width & 1) {
+            memcpy(row_sum + row_bytes, row_sum + row_bytes - channels, channels * sizeof(unsigned short));
+        }
+
+        // 横向相加并四舍五入
+        unsigned char *out = dst + (size_t)y * ow * channels;
+        for (int x = 0; x < ow; x++) {
+            const unsigned short *a = row_sum + (size_t)(2 * x) * channels;
+            const unsigned short *b = a + channels;
+            for (int c = 0; c < channels; c++) {
+                out[x * channels + c] = (unsigned char)((a[c] + b[c] + 2) >> 2);
+            }
+        }
+    }
+
+    free(row_sum);
+    *out_width = ow;
+    *out_height = oh;
+    return dst;
+}
+
+/**
+ * @brief 由原图构建金字塔。
+ * @param pyramid 输出的金字塔。
+ * @param data 原图数据，作为第0层（金字塔不负责释放）。
+ * @param width 原图宽度。
+ * @param height 原图高度。
+ * @param channels 通道数。
+ * @param max_factor 最大缩小倍数（1/2/4/8）。
+ * @return 成功返回1，失败返回0。
+ */
+int pyramid_build(image_pyramid_t *pyramid, unsigned char *data, int width, int height, int channels, int max_factor)
+{
+    if (!pyramid || !data || width <= 0 || height <= 0 || channels <= 0) {
+        return 0;
+    }
+
+    memset(pyramid, 0, sizeof(*pyramid));
+    pyramid->channels = channels;
+    pyramid->width[0] = width;
+    pyramid->height[0] = height;
+    pyramid->data[0] = data;
+    pyramid->levels = 1;
+
+    // 每一层都由上一层缩小得到，总开销约为原图的1/3
+    for (int level = 1; level < PYRAMID_MAX_LEVELS && (1 << level) <= max_factor; level++) {
+        int pw = pyramid->width[level - 1];
+        int ph = pyramid->height[level - 1];
+        if (pw < 2 && ph < 2)
+            break;
+
+        unsigned char *reduced = downsample_2x(
+            pyramid->data[level - 1], pw, ph, channels, &pyramid->width[level], &pyramid->height[level]);
+        if (!reduced) {
+            pyramid_free(pyramid);
+            return 0;
+        }
+        pyramid->data[level] = reduced;
+        pyramid->levels = level + 1;
+    }
+    return 1;
+}
+
+/**
+ * @brief 为给定的块大小选择最合适的层：缩小倍数必须整除块大小，且尽可能大。
+ * @param pyramid 金字塔。
+ * @param block_size 每个输出单元在原图中对应的像素数。
+ * @return 选中的层号。
+ */
+int pyramid_level_for_block(const image_pyramid_t *pyramid, int block_size)
+{
+    int best = 0;
+    for (int level = 1; pyramid && level < pyramid->levels; level++) {
+        if (block_size % (1 << level) == 0) {
+            best = level;
+        }
+    }
+    // 被丢弃（没有数据）的层只能改用更小的层
+    while (pyramid && !pyramid->data[best] && best + 1 < pyramid->levels) {
+        best++;
+    }
+    return best;
+}
+
+/**
+ * @brief 选择长边不超过 max_size 的最大一层（都不满足时返回最小的一层）。
+ * @param pyramid 金字塔。
+ * @param max_size 长边上限（像素）。
+ * @return 选中的层号。
+ */
+int pyramid_level_for_size(const image_pyramid_t *pyramid, int max_size)
+{
+    if (!pyramid || pyramid->levels <= 0)
+        return 0;
+
+    for (int level = 0; level < pyramid->levels; level++) {
+        int longest = pyramid->width[level] > pyramid->height[level] ? pyramid->width[level] : pyramid->height[level];
+        if (longest <= max_size && pyramid->data[level]) {
+            return level;
+        }
+    }
+    return pyramid->levels - 1;
+}
+
+/**
+ * @brief 生成长边不超过 max_size 的缩略图：取长边不超过 max_size 的最大一层，
+ *        最小的一层仍然过大时（原图大于 8*max_size）再用盒式滤波缩放到上限。
+ * @param pyramid 金字塔。
+ * @param max_size 长边上限（像素）。
+ * @param out_width 输出的缩略图宽度。
+ * @param out_height 输出的缩略图高度。
+ * @return 成功返回新分配的缩略图，调用者负责释放；失败返回NULL。
+ */
+unsigned char *pyramid_thumbnail(const image_pyramid_t *pyramid, int max_size, int *out_width, int *out_height)
+{
+    if (!pyramid || pyramid->levels <= 0 || max_size <= 0 || !out_width || !out_height)
+        return NULL;
+
+    int level = pyramid_level_for_size(pyramid, max_size);
+    const unsigned char *src = pyramid->data[level];
+    int w = pyramid->width[level];
+    int h = pyramid->height[level];
+    if (!src)
+        return NULL;
+
+    // 金字塔最多缩小8倍，更大的原图在最小的一层上再缩放一次，保持宽高比
+    int longest = w > h ? w : h;
+    if (longest > max_size) {
+        int tw = w >= h ? max_size : (int)(((long long)w * max_size + longest / 2) / longest);
+        int th = h >= w ? max_size : (int)(((long long)h * max_size + longest / 2) / longest);
+        *out_width = tw > 0 ? tw : 1;
+        *out_height = th > 0 ? th : 1;
+        return resize_image(src, w, h, pyramid->channels, *out_width, *out_height, RESIZE_FILTER_BOX);
+    }
+
+    size_t size = (size_t)w * h * pyramid->channels;
+    unsigned char *copy = (unsigned char *)malloc(size);
+    if (copy)
+        memcpy(copy, src, size);
+    *out_width = w;
+    *out_height = h;
+    return copy;
+}
+
+/**
+ * @brief 释放金字塔第1层及以上的数据（第0层由调用者管理）。
+ * @param pyramid 金字塔。
+ */
+void pyramid_free(image_pyramid_t *pyramid)
+{
+    if (!pyramid)
+        return;
+
+    for (int level = 1; level < PYRAMID_MAX_LEVELS; level++) {
+        free(pyramid->data[level]);
+        pyramid->data[level] = NULL;
+    }
+    pyramid->levels = 0;
+}
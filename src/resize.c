@@ -0,0 +1,501 @@
+#include "resize.h"
+#include "parallel.h"
+#include <stddef.h> // For size_t
+#include <stdlib.h> // For malloc and free
+#include <string.h> // For strcmp
+#include <math.h>   // For sin, ceil, fabs 和 M_PI
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 定点权重的小数位数
+#define RESIZE_PRECISION_BITS 14
+#define RESIZE_ROUND_BIAS (1 << (RESIZE_PRECISION_BITS - 1))
+
+// 每个输出位置对应的输入区间和权重
+typedef struct
+{
+    int *start;     // 每个输出位置的第一个输入下标
+    int *count;     // 每个输出位置参与计算的输入个数
+    short *weights; // 定点权重，每个输出位置占 max_count 个
+    int max_count;  // 单个输出位置的最大输入个数
+} resize_coeffs_t;
+
+// 滤波器描述：核函数和支撑半径
+typedef struct
+{
+    double (*kernel)(double x);
+    double support;
+} resize_kernel_t;
+
+static double box_kernel(double x)
+{
+    // 区间取 (-0.5, 0.5]，与取样范围的取整方式一致，否则放大时落在区间端点上的输出没有任何输入
+    if (x > -0.5 && x <= 0.5)
+        return 1.0;
+    return 0.0;
+}
+
+static double triangle_kernel(double x)
+{
+    if (x < 0.0)
+        x = -x;
+    if (x < 1.0)
+        return 1.0 - x;
+    return 0.0;
+}
+
+static double bicubic_kernel(double x)
+{
+    // 取 a = -0.5 的 Keys 三次卷积核
+    const double a = -0.5;
+    if (x < 0.0)
+        x = -x;
+    if (x < 1.0)
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1;
+    if (x < 2.0)
+        return (((x - 5) * x + 8) * x - 4) * a;
+    return 0.0;
+}
+
+static double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double lanczos3_kernel(double x)
+{
+    if (x > -3.0 && x < 3.0)
+        return sinc(x) * sinc(x / 3.0);
+    return 0.0;
+}
+
+/**
+ * @brief 获取滤波器的核函数和支撑半径。
+ */
+static resize_kernel_t get_kernel(resize_filter_t filter)
+{
+    resize_kernel_t k;
+    switch (filter) {
+    case RESIZE_FILTER_BOX:
+        k.kernel = box_kernel;
+        k.support = 0.5;
+        break;
+    case RESIZE_FILTER_BILINEAR:
+        k.kernel = triangle_kernel;
+        k.support = 1.0;
+        break;
+    case RESIZE_FILTER_BICUBIC:
+        k.kernel = bicubic_kernel;
+        k.support = 2.0;
+        break;
+    case RESIZE_FILTER_LANCZOS3:
+    default:
+        k.kernel = lanczos3_kernel;
+        k.support = 3.0;
+        break;
+    }
+    return k;
+}
+
+/**
+ * @brief 释放权重表。
+ */
+static void free_coeffs(resize_coeffs_t *c)
+{
+    free(c->start);
+    free(c->count);
+    free(c->weights);
+}
+
+/**
+ * @brief 预计算一维重采样的权重表。
+ * @param in_size 输入长度。
+ * @param out_size 输出长度。
+ * @param filter 滤波器。
+ * @param c 输出的权重表。
+ * @return 成功返回1，失败返回0。
+ */
+static int precompute_coeffs(int in_size, int out_size, resize_filter_t filter, resize_coeffs_t *c)
+{
+    resize_kernel_t k = get_kernel(filter);
+
+    double scale = (double)in_size / out_size;
+    // 缩小时把滤波核按比例拉宽，放大时保持原始宽度
+    double filter_scale = scale < 1.0 ? 1.0 : scale;
+    double support = k.support * filter_scale;
+    int max_count = (int)ceil(support) * 2 + 1;
+
+    memset(c, 0, sizeof(*c));
+    c->start = (int *)malloc(out_size * sizeof(int));
+    c->count = (int *)malloc(out_size * sizeof(int));
+    c->weights = (short *)calloc((size_t)out_size * max_count, sizeof(short));
+    double *w = (double *)malloc(max_count * sizeof(double));
+    if (!c->start || !c->count || !c->weights || !w) {
+        free_coeffs(c);
+        free(w);
+        return 0;
+    }
+    c->max_count = max_count;
+
+    for (int i = 0; i < out_size; i++) {
+        double center = (i + 0.5) * scale;
+        int lo = (int)(center - support + 0.5);
+        int hi = (int)(center + support + 0.5);
+        if (lo < 0)
+            lo = 0;
+        if (hi > in_size)
+            hi = in_size;
+        int n = hi - lo;
+        if (n > max_count)
+            n = max_count;
+
+        double total = 0.0;
+        for (int j = 0; j < n; j++) {
+            w[j] = k.kernel((j + lo - center + 0.5) / filter_scale);
+            total += w[j];
+        }
+
+        // 归一化后转换为定点数
+        short *fixed = c->weights + (size_t)i * max_count;
+        for (int j = 0; j < n; j++) {
+            double v = total != 0.0 ? w[j] / total : 0.0;
+            fixed[j] = (short)floor(v * (1 << RESIZE_PRECISION_BITS) + 0.5);
+        }
+        c->start[i] = lo;
+        c->count[i] = n;
+    }
+
+    free(w);
+    return 1;
+}
+
+/**
+ * @brief 把定点累加结果还原为0-255之间的像素值。
+ */
+static inline unsigned char clip_fixed(int acc)
+{
+    acc >>= RESIZE_PRECISION_BITS;
+    if (acc < 0)
+        return 0;
+    if (acc > 255)
+        return 255;
+    return (unsigned char)acc;
+}
+
+// 两遍卷积共享的参数
+typedef struct
+{
+    const unsigned char *src;
+    unsigned char *dst;
+    int src_width;  // 横向：源宽度；纵向：未使用
+    int dst_width;  // 输出宽度（像素）
+    int channels;
+    int row_offset; // 横向：源起始行；纵向：中间结果起始行
+    const resize_coeffs_t *coeffs;
+} resize_pass_t;
+
+#if defined(__SSE2__)
+/**
+ * @brief SSE2 横向卷积一个3/4通道的输出像素：每次取两个输入像素按通道交错，用 pmaddwd 同时乘加两个权重，
+ *        四个通道在一个寄存器中并行累加。3通道时每个像素按4字节读取，多读的字节只进入被丢弃的第4个累加器，
+ *        调用者保证多读的1字节仍在源行内。
+ */
+static void horizontal_pixel_sse2(const unsigned char *s, int ch, const short *w, int n, unsigned char *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_set1_epi32(RESIZE_ROUND_BIAS);
+    int k = 0;
+    for (; k + 1 < n; k += 2) {
+        int p0, p1;
+        memcpy(&p0, s + (size_t)k * ch, 4);
+        memcpy(&p1, s + (size_t)(k + 1) * ch, 4);
+        // [r0 r1 g0 g1 b0 b1 a0 a1]，与 (w[k], w[k+1]) 成对相乘
+        __m128i pix = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(p0), _mm_cvtsi32_si128(p1)), zero);
+        __m128i coeff = _mm_set1_epi32((int)((unsigned short)w[k] | ((unsigned int)(unsigned short)w[k + 1] << 16)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(pix, coeff));
+    }
+    if (k < n) {
+        // 奇数个权重时最后一个像素与0配对
+        int p0;
+        memcpy(&p0, s + (size_t)k * ch, 4);
+        __m128i pix = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(p0), zero), zero);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(pix, _mm_set1_epi32((unsigned short)w[k])));
+    }
+
+    acc = _mm_srai_epi32(acc, RESIZE_PRECISION_BITS);
+    // 饱和打包自动完成 0-255 钳制
+    int packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(acc, acc), zero));
+    memcpy(dst, &packed, (size_t)ch);
+}
+#endif
+
+/**
+ * @brief 横向卷积：对 [begin, end) 行，每个输出像素按权重累加源行上的连续像素。
+ */
+static void horizontal_pass(void *ctx, int begin, int end)
+{
+    const resize_pass_t *p = (const resize_pass_t *)ctx;
+    const resize_coeffs_t *c = p->coeffs;
+    int ch = p->channels;
+    size_t src_row_bytes = (size_t)p->src_width * ch;
+    size_t dst_row_bytes = (size_t)p->dst_width * ch;
+
+    for (int y = begin; y < end; y++) {
+        const unsigned char *src = p->src + (size_t)(y + p->row_offset) * src_row_bytes;
+        unsigned char *dst = p->dst + (size_t)y * dst_row_bytes;
+
+        for (int x = 0; x < p->dst_width; x++) {
+            const unsigned char *s = src + (size_t)c->start[x] * ch;
+            const short *w = c->weights + (size_t)x * c->max_count;
+            int n = c->count[x];
+
+#if defined(__SSE2__)
+            // 3通道时多读1字节，行末的一两个输出像素仍用标量计算
+            if (ch == 4 || (ch == 3 && s + (size_t)n * 3 < src + src_row_bytes)) {
+                horizontal_pixel_sse2(s, ch, w, n, dst + (size_t)x * ch);
+                continue;
+            }
+#endif
+            // 常见的3/4通道展开为固定数量的累加器，避免按通道的内层循环
+            if (ch == 3) {
+                int a0 = RESIZE_ROUND_BIAS, a1 = RESIZE_ROUND_BIAS, a2 = RESIZE_ROUND_BIAS;
+                for (int k = 0; k < n; k++) {
+                    a0 += s[k * 3] * w[k];
+                    a1 += s[k * 3 + 1] * w[k];
+                    a2 += s[k * 3 + 2] * w[k];
+                }
+                dst[x * 3] = clip_fixed(a0);
+                dst[x * 3 + 1] = clip_fixed(a1);
+                dst[x * 3 + 2] = clip_fixed(a2);
+            }
+            else if (ch == 4) {
+                int a0 = RESIZE_ROUND_BIAS, a1 = RESIZE_ROUND_BIAS, a2 = RESIZE_ROUND_BIAS, a3 = RESIZE_ROUND_BIAS;
+                for (int k = 0; k < n; k++) {
+                    a0 += s[k * 4] * w[k];
+                    a1 += s[k * 4 + 1] * w[k];
+                    a2 += s[k * 4 + 2] * w[k];
+                    a3 += s[k * 4 + 3] * w[k];
+                }
+                dst[x * 4] = clip_fixed(a0);
+                dst[x * 4 + 1] = clip_fixed(a1);
+                dst[x * 4 + 2] = clip_fixed(a2);
+                dst[x * 4 + 3] = clip_fixed(a3);
+            }
+            else {
+                for (int cc = 0; cc < ch; cc++) {
+                    int acc = RESIZE_ROUND_BIAS;
+                    for (int k = 0; k < n; k++) {
+                        acc += s[k * ch + cc] * w[k];
+                    }
+                    dst[x * ch + cc] = clip_fixed(acc);
+                }
+            }
+        }
+    }
+}
+
+#if defined(__SSE2__)
+/**
+ * @brief SSE2 纵向卷积一行：每次处理16字节，两条源行配对后用 pmaddwd 同时乘加。
+ * @return 已处理的字节数。
+ */
+static size_t vertical_row_sse2(const unsigned char *src, size_t row_bytes, const short *w, int n, unsigned char *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi32(RESIZE_ROUND_BIAS);
+    size_t i = 0;
+
+    for (; i + 16 <= row_bytes; i += 16) {
+        __m128i acc0 = bias, acc1 = bias, acc2 = bias, acc3 = bias;
+
+        for (int k = 0; k < n; k += 2) {
+            const unsigned char *ra = src + (size_t)k * row_bytes + i;
+            // 奇数个权重时最后一行与自身配对，权重补0
+            const unsigned char *rb = (k + 1 < n) ? ra + row_bytes : ra;
+            short wb = (k + 1 < n) ? w[k + 1] : 0;
+            __m128i coeff = _mm_set1_epi32((int)((unsigned short)w[k] | ((unsigned int)(unsigned short)wb << 16)));
+
+            __m128i a = _mm_loadu_si128((const __m128i *)ra);
+            __m128i b = _mm_loadu_si128((const __m128i *)rb);
+            __m128i a_lo = _mm_unpacklo_epi8(a, zero);
+            __m128i a_hi = _mm_unpackhi_epi8(a, zero);
+            __m128i b_lo = _mm_unpacklo_epi8(b, zero);
+            __m128i b_hi = _mm_unpackhi_epi8(b, zero);
+
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a_lo, b_lo), coeff));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a_lo, b_lo), coeff));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(a_hi, b_hi), coeff));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(a_hi, b_hi), coeff));
+        }
+
+        acc0 = _mm_srai_epi32(acc0, RESIZE_PRECISION_BITS);
+        acc1 = _mm_srai_epi32(acc1, RESIZE_PRECISION_BITS);
+        acc2 = _mm_srai_epi32(acc2, RESIZE_PRECISION_BITS);
+        acc3 = _mm_srai_epi32(acc3, RESIZE_PRECISION_BITS);
+        // 饱和打包自动完成 0-255 钳制
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3));
+        _mm_storeu_si128((__m128i *)(dst + i), packed);
+    }
+    return i;
+}
+#endif
+
+/**
+ * @brief 纵向卷积：对 [begin, end) 输出行，按权重累加中间结果中的若干整行。
+ */
+static void vertical_pass(void *ctx, int begin, int end)
+{
+    const resize_pass_t *p = (const resize_pass_t *)ctx;
+    const resize_coeffs_t *c = p->coeffs;
+    size_t row_bytes = (size_t)p->dst_width * p->channels;
+
+    for (int y = begin; y < end; y++) {
+        const unsigned char *src = p->src + (size_t)(c->start[y] - p->row_offset) * row_bytes;
+        const short *w = c->weights + (size_t)y * c->max_count;
+        int n = c->count[y];
+        unsigned char *dst = p->dst + (size_t)y * row_bytes;
+
+        size_t i = 0;
+#if defined(__SSE2__)
+        i = vertical_row_sse2(src, row_bytes, w, n, dst);
+#endif
+        for (; i < row_bytes; i++) {
+            int acc = RESIZE_ROUND_BIAS;
+            for (int k = 0; k < n; k++) {
+                acc += src[(size_t)k * row_bytes + i] * w[k];
+            }
+            dst[i] = clip_fixed(acc);
+        }
+    }
+}
+
+/**
+ * @brief 缩放图像到指定尺寸。
+ * @param data 源图像数据（交错布局、紧密排列）。
+ * @param width 源图像宽度。
+ * @param height 源图像高度。
+ * @param channels 图像通道数。
+ * @param new_width 目标宽度。
+ * @param new_height 目标高度。
+ * @param filter 重采样滤波器。
+ * @return 成功返回新分配的缩放结果，调用者负责释放；失败返回NULL。
+ */
+unsigned char *resize_image(const unsigned char *data,
+                            int width,
+                            int height,
+                            int channels,
+                            int new_width,
+                            int new_height,
+                            resize_filter_t filter)
+{
+    if (!data || width <= 0 || height <= 0 || channels <= 0 || new_width <= 0 || new_height <= 0) {
+        return NULL;
+    }
+
+    unsigned char *result = (unsigned char *)malloc((size_t)new_height * new_width * channels);
+    if (!result) {
+        return NULL;
+    }
+    if (!resize_image_into(data, width, height, channels, result, new_width, new_height, filter)) {
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * @brief 缩放图像，结果写入调用者提供的缓冲区。
+ * @param data 源图像数据（交错布局、紧密排列）。
+ * @param width 源图像宽度。
+ * @param height 源图像高度。
+ * @param channels 图像通道数。
+ * @param dst 目标缓冲区，至少 new_width * new_height * channels 字节。横向一遍先把所需源行全部读入
+ *            中间缓冲区，纵向一遍才写 dst，因此容量足够时 dst 可以就是 data。
+ * @param new_width 目标宽度。
+ * @param new_height 目标高度。
+ * @param filter 重采样滤波器。
+ * @return 成功返回1，失败返回0。
+ */
+int resize_image_into(const unsigned char *data,
+                      int width,
+                      int height,
+                      int channels,
+                      unsigned char *dst,
+                      int new_width,
+                      int new_height,
+                      resize_filter_t filter)
+{
+    if (!data || !dst || width <= 0 || height <= 0 || channels <= 0 || new_width <= 0 || new_height <= 0) {
+        return 0;
+    }
+
+    resize_coeffs_t hc, vc;
+    if (!precompute_coeffs(width, new_width, filter, &hc)) {
+        return 0;
+    }
+    if (!precompute_coeffs(height, new_height, filter, &vc)) {
+        free_coeffs(&hc);
+        return 0;
+    }
+
+    // 纵向卷积实际用到的源行范围，横向结果只需覆盖这些行
+    int first_row = vc.start[0];
+    int last_row = vc.start[new_height - 1] + vc.count[new_height - 1];
+    int temp_rows = last_row - first_row;
+
+    unsigned char *temp = (unsigned char *)malloc((size_t)temp_rows * new_width * channels);
+    if (!temp) {
+        free_coeffs(&hc);
+        free_coeffs(&vc);
+        return 0;
+    }
+
+    // 第一遍：横向缩放
+    resize_pass_t h = {data, temp, width, new_width, channels, first_row, &hc};
+    parallel_for(temp_rows, 16, horizontal_pass, &h);
+
+    // 第二遍：纵向缩放
+    resize_pass_t v = {temp, dst, new_width, new_width, channels, first_row, &vc};
+    parallel_for(new_height, 16, vertical_pass, &v);
+
+    free(temp);
+    free_coeffs(&hc);
+    free_coeffs(&vc);
+    return 1;
+}
+
+/**
+ * @brief 按名称解析滤波器（"box"、"bilinear"、"bicubic"、"lanczos3"）。
+ * @param name 滤波器名称。
+ * @param filter 输出的滤波器。
+ * @return 成功返回1，未知名称返回0。
+ */
+int resize_filter_from_name(const char *name, resize_filter_t *filter)
+{
+    static const struct
+    {
+        const char *name;
+        resize_filter_t filter;
+    } names[] = {
+        {"box", RESIZE_FILTER_BOX},
+        {"bilinear", RESIZE_FILTER_BILINEAR},
+        {"bicubic", RESIZE_FILTER_BICUBIC},
+        {"lanczos3", RESIZE_FILTER_LANCZOS3},
+    };
+
+    if (!name || !filter)
+        return 0;
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i].name) == 0) {
+            *filter = names[i].filter;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "rotate.h"
+#include <stddef.h> // 为 size_t
 #include <stdlib.h> // 为 malloc 和 free 函数
 #include <string.h> // 为 memcpy 函数
 
@@ -14,29 +15,61 @@ void rotate_image(unsigned char *data, int width, int height, int channels)
     if (!data || width <= 0 || height <= 0 || channels <= 0)
         return;
 
-    // 分配临时缓冲区
-    unsigned char *temp = (unsigned char *)malloc(width * height * channels);
-    if (!temp)
-        return;
+    image_rect_t full = {0, 0, width, height};
+    rotate_image_roi(data, width, height, channels, width * channels, full, NULL, 0);
+}
+
+/**
+ * @brief 对图像中的矩形区域做上下翻转
+ * @param data 整幅图像的像素数据
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param channels 图像通道数
+ * @param stride 图像的行步长（字节）
+ * @param roi 处理区域，超出图像的部分会被裁剪
+ * @param dst 输出区域左上角像素的地址，传NULL表示在区域内原地翻转
+ * @param dst_stride 输出的行步长（字节）
+ * @return 成功返回1，失败返回0
+ */
+int rotate_image_roi(unsigned char *data,
+                     int width,
+                     int height,
+                     int channels,
+                     int stride,
+                     image_rect_t roi,
+                     unsigned char *dst,
+                     int dst_stride)
+{
+    if (!data || channels <= 0 || !image_rect_clip(&roi, width, height))
+        return 0;
 
-    // 复制原始数据
-    memcpy(temp, data, width * height * channels);
-
-    // 垂直翻转 (上下翻转)
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            // 源像素位置：从顶部开始
-            unsigned char *src_pixel = temp + (y * width + x) * channels;
-            // 目标像素位置：从底部开始
-            unsigned char *dst_pixel = data + ((height - 1 - y) * width + x) * channels;
-
-            // 复制所有通道的像素值
-            for (int c = 0; c < channels; c++) {
-                dst_pixel[c] = src_pixel[c];
-            }
+    unsigned char *src = data + (size_t)roi.y * stride + (size_t)roi.x * channels;
+    size_t row_bytes = (size_t)roi.w * channels;
+
+    // 输出到独立缓冲区时直接按倒序拷贝各行
+    if (dst && dst != src) {
+        for (int y = 0; y < roi.h; y++) {
+            memcpy(dst + (size_t)(roi.h - 1 - y) * dst_stride, src + (size_t)y * stride, row_bytes);
         }
+        return 1;
+    }
+
+    // 只需要一行大小的临时缓冲区
+    unsigned char *temp = (unsigned char *)malloc(row_bytes);
+    if (!temp)
+        return 0;
+
+    // 垂直翻转 (上下翻转)：成对交换首尾两行，整行连续拷贝不再按通道逐字节复制
+    for (int y = 0; y < roi.h / 2; y++) {
+        unsigned char *top_row = src + (size_t)y * stride;
+        unsigned char *bottom_row = src + (size_t)(roi.h - 1 - y) * stride;
+
+        memcpy(temp, top_row, row_bytes);
+        memcpy(top_row, bottom_row, row_bytes);
+        memcpy(bottom_row, temp, row_bytes);
     }
 
     // 释放临时缓冲区
     free(temp);
+    return 1;
 }
@@ -0,0 +1,419 @@
+#include "scheduler.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// 双端队列的初始容量（必须是2的幂），满时翻倍
+#define DEQUE_INITIAL_CAPACITY 64
+
+#ifdef _WIN32
+typedef SRWLOCK sched_mutex_t;
+typedef CONDITION_VARIABLE sched_cond_t;
+#define MUTEX_INIT(m) InitializeSRWLock(m)
+#define MUTEX_DESTROY(m) ((void)(m))
+#define MUTEX_LOCK(m) AcquireSRWLockExclusive(m)
+#define MUTEX_UNLOCK(m) ReleaseSRWLockExclusive(m)
+#define COND_INIT(c) InitializeConditionVariable(c)
+#define COND_DESTROY(c) ((void)(c))
+#define COND_WAIT(c, m) SleepConditionVariableSRW(c, m, INFINITE, 0)
+#define COND_SIGNAL(c) WakeConditionVariable(c)
+#define COND_BROADCAST(c) WakeAllConditionVariable(c)
+#define THREAD_YIELD() SwitchToThread()
+#else
+typedef pthread_mutex_t sched_mutex_t;
+typedef pthread_cond_t sched_cond_t;
+#define MUTEX_INIT(m) pthread_mutex_init(m, NULL)
+#define MUTEX_DESTROY(m) pthread_mutex_destroy(m)
+#define MUTEX_LOCK(m) pthread_mutex_lock(m)
+#define MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
+#define COND_INIT(c) pthread_cond_init(c, NULL)
+#define COND_DESTROY(c) pthread_cond_destroy(c)
+#define COND_WAIT(c, m) pthread_cond_wait(c, m)
+#define COND_SIGNAL(c) pthread_cond_signal(c)
+#define COND_BROADCAST(c) pthread_cond_broadcast(c)
+#define THREAD_YIELD() sched_yield()
+#endif
+
+// 一个待执行的任务
+typedef struct
+{
+    task_fn fn;
+    void *arg;
+    task_group_t *group;
+} task_t;
+
+// 环形缓冲区实现的双端队列：所有者在队尾压入和取出，窃取者从队首取。
+// 任务粒度是整幅小图像或大图像的一个分块（远大于加锁的开销），因此每个队列用一把锁保护
+typedef struct
+{
+    task_t *tasks;
+    int capacity;
+    int head;  // 队首下标
+    int count; // 任务数（锁外只用于快速跳过空队列）
+    sched_mutex_t lock;
+} task_deque_t;
+
+typedef struct
+{
+    scheduler_t *sched;
+    task_deque_t deque;
+    unsigned int rng; // 选择窃取对象的随机数状态
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+    int started;
+} scheduler_worker_t;
+
+struct scheduler
+{
+    scheduler_worker_t *workers;
+    int thread_count;
+    task_deque_t global; // 工作线程之外提交的任务
+    int queued;          // 所有队列中的任务总数
+    int idle;            // 正在休眠的工作线程数
+    int stop;
+    sched_mutex_t lock;     // 保护休眠、唤醒和停止标志
+    sched_cond_t work_cond; // 有新任务
+    sched_cond_t done_cond; // 有任务组完成
+};
+
+static __thread scheduler_worker_t *current_worker = NULL;
+
+static int deque_init(task_deque_t *dq)
+{
+    dq->tasks = (task_t *)malloc(DEQUE_INITIAL_CAPACITY * sizeof(task_t));
+    dq->capacity = DEQUE_INITIAL_CAPACITY;
+    dq->head = 0;
+    dq->count = 0;
+    MUTEX_INIT(&dq->lock);
+    return dq->tasks != NULL;
+}
+
+static void deque_free(task_deque_t *dq)
+{
+    free(dq->tasks);
+    dq->tasks = NULL;
+    MUTEX_DESTROY(&dq->lock);
+}
+
+/**
+ * @brief 压入队尾，队列满时扩容。
+ * @return 成功返回1，内存不足返回0。
+ */
+static int deque_push_back(task_deque_t *dq, const task_t *task)
+{
+    MUTEX_LOCK(&dq->lock);
+    if (dq->count == dq->capacity) {
+        task_t *grown = (task_t *)malloc((size_t)dq->capacity * 2 * sizeof(task_t));
+        if (!grown) {
+            MUTEX_UNLOCK(&dq->lock);
+            return 0;
+        }
+        // 按队列顺序拷贝到新数组的开头
+        for (int i = 0; i < dq->count; i++)
+            grown[i] = dq->tasks[(dq->head + i) & (dq->capacity - 1)];
+        free(dq->tasks);
+        dq->tasks = grown;
+        dq->capacity *= 2;
+        dq->head = 0;
+    }
+    dq->tasks[(dq->head + dq->count) & (dq->capacity - 1)] = *task;
+    __atomic_store_n(&dq->count, dq->count + 1, __ATOMIC_RELAXED);
+    MUTEX_UNLOCK(&dq->lock);
+    return 1;
+}
+
+/**
+ * @brief 从队尾（from_back 非0）或队首取出一个任务。
+ * @return 取到返回1，队列为空返回0。
+ */
+static int deque_pop(task_deque_t *dq, int from_back, task_t *task)
+{
+    if (__atomic_load_n(&dq->count, __ATOMIC_RELAXED) == 0)
+        return 0;
+
+    MUTEX_LOCK(&dq->lock);
+    int found = dq->count > 0;
+    if (found) {
+        if (from_back) {
+            *task = dq->tasks[(dq->head + dq->count - 1) & (dq->capacity - 1)];
+        }
+        else {
+            *task = dq->tasks[dq->head];
+            dq->head = (dq->head + 1) & (dq->capacity - 1);
+        }
+        __atomic_store_n(&dq->count, dq->count - 1, __ATOMIC_RELAXED);
+    }
+    MUTEX_UNLOCK(&dq->lock);
+    return found;
+}
+
+/**
+ * @brief 找一个可执行的任务：先取自己队列的队尾，再从随机选择的其他线程的队首窃取，最后（如果允许）取全局队列。
+ * @param sched 调度器。
+ * @param self 当前工作线程，非工作线程为NULL。
+ * @param allow_global 是否允许领取全局队列中的任务。
+ * @param task 输出的任务。
+ * @return 找到返回1，否则返回0。
+ */
+static int find_task(scheduler_t *sched, scheduler_worker_t *self, int allow_global, task_t *task)
+{
+    int found = self && deque_pop(&self->deque, 1, task);
+
+    if (!found && sched->thread_count > 1) {
+        unsigned int start = 0;
+        if (self) {
+            self->rng = self->rng * 1103515245u + 12345u;
+            start = (self->rng >> 16) % (unsigned int)sched->thread_count;
+        }
+        for (int i = 0; i < sched->thread_count && !found; i++) {
+            scheduler_worker_t *victim = &sched->workers[(start + i) % sched->thread_count];
+            if (victim != self)
+                found = deque_pop(&victim->deque, 0, task);
+        }
+    }
+
+    if (!found && allow_global)
+        found = deque_pop(&sched->global, 0, task);
+
+    if (found)
+        __atomic_sub_fetch(&sched->queued, 1, __ATOMIC_SEQ_CST);
+    return found;
+}
+
+/**
+ * @brief 执行任务，并在它是所属组的最后一个任务时唤醒等待该组的非工作线程。
+ */
+static void run_task(scheduler_t *sched, const task_t *task)
+{
+    task->fn(task->arg);
+    if (task->group && __atomic_sub_fetch(&task->group->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        MUTEX_LOCK(&sched->lock);
+        COND_BROADCAST(&sched->done_cond);
+        MUTEX_UNLOCK(&sched->lock);
+    }
+}
+
+static void worker_loop(scheduler_worker_t *self)
+{
+    scheduler_t *sched = self->sched;
+    current_worker = self;
+
+    for (;;) {
+        task_t task;
+        if (find_task(sched, self, 1, &task)) {
+            run_task(sched, &task);
+            continue;
+        }
+
+        // 没有任务时休眠。idle 和 queued 都按顺序一致的原子操作读写：提交者先增加 queued 再读 idle，
+        // 这里先增加 idle 再读 queued，两边至少有一方能看到对方的修改，唤醒不会丢失
+        MUTEX_LOCK(&sched->lock);
+        if (sched->stop) {
+            MUTEX_UNLOCK(&sched->lock);
+            break;
+        }
+        __atomic_add_fetch(&sched->idle, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&sched->queued, __ATOMIC_SEQ_CST) == 0)
+            COND_WAIT(&sched->work_cond, &sched->lock);
+        __atomic_sub_fetch(&sched->idle, 1, __ATOMIC_SEQ_CST);
+        MUTEX_UNLOCK(&sched->lock);
+    }
+
+    current_worker = NULL;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg)
+{
+    worker_loop((scheduler_worker_t *)arg);
+    return 0;
+}
+#else
+static void *worker_main(void *arg)
+{
+    worker_loop((scheduler_worker_t *)arg);
+    return NULL;
+}
+#endif
+
+/**
+ * @brief 创建调度器并启动工作线程。
+ * @param threads 工作线程数，<=0 时使用 parallel_thread_count()。
+ * @return 调度器，失败返回NULL。
+ */
+scheduler_t *scheduler_create(int threads)
+{
+    if (threads <= 0)
+        threads = parallel_thread_count();
+
+    scheduler_t *sched = (scheduler_t *)calloc(1, sizeof(scheduler_t));
+    if (!sched)
+        return NULL;
+    sched->workers = (scheduler_worker_t *)calloc((size_t)threads, sizeof(scheduler_worker_t));
+    if (!sched->workers || !deque_init(&sched->global)) {
+        free(sched->workers);
+        free(sched);
+        return NULL;
+    }
+    MUTEX_INIT(&sched->lock);
+    COND_INIT(&sched->work_cond);
+    COND_INIT(&sched->done_cond);
+
+    // 先初始化全部队列再启动线程，线程启动后立即可能窃取任意队列
+    int ready = 0;
+    while (ready < threads) {
+        scheduler_worker_t *w = &sched->workers[ready];
+        w->sched = sched;
+        w->rng = 0x9e3779b9u * (unsigned int)(ready + 1);
+        if (!deque_init(&w->deque))
+            break;
+        ready++;
+    }
+    sched->thread_count = ready;
+
+    int started = 0;
+    for (int i = 0; i < ready; i++) {
+        scheduler_worker_t *w = &sched->workers[i];
+#ifdef _WIN32
+        w->thread = CreateThread(NULL, 0, worker_main, w, 0, NULL);
+        w->started = w->thread != NULL;
+#else
+        w->started = pthread_create(&w->thread, NULL, worker_main, w) == 0;
+#endif
+        started += w->started;
+    }
+
+    if (started == 0) {
+        scheduler_destroy(sched);
+        return NULL;
+    }
+    return sched;
+}
+
+/**
+ * @brief 停止工作线程并释放调度器。调用前应等待所有任务完成。
+ * @param sched 调度器。
+ */
+void scheduler_destroy(scheduler_t *sched)
+{
+    if (!sched)
+        return;
+
+    MUTEX_LOCK(&sched->lock);
+    sched->stop = 1;
+    COND_BROADCAST(&sched->work_cond);
+    MUTEX_UNLOCK(&sched->lock);
+
+    for (int i = 0; i < sched->thread_count; i++) {
+        scheduler_worker_t *w = &sched->workers[i];
+        if (w->started) {
+#ifdef _WIN32
+            WaitForSingleObject(w->thread, INFINITE);
+            CloseHandle(w->thread);
+#else
+            pthread_join(w->thread, NULL);
+#endif
+        }
+        deque_free(&w->deque);
+    }
+
+    deque_free(&sched->global);
+    COND_DESTROY(&sched->work_cond);
+    COND_DESTROY(&sched->done_cond);
+    MUTEX_DESTROY(&sched->lock);
+    free(sched->workers);
+    free(sched);
+}
+
+/**
+ * @brief 调度器的工作线程数。
+ * @param sched 调度器。
+ * @return 线程数。
+ */
+int scheduler_thread_count(const scheduler_t *sched)
+{
+    return sched->thread_count;
+}
+
+/**
+ * @brief 当前线程所属的调度器。
+ * @return 在工作线程中返回其调度器，否则返回NULL。
+ */
+scheduler_t *scheduler_current(void)
+{
+    return current_worker ? current_worker->sched : NULL;
+}
+
+/**
+ * @brief 初始化任务组。
+ * @param group 任务组。
+ */
+void task_group_init(task_group_t *group)
+{
+    group->pending = 0;
+}
+
+/**
+ * @brief 提交一个任务。在工作线程中提交时进入该线程的队列，否则进入全局队列。
+ * @param sched 调度器。
+ * @param group 任务所属的组，可以为NULL。
+ * @param fn 任务函数。
+ * @param arg 任务参数。
+ * @return 成功返回1；内存不足时在调用线程上直接执行任务并返回0。
+ */
+int scheduler_spawn(scheduler_t *sched, task_group_t *group, task_fn fn, void *arg)
+{
+    task_t task = {fn, arg, group};
+    if (group)
+        __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+
+    scheduler_worker_t *self = (current_worker && current_worker->sched == sched) ? current_worker : NULL;
+    if (!deque_push_back(self ? &self->deque : &sched->global, &task)) {
+        run_task(sched, &task);
+        return 0;
+    }
+
+    __atomic_add_fetch(&sched->queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sched->idle, __ATOMIC_SEQ_CST) > 0) {
+        MUTEX_LOCK(&sched->lock);
+        COND_SIGNAL(&sched->work_cond);
+        MUTEX_UNLOCK(&sched->lock);
+    }
+    return 1;
+}
+
+/**
+ * @brief 等待组内任务全部完成。
+ * @param sched 调度器。
+ * @param group 任务组。
+ */
+void scheduler_wait(scheduler_t *sched, task_group_t *group)
+{
+    scheduler_worker_t *self = (current_worker && current_worker->sched == sched) ? current_worker : NULL;
+
+    if (self) {
+        // 等待期间帮忙执行任务；组内剩余的任务都在其他线程上运行时让出处理器
+        while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) > 0) {
+            task_t task;
+            if (find_task(sched, self, 0, &task))
+                run_task(sched, &task);
+            else
+                THREAD_YIELD();
+        }
+        return;
+    }
+
+    MUTEX_LOCK(&sched->lock);
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) > 0)
+        COND_WAIT(&sched->done_cond, &sched->lock);
+    MUTEX_UNLOCK(&sched->lock);
+}
@@ -0,0 +1,433 @@
+#include "server.h"
+#include "log.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+
+/**
+ * @brief Windows 下没有 Unix 域套接字服务模式。
+ */
+int serve_run(const char *socket_path, int workers)
+{
+    (void)socket_path;
+    (void)workers;
+    LOG_ERROR("Server mode is not supported on Windows");
+    return 0;
+}
+
+#else
+
+#include "effects.h"
+#include "image.h"
+#include "parallel.h"
+#include "stb_image.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// 等待工作线程处理的连接队列容量
+#define SERVER_QUEUE_SIZE 64
+// 单行请求的最大长度
+#define SERVER_LINE_MAX 4096
+// 主线程等待连接时写出缓冲日志的间隔（毫秒）
+#define SERVER_LOG_FLUSH_MS 250
+
+// 已接受、等待处理的连接队列
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    int fds[SERVER_QUEUE_SIZE];
+    int head;
+    int count;
+    int closed; // 服务停止后不再接受新连接
+} client_queue_t;
+
+// 每个工作线程的常驻状态
+typedef struct
+{
+    pthread_t thread;
+    client_queue_t *queue;
+    int active_fd;         // 正在处理的连接，停止时用于唤醒阻塞的读
+    unsigned char *file;   // 输入文件缓冲区，只增不减，跨请求复用
+    size_t file_capacity;
+} server_worker_t;
+
+static volatile sig_atomic_t server_stop = 0;
+static int server_listen_fd = -1;
+
+static void on_stop_signal(int sig)
+{
+    (void)sig;
+    server_stop = 1;
+}
+
+/**
+ * @brief 请求停止服务：关闭监听套接字的读端，使等待连接的主线程返回。
+ */
+static void request_stop(void)
+{
+    server_stop = 1;
+    if (server_listen_fd >= 0)
+        shutdown(server_listen_fd, SHUT_RDWR);
+}
+
+static void queue_push(client_queue_t *q, int fd)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == SERVER_QUEUE_SIZE && !q->closed)
+        pthread_cond_wait(&q->not_full, &q->lock);
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        close(fd);
+        return;
+    }
+    q->fds[(q->head + q->count) % SERVER_QUEUE_SIZE] = fd;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * @brief 取出一个连接；队列关闭且为空时返回-1。
+ */
+static int queue_pop(client_queue_t *q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    int fd = -1;
+    if (q->count > 0) {
+        fd = q->fds[q->head];
+        q->head = (q->head + 1) % SERVER_QUEUE_SIZE;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return fd;
+}
+
+/**
+ * @brief 把整个文件读入工作线程的常驻缓冲区。
+ * @return 成功返回1，失败返回0。
+ */
+static int read_file(server_worker_t *worker, const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+
+    size_t used = 0;
+    for (;;) {
+        if (used == worker->file_capacity) {
+            size_t capacity = worker->file_capacity ? worker->file_capacity * 2 : (1u << 20);
+            unsigned char *grown = (unsigned char *)realloc(worker->file, capacity);
+            if (!grown) {
+                fclose(fp);
+                return 0;
+            }
+            worker->file = grown;
+            worker->file_capacity = capacity;
+        }
+        size_t n = fread(worker->file + used, 1, worker->file_capacity - used, fp);
+        used += n;
+        if (n == 0)
+            break;
+    }
+
+    int ok = !ferror(fp);
+    fclose(fp);
+    *size = used;
+    return ok;
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static double elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/**
+ * @brief 处理一行请求并生成一行应答（不含换行符）。
+ */
+static void handle_request(server_worker_t *worker, char *line, char *reply, size_t reply_size)
+{
+    char *save = NULL;
+    char *input = strtok_r(line, " \t\r", &save);
+    if (!input) {
+        reply[0] = '\0';
+        return;
+    }
+    if (strcmp(input, "PING") == 0) {
+        snprintf(reply, reply_size, "PONG");
+        return;
+    }
+    if (strcmp(input, "SHUTDOWN") == 0) {
+        snprintf(reply, reply_size, "BYE");
+        request_stop();
+        return;
+    }
+
+    char *output = strtok_r(NULL, " \t\r", &save);
+    char *spec = strtok_r(NULL, " \t\r", &save);
+    if (!output || !spec) {
+        snprintf(reply, reply_size, "ERR usage: <input> <output> <effects>");
+        return;
+    }
+
+    effect_op_t ops[EFFECT_MAX_OPS];
+    int op_count = effects_parse(spec, ops, EFFECT_MAX_OPS);
+    if (op_count == 0) {
+        snprintf(reply, reply_size, "ERR invalid effects '%s'", spec);
+        return;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t size;
+    if (!read_file(worker, input, &size)) {
+        snprintf(reply, reply_size, "ERR cannot read '%s'", input);
+        return;
+    }
+
+    effect_image_t img;
+    img.data = stbi_load_from_memory(worker->file, (int)size, &img.width, &img.height, &img.channels, 0);
+    if (!img.data) {
+        snprintf(reply, reply_size, "ERR cannot decode '%s'", input);
+        return;
+    }
+
+    if (!effects_apply_all(ops, op_count, &img)) {
+        snprintf(reply, reply_size, "ERR processing failed");
+    }
+    else if (!save_image(output, img.data, img.width, img.height, img.channels, 100)) {
+        snprintf(reply, reply_size, "ERR cannot write '%s'", output);
+    }
+    else {
+        snprintf(reply, reply_size, "OK %s %dx%d %.2fms", output, img.width, img.height, elapsed_ms(&start));
+    }
+    free(img.data);
+}
+
+/**
+ * @brief 处理一个连接上的全部请求，直到对端关闭或服务停止。
+ */
+static void handle_connection(server_worker_t *worker, int fd)
+{
+    char buf[SERVER_LINE_MAX];
+    char reply[SERVER_LINE_MAX + 64];
+    size_t used = 0;
+
+    while (!server_stop) {
+        ssize_t n = recv(fd, buf + used, sizeof(buf) - 1 - used, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        used += (size_t)n;
+
+        // 逐行处理已收到的完整请求
+        char *start = buf;
+        char *newline;
+        while ((newline = memchr(start, '\n', used - (start - buf))) != NULL) {
+            *newline = '\0';
+            handle_request(worker, start, reply, sizeof(reply) - 1);
+            if (reply[0]) {
+                size_t len = strlen(reply);
+                reply[len++] = '\n';
+                if (!write_all(fd, reply, len))
+                    return;
+            }
+            start = newline + 1;
+        }
+
+        used -= start - buf;
+        memmove(buf, start, used);
+        if (used == sizeof(buf) - 1) {
+            write_all(fd, "ERR request too long\n", 21);
+            return;
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    server_worker_t *worker = (server_worker_t *)arg;
+    int fd;
+    while ((fd = queue_pop(worker->queue)) >= 0) {
+        __atomic_store_n(&worker->active_fd, fd, __ATOMIC_SEQ_CST);
+        handle_connection(worker, fd);
+        __atomic_store_n(&worker->active_fd, -1, __ATOMIC_SEQ_CST);
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 以服务模式运行：监听 Unix 域套接字，由常驻的工作线程池处理请求。
+ * @param socket_path 套接字路径，已存在的同名文件会被删除。
+ * @param workers 工作线程数，<=0 时使用 parallel_thread_count()。
+ * @return 正常停止返回1，启动失败返回0。
+ */
+int serve_run(const char *socket_path, int workers)
+{
+    struct sockaddr_un addr;
+    if (!socket_path || strlen(socket_path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Invalid socket path");
+        return 0;
+    }
+    if (workers <= 0)
+        workers = parallel_thread_count();
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG_ERROR("Error creating socket: %s", strerror(errno));
+        return 0;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_QUEUE_SIZE) != 0) {
+        LOG_ERROR("Error listening on '%s': %s", socket_path, strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    // 不使用 SA_RESTART，使 pselect 在收到信号时返回
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    client_queue_t queue;
+    memset(&queue, 0, sizeof(queue));
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.not_empty, NULL);
+    pthread_cond_init(&queue.not_full, NULL);
+
+    server_worker_t *pool = (server_worker_t *)calloc(workers, sizeof(server_worker_t));
+    if (!pool) {
+        close(fd);
+        unlink(socket_path);
+        return 0;
+    }
+    // 工作线程（以及它们派生的线程）继承屏蔽 SIGINT/SIGTERM 的信号掩码，停止信号只会交给主线程。
+    // 主线程也一直屏蔽它们，只在 pselect 等待期间解除：检查 server_stop 之后、开始等待之前到达的信号
+    // 保持挂起，由 pselect 原子地解除屏蔽后立即递送，不会等到下一个连接
+    sigset_t stop_signals, old_mask, wait_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+    wait_mask = old_mask;
+    sigdelset(&wait_mask, SIGINT);
+    sigdelset(&wait_mask, SIGTERM);
+    int started = 0;
+    for (; started < workers; started++) {
+        pool[started].queue = &queue;
+        pool[started].active_fd = -1;
+        if (pthread_create(&pool[started].thread, NULL, worker_main, &pool[started]) != 0)
+            break;
+    }
+
+    // 监听套接字设为非阻塞：pselect 报告可读后连接可能已被对端放弃，accept 不能因此阻塞
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    server_stop = 0;
+    server_listen_fd = fd;
+    LOG_INFO("Serving on '%s' with %d workers", socket_path, started);
+    log_flush();
+
+    while (!server_stop && started > 0) {
+        // 定时醒来写出工作线程缓冲的日志，没有新连接时日志也不会一直留在缓冲区中
+        log_flush_pending();
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        struct timespec timeout = {0, SERVER_LOG_FLUSH_MS * 1000000L};
+        int ready = pselect(fd + 1, &readable, NULL, NULL, &timeout, &wait_mask);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("Error waiting for connections: %s", strerror(errno));
+            break;
+        }
+        if (ready == 0)
+            continue;
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || server_stop)
+                continue;
+            LOG_ERROR("Error accepting connection: %s", strerror(errno));
+            break;
+        }
+        // BSD 和 macOS 上接受的连接继承监听套接字的 O_NONBLOCK，工作线程按阻塞方式读写
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) & ~O_NONBLOCK);
+        queue_push(&queue, client);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    // 停止：关闭队列，唤醒仍在等待请求的连接，等待工作线程退出
+    pthread_mutex_lock(&queue.lock);
+    queue.closed = 1;
+    pthread_cond_broadcast(&queue.not_empty);
+    pthread_cond_broadcast(&queue.not_full);
+    pthread_mutex_unlock(&queue.lock);
+    for (int i = 0; i < started; i++) {
+        int active = __atomic_load_n(&pool[i].active_fd, __ATOMIC_SEQ_CST);
+        if (active >= 0)
+            shutdown(active, SHUT_RD);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i].thread, NULL);
+        free(pool[i].file);
+    }
+    while (queue.count > 0) {
+        close(queue.fds[queue.head]);
+        queue.head = (queue.head + 1) % SERVER_QUEUE_SIZE;
+        queue.count--;
+    }
+
+    server_listen_fd = -1;
+    close(fd);
+    unlink(socket_path);
+    free(pool);
+    pthread_mutex_destroy(&queue.lock);
+    pthread_cond_destroy(&queue.not_empty);
+    pthread_cond_destroy(&queue.not_full);
+
+    LOG_INFO("Server stopped");
+    return 1;
+}
+
+#endif
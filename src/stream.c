@@ -0,0 +1,115 @@
+#include "stream.h"
+#include "log.h"
+#include "effects.h"
+#include "hdr.h"
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define dup _dup
+#define dup2 _dup2
+#define fileno _fileno
+#define fdopen _fdopen
+#else
+#include <unistd.h>
+#endif
+
+/**
+ * @brief 链式处理模式：读取一幅图像，按执行计划在同一个缓冲区上依次应用效果链，最后只编码一次。
+ * @param ops_spec 效果列表，格式见 effects_parse，例如 "grayscale,blur:3,edge:40"。
+ * @param input_path 输入图像路径，NULL 表示标准输入。
+ * @param output_path 输出图像路径，NULL 表示标准输出。
+ * @param format 写标准输出时的格式："png"、"jpg"、"bmp" 或 "tga"；写文件时由扩展名决定。
+ * @param quality JPEG质量参数 (1-100)。
+ * @return 成功返回1，失败返回0。
+ */
+int stream_process(const char *ops_spec,
+                   const char *input_path,
+                   const char *output_path,
+                   const char *format,
+                   int quality)
+{
+    effect_op_t ops[EFFECT_MAX_OPS];
+    int op_count = effects_parse(ops_spec, ops, EFFECT_MAX_OPS);
+    if (op_count == 0) {
+        return 0;
+    }
+
+    // 标准输入先整体读入内存，与文件一样按内容判断位深
+    unsigned char *input = NULL;
+    size_t input_size = 0;
+    if (!input_path) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        input = read_stream(stdin, &input_size);
+        if (!input)
+            return 0;
+    }
+    // 16位和 HDR 输入走高位深流水线，保留完整精度；8位输入仍走下面的原地执行计划
+    int high_bit_depth =
+        input ? hdr_is_high_bit_depth_from_memory(input, input_size) : hdr_is_high_bit_depth(input_path);
+
+    FILE *out = NULL;
+    if (!output_path) {
+#ifdef _WIN32
+        // Windows 下标准流默认是文本模式，会改写换行字节
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        // 图像数据使用原标准输出的副本，标准输出本身改为指向标准错误，
+        // 这样处理过程中写标准输出的日志不会破坏输出的图像
+        log_flush();
+        fflush(stdout);
+        int out_fd = dup(fileno(stdout));
+        out = out_fd >= 0 ? fdopen(out_fd, "wb") : NULL;
+        if (!out || dup2(fileno(stderr), fileno(stdout)) < 0) {
+            LOG_ERROR("Failed to redirect standard output");
+            if (out)
+                fclose(out);
+            free(input);
+            return 0;
+        }
+    }
+
+    int ok;
+    if (high_bit_depth) {
+        hdr_image_t hdr = {NULL, 0, 0, 0, 0};
+        ok = input ? hdr_image_load_from_memory(input, input_size, &hdr) : hdr_image_load(input_path, &hdr);
+        ok = ok && hdr_apply_effects(&hdr, ops, op_count);
+        if (ok) {
+            if (out)
+                ok = hdr_image_write_to_stream(out, format, &hdr, quality);
+            else
+                ok = hdr_image_save(output_path, &hdr, quality);
+        }
+        hdr_image_free(&hdr);
+    }
+    else {
+        effect_image_t img;
+        if (input)
+            img.data = load_image_from_memory(input, input_size, &img.width, &img.height, &img.channels);
+        else
+            img.data = load_image(input_path, &img.width, &img.height, &img.channels);
+
+        effect_plan_t plan;
+        ok = img.data && effect_plan_build(&plan, ops, op_count, img.width, img.height, img.channels);
+        if (ok) {
+            effect_plan_print(&plan);
+            ok = effect_plan_execute(&plan, &img);
+        }
+        if (ok) {
+            if (out)
+                ok = write_image_to_stream(out, format, img.data, img.width, img.height, img.channels, quality);
+            else
+                ok = save_image(output_path, img.data, img.width, img.height, img.channels, quality);
+        }
+        free_image(img.data);
+    }
+
+    free(input);
+    if (out && fclose(out) != 0)
+        ok = 0;
+    return ok;
+}
@@ -0,0 +1,2047 @@
+/*
+ * 回归与性能测试：
+ * - 在 lenna.png 上运行每个效果，与 tests/golden 中的标准输出按各自的容差比较，并检查耗时预算；
+ * - 在合成的边界情况图像（1x1、奇数宽度、1/2/4 通道、超大半径）上与参考实现或不变量比较。
+ *
+ * 用法: run_tests [--update-golden] <golden目录> <lenna.png>
+ * 环境变量 IMAGEPROC_TEST_TIME_SCALE 按倍数放宽耗时预算（慢速机器或调试构建），设为0时跳过耗时检查。
+ */
+#include "ascii_art.h"
+#include "batch.h"
+#include "bilateral.h"
+#include "checksum.h"
+#include "convolve.h"
+#include "edge.h"
+#include "effects.h"
+#include "filters.h"
+#include "hdr.h"
+#include "image.h"
+#include "journal.h"
+#include "log.h"
+#include "median.h"
+#include "morphology.h"
+#include "parallel.h"
+#include "phash.h"
+#include "pixel_cache.h"
+#include "planar.h"
+#include "pyramid.h"
+#include "resize.h"
+#include "rotate.h"
+#include "scheduler.h"
+#include "server.h"
+#include "stream.h"
+#include "stb_image.h"
+#include "stb_image_write.h"
+#include <dirent.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
+// 计时的重复次数，取最短的一次，减少调度抖动的影响
+#define TIMING_RUNS 5
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                               \
+    do {                                                                                                               \
+        checks++;                                                                                                      \
+        if (!(cond)) {                                                                                                 \
+            failures++;                                                                                                \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);                                                       \
+            fprintf(stderr, __VA_ARGS__);                                                                              \
+            fputc('\n', stderr);                                                                                       \
+        }                                                                                                              \
+    } while (0)
+
+// lenna.png 上的标准输出用例
+typedef struct
+{
+    const char *spec;         // 效果链，格式见 effects_parse
+    int max_diff;             // 允许的单个样本最大差值
+    double max_over_fraction; // 超过 max_diff 的样本所占比例上限
+    double budget_ms;         // 单次运行的耗时预算（毫秒）
+} golden_case_t;
+
+static const golden_case_t golden_cases[] = {
+    {"grayscale", 0, 0.0, 20.0},
+    {"invert", 0, 0.0, 20.0},
+    {"rotate", 0, 0.0, 20.0},
+    {"blur:5", 1, 0.0, 150.0},
+    {"blur:25", 1, 0.0, 400.0},
+    {"edge", 0, 0.005, 150.0},
+    {"edge:40", 0, 0.005, 150.0},
+    {"resize:50", 1, 0.0, 150.0},
+    {"autocontrast", 1, 0.0, 50.0},
+    {"sharpen", 0, 0.0, 150.0},
+    {"emboss", 0, 0.0, 150.0},
+    {"edge,close:3", 0, 0.005, 150.0},
+    {"grayscale,open:5x3", 0, 0.0, 50.0},
+    {"median:1", 0, 0.0, 50.0},
+    {"median:2", 0, 0.0, 80.0},
+    {"median:6", 0, 0.0, 300.0},
+    {"edge:otsu:2", 0, 0.005, 150.0},
+    {"bilateral:8:20", 1, 0.0, 100.0},
+    {"bilateral:32:40", 1, 0.0, 100.0},
+};
+
+#define GOLDEN_CASE_COUNT ((int)(sizeof(golden_cases) / sizeof(golden_cases[0])))
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * @brief 把效果链转换为标准输出文件名，例如 "blur:5" -> "<dir>/blur_5.png"。
+ */
+static void golden_path(const char *dir, const char *spec, char *path, size_t size)
+{
+    int n = snprintf(path, size, "%s/", dir);
+    for (const char *p = spec; *p && (size_t)n + 5 < size; p++)
+        path[n++] = (*p == ':' || *p == ',') ? '_' : *p;
+    snprintf(path + n, size - n, ".png");
+}
+
+static effect_image_t copy_image(const unsigned char *data, int width, int height, int channels)
+{
+    effect_image_t img = {NULL, width, height, channels};
+    size_t size = (size_t)width * height * channels;
+    img.data = (unsigned char *)malloc(size);
+    if (img.data)
+        memcpy(img.data, data, size);
+    return img;
+}
+
+/**
+ * @brief 统计两幅图像中差值超过 max_diff 的样本数，并返回最大差值。
+ */
+static size_t count_over(const unsigned char *a, const unsigned char *b, size_t n, int max_diff, int *largest)
+{
+    size_t over = 0;
+    *largest = 0;
+    for (size_t i = 0; i < n; i++) {
+        int d = abs((int)a[i] - (int)b[i]);
+        if (d > *largest)
+            *largest = d;
+        if (d > max_diff)
+            over++;
+    }
+    return over;
+}
+
+/**
+ * @brief 在 lenna.png 上运行每个用例，与标准输出比较并检查耗时预算（或重新生成标准输出）。
+ */
+static void test_golden(const char *golden_dir, const char *lenna_path, int update)
+{
+    int w, h, c;
+    unsigned char *lenna = load_image(lenna_path, &w, &h, &c);
+    CHECK(lenna != NULL, "cannot load '%s'", lenna_path);
+    if (!lenna)
+        return;
+
+    const char *scale_env = getenv("IMAGEPROC_TEST_TIME_SCALE");
+    double time_scale = scale_env ? atof(scale_env) : 1.0;
+
+    for (int i = 0; i < GOLDEN_CASE_COUNT; i++) {
+        const golden_case_t *gc = &golden_cases[i];
+        effect_op_t ops[EFFECT_MAX_OPS];
+        int count = effects_parse(gc->spec, ops, EFFECT_MAX_OPS);
+        CHECK(count > 0, "cannot parse '%s'", gc->spec);
+
+        // 计时：每次都从原图的副本开始，取最短的一次
+        double best = 0.0;
+        effect_image_t img = {NULL, 0, 0, 0};
+        for (int run = 0; run < TIMING_RUNS; run++) {
+            free(img.data);
+            img = copy_image(lenna, w, h, c);
+            double start = now_ms();
+            int ok = effects_apply_all(ops, count, &img);
+            double elapsed = now_ms() - start;
+            CHECK(ok, "%s: effect failed", gc->spec);
+            if (run == 0 || elapsed < best)
+                best = elapsed;
+        }
+
+        char path[512];
+        golden_path(golden_dir, gc->spec, path, sizeof(path));
+        if (update) {
+            CHECK(save_image(path, img.data, img.width, img.height, img.channels, 100), "cannot write '%s'", path);
+            free(img.data);
+            continue;
+        }
+
+        int gw, gh, gch;
+        unsigned char *golden = load_image(path, &gw, &gh, &gch);
+        CHECK(golden != NULL, "%s: missing golden output '%s'", gc->spec, path);
+        if (golden) {
+            CHECK(gw == img.width && gh == img.height && gch == img.channels,
+                  "%s: size %dx%dx%d, golden %dx%dx%d",
+                  gc->spec,
+                  img.width,
+                  img.height,
+                  img.channels,
+                  gw,
+                  gh,
+                  gch);
+            if (gw == img.width && gh == img.height && gch == img.channels) {
+                size_t n = (size_t)gw * gh * gch;
+                int largest;
+                size_t over = count_over(img.data, golden, n, gc->max_diff, &largest);
+                CHECK(over <= gc->max_over_fraction * n,
+                      "%s: %zu of %zu samples differ by more than %d (largest %d)",
+                      gc->spec,
+                      over,
+                      n,
+                      gc->max_diff,
+                      largest);
+            }
+            free_image(golden);
+        }
+
+        if (time_scale > 0.0) {
+            CHECK(best <= gc->budget_ms * time_scale,
+                  "%s: %.2f ms exceeds budget %.2f ms",
+                  gc->spec,
+                  best,
+                  gc->budget_ms * time_scale);
+        }
+        printf("  %-14s %8.2f ms (budget %.0f ms)\n", gc->spec, best, gc->budget_ms * time_scale);
+        free(img.data);
+    }
+    free_image(lenna);
+}
+
+// 合成图像使用固定种子的线性同余发生器，每次运行结果相同
+static unsigned int rng_state = 12345u;
+
+static unsigned char rng_byte(void)
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (unsigned char)(rng_state >> 16);
+}
+
+static unsigned char *make_image(int width, int height, int channels, int constant)
+{
+    size_t n = (size_t)width * height * channels;
+    unsigned char *data = (unsigned char *)malloc(n);
+    for (size_t i = 0; data && i < n; i++)
+        data[i] = constant >= 0 ? (unsigned char)constant : rng_byte();
+    return data;
+}
+
+/**
+ * @brief 灰度化、反色和翻转与逐像素的参考实现比较（必须完全一致）。
+ */
+static void test_pointwise(int w, int h, int c)
+{
+    size_t n = (size_t)w * h * c;
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *img = (unsigned char *)malloc(n);
+
+    memcpy(img, src, n);
+    grayscale(img, w, h, c);
+    int bad = 0;
+    for (size_t i = 0; i < (size_t)w * h; i++) {
+        const unsigned char *p = src + i * c;
+        unsigned char gray = c >= 3 ? (unsigned char)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]) : 0;
+        for (int ch = 0; ch < c; ch++) {
+            unsigned char expected = (c >= 3 && ch < 3) ? gray : p[ch];
+            bad += img[i * c + ch] != expected;
+        }
+    }
+    CHECK(bad == 0, "grayscale %dx%dx%d: %d samples differ from reference", w, h, c, bad);
+
+    memcpy(img, src, n);
+    invert(img, w, h, c);
+    bad = 0;
+    for (size_t i = 0; i < n; i++)
+        bad += img[i] != ((int)(i % c) < 3 ? 255 - src[i] : src[i]);
+    CHECK(bad == 0, "invert %dx%dx%d: %d samples differ from reference", w, h, c, bad);
+
+    memcpy(img, src, n);
+    rotate_image(img, w, h, c);
+    bad = 0;
+    for (int y = 0; y < h; y++)
+        bad += memcmp(img + (size_t)y * w * c, src + (size_t)(h - 1 - y) * w * c, (size_t)w * c) != 0;
+    CHECK(bad == 0, "rotate %dx%dx%d: %d rows differ from reference", w, h, c, bad);
+
+    free(src);
+    free(img);
+}
+
+/**
+ * @brief 模糊：常数图像保持不变，输出不超出输入的取值范围，区域结果与整幅结果的对应部分一致。
+ */
+static void test_blur(int w, int h, int c, int radius)
+{
+    size_t n = (size_t)w * h * c;
+
+    unsigned char *flat = make_image(w, h, c, 173);
+    blur(flat, w, h, c, radius);
+    int bad = 0;
+    for (size_t i = 0; i < n; i++)
+        bad += abs(flat[i] - 173) > 1;
+    CHECK(bad == 0, "blur r=%d %dx%dx%d: constant image changed in %d samples", radius, w, h, c, bad);
+    free(flat);
+
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *full = (unsigned char *)malloc(n);
+    memcpy(full, src, n);
+    blur(full, w, h, c, radius);
+
+    int lo = 255, hi = 0;
+    for (size_t i = 0; i < n; i++) {
+        lo = src[i] < lo ? src[i] : lo;
+        hi = src[i] > hi ? src[i] : hi;
+    }
+    bad = 0;
+    for (size_t i = 0; i < n; i++)
+        bad += full[i] < lo - 1 || full[i] > hi + 1;
+    CHECK(bad == 0, "blur r=%d %dx%dx%d: %d samples outside input range", radius, w, h, c, bad);
+
+    // 区域模糊写到独立缓冲区，应与整幅模糊的对应部分完全一致
+    image_rect_t roi = {w / 3, h / 3, (w + 1) / 2, (h + 1) / 2};
+    unsigned char *part = (unsigned char *)malloc((size_t)roi.w * roi.h * c);
+    int ok = blur_roi(src, w, h, c, w * c, roi, radius, BORDER_CLAMP, part, roi.w * c);
+    CHECK(ok, "blur_roi r=%d %dx%dx%d failed", radius, w, h, c);
+    bad = 0;
+    for (int y = 0; ok && y < roi.h; y++) {
+        bad += memcmp(part + (size_t)y * roi.w * c,
+                      full + ((size_t)(roi.y + y) * w + roi.x) * c,
+                      (size_t)roi.w * c) != 0;
+    }
+    CHECK(bad == 0, "blur_roi r=%d %dx%dx%d: %d rows differ from full blur", radius, w, h, c, bad);
+
+    free(part);
+    free(src);
+    free(full);
+}
+
+/**
+ * @brief 通道数超过 IMAGE_MAX_CHANNELS 的模糊：每个通道与单独模糊该通道的结果完全一致。
+ */
+static void test_blur_many_channels(int w, int h, int c, int radius)
+{
+    size_t n = (size_t)w * h * c;
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *ref = (unsigned char *)malloc(n);
+    unsigned char *plane = (unsigned char *)malloc((size_t)w * h);
+    memcpy(ref, src, n);
+    blur(src, w, h, c, radius);
+    int bad = 0;
+    for (int cc = 0; cc < c; cc++) {
+        for (size_t i = 0; i < (size_t)w * h; i++)
+            plane[i] = ref[i * c + cc];
+        blur(plane, w, h, 1, radius);
+        for (size_t i = 0; i < (size_t)w * h; i++)
+            bad += src[i * c + cc] != plane[i];
+    }
+    CHECK(bad == 0, "blur r=%d %dx%dx%d: %d samples differ from per-channel blur", radius, w, h, c, bad);
+    free(ref);
+    free(plane);
+    free(src);
+}
+
+/**
+ * @brief 边缘检测：输出只有0和255且各通道相同，常数图像没有边缘，区域结果与整幅结果的对应部分一致。
+ */
+static void test_edge(int w, int h, int c)
+{
+    size_t n = (size_t)w * h * c;
+
+    unsigned char *flat = make_image(w, h, c, 90);
+    unsigned char *edges = sobel_edge_detect(flat, w, h, c, 40, 0);
+    CHECK(edges != NULL, "edge %dx%dx%d failed", w, h, c);
+    int bad = 0;
+    for (size_t i = 0; edges && i < n; i++)
+        bad += edges[i] != 0;
+    CHECK(bad == 0, "edge %dx%dx%d: constant image has %d edge samples", w, h, c, bad);
+    free(edges);
+    free(flat);
+
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *full = sobel_edge_detect(src, w, h, c, 40, 0);
+    CHECK(full != NULL, "edge %dx%dx%d failed", w, h, c);
+    bad = 0;
+    for (size_t i = 0; full && i < n; i++)
+        bad += (full[i] != 0 && full[i] != 255) || full[i] != full[i - i % c];
+    CHECK(bad == 0, "edge %dx%dx%d: %d samples are not binary or differ across channels", w, h, c, bad);
+
+    // 共用梯度场的检测与直接检测相同，SSE2 计算的幅值与标量公式一致
+    sobel_gradient_t gradient;
+    int ok = sobel_gradient_compute(src, w, h, c, 0, &gradient);
+    CHECK(ok, "gradient %dx%dx%d failed", w, h, c);
+    bad = 0;
+    for (size_t i = 0; ok && i < (size_t)w * h; i++) {
+        int mag = (int)sqrt(gradient.gx[i] * gradient.gx[i] + gradient.gy[i] * gradient.gy[i]);
+        bad += gradient.magnitude[i] != (mag > 255 ? 255 : mag);
+    }
+    CHECK(bad == 0, "gradient %dx%dx%d: %d magnitudes differ from the scalar formula", w, h, c, bad);
+    unsigned char *shared = ok ? sobel_edge_detect_gradient(&gradient, 40, c) : NULL;
+    CHECK(shared && full && memcmp(shared, full, n) == 0, "edge from gradient %dx%dx%d differs", w, h, c);
+    free(shared);
+    sobel_gradient_free(&gradient);
+
+    image_rect_t roi = {w / 4, h / 4, (w + 1) / 2, (h + 1) / 2};
+    unsigned char *part = sobel_edge_detect_roi(src, w, h, c, w * c, roi, 40, 0, BORDER_REFLECT);
+    CHECK(part != NULL, "edge roi %dx%dx%d failed", w, h, c);
+    bad = 0;
+    for (int y = 0; full && part && y < roi.h; y++) {
+        bad += memcmp(part + (size_t)y * roi.w * c,
+                      full + ((size_t)(roi.y + y) * w + roi.x) * c,
+                      (size_t)roi.w * c) != 0;
+    }
+    CHECK(bad == 0, "edge roi %dx%dx%d: %d rows differ from full detection", w, h, c, bad);
+
+    free(part);
+    free(full);
+    free(src);
+}
+
+/**
+ * @brief 分块边缘检测：按行带分别计算梯度幅值和直方图，合并直方图后取全局 Otsu 阈值再逐带滞后处理，
+ *        结果与整幅检测相同（批处理对大图像的分块方式）。
+ */
+static void test_edge_tiled(int w, int h, int c, int band_rows)
+{
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *full = sobel_edge_detect(src, w, h, c, EDGE_THRESHOLD_OTSU, 0);
+    // 四周留一圈0，滞后处理读取区域外一圈的幅值
+    int mag_stride = w + 2;
+    unsigned char *magnitude = (unsigned char *)calloc((size_t)mag_stride * (h + 2), 1);
+    unsigned char *tiled = (unsigned char *)malloc((size_t)w * h * c);
+    unsigned char *mag_origin = magnitude + mag_stride + 1;
+
+    unsigned int hist[256] = {0};
+    for (int y = 0; y < h; y += band_rows) {
+        image_rect_t band = {0, y, w, (h - y < band_rows) ? h - y : band_rows};
+        unsigned char *mag = mag_origin + (size_t)y * mag_stride;
+        sobel_magnitude_into(src, w, h, c, w * c, band, 0, BORDER_REFLECT, mag, mag_stride);
+        for (int by = 0; by < band.h; by++) {
+            for (int x = 0; x < w; x++)
+                hist[mag[(size_t)by * mag_stride + x]]++;
+        }
+    }
+    int threshold = edge_auto_threshold(hist, EDGE_THRESHOLD_OTSU);
+    for (int y = 0; y < h; y += band_rows) {
+        int rows = (h - y < band_rows) ? h - y : band_rows;
+        edge_hysteresis(
+            mag_origin + (size_t)y * mag_stride, mag_stride, w, rows, threshold, c, tiled + (size_t)y * w * c, w * c);
+    }
+
+    CHECK(full && memcmp(full, tiled, (size_t)w * h * c) == 0,
+          "edge tiled %dx%dx%d (%d-row bands) differs from full detection",
+          w,
+          h,
+          c,
+          band_rows);
+
+    free(tiled);
+    free(magnitude);
+    free(full);
+    free(src);
+}
+
+/**
+ * @brief 逐像素的形态学参考实现（一次膨胀或腐蚀，图像外的位置不参与运算）。
+ */
+static void morph_reference(const unsigned char *src,
+                            unsigned char *dst,
+                            int w,
+                            int h,
+                            int c,
+                            int is_max,
+                            int kw,
+                            int kh)
+{
+    for (int y = 0; y < h; y++) {
+        int y0 = y - kh / 2 < 0 ? 0 : y - kh / 2;
+        int y1 = y - kh / 2 + kh > h ? h : y - kh / 2 + kh;
+        for (int x = 0; x < w; x++) {
+            int x0 = x - kw / 2 < 0 ? 0 : x - kw / 2;
+            int x1 = x - kw / 2 + kw > w ? w : x - kw / 2 + kw;
+            for (int ch = 0; ch < c; ch++) {
+                int v = is_max ? 0 : 255;
+                for (int yy = y0; yy < y1; yy++) {
+                    for (int xx = x0; xx < x1; xx++) {
+                        int s = src[((size_t)yy * w + xx) * c + ch];
+                        v = is_max ? (s > v ? s : v) : (s < v ? s : v);
+                    }
+                }
+                dst[((size_t)y * w + x) * c + ch] = (unsigned char)v;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 形态学运算：灰度图和二值图（按位打包的路径）都与逐像素参考实现完全相同，包括远大于图像的结构元素。
+ */
+static void test_morphology(int w, int h, int c)
+{
+    static const int kernels[][2] = {{1, 1}, {3, 3}, {4, 2}, {1, 5}, {7, 1}, {150, 70}};
+    size_t n = (size_t)w * h * c;
+
+    unsigned char *gray = make_image(w, h, c, -1);
+    unsigned char *binary = make_image(w, h, c, -1);
+    for (size_t i = 0; i < n; i += c)
+        memset(binary + i, binary[i] > 160 ? 255 : 0, (size_t)c);
+    CHECK(morphology_is_binary(binary, w, h, c), "morphology %dx%dx%d: binary image not detected", w, h, c);
+
+    unsigned char *expected = (unsigned char *)malloc(n);
+    unsigned char *temp = (unsigned char *)malloc(n);
+    unsigned char *actual = (unsigned char *)malloc(n);
+    for (int b = 0; b < 2; b++) {
+        const unsigned char *src = b ? binary : gray;
+        for (int k = 0; k < (int)(sizeof(kernels) / sizeof(kernels[0])); k++) {
+            int kw = kernels[k][0], kh = kernels[k][1];
+            for (int op = MORPH_DILATE; op <= MORPH_CLOSE; op++) {
+                // 开运算先腐蚀后膨胀，闭运算先膨胀后腐蚀
+                int first_max = (op == MORPH_DILATE || op == MORPH_CLOSE);
+                morph_reference(src, expected, w, h, c, first_max, kw, kh);
+                if (op == MORPH_OPEN || op == MORPH_CLOSE) {
+                    memcpy(temp, expected, n);
+                    morph_reference(temp, expected, w, h, c, !first_max, kw, kh);
+                }
+
+                memcpy(actual, src, n);
+                int ok = morphology(actual, w, h, c, (morph_op_t)op, kw, kh);
+                CHECK(ok && memcmp(actual, expected, n) == 0,
+                      "morphology %dx%dx%d %s op %d kernel %dx%d differs from reference",
+                      w,
+                      h,
+                      c,
+                      b ? "binary" : "gray",
+                      op,
+                      kw,
+                      kh);
+            }
+        }
+    }
+
+    free(actual);
+    free(temp);
+    free(expected);
+    free(binary);
+    free(gray);
+}
+
+/**
+ * @brief 中值滤波：排序网络（半径1、2）和直方图方法（更大半径）都与逐像素排序的参考实现相同；
+ *        带中值预滤波的边缘检测在区域上的结果与整幅结果的对应部分一致。
+ */
+static void test_median(int w, int h, int c)
+{
+    static const int radii[] = {1, 2, 3, 9};
+    size_t n = (size_t)w * h * c;
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *expected = (unsigned char *)malloc(n);
+    unsigned char *actual = (unsigned char *)malloc(n);
+
+    for (int k = 0; k < (int)(sizeof(radii) / sizeof(radii[0])); k++) {
+        int r = radii[k];
+        int side = 2 * r + 1;
+        int counts[256];
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                for (int ch = 0; ch < c; ch++) {
+                    memset(counts, 0, sizeof(counts));
+                    for (int dy = -r; dy <= r; dy++) {
+                        int yy = y + dy < 0 ? 0 : (y + dy >= h ? h - 1 : y + dy);
+                        for (int dx = -r; dx <= r; dx++) {
+                            int xx = x + dx < 0 ? 0 : (x + dx >= w ? w - 1 : x + dx);
+                            counts[src[((size_t)yy * w + xx) * c + ch]]++;
+                        }
+                    }
+                    int v = 0;
+                    for (int seen = counts[0]; seen <= side * side / 2; seen += counts[++v])
+                        ;
+                    expected[((size_t)y * w + x) * c + ch] = (unsigned char)v;
+                }
+            }
+        }
+        memcpy(actual, src, n);
+        int ok = median_filter(actual, w, h, c, r);
+        CHECK(ok && memcmp(actual, expected, n) == 0, "median %dx%dx%d radius %d differs from reference", w, h, c, r);
+    }
+
+    unsigned char *full = sobel_edge_detect(src, w, h, c, 40, 2);
+    image_rect_t roi = {w / 4, h / 4, (w + 1) / 2, (h + 1) / 2};
+    unsigned char *part = sobel_edge_detect_roi(src, w, h, c, w * c, roi, 40, 2, BORDER_REFLECT);
+    int bad = !full || !part;
+    for (int y = 0; !bad && y < roi.h; y++) {
+        bad += memcmp(part + (size_t)y * roi.w * c,
+                      full + ((size_t)(roi.y + y) * w + roi.x) * c,
+                      (size_t)roi.w * c) != 0;
+    }
+    CHECK(bad == 0, "edge with median pre-filter %dx%dx%d: roi differs from full detection", w, h, c);
+
+    free(part);
+    free(full);
+    free(actual);
+    free(expected);
+    free(src);
+}
+
+/**
+ * @brief 双边滤波：常数图像和阶跃边缘（亮度差远大于值域标准差）保持不变，Alpha 通道不变，
+ *        颜色不超出输入的取值范围。
+ */
+static void test_bilateral(int w, int h, int c)
+{
+    size_t n = (size_t)w * h * c;
+    int colors = (c == 2 || c == 4) ? c - 1 : c;
+
+    unsigned char *flat = make_image(w, h, c, 173);
+    int ok = bilateral_filter(flat, w, h, c, 3, 10);
+    int bad = 0;
+    for (size_t i = 0; i < n; i++)
+        bad += flat[i] != 173;
+    CHECK(ok && bad == 0, "bilateral %dx%dx%d: constant image changed in %d samples", w, h, c, bad);
+    free(flat);
+
+    unsigned char *step = (unsigned char *)malloc(n);
+    for (size_t i = 0; i < n; i++)
+        step[i] = ((int)(i / c % w) < w / 2) ? 30 : 220;
+    ok = bilateral_filter(step, w, h, c, 3, 10);
+    bad = 0;
+    for (size_t i = 0; i < n; i++)
+        bad += step[i] != (((int)(i / c % w) < w / 2) ? 30 : 220);
+    CHECK(ok && bad == 0, "bilateral %dx%dx%d: step edge changed in %d samples", w, h, c, bad);
+    free(step);
+
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *img = (unsigned char *)malloc(n);
+    memcpy(img, src, n);
+    ok = bilateral_filter(img, w, h, c, 2, 40);
+    bad = 0;
+    for (int ch = 0; ch < c; ch++) {
+        int lo = 255, hi = 0;
+        for (size_t i = ch; i < n; i += c) {
+            lo = src[i] < lo ? src[i] : lo;
+            hi = src[i] > hi ? src[i] : hi;
+        }
+        for (size_t i = ch; i < n; i += c)
+            bad += (ch < colors) ? (img[i] < lo || img[i] > hi) : img[i] != src[i];
+    }
+    CHECK(ok && bad == 0, "bilateral %dx%dx%d: %d samples out of range or alpha changed", w, h, c, bad);
+    free(img);
+    free(src);
+}
+
+/**
+ * @brief 双边网格与直接计算的双边滤波（空间和值域都是高斯权重）比较：噪声被平滑，
+ *        结果与直接计算的平均差值很小，跨越边缘的像素不被混合。
+ */
+static void test_bilateral_reference(void)
+{
+    const int w = 64, h = 48, c = 3, sigma_s = 4, sigma_r = 16;
+    size_t n = (size_t)w * h * c;
+    unsigned char *src = (unsigned char *)malloc(n);
+    for (size_t i = 0; i < n; i++)
+        src[i] = (unsigned char)((((int)(i / c % w) < w / 2) ? 60 : 190) + rng_byte() % 21 - 10);
+
+    unsigned char *img = (unsigned char *)malloc(n);
+    memcpy(img, src, n);
+    int ok = bilateral_filter(img, w, h, c, sigma_s, sigma_r);
+
+    double diff = 0.0, noise_in = 0.0, noise_out = 0.0;
+    int crossed = 0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const unsigned char *p = src + ((size_t)y * w + x) * c;
+            float lp = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+            double sum[3] = {0.0, 0.0, 0.0}, weight = 0.0;
+            for (int yy = y - 3 * sigma_s; yy <= y + 3 * sigma_s; yy++) {
+                for (int xx = x - 3 * sigma_s; xx <= x + 3 * sigma_s; xx++) {
+                    if (yy < 0 || yy >= h || xx < 0 || xx >= w)
+                        continue;
+                    const unsigned char *q = src + ((size_t)yy * w + xx) * c;
+                    float lq = 0.299f * q[0] + 0.587f * q[1] + 0.114f * q[2];
+                    double d2 = (double)(xx - x) * (xx - x) + (double)(yy - y) * (yy - y);
+                    double wt = exp(-d2 / (2.0 * sigma_s * sigma_s) -
+                                    (lq - lp) * (lq - lp) / (2.0 * sigma_r * sigma_r));
+                    for (int ch = 0; ch < 3; ch++)
+                        sum[ch] += wt * q[ch];
+                    weight += wt;
+                }
+            }
+            int center = (x < w / 2) ? 60 : 190;
+            for (int ch = 0; ch < 3; ch++) {
+                int out = img[((size_t)y * w + x) * c + ch];
+                diff += fabs(out - sum[ch] / weight);
+                noise_in += abs(p[ch] - center);
+                noise_out += abs(out - center);
+                crossed += abs(out - center) > 20;
+            }
+        }
+    }
+    diff /= n;
+    CHECK(ok && diff < 1.0, "bilateral grid: mean difference from direct bilateral filter %.2f", diff);
+    CHECK(noise_out < noise_in / 2, "bilateral grid: noise %.0f -> %.0f not reduced", noise_in, noise_out);
+    CHECK(crossed == 0, "bilateral grid: %d samples mixed across the edge", crossed);
+    printf("  bilateral grid vs direct: mean difference %.2f\n", diff);
+    free(img);
+    free(src);
+}
+
+/**
+ * @brief 渲染彩色字符画到临时文件，返回文件头之后的内容（调用者释放），失败返回NULL。
+ */
+static char *render_ascii_color(
+    const unsigned char *data, int w, int h, int c, ascii_style_t style, ascii_color_t color, int background)
+{
+    char path[] = "/tmp/run_tests_ascii_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return NULL;
+    close(fd);
+
+    char *text = NULL;
+    if (image_to_ascii_color(data, w, h, c, path, 2, style, 1.0f, color, background)) {
+        FILE *fp = fopen(path, "rb");
+        text = (char *)calloc(1 << 16, 1);
+        if (fp && text)
+            fread(text, 1, (1 << 16) - 1, fp);
+        if (fp)
+            fclose(fp);
+    }
+    remove(path);
+
+    char *body = text ? strstr(text, "\n\n") : NULL;
+    if (body)
+        memmove(text, body + 2, strlen(body + 2) + 1);
+    return text;
+}
+
+/**
+ * @brief 彩色字符画：左半红色、右半灰色的图像，每行只在颜色变化处输出转义序列，
+ *        256色查表和真彩色的量化结果正确，去掉颜色后与无色输出的字符相同。
+ */
+static void test_ascii_color(void)
+{
+    const int w = 24, h = 16, c = 3;
+    unsigned char *img = (unsigned char *)malloc((size_t)w * h * c);
+    for (int i = 0; i < w * h; i++) {
+        int red = i % w < w / 2;
+        img[i * c] = red ? 255 : 128;
+        img[i * c + 1] = red ? 0 : 128;
+        img[i * c + 2] = red ? 0 : 128;
+    }
+
+    // 2x4 的字符块：每行12个字符，红色亮度76 -> ';'，灰色128 -> '*'（量化为132，256色时最接近立方体中的135）
+    const char *plain_row = ";;;;;;******\n";
+    const char *expected[3] = {plain_row,
+                               "\x1b[38;5;196m;;;;;;\x1b[38;5;102m******\x1b[0m\n",
+                               "\x1b[48;2;255;0;0m;;;;;;\x1b[48;2;132;132;132m******\x1b[0m\n"};
+    const ascii_color_t colors[3] = {ASCII_COLOR_NONE, ASCII_COLOR_256, ASCII_COLOR_TRUECOLOR};
+    for (int k = 0; k < 3; k++) {
+        char *text = render_ascii_color(img, w, h, c, ASCII_STYLE_EXTENDED, colors[k], k == 2);
+        int bad = !text;
+        const char *p = text;
+        for (int row = 0; !bad && row < h / 4; row++) {
+            bad = strncmp(p, expected[k], strlen(expected[k])) != 0;
+            p += strlen(expected[k]);
+        }
+        CHECK(!bad && *p == '\0', "ascii color mode %d: unexpected output", (int)colors[k]);
+        free(text);
+    }
+
+    // 灰度图像：三个分量都取唯一的通道
+    unsigned char gray[8 * 4];
+    memset(gray, 255, sizeof(gray));
+    char *text = render_ascii_color(gray, 8, 4, 1, ASCII_STYLE_EXTENDED, ASCII_COLOR_256, 0);
+    CHECK(text && strcmp(text, "\x1b[38;5;231m@@@@\x1b[0m\n") == 0, "ascii color: gray image output differs");
+    free(text);
+    free(img);
+}
+
+/**
+ * @brief 边缘方向字符画：竖直、水平和两条对角阶跃边缘上的字符块分别使用 '|'、'-'/'_'、'\\' 和 '/'，
+ *        远离边缘的字符块按亮度选择字符；共用原图梯度场的金字塔版本与直接计算的结果相同。
+ */
+static void test_ascii_edges(void)
+{
+    const int w = 32, h = 32;
+    const char *expected[4] = {"|", "-_", "\\", "/"};
+    unsigned char *img = (unsigned char *)malloc((size_t)w * h);
+    for (int k = 0; k < 4; k++) {
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                int bright = k == 0 ? x >= w / 2 : k == 1 ? y >= h / 2 : k == 2 ? x - y >= 0 : x + y >= w;
+                img[y * w + x] = bright ? 220 : 30;
+            }
+        }
+        char *text = render_ascii_color(img, w, h, 1, ASCII_STYLE_EDGES, ASCII_COLOR_NONE, 0);
+        int found = 0, wrong = 0;
+        for (const char *p = text; p && *p; p++) {
+            if (strchr("|/-\\_", *p))
+                found += strchr(expected[k], *p) != NULL, wrong += strchr(expected[k], *p) == NULL;
+        }
+        // 每个字符行至少穿过一个边缘字符块
+        CHECK(text && found >= h / 4 && wrong == 0,
+              "ascii edges case %d: %d expected and %d unexpected glyphs",
+              k,
+              found,
+              wrong);
+        // 亮度 30 -> ','，220 -> '0'，阶跃两侧的两列字符块是边缘
+        if (k == 0)
+            CHECK(text && strncmp(text, ",,,,,,,||0000000\n", 17) == 0, "ascii edges: vertical step row differs");
+        free(text);
+    }
+
+    // 金字塔版本：传入原图梯度场与在第0层上计算的结果相同，尺寸不符的梯度场被拒绝
+    image_pyramid_t pyramid;
+    sobel_gradient_t gradient;
+    int ok = pyramid_build(&pyramid, img, w, h, 1, 1) && sobel_gradient_compute(img, w, h, 1, 0, &gradient);
+    CHECK(ok, "ascii edges: pyramid or gradient failed");
+    if (ok) {
+        char path_a[] = "/tmp/run_tests_edges_XXXXXX";
+        char path_b[] = "/tmp/run_tests_edges_XXXXXX";
+        int fa = mkstemp(path_a), fb = mkstemp(path_b);
+        close(fa);
+        close(fb);
+        ok = image_to_ascii_edges_pyramid(&pyramid, &gradient, path_a, 2, 0.8f) &&
+             image_to_ascii_edges_pyramid(&pyramid, NULL, path_b, 2, 0.8f);
+        char a[4096] = {0}, b[4096] = {0};
+        FILE *fp = fopen(path_a, "rb");
+        if (fp) {
+            fread(a, 1, sizeof(a) - 1, fp);
+            fclose(fp);
+        }
+        fp = fopen(path_b, "rb");
+        if (fp) {
+            fread(b, 1, sizeof(b) - 1, fp);
+            fclose(fp);
+        }
+        CHECK(ok && strcmp(a, b) == 0, "ascii edges: shared gradient output differs");
+        gradient.width--;
+        CHECK(!image_to_ascii_edges_pyramid(&pyramid, &gradient, path_a, 2, 0.8f),
+              "ascii edges: mismatched gradient accepted");
+        gradient.width++;
+#ifdef __linux__
+        // 写入失败（/dev/full 总是报告磁盘已满）必须报告，批处理据此把图像标记为失败
+        CHECK(!image_to_ascii_styled_pyramid(&pyramid, "/dev/full", 2, ASCII_STYLE_BLOCKS, 0.8f) &&
+                  !image_to_ascii_edges_pyramid(&pyramid, &gradient, "/dev/full", 2, 0.8f),
+              "ascii: write error not reported");
+#endif
+        remove(path_a);
+        remove(path_b);
+        sobel_gradient_free(&gradient);
+        pyramid_free(&pyramid);
+    }
+    free(img);
+}
+
+/**
+ * @brief 参考实现的边界映射：越界坐标按边界模式映射回 [0, n)，BORDER_CONSTANT 越界返回-1。
+ */
+static int reference_border(int i, int n, border_mode_t mode)
+{
+    while (i < 0 || i >= n) {
+        if (mode == BORDER_CONSTANT)
+            return -1;
+        if (mode == BORDER_CLAMP || (mode == BORDER_REFLECT && n == 1))
+            return i < 0 ? 0 : n - 1;
+        if (mode == BORDER_WRAP)
+            i = i < 0 ? i + n : i - n;
+        else
+            i = i < 0 ? -i : 2 * (n - 1) - i;
+    }
+    return i;
+}
+
+/**
+ * @brief 逐点直接计算二维卷积的参考实现（double 精度，四舍五入并钳制），只处理前 channels 个通道。
+ */
+static void reference_convolve(const unsigned char *src,
+                               int w,
+                               int h,
+                               int c,
+                               int channels,
+                               const float *weights,
+                               int size,
+                               border_mode_t mode,
+                               unsigned char *dst)
+{
+    int r = size / 2;
+    memcpy(dst, src, (size_t)w * h * c);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            for (int ch = 0; ch < channels; ch++) {
+                double sum = 0.0;
+                for (int i = 0; i < size; i++) {
+                    int sy = reference_border(y + i - r, h, mode);
+                    for (int j = 0; j < size; j++) {
+                        int sx = reference_border(x + j - r, w, mode);
+                        int v = (sy < 0 || sx < 0) ? 0 : src[((size_t)sy * w + sx) * c + ch];
+                        sum += (double)weights[i * size + j] * v;
+                    }
+                }
+                long v = lround(sum);
+                dst[((size_t)y * w + x) * c + ch] = (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+            }
+        }
+    }
+}
+
+/**
+ * @brief 边界模式：模糊（可分离核）和锐化（二维整数核）在四种边界模式下都与直接计算的参考实现一致（允许±1），
+ *        效果链中的 blur:半径:模式 与直接调用相同。
+ */
+static void test_border_modes(int w, int h, int c)
+{
+    static const border_mode_t modes[] = {BORDER_CLAMP, BORDER_REFLECT, BORDER_WRAP, BORDER_CONSTANT};
+    static const char *mode_names[] = {"clamp", "reflect", "wrap", "constant"};
+    static const float sharpen[9] = {0, -1, 0, -1, 5, -1, 0, -1, 0};
+    size_t n = (size_t)w * h * c;
+    unsigned char *src = make_image(w, h, c, -1);
+    unsigned char *out = (unsigned char *)malloc(n);
+    unsigned char *ref = (unsigned char *)malloc(n);
+
+    for (int m = 0; m < 4; m++) {
+        for (int radius = 1; radius <= 4; radius += 3) {
+            conv_kernel_t *kernel = conv_kernel_gaussian(radius);
+            int size = 2 * radius + 1;
+            float weights[9 * 9];
+            for (int i = 0; i < size; i++)
+                for (int j = 0; j < size; j++)
+                    weights[i * size + j] = kernel->col[i] * kernel->row[j];
+            conv_kernel_free(kernel);
+
+            image_rect_t full = {0, 0, w, h};
+            int ok = blur_roi(src, w, h, c, w * c, full, radius, modes[m], out, w * c);
+            reference_convolve(src, w, h, c, c, weights, size, modes[m], ref);
+            int bad = 0;
+            for (size_t i = 0; ok && i < n; i++)
+                bad += abs(out[i] - ref[i]) > 1;
+            CHECK(ok && bad == 0, "blur %s r=%d %dx%dx%d: %d samples differ", mode_names[m], radius, w, h, c, bad);
+
+            // 效果链中给出的边界模式与直接调用相同
+            char spec[32];
+            snprintf(spec, sizeof(spec), "blur:%d:%s", radius, mode_names[m]);
+            effect_op_t op;
+            effect_image_t img = {(unsigned char *)malloc(n), w, h, c};
+            memcpy(img.data, src, n);
+            ok = effects_parse(spec, &op, 1) == 1 && op.border == modes[m] && op.param == radius &&
+                 effect_apply(&op, &img) && memcmp(img.data, out, n) == 0;
+            CHECK(ok, "%s %dx%dx%d: effect chain differs from blur_roi", spec, w, h, c);
+            free(img.data);
+        }
+
+        // 锐化：Alpha 通道保持不变
+        conv_kernel_t *kernel = conv_kernel_preset("sharpen");
+        memcpy(out, src, n);
+        int ok = kernel && convolve_image(out, w, h, c, kernel, modes[m]);
+        conv_kernel_free(kernel);
+        reference_convolve(src, w, h, c, (c == 2 || c == 4) ? c - 1 : c, sharpen, 3, modes[m], ref);
+        int bad = 0;
+        for (size_t i = 0; ok && i < n; i++)
+            bad += abs(out[i] - ref[i]) > 1;
+        CHECK(ok && bad == 0, "sharpen %s %dx%dx%d: %d samples differ", mode_names[m], w, h, c, bad);
+    }
+
+    free(src);
+    free(out);
+    free(ref);
+}
+
+/**
+ * @brief 缩放到奇数尺寸（包括1x1）：常数图像保持不变；随机图像的每个通道与单独缩放该通道的结果完全一致
+ *        （多通道的 SIMD 路径与单通道的标量路径比较）。
+ */
+static void test_resize(int w, int h, int c)
+{
+    static const int targets[][2] = {{1, 1}, {3, 1}, {1, 5}, {7, 3}, {33, 17}, {131, 5}};
+    unsigned char *flat = make_image(w, h, c, 64);
+    unsigned char *noise = make_image(w, h, c, -1);
+    unsigned char *plane = (unsigned char *)malloc((size_t)w * h);
+    for (int t = 0; t < (int)(sizeof(targets) / sizeof(targets[0])); t++) {
+        int nw = targets[t][0], nh = targets[t][1];
+        for (int f = RESIZE_FILTER_BOX; f <= RESIZE_FILTER_LANCZOS3; f++) {
+            unsigned char *out = resize_image(flat, w, h, c, nw, nh, (resize_filter_t)f);
+            CHECK(out != NULL, "resize %dx%dx%d -> %dx%d filter %d failed", w, h, c, nw, nh, f);
+            int bad = 0;
+            for (size_t i = 0; out && i < (size_t)nw * nh * c; i++)
+                bad += abs(out[i] - 64) > 1;
+            CHECK(bad == 0, "resize %dx%dx%d -> %dx%d filter %d: constant image changed", w, h, c, nw, nh, f);
+            free(out);
+
+            out = resize_image(noise, w, h, c, nw, nh, (resize_filter_t)f);
+            bad = !out;
+            for (int cc = 0; cc < c && !bad; cc++) {
+                for (size_t i = 0; i < (size_t)w * h; i++)
+                    plane[i] = noise[i * c + cc];
+                unsigned char *single = resize_image(plane, w, h, 1, nw, nh, (resize_filter_t)f);
+                for (size_t i = 0; single && i < (size_t)nw * nh; i++)
+                    bad += out[i * c + cc] != single[i];
+                bad += !single;
+                free(single);
+            }
+            CHECK(bad == 0,
+                  "resize %dx%dx%d -> %dx%d filter %d: channels differ from single-channel",
+                  w,
+                  h,
+                  c,
+                  nw,
+                  nh,
+                  f);
+            free(out);
+        }
+    }
+    free(plane);
+    free(noise);
+    free(flat);
+}
+
+/**
+ * @brief 缩略图：小图像取金字塔中合适的一层，比8倍上限还大的图像再缩放，长边都不超过上限且保持宽高比。
+ */
+static void test_thumbnail(void)
+{
+    static const int sizes[][2] = {{512, 512}, {6000, 4000}, {1500, 90}, {90, 1500}, {100, 60}, {1, 1}};
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        int w = sizes[s][0], h = sizes[s][1];
+        unsigned char *img = make_image(w, h, 3, 90);
+        image_pyramid_t pyramid;
+        int tw = 0, th = 0;
+        unsigned char *thumb = NULL;
+        if (pyramid_build(&pyramid, img, w, h, 3, 8)) {
+            thumb = pyramid_thumbnail(&pyramid, PYRAMID_THUMBNAIL_SIZE, &tw, &th);
+            pyramid_free(&pyramid);
+        }
+        int longest = w > h ? w : h;
+        int expected = longest < PYRAMID_THUMBNAIL_SIZE ? longest : PYRAMID_THUMBNAIL_SIZE;
+        CHECK(thumb && (tw > th ? tw : th) <= PYRAMID_THUMBNAIL_SIZE && (tw > th ? tw : th) >= expected / 2 &&
+                  abs(tw * h - th * w) <= longest,
+              "thumbnail %dx%d -> %dx%d",
+              w,
+              h,
+              tw,
+              th);
+        free(thumb);
+        free(img);
+    }
+}
+
+/**
+ * @brief 缩小加载：只保留缩小到的一层，内容与完整金字塔的同一层相同，第0层记录原图尺寸；min_size 提前停止缩小。
+ */
+static void test_reduced_load(const char *lenna_path)
+{
+    int w, h, c;
+    unsigned char *full = load_image(lenna_path, &w, &h, &c);
+    image_pyramid_t pyramid, reduced;
+    if (!full || !pyramid_build(&pyramid, full, w, h, c, 8)) {
+        CHECK(0, "reduced load: cannot load '%s'", lenna_path);
+        free_image(full);
+        return;
+    }
+    for (int factor = 1; factor <= 8; factor *= 2) {
+        int level = factor == 8 ? 3 : factor / 2;
+        int ok = load_image_reduced(lenna_path, factor, 0, &reduced) && reduced.levels == level + 1 &&
+                 reduced.width[0] == w && reduced.height[0] == h && reduced.channels == c;
+        for (int l = 0; ok && l < level; l++)
+            ok = reduced.data[l] == NULL;
+        size_t n = (size_t)pyramid.width[level] * pyramid.height[level] * c;
+        ok = ok && reduced.data[level] && reduced.width[level] == pyramid.width[level] &&
+             memcmp(reduced.data[level], pyramid.data[level], n) == 0;
+        CHECK(ok, "reduced load: factor %d differs from the pyramid", factor);
+        free_image(reduced.data[0]);
+        pyramid_free(&reduced);
+    }
+    CHECK(load_image_reduced(lenna_path, 8, w / 3, &reduced) && reduced.levels == 2, "reduced load: min_size ignored");
+    free_image(reduced.data[0]);
+    pyramid_free(&reduced);
+    pyramid_free(&pyramid);
+    free_image(full);
+}
+
+/**
+ * @brief 效果链的执行计划：放大再缩小后尺寸正确，中间步骤在同一个缓冲区上完成。
+ */
+static void test_effect_chain(int w, int h, int c)
+{
+    effect_op_t ops[EFFECT_MAX_OPS];
+    int count = effects_parse("resize:300,blur:2,edge:30,resize:50,invert", ops, EFFECT_MAX_OPS);
+    CHECK(count == 5, "cannot parse effect chain");
+
+    effect_image_t img = {make_image(w, h, c, -1), w, h, c};
+    int ok = effects_apply_all(ops, count, &img);
+    int ew = w * 3 * 50 / 100, eh = h * 3 * 50 / 100;
+    ew = ew < 1 ? 1 : ew;
+    eh = eh < 1 ? 1 : eh;
+    CHECK(ok && img.width == ew && img.height == eh,
+          "effect chain %dx%dx%d: got %dx%d, expected %dx%d",
+          w,
+          h,
+          c,
+          img.width,
+          img.height,
+          ew,
+          eh);
+    free(img.data);
+}
+
+/**
+ * @brief float 流水线与8位流水线在 lenna 上的结果一致（在量化误差范围内）。
+ */
+static void test_hdr(const char *lenna_path)
+{
+    hdr_image_t hdr;
+    if (!hdr_image_load(lenna_path, &hdr)) {
+        CHECK(0, "cannot load '%s' into the float pipeline", lenna_path);
+        return;
+    }
+    int w, h, c;
+    unsigned char *ref = load_image(lenna_path, &w, &h, &c);
+    size_t n = (size_t)w * h * c;
+
+    grayscale(ref, w, h, c);
+    hdr_grayscale(&hdr);
+    int bad = 0;
+    for (size_t i = 0; i < n; i++)
+        bad += abs((int)(hdr.data[i] * 255.0f + 0.5f) - ref[i]) > 1;
+    CHECK(bad == 0, "float grayscale: %d samples differ from 8-bit by more than 1", bad);
+
+    unsigned char *edges = sobel_edge_detect(ref, w, h, c, 40, 0);
+    hdr_edge_detect(&hdr, 40);
+    bad = 0;
+    for (size_t i = 0; edges && i < n; i++)
+        bad += (hdr.data[i] > 0.5f) != (edges[i] > 127);
+    CHECK((size_t)bad <= n / 50, "float edge: %d of %zu samples differ from 8-bit", bad, n);
+
+    // 常数图像上的 float 模糊保持不变
+    hdr_image_t flat = {(float *)malloc(7 * 5 * 4 * sizeof(float)), 7, 5, 4, 16};
+    for (int i = 0; i < 7 * 5 * 4; i++)
+        flat.data[i] = 0.625f;
+    hdr_blur(&flat, 50);
+    bad = 0;
+    for (int i = 0; i < 7 * 5 * 4; i++)
+        bad += flat.data[i] < 0.6249f || flat.data[i] > 0.6251f;
+    CHECK(bad == 0, "float blur: constant image changed in %d samples", bad);
+
+    free(flat.data);
+    free(edges);
+    free_image(ref);
+    hdr_image_free(&hdr);
+}
+
+// 调度器测试：顶层任务数、每个顶层任务嵌套提交的子任务数和 parallel_for 的元素数
+#define SCHED_TASKS 64
+#define SCHED_CHILDREN 8
+#define SCHED_RANGE 1000
+
+typedef struct
+{
+    scheduler_t *sched;
+    int *child_runs;                  // 子任务执行次数
+    unsigned char range[SCHED_RANGE]; // parallel_for 中每个元素的执行次数
+    int in_worker;                    // 任务是否在工作线程中执行
+} sched_task_t;
+
+static void sched_child(void *arg)
+{
+    __atomic_fetch_add((int *)arg, 1, __ATOMIC_RELAXED);
+}
+
+static void sched_range(void *ctx, int begin, int end)
+{
+    unsigned char *range = (unsigned char *)ctx;
+    for (int i = begin; i < end; i++)
+        __atomic_fetch_add(&range[i], 1, __ATOMIC_RELAXED);
+}
+
+static void sched_task(void *arg)
+{
+    sched_task_t *task = (sched_task_t *)arg;
+    task->in_worker = scheduler_current() == task->sched;
+    task_group_t group;
+    task_group_init(&group);
+    for (int i = 0; i < SCHED_CHILDREN; i++)
+        scheduler_spawn(task->sched, &group, sched_child, task->child_runs);
+    parallel_for(SCHED_RANGE, 16, sched_range, task->range);
+    scheduler_wait(task->sched, &group);
+}
+
+/**
+ * @brief 工作窃取调度器：外部提交的任务在工作线程中执行，嵌套提交的子任务和 parallel_for 的每个元素恰好执行一次。
+ */
+static void test_scheduler(void)
+{
+    scheduler_t *sched = scheduler_create(4);
+    CHECK(sched != NULL, "scheduler_create failed");
+    if (!sched)
+        return;
+    CHECK(scheduler_thread_count(sched) == 4, "scheduler has %d threads", scheduler_thread_count(sched));
+    CHECK(scheduler_current() == NULL, "main thread reports a scheduler");
+
+    sched_task_t *tasks = (sched_task_t *)calloc(SCHED_TASKS, sizeof(sched_task_t));
+    int child_runs = 0;
+    task_group_t group;
+    task_group_init(&group);
+    for (int t = 0; t < SCHED_TASKS; t++) {
+        tasks[t].sched = sched;
+        tasks[t].child_runs = &child_runs;
+        scheduler_spawn(sched, &group, sched_task, &tasks[t]);
+    }
+    scheduler_wait(sched, &group);
+
+    int outside = 0, bad_range = 0;
+    for (int t = 0; t < SCHED_TASKS; t++) {
+        outside += !tasks[t].in_worker;
+        for (int i = 0; i < SCHED_RANGE; i++)
+            bad_range += tasks[t].range[i] != 1;
+    }
+    CHECK(outside == 0, "scheduler: %d tasks did not run on a worker", outside);
+    CHECK(child_runs == SCHED_TASKS * SCHED_CHILDREN,
+          "scheduler: %d of %d nested tasks ran",
+          child_runs,
+          SCHED_TASKS * SCHED_CHILDREN);
+    CHECK(bad_range == 0, "scheduler: %d parallel_for elements did not run exactly once", bad_range);
+
+    free(tasks);
+    scheduler_destroy(sched);
+}
+
+/**
+ * @brief 合成图像上的边界情况。
+ */
+static void test_synthetic(void)
+{
+    static const int sizes[][2] = {{1, 1}, {2, 1}, {1, 3}, {7, 5}, {33, 3}, {3, 33}, {65, 9}};
+    static const int channel_counts[] = {1, 2, 3, 4};
+
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        int w = sizes[s][0], h = sizes[s][1];
+        for (int k = 0; k < 4; k++) {
+            int c = channel_counts[k];
+            test_pointwise(w, h, c);
+            test_blur(w, h, c, 1);
+            test_blur(w, h, c, 5);
+            test_blur(w, h, c, 200); // 半径远大于图像
+            test_border_modes(w, h, c);
+            test_edge(w, h, c);
+            test_edge_tiled(w, h, c, 2);
+            test_morphology(w, h, c);
+            test_median(w, h, c);
+            test_bilateral(w, h, c);
+            test_resize(w, h, c);
+            test_effect_chain(w, h, c);
+        }
+    }
+    // 按位打包后一行超过一个列带（1024像素）
+    test_morphology(1100, 7, 1);
+    test_morphology(1100, 7, 3);
+    test_bilateral_reference();
+    test_thumbnail();
+    // 通道数超过平面布局的上限
+    test_blur(33, 9, 6, 2);
+    test_blur_many_channels(33, 9, 6, 2);
+    test_blur_many_channels(7, 5, 5, 200);
+}
+
+/**
+ * @brief 感知哈希：缩小、JPEG 重新编码、调整亮度后的图像与原图距离很小，旋转和反色后的图像距离很大；
+ *        灰度图像与同亮度的彩色图像哈希相同；索引按距离查找最近的条目，保存后重新读入的内容不变。
+ */
+static void test_phash(const char *lenna_path)
+{
+    int w, h, c;
+    unsigned char *ref = load_image(lenna_path, &w, &h, &c);
+    image_hash_t base;
+    if (!ref || !image_hash_compute(ref, w, h, c, &base)) {
+        CHECK(0, "phash: cannot hash '%s'", lenna_path);
+        free_image(ref);
+        return;
+    }
+    size_t n = (size_t)w * h * c;
+    unsigned char *work = (unsigned char *)malloc(n);
+    image_hash_t hash;
+
+    unsigned char *small = resize_image(ref, w, h, c, w / 3, h / 3, RESIZE_FILTER_LANCZOS3);
+    CHECK(small && image_hash_compute(small, w / 3, h / 3, c, &hash) && image_hash_distance(base, hash) <= 4,
+          "phash: downscaled copy is too far (%d)",
+          image_hash_distance(base, hash));
+    free(small);
+
+    char path[] = "/tmp/run_tests_phash_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    int jw = 0, jh = 0, jc = 0;
+    unsigned char *jpeg = stbi_write_jpg(path, w, h, c, ref, 60) ? load_image(path, &jw, &jh, &jc) : NULL;
+    CHECK(jpeg && image_hash_compute(jpeg, jw, jh, jc, &hash) && image_hash_distance(base, hash) <= 4,
+          "phash: re-encoded copy is too far (%d)",
+          image_hash_distance(base, hash));
+    free_image(jpeg);
+    remove(path);
+
+    for (size_t i = 0; i < n; i++)
+        work[i] = ref[i] > 235 ? 255 : ref[i] + 20;
+    CHECK(image_hash_compute(work, w, h, c, &hash) && image_hash_distance(base, hash) <= 4,
+          "phash: brightened copy is too far (%d)",
+          image_hash_distance(base, hash));
+
+    memcpy(work, ref, n);
+    rotate_image(work, w, h, c);
+    CHECK(image_hash_compute(work, w, h, c, &hash) && image_hash_distance(base, hash) > 16,
+          "phash: rotated image is too close (%d)",
+          image_hash_distance(base, hash));
+    image_hash_t rotated = hash;
+
+    memcpy(work, ref, n);
+    invert(work, w, h, c);
+    CHECK(image_hash_compute(work, w, h, c, &hash) && image_hash_distance(base, hash) > 16,
+          "phash: inverted image is too close (%d)",
+          image_hash_distance(base, hash));
+    image_hash_t inverted = hash;
+
+    // 灰度图像：单通道与三个通道都取同一亮度的图像哈希相同；1x1 图像也能计算
+    unsigned char gray[12 * 7], rgb[12 * 7 * 3];
+    for (int i = 0; i < 12 * 7; i++) {
+        gray[i] = (unsigned char)(i * 37 % 251);
+        rgb[3 * i] = rgb[3 * i + 1] = rgb[3 * i + 2] = gray[i];
+    }
+    image_hash_t gray_hash;
+    CHECK(image_hash_compute(gray, 12, 7, 1, &gray_hash) && image_hash_compute(rgb, 12, 7, 3, &hash) &&
+              image_hash_distance(gray_hash, hash) == 0,
+          "phash: gray and rgb hashes differ");
+    CHECK(image_hash_compute(gray, 1, 1, 1, &hash), "phash: 1x1 image failed");
+
+    // 索引：最近的条目、同名替换、删除、保存和读入
+    hash_index_t index, loaded;
+    hash_index_init(&index);
+    hash_index_init(&loaded);
+    hash_index_add(&index, rotated, "rotated", 0);
+    hash_index_add(&index, base, "lenna", 1);
+    hash_index_add(&index, inverted, "inverted", 2);
+    int distance = -1;
+    int k = hash_index_find(&index, base, 4, &distance);
+    CHECK(k >= 0 && strcmp(index.entries[k].name, "lenna") == 0 && distance == 0, "phash index: lookup failed");
+    CHECK(hash_index_add(&index, gray_hash, "lenna", 5) == k && index.count == 3 && index.entries[k].id == 5,
+          "phash index: same name was not replaced");
+    CHECK(hash_index_find(&index, base, 4, NULL) < 0, "phash index: replaced hash still found");
+    hash_index_remove(&index, hash_index_lookup_name(&index, "rotated"));
+    CHECK(index.count == 2 && hash_index_lookup_name(&index, "rotated") < 0, "phash index: remove failed");
+
+    fd = mkstemp(path);
+    close(fd);
+    CHECK(hash_index_save(&index, path) && hash_index_load(&loaded, path) == 2, "phash index: save/load failed");
+    int same = loaded.count == index.count;
+    for (int i = 0; same && i < index.count; i++) {
+        int j = hash_index_lookup_name(&loaded, index.entries[i].name);
+        same = j >= 0 && loaded.entries[j].id == -1 && loaded.entries[j].hash.dhash == index.entries[i].hash.dhash &&
+               loaded.entries[j].hash.phash == index.entries[i].hash.phash;
+    }
+    CHECK(same, "phash index: reloaded entries differ");
+    remove(path);
+    hash_index_free(&index);
+    hash_index_free(&loaded);
+
+    free(work);
+    free_image(ref);
+}
+
+/**
+ * @brief 重复图像索引：大量随机增删和替换后，按名称和按距离查找的结果与逐个比较全部条目的结果相同。
+ */
+static void test_hash_index(void)
+{
+    enum
+    {
+        NAMES = 3000,
+        QUERIES = 400
+    };
+    static image_hash_t hashes[NAMES];
+    static int present[NAMES];
+    hash_index_t index;
+    hash_index_init(&index);
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+#define NEXT_RANDOM() (state ^= state << 13, state ^= state >> 7, state ^= state << 17)
+
+    // 一部分哈希是前面某个哈希翻转几位得到的近似重复
+    char name[32];
+    int ok = 1;
+    for (int step = 0; step < 3 * NAMES; step++) {
+        int n = (int)(NEXT_RANDOM() % NAMES);
+        snprintf(name, sizeof(name), "image-%d", n);
+        if (present[n] && NEXT_RANDOM() % 3 == 0) {
+            hash_index_remove(&index, hash_index_lookup_name(&index, name));
+            present[n] = 0;
+            continue;
+        }
+        image_hash_t hash = {NEXT_RANDOM(), NEXT_RANDOM()};
+        if (n > 0 && NEXT_RANDOM() % 2 == 0) {
+            hash = hashes[NEXT_RANDOM() % (uint64_t)n];
+            for (int flips = (int)(NEXT_RANDOM() % 12); flips > 0; flips--) {
+                hash.dhash ^= 1ull << (NEXT_RANDOM() % 64);
+                hash.phash ^= 1ull << (NEXT_RANDOM() % 64);
+            }
+        }
+        hashes[n] = hash;
+        present[n] = 1;
+        ok &= hash_index_add(&index, hash, name, n) >= 0;
+    }
+    CHECK(ok, "hash index: add failed");
+
+    int live = 0;
+    for (int n = 0; n < NAMES; n++) {
+        snprintf(name, sizeof(name), "image-%d", n);
+        int k = hash_index_lookup_name(&index, name);
+        live += present[n];
+        ok &= present[n] ? k >= 0 && index.entries[k].id == n && strcmp(index.entries[k].name, name) == 0 : k < 0;
+    }
+    CHECK(ok && index.count == live, "hash index: name lookup differs (%d entries, %d expected)", index.count, live);
+
+    int bad_query = -1, bad_result = 0, bad_expected = 0;
+    for (int q = 0; q < QUERIES && bad_query < 0; q++) {
+        image_hash_t hash = hashes[NEXT_RANDOM() % NAMES];
+        hash.dhash ^= 1ull << (NEXT_RANDOM() % 64);
+        int max_distance = q % 13;
+        int expected = -1, expected_distance = max_distance + 1;
+        for (int i = 0; i < index.count; i++) {
+            int d = image_hash_distance(hash, index.entries[i].hash);
+            if (d < expected_distance) {
+                expected = i;
+                expected_distance = d;
+            }
+        }
+        int distance = -1;
+        int k = hash_index_find(&index, hash, max_distance, &distance);
+        if (k != expected || (k >= 0 && distance != expected_distance)) {
+            bad_query = q;
+            bad_result = k;
+            bad_expected = expected;
+        }
+    }
+    CHECK(bad_query < 0,
+          "hash index: query %d at distance %d returned %d, expected %d",
+          bad_query,
+          bad_query % 13,
+          bad_result,
+          bad_expected);
+#undef NEXT_RANDOM
+    hash_index_free(&index);
+}
+
+static void test_journal(void)
+{
+    char dir[] = "/tmp/run_tests_journal_XXXXXX";
+    CHECK(mkdtemp(dir) != NULL, "journal: cannot create directory");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/main.log", dir);
+
+    // CRC-32 的标准校验值
+    FILE *fp = fopen(path, "w");
+    fputs("123456789", fp);
+    fclose(fp);
+    long long size = 0;
+    uint32_t crc = 0;
+    CHECK(journal_checksum_file(path, &size, &crc) && size == 9 && crc == 0xcbf43926u,
+          "journal: checksum %08x",
+          (unsigned)crc);
+    remove(path);
+
+    // 切片查表与逐位计算一致，任意位置分段计算的结果相同
+    unsigned char bytes[67];
+    for (int i = 0; i < (int)sizeof(bytes); i++)
+        bytes[i] = (unsigned char)(i * 151 + 7);
+    int crc_ok = 1;
+    for (int len = 0; len <= (int)sizeof(bytes); len++) {
+        uint32_t expected = 0xffffffffu;
+        for (int i = 0; i < len; i++) {
+            expected ^= bytes[i];
+            for (int k = 0; k < 8; k++)
+                expected = (expected & 1) ? 0xedb88320u ^ (expected >> 1) : expected >> 1;
+        }
+        expected = ~expected;
+        for (int split = 0; split <= len; split++)
+            crc_ok &= crc32_update(crc32_update(0, bytes, (size_t)split), bytes + split, (size_t)(len - split)) ==
+                      expected;
+    }
+    CHECK(crc_ok, "checksum: sliced CRC-32 differs from the bitwise reference");
+
+    // 同一个 (输入, 输出) 的后一条记录覆盖前一条
+    journal_t journal;
+    journal_record_t a = {100, 1700000000, 2000, 1700000100, 0, 0x11111111u};
+    journal_record_t b = {200, 1700000001, 3000, 1700000101, 0x2222u, 0x33333333u};
+    journal_record_t c = {100, 1700000000, 2500, 1700000102, 0, 0x44444444u};
+    CHECK(journal_open(&journal, dir, "main.log", 2, 1) && journal.count == 0, "journal: open failed");
+    CHECK(journal_append(&journal, "a b.png", "grayscale", &a) && journal_append(&journal, "a b.png", "blur", &b) &&
+              journal_append(&journal, "c.png", "grayscale", &b) &&
+              journal_append(&journal, "a b.png", "grayscale", &c),
+          "journal: append failed");
+    journal_close(&journal);
+
+    // 写到一半的残行被丢弃，之后追加的记录照常重放
+    fp = fopen(path, "a");
+    fputs("deadbeef grayscale 1 2 0000", fp);
+    fclose(fp);
+    CHECK(journal_open(&journal, dir, "main.log", 2, 1) && journal.count == 3, "journal: replay count");
+    const journal_record_t *r = journal_find(&journal, "a b.png", "grayscale");
+    CHECK(r && r->output_size == 2500 && r->output_mtime == 1700000102 && r->checksum == 0x44444444u,
+          "journal: latest record not kept");
+    r = journal_find(&journal, "a b.png", "blur");
+    CHECK(r && r->input_size == 200 && r->input_mtime == 1700000001 && r->params == 0x2222u,
+          "journal: record fields differ");
+    CHECK(!journal_find(&journal, "c.png", "blur") && !journal_find(&journal, "d.png", "grayscale"),
+          "journal: missing record found");
+    CHECK(journal_append(&journal, "d.png", "edge", &a), "journal: append after torn line failed");
+    journal_close(&journal);
+
+    // 另一个写入者的日志文件同样被重放
+    CHECK(journal_open(&journal, dir, "other.log", 1, 1) && journal.count == 4 &&
+              journal_find(&journal, "d.png", "edge"),
+          "journal: reopen count");
+    CHECK(journal_append(&journal, "e.png", "edge", &a), "journal: second writer append failed");
+    journal_close(&journal);
+
+    // 不同文件中同一个键的记录以写入时间为准：先读到的 a.log 中的记录更新，后读到的 z.log 中的旧记录不覆盖它
+    CHECK(journal_open(&journal, dir, "z.log", 1, 1) && journal_append(&journal, "f.png", "edge", &a),
+          "journal: z.log append failed");
+    journal_close(&journal);
+    CHECK(journal_open(&journal, dir, "a.log", 1, 1) && journal_append(&journal, "f.png", "edge", &c),
+          "journal: a.log append failed");
+    journal_close(&journal);
+    CHECK(journal_open(&journal, dir, "main.log", 1, 1), "journal: reopen failed");
+    r = journal_find(&journal, "f.png", "edge");
+    CHECK(r && r->checksum == c.checksum, "journal: older record from a later file won");
+    journal_close(&journal);
+
+    // 不重放时删除全部写入者的日志
+    CHECK(journal_open(&journal, dir, "main.log", 1, 0) && journal.count == 0, "journal: fresh open replayed");
+    journal_close(&journal);
+    CHECK(journal_open(&journal, dir, "main.log", 1, 1) && journal.count == 0, "journal: fresh open kept old logs");
+    journal_close(&journal);
+
+    DIR *d = opendir(dir);
+    int logs = 0;
+    struct dirent *entry;
+    while (d && (entry = readdir(d)) != NULL)
+        logs += entry->d_name[0] != '.';
+    if (d)
+        closedir(d);
+    CHECK(logs == 1, "journal: %d log files after fresh open", logs);
+    remove(path);
+    rmdir(dir);
+}
+
+/**
+ * @brief 解码缓存：未命中时写入条目且结果与直接解码相同；命中时映射条目，原地修改不影响缓存文件；
+ *        源文件改变后不再命中，截断的条目被忽略并重新写入；映射的图像可以扩展。
+ */
+static void test_pixel_cache(void)
+{
+    char dir[] = "/tmp/run_tests_pixel_cache_XXXXXX";
+    CHECK(mkdtemp(dir) != NULL, "pixel cache: cannot create directory");
+    char source[256], entry[600] = "";
+    snprintf(source, sizeof(source), "%s/source.png", dir);
+    char cache_dir[300];
+    snprintf(cache_dir, sizeof(cache_dir), "%s/cache", dir);
+
+    const int sw = 37, sh = 45, sc = 3;
+    unsigned char pixels[37 * 45 * 3];
+    for (int i = 0; i < sw * sh * sc; i++)
+        pixels[i] = (unsigned char)(i * 7 % 253);
+    size_t n = sizeof(pixels);
+    CHECK(stbi_write_png(source, sw, sh, sc, pixels, sw * sc), "pixel cache: cannot write source");
+    CHECK(pixel_cache_set_dir(cache_dir) && pixel_cache_enabled(), "pixel cache: cannot enable");
+
+    int w = 0, h = 0, c = 0;
+    unsigned char *data = load_image(source, &w, &h, &c);
+    CHECK(data && w == sw && h == sh && c == sc && pixel_cache_mapped_size(data) == 0 &&
+              memcmp(data, pixels, n) == 0,
+          "pixel cache: miss result differs");
+    free_image(data);
+
+    DIR *d = opendir(cache_dir);
+    struct dirent *de;
+    int entries = 0;
+    while (d && (de = readdir(d)) != NULL) {
+        if (strstr(de->d_name, ".ipx")) {
+            snprintf(entry, sizeof(entry), "%s/%s", cache_dir, de->d_name);
+            entries++;
+        }
+    }
+    if (d)
+        closedir(d);
+    struct stat st;
+    CHECK(entries == 1 && stat(entry, &st) == 0 && (size_t)st.st_size == PIXEL_CACHE_HEADER_SIZE + n,
+          "pixel cache: entry not written (%d)",
+          entries);
+
+    // 命中：映射条目，写时复制的修改不影响缓存文件
+    data = load_image(source, &w, &h, &c);
+    CHECK(data && pixel_cache_mapped_size(data) == n && w == sw && h == sh && c == sc && memcmp(data, pixels, n) == 0,
+          "pixel cache: hit result differs");
+    if (data)
+        memset(data, 0, n);
+    free_image(data);
+    data = load_image(source, &w, &h, &c);
+    CHECK(data && pixel_cache_mapped_size(data) == n && memcmp(data, pixels, n) == 0,
+          "pixel cache: modification reached the entry");
+
+    // 扩展映射的图像：内容保留，之后是普通内存
+    unsigned char *grown = image_realloc(data, n * 2);
+    CHECK(grown && pixel_cache_mapped_size(grown) == 0 && memcmp(grown, pixels, n) == 0,
+          "pixel cache: realloc of mapped image failed");
+    if (grown)
+        free(grown);
+    else
+        free_image(data);
+
+    // 截断的条目被忽略，解码后重新写入
+    CHECK(truncate(entry, (off_t)st.st_size - 1) == 0, "pixel cache: cannot truncate entry");
+    data = load_image(source, &w, &h, &c);
+    CHECK(data && pixel_cache_mapped_size(data) == 0 && memcmp(data, pixels, n) == 0,
+          "pixel cache: truncated entry was used");
+    free_image(data);
+    data = load_image(source, &w, &h, &c);
+    CHECK(data && pixel_cache_mapped_size(data) == n, "pixel cache: entry not rewritten");
+    free_image(data);
+
+    // 源文件改变后按新的内容解码
+    for (size_t i = 0; i < n; i++)
+        pixels[i] = (unsigned char)(255 - pixels[i]);
+    CHECK(stbi_write_png(source, sw, sh, sc, pixels, sw * sc), "pixel cache: cannot rewrite source");
+    data = load_image(source, &w, &h, &c);
+    CHECK(data && pixel_cache_mapped_size(data) == 0 && memcmp(data, pixels, n) == 0,
+          "pixel cache: stale entry was used");
+    free_image(data);
+
+    pixel_cache_set_dir(NULL);
+    CHECK(!pixel_cache_enabled(), "pixel cache: cannot disable");
+    d = opendir(cache_dir);
+    while (d && (de = readdir(d)) != NULL) {
+        if (de->d_name[0] != '.') {
+            snprintf(entry, sizeof(entry), "%s/%s", cache_dir, de->d_name);
+            remove(entry);
+        }
+    }
+    if (d)
+        closedir(d);
+    rmdir(cache_dir);
+    remove(source);
+    rmdir(dir);
+}
+
+/**
+ * @brief 向服务发送一行请求并读取一行应答（去掉换行符）。
+ * @return 读到完整的应答返回1，否则返回0。
+ */
+static int server_exchange(int fd, const char *request, char *reply, size_t size)
+{
+    size_t len = strlen(request);
+    if (write(fd, request, len) != (ssize_t)len)
+        return 0;
+    size_t n = 0;
+    while (n + 1 < size) {
+        ssize_t got = read(fd, reply + n, 1);
+        if (got <= 0)
+            break;
+        if (reply[n] == '\n') {
+            reply[n] = '\0';
+            return 1;
+        }
+        n++;
+    }
+    reply[n] = '\0';
+    return 0;
+}
+
+/**
+ * @brief 服务模式：子进程中运行服务，经套接字往返 PING 和一个处理请求，输出与直接应用效果链的结果一致；
+ *        发给进程的 SIGTERM 使服务停止（工作线程屏蔽停止信号，信号交给阻塞在 accept 上的主线程）。
+ */
+static void test_server(const char *lenna_path)
+{
+    char dir[] = "/tmp/run_tests_server_XXXXXX";
+    CHECK(mkdtemp(dir) != NULL, "server: cannot create directory");
+    // 套接字路径不能超过 sun_path 的长度
+    char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)], output[256];
+    snprintf(socket_path, sizeof(socket_path), "%s/server.sock", dir);
+    snprintf(output, sizeof(output), "%s/out.png", dir);
+
+    // 日志模块缓冲中的内容不能被子进程再写一遍
+    log_flush();
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        log_set_level(LOG_LEVEL_ERROR);
+        _exit(serve_run(socket_path, 2) ? 0 : 1);
+    }
+    CHECK(pid > 0, "server: fork failed");
+    if (pid < 0) {
+        rmdir(dir);
+        return;
+    }
+
+    // 等待服务开始监听
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, socket_path, sizeof(socket_path));
+    int fd = -1;
+    for (int attempt = 0; attempt < 500 && fd < 0; attempt++) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+            usleep(10000);
+        }
+    }
+    CHECK(fd >= 0, "server: cannot connect to '%s'", socket_path);
+
+    const char *spec = "grayscale,blur:2";
+    char request[1024], reply[1024] = "";
+    if (fd >= 0) {
+        CHECK(server_exchange(fd, "PING\n", reply, sizeof(reply)) && strcmp(reply, "PONG") == 0,
+              "server: PING answered '%s'",
+              reply);
+        snprintf(request, sizeof(request), "%s %s %s\n", lenna_path, output, spec);
+        CHECK(server_exchange(fd, request, reply, sizeof(reply)) && strncmp(reply, "OK ", 3) == 0,
+              "server: request answered '%s'",
+              reply);
+        close(fd);
+    }
+
+    effect_op_t ops[EFFECT_MAX_OPS];
+    effect_image_t expected;
+    expected.data = load_image(lenna_path, &expected.width, &expected.height, &expected.channels);
+    int ok = expected.data && effects_apply_all(ops, effects_parse(spec, ops, EFFECT_MAX_OPS), &expected);
+    int w = 0, h = 0, c = 0;
+    unsigned char *served = load_image(output, &w, &h, &c);
+    CHECK(ok && served && w == expected.width && h == expected.height && c == expected.channels &&
+              memcmp(served, expected.data, (size_t)w * h * c) == 0,
+          "server: output differs from applying '%s' directly",
+          spec);
+    free_image(served);
+    free_image(expected.data);
+
+    // 停止信号发给整个进程
+    kill(pid, SIGTERM);
+    int status = 0, exited = 0;
+    for (int attempt = 0; attempt < 500 && !exited; attempt++) {
+        exited = waitpid(pid, &status, WNOHANG) == pid;
+        if (!exited)
+            usleep(10000);
+    }
+    if (!exited) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    CHECK(exited && WIFEXITED(status) && WEXITSTATUS(status) == 0, "server: did not stop on SIGTERM");
+    CHECK(access(socket_path, F_OK) != 0, "server: socket not removed");
+
+    remove(output);
+    remove(socket_path);
+    rmdir(dir);
+}
+
+/**
+ * @brief 在子进程中以标准输入/标准输出运行 stream_process：把 input 文件写入它的标准输入，标准输出保存到 output。
+ * @return 子进程成功退出返回1，否则返回0。
+ */
+static int run_stream_pipe(const char *spec, const char *input, const char *output)
+{
+    int to_child[2], from_child[2];
+    if (pipe(to_child) != 0 || pipe(from_child) != 0)
+        return 0;
+    // 日志模块缓冲中的内容不能被子进程写进输出管道
+    log_flush();
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        log_set_level(LOG_LEVEL_ERROR);
+        _exit(stream_process(spec, NULL, NULL, "png", 90) ? 0 : 1);
+    }
+    close(to_child[0]);
+    close(from_child[1]);
+
+    // 子进程读完标准输入才开始写，先写入全部输入再读取输出不会互相阻塞；子进程提前退出时写入失败而不是终止测试
+    void (*old_handler)(int) = signal(SIGPIPE, SIG_IGN);
+    FILE *in = fopen(input, "rb");
+    char buffer[65536];
+    size_t n;
+    while (pid > 0 && in && (n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (write(to_child[1], buffer, n) != (ssize_t)n)
+            break;
+    }
+    if (in)
+        fclose(in);
+    close(to_child[1]);
+    signal(SIGPIPE, old_handler);
+
+    FILE *out = fopen(output, "wb");
+    ssize_t got;
+    while ((got = read(from_child[0], buffer, sizeof(buffer))) > 0) {
+        if (out)
+            fwrite(buffer, 1, (size_t)got, out);
+    }
+    if (out)
+        fclose(out);
+    close(from_child[0]);
+
+    int status = 0;
+    if (pid > 0)
+        waitpid(pid, &status, 0);
+    return pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief 读入整个文件，与另一个文件逐字节比较。
+ */
+static int same_file_contents(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    size_t na = 0, nb = 0;
+    unsigned char *da = fa ? read_stream(fa, &na) : NULL;
+    unsigned char *db = fb ? read_stream(fb, &nb) : NULL;
+    int same = da && db && na == nb && memcmp(da, db, na) == 0;
+    free(da);
+    free(db);
+    if (fa)
+        fclose(fa);
+    if (fb)
+        fclose(fb);
+    return same;
+}
+
+/**
+ * @brief 标准输入/标准输出的链式处理与文件路径的结果相同：8位输入比较解码后的像素，
+ *        16位输入同样走高位深流水线，输出逐字节相同的16位PNG。
+ */
+static void test_stream_pipe(const char *lenna_path)
+{
+    char dir[] = "/tmp/run_tests_pipe_XXXXXX";
+    CHECK(mkdtemp(dir) != NULL, "pipe: cannot create directory");
+    char file_output[256], pipe_output[256], input16[256];
+    snprintf(file_output, sizeof(file_output), "%s/file.png", dir);
+    snprintf(pipe_output, sizeof(pipe_output), "%s/pipe.png", dir);
+    snprintf(input16, sizeof(input16), "%s/input16.png", dir);
+
+    const char *spec = "grayscale,blur:2";
+    CHECK(stream_process(spec, lenna_path, file_output, NULL, 90), "pipe: file stream_process failed");
+    CHECK(run_stream_pipe(spec, lenna_path, pipe_output), "pipe: stdin/stdout stream_process failed");
+
+    int fw = 0, fh = 0, fc = 0, pw = 0, ph = 0, pc = 0;
+    unsigned char *from_file = load_image(file_output, &fw, &fh, &fc);
+    unsigned char *from_pipe = load_image(pipe_output, &pw, &ph, &pc);
+    CHECK(from_file && from_pipe && fw == pw && fh == ph && fc == pc &&
+              memcmp(from_file, from_pipe, (size_t)fw * fh * fc) == 0,
+          "pipe: '%s' through stdin/stdout differs from the file path",
+          spec);
+    free_image(from_file);
+    free_image(from_pipe);
+
+    // 16位输入：低8位不为0，截断到8位后结果会不同
+    hdr_image_t hdr;
+    int ok = hdr_image_load(lenna_path, &hdr);
+    for (size_t i = 0; ok && i < (size_t)hdr.width * hdr.height * hdr.channels; i++)
+        hdr.data[i] = hdr.data[i] * (65280.0f / 65535.0f) + (float)(i % 251) / 65535.0f;
+    CHECK(ok && hdr_image_save(input16, &hdr, 90), "pipe: cannot write 16-bit input");
+    hdr_image_free(&hdr);
+    CHECK(stream_process(spec, input16, file_output, NULL, 90), "pipe: 16-bit file stream_process failed");
+    CHECK(run_stream_pipe(spec, input16, pipe_output), "pipe: 16-bit stdin/stdout stream_process failed");
+    CHECK(stbi_is_16_bit(pipe_output) && same_file_contents(file_output, pipe_output),
+          "pipe: 16-bit '%s' through stdin/stdout differs from the file path",
+          spec);
+
+    remove(file_output);
+    remove(pipe_output);
+    remove(input16);
+    rmdir(dir);
+}
+
+// 递归删除测试生成的目录
+static void remove_tree(const char *path)
+{
+    DIR *d = opendir(path);
+    if (d) {
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            char child[1024];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            remove_tree(child);
+        }
+        closedir(d);
+        rmdir(path);
+    }
+    else {
+        remove(path);
+    }
+}
+
+// 统计各输入在全部进度日志中的 grayscale 记录数，记录行的第三个字段是输出名，最后一个字段是输入文件名
+static void count_journal_records(const char *journal_dir, int *counts, int count)
+{
+    memset(counts, 0, sizeof(int) * count);
+    DIR *d = opendir(journal_dir);
+    if (!d)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".log") != 0)
+            continue;
+        char path[1024], line[1024];
+        snprintf(path, sizeof(path), "%s/%s", journal_dir, entry->d_name);
+        FILE *fp = fopen(path, "r");
+        while (fp && fgets(line, sizeof(line), fp)) {
+            char output[64];
+            const char *input = strrchr(line, ' ');
+            int index = -1;
+            if (sscanf(line, "%*s %*s %63s", output) == 1 && strcmp(output, "grayscale") == 0 && input &&
+                sscanf(input + 1, "img-%d.png", &index) == 1 && index >= 0 && index < count)
+                counts[index]++;
+        }
+        if (fp)
+            fclose(fp);
+    }
+    closedir(d);
+}
+
+static void test_batch_workers(void)
+{
+    enum { IMAGE_COUNT = 7 };
+    char dir[] = "/tmp/run_tests_batch_XXXXXX";
+    char cwd[1024];
+    CHECK(mkdtemp(dir) != NULL, "batch workers: cannot create directory");
+    if (!getcwd(cwd, sizeof(cwd)) || chdir(dir) != 0) {
+        CHECK(0, "batch workers: cannot enter '%s'", dir);
+        rmdir(dir);
+        return;
+    }
+
+    mkdir("batch_input", 0755);
+    for (int i = 0; i < IMAGE_COUNT; i++) {
+        unsigned char *img = make_image(24 + i, 16 + i, 3, -1);
+        char path[64];
+        snprintf(path, sizeof(path), "batch_input/img-%d.png", i);
+        CHECK(img && stbi_write_png(path, 24 + i, 16 + i, 3, img, (24 + i) * 3),
+              "batch workers: cannot write '%s'",
+              path);
+        free(img);
+    }
+
+    // 先按文件名哈希分片，再从头以认领方式运行：两种方式下每幅输入都只能被一个工作进程处理一次。
+    // 最后以新的认领标识续跑：全部图像都已完成，但仍要被认领，只由认领到它的进程核对和报告
+    log_level_t level = (log_level_t)log_max_level;
+    log_set_level(LOG_LEVEL_ERROR);
+    const char *claim_ids[] = {NULL, "test-run", "test-resume"};
+    for (int run = 0; run < 3; run++) {
+        const char *mode = claim_ids[run] ? claim_ids[run] : "shard";
+        CHECK(batch_run_workers(NULL, NULL, 2, claim_ids[run], run == 2), "batch workers (%s): run failed", mode);
+
+        int counts[IMAGE_COUNT];
+        count_journal_records("batch_output/.journal", counts, IMAGE_COUNT);
+        for (int i = 0; i < IMAGE_COUNT; i++) {
+            char path[64];
+            snprintf(path, sizeof(path), "batch_output/grayscale/img-%d_grayscale.jpg", i);
+            CHECK(counts[i] == 1, "batch workers (%s): img-%d.png processed %d times", mode, i, counts[i]);
+            CHECK(access(path, F_OK) == 0, "batch workers (%s): missing '%s'", mode, path);
+            if (claim_ids[run]) {
+                snprintf(path, sizeof(path), "batch_output/.claims/%s/img-%d.png.claim", claim_ids[run], i);
+                CHECK(access(path, F_OK) == 0, "batch workers (%s): missing '%s'", mode, path);
+            }
+        }
+    }
+
+    // 续跑默认只比较输出的字节数和修改时间：内容被改动、两者都没变的输出只在 BATCH_RESUME_VERIFY 时重做
+    const char *target = "batch_output/grayscale/img-0_grayscale.jpg";
+    struct stat st;
+    FILE *fp = stat(target, &st) == 0 ? fopen(target, "r+b") : NULL;
+    if (fp) {
+        int byte = fseek(fp, 100, SEEK_SET) == 0 ? fgetc(fp) : EOF;
+        if (byte != EOF && fseek(fp, 100, SEEK_SET) == 0)
+            fputc(byte ^ 0xff, fp);
+        fclose(fp);
+        struct utimbuf times = {st.st_atime, st.st_mtime};
+        utime(target, &times);
+    }
+    int counts[IMAGE_COUNT];
+    CHECK(fp && batch_process(NULL, NULL, -1, NULL, BATCH_RESUME), "batch workers: resume run failed");
+    count_journal_records("batch_output/.journal", counts, IMAGE_COUNT);
+    CHECK(counts[0] == 1, "batch workers: default resume redid the altered output (%d records)", counts[0]);
+    CHECK(batch_process(NULL, NULL, -1, NULL, BATCH_RESUME_VERIFY), "batch workers: verify run failed");
+    count_journal_records("batch_output/.journal", counts, IMAGE_COUNT);
+    CHECK(counts[0] == 2 && counts[1] == 1,
+          "batch workers: verify redid img-0.png %d times, img-1.png %d times",
+          counts[0] - 1,
+          counts[1] - 1);
+    log_set_level(level);
+
+    CHECK(chdir(cwd) == 0, "batch workers: cannot return to '%s'", cwd);
+    remove_tree(dir);
+}
+
+int main(int argc, char **argv)
+{
+    int update = argc > 1 && strcmp(argv[1], "--update-golden") == 0;
+    if (argc != 3 + update) {
+        fprintf(stderr, "Usage: %s [--update-golden] <golden_dir> <lenna.png>\n", argv[0]);
+        return 2;
+    }
+    const char *golden_dir = argv[1 + update];
+    const char *lenna_path = argv[2 + update];
+
+    // 标准输出随仓库提交，生成时使用最高压缩级别
+    if (update)
+        stbi_write_png_compression_level = 9;
+
+    printf("Golden outputs (%s):\n", golden_dir);
+    test_golden(golden_dir, lenna_path, update);
+    if (update) {
+        printf("Golden outputs updated\n");
+        return failures ? 1 : 0;
+    }
+
+    printf("Synthetic edge cases\n");
+    test_synthetic();
+    printf("Float pipeline\n");
+    test_hdr(lenna_path);
+    printf("Scheduler\n");
+    test_scheduler();
+    printf("ASCII art\n");
+    test_ascii_color();
+    test_ascii_edges();
+    printf("Reduced decode\n");
+    test_reduced_load(lenna_path);
+    printf("Perceptual hash\n");
+    test_phash(lenna_path);
+    test_hash_index();
+    printf("Progress journal\n");
+    test_journal();
+    printf("Pixel cache\n");
+    test_pixel_cache();
+    printf("Server mode\n");
+    test_server(lenna_path);
+    printf("Pipe mode\n");
+    test_stream_pipe(lenna_path);
+    printf("Batch workers\n");
+    test_batch_workers();
+
+    printf("%d checks, %d failures\n", checks, failures);
+    return failures ? 1 : 0;
+}